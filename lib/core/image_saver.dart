@@ -1,8 +1,10 @@
+import 'dart:isolate';
 import 'dart:ui' as ui;
-import 'dart:typed_data';
 import 'package:flutter/material.dart';
 import 'package:file_picker/file_picker.dart';
 import '../data/models/heptapod_spectrum.dart';
+import '../data/services/native_renderer.dart';
+import '../ui/painters/heptapod_geometry.dart';
 import '../ui/painters/heptapod_painter.dart';
 
 class ImageSaver {
@@ -10,21 +12,14 @@ class ImageSaver {
       HeptapodSpectrum spectrum,
       {double size = 2048.0}) async {
 
-    final recorder = ui.PictureRecorder();
-    final canvas = Canvas(recorder);
-    // Note: If exact reproduction is needed, the seed should be stored in the state.
-    // Currently using default seed behavior.
-    final painter = HeptapodPainter(spectrum: spectrum);
-
-    // Fill background with black (Zen Theme)
-    final bgPaint = Paint()..color = const Color(0xFF101010);
-    canvas.drawRect(Rect.fromLTWH(0, 0, size, size), bgPaint);
-
-    painter.paint(canvas, Size(size, size));
+    if (NativeRenderer.instance != null) {
+      await _exportNative(spectrum, size.toInt());
+      return;
+    }
 
-    final picture = recorder.endRecording();
-    final img = await picture.toImage(size.toInt(), size.toInt());
+    final img = await _renderPicture(spectrum, size);
     final byteData = await img.toByteData(format: ui.ImageByteFormat.png);
+    img.dispose();
 
     if (byteData != null) {
       final buffer = byteData.buffer.asUint8List();
@@ -50,4 +45,56 @@ class ImageSaver {
       }
     }
   }
+
+  /// Asks where to save first, then renders natively on a background
+  /// isolate straight into that file. Rows are compressed on all cores as
+  /// they are rendered and streamed to disk, so even an 8K export holds
+  /// only a few megabytes of pixels and PNG data at a time.
+  static Future<void> _exportNative(HeptapodSpectrum spectrum, int size) async {
+    try {
+      final outputFile = await FilePicker.platform.saveFile(
+        dialogTitle: 'Save Logogram',
+        fileName: 'heptapod_logogram.png',
+        type: FileType.image,
+      );
+      if (outputFile == null) {
+        debugPrint('User canceled save.');
+        return;
+      }
+
+      final shape = HeptapodGeometry.shapeOf(spectrum);
+      final style = HeptapodPainter.nativeStyle(size, size);
+      await Isolate.run(() => NativeRenderer.instance!.exportPng(
+            path: outputFile,
+            coreAmplitude: shape.coreAmplitude,
+            nuanceChaos: shape.nuanceChaos,
+            nuanceAmplitude: shape.nuanceAmplitude,
+            seed: HeptapodPainter.defaultSeed,
+            style: style,
+          ));
+      debugPrint('Saved to $outputFile');
+    } catch (e) {
+      debugPrint('Error saving file: $e');
+    }
+  }
+
+  /// Replays [HeptapodPainter] into a picture. Used where the native
+  /// library is not available.
+  static Future<ui.Image> _renderPicture(
+      HeptapodSpectrum spectrum, double size) {
+    final recorder = ui.PictureRecorder();
+    final canvas = Canvas(recorder);
+    // Note: If exact reproduction is needed, the seed should be stored in the state.
+    // Currently using default seed behavior.
+    final painter = HeptapodPainter(spectrum: spectrum);
+
+    // Fill background with black (Zen Theme)
+    final bgPaint = Paint()..color = const Color(0xFF101010);
+    canvas.drawRect(Rect.fromLTWH(0, 0, size, size), bgPaint);
+
+    painter.paint(canvas, Size(size, size));
+
+    final picture = recorder.endRecording();
+    return picture.toImage(size.toInt(), size.toInt());
+  }
 }
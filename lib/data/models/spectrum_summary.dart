@@ -1,12 +1,30 @@
+import 'dart:typed_data';
+
 class SpectrumSummary {
   final List<double> dominantFrequencies;
   final double chaosLevel;
   final double density;
 
+  /// Mean ink distance along each ray cast from the centroid, when asked
+  /// for.
+  final Float64List? rayProfile;
+
+  /// Magnitudes of bins 0 to rays / 2 of [rayProfile]'s DFT, when asked
+  /// for.
+  final Float64List? spectrum;
+
+  /// Whether this is a coarse estimate sent while a progressive analysis
+  /// runs. Its [chaosLevel] is provisional: measured at reduced
+  /// resolution, it runs higher than the final result's.
+  final bool isPreview;
+
   SpectrumSummary({
     required this.dominantFrequencies,
     required this.chaosLevel,
     required this.density,
+    this.rayProfile,
+    this.spectrum,
+    this.isPreview = false,
   });
 
   @override
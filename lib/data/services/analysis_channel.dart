@@ -0,0 +1,212 @@
+import 'dart:convert';
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
+import '../models/spectrum_summary.dart';
+import 'native_analysis.dart';
+
+/// Thrown when a newer request under the same key superseded an analysis,
+/// or the app shut down before it finished.
+class AnalysisCancelledException implements Exception {
+  const AnalysisCancelledException();
+
+  @override
+  String toString() => 'AnalysisCancelledException';
+}
+
+/// Client of the `orbita/analysis` channel the Linux runner serves (see
+/// linux/runner/analysis_channel.h for the message layout).
+///
+/// Requests and results travel as raw bytes rather than codec maps, and
+/// the runner analyses on its own worker threads, so a call costs the UI
+/// isolate only the encoding of a short header. Ray profiles and spectra
+/// are views into the response buffer, not copies.
+class AnalysisChannel {
+  static const String name = 'orbita/analysis';
+  static const String previewName = 'orbita/analysis/preview';
+
+  static const int _sourcePath = 0;
+  static const int _sourceBytes = 1;
+  static const int _flagRays = 1 << 0;
+  static const int _flagSpectrum = 1 << 1;
+  static const int _flagProgressive = 1 << 2;
+  static const int _requestHeaderSize = 8;
+  static const int _previewIdSize = 4;
+  static const int _previewHeaderSize = 16;
+  static const int _responseHeaderSize = 16;
+  static const int _summaryValues = 7;
+
+  /// Scheduling class of interactive analysis; see JobPriority in
+  /// linux/native/job_scheduler.h.
+  static const int interpretPriority = 1;
+
+  /// Preview callbacks of the progressive requests in flight, by id.
+  static final Map<int, void Function(SpectrumSummary)> _previewHandlers = {};
+  static final Set<BinaryMessenger> _previewMessengers = {};
+  static int _lastPreviewId = 0;
+
+  final BinaryMessenger? _messenger;
+
+  /// Sends on [messenger], or on the app's default messenger if null.
+  const AnalysisChannel({BinaryMessenger? messenger}) : _messenger = messenger;
+
+  /// Analyses the JPEG or PNG file at [path]; see [analyzeBytes].
+  Future<SpectrumSummary?> analyzeFile(String path,
+      {int workingPixels = 0,
+      bool rays = false,
+      bool spectrum = false,
+      int priority = interpretPriority,
+      int key = 0,
+      void Function(SpectrumSummary)? onPreview}) {
+    return _send(_sourcePath, utf8.encode(path),
+        workingPixels: workingPixels,
+        rays: rays,
+        spectrum: spectrum,
+        priority: priority,
+        key: key,
+        onPreview: onPreview);
+  }
+
+  /// Analyses the encoded JPEG or PNG image in [bytes].
+  ///
+  /// Images with at least four times [workingPixels] pixels are reduced
+  /// while decoding; 0 analyses at full resolution. [rays] and [spectrum]
+  /// ask for [SpectrumSummary.rayProfile] and [SpectrumSummary.spectrum];
+  /// summaries without them may be answered from the result cache.
+  ///
+  /// The request is scheduled at [priority]. A non-zero [key] (1 to 255)
+  /// supersedes any earlier request with the same key, which then throws
+  /// [AnalysisCancelledException].
+  ///
+  /// With [onPreview], the image is analysed progressively: estimates from
+  /// reduced copies of it, marked [SpectrumSummary.isPreview] and carrying
+  /// no ray profile or spectrum, are passed to [onPreview] as they are
+  /// ready, coarsest first, before the returned future completes with the
+  /// full result.
+  ///
+  /// Returns null if the runner does not serve the channel or the image
+  /// cannot be decoded natively (a format other than JPEG and PNG, or a
+  /// variant the native decoders reject), and throws on any other failure.
+  Future<SpectrumSummary?> analyzeBytes(Uint8List bytes,
+      {int workingPixels = 0,
+      bool rays = false,
+      bool spectrum = false,
+      int priority = interpretPriority,
+      int key = 0,
+      void Function(SpectrumSummary)? onPreview}) {
+    return _send(_sourceBytes, bytes,
+        workingPixels: workingPixels,
+        rays: rays,
+        spectrum: spectrum,
+        priority: priority,
+        key: key,
+        onPreview: onPreview);
+  }
+
+  Future<SpectrumSummary?> _send(int source, List<int> payload,
+      {required int workingPixels,
+      required bool rays,
+      required bool spectrum,
+      required int priority,
+      required int key,
+      void Function(SpectrumSummary)? onPreview}) async {
+    final progressive = onPreview != null;
+    final payloadStart =
+        _requestHeaderSize + (progressive ? _previewIdSize : 0);
+    final request = Uint8List(payloadStart + payload.length);
+    final header = ByteData.sublistView(request)
+      ..setUint8(0, source)
+      ..setUint8(
+          1,
+          (rays ? _flagRays : 0) |
+              (spectrum ? _flagSpectrum : 0) |
+              (progressive ? _flagProgressive : 0))
+      ..setUint8(2, priority)
+      ..setUint8(3, key)
+      ..setInt32(4, workingPixels, Endian.little);
+    request.setAll(payloadStart, payload);
+
+    final messenger =
+        _messenger ?? ServicesBinding.instance.defaultBinaryMessenger;
+    int? previewId;
+    if (onPreview != null) {
+      previewId = _lastPreviewId = (_lastPreviewId + 1) & 0xffffffff;
+      header.setUint32(_requestHeaderSize, previewId, Endian.little);
+      _listenForPreviews(messenger);
+      _previewHandlers[previewId] = onPreview;
+    }
+    try {
+      final response =
+          await messenger.send(name, ByteData.sublistView(request));
+      if (response == null) return null;
+      return _decode(response);
+    } finally {
+      if (previewId != null) _previewHandlers.remove(previewId);
+    }
+  }
+
+  /// Routes previews arriving on [messenger] to their requests' callbacks.
+  /// Previews of requests that have already been answered are dropped.
+  static void _listenForPreviews(BinaryMessenger messenger) {
+    if (!_previewMessengers.add(messenger)) return;
+    messenger.setMessageHandler(previewName, (message) async {
+      const size = _previewHeaderSize + _summaryValues * 8;
+      if (message == null || message.lengthInBytes < size) return null;
+      final handler = _previewHandlers[message.getUint32(0, Endian.little)];
+      if (handler == null) return null;
+      final values = _doubles(message, _previewHeaderSize, _summaryValues);
+      handler(SpectrumSummary(
+        dominantFrequencies: values.sublist(0, 5),
+        chaosLevel: values[5],
+        density: values[6],
+        isPreview: true,
+      ));
+      return null;
+    });
+  }
+
+  static SpectrumSummary? _decode(ByteData response) {
+    final status = response.getInt32(0, Endian.little);
+    if (status == NativeStatus.unsupportedFormat ||
+        status == NativeStatus.decode) {
+      return null;
+    }
+    if (status == NativeStatus.cancelled) {
+      throw const AnalysisCancelledException();
+    }
+    if (status != NativeStatus.ok) {
+      throw Exception('Native analysis failed with status $status');
+    }
+    final rayCount = response.getInt32(4, Endian.little);
+    final binCount = response.getInt32(8, Endian.little);
+
+    final values = _doubles(response, _responseHeaderSize,
+        _summaryValues + rayCount + binCount);
+    const rayStart = _summaryValues;
+    final binStart = rayStart + rayCount;
+    return SpectrumSummary(
+      dominantFrequencies: values.sublist(0, 5),
+      chaosLevel: values[5],
+      density: values[6],
+      rayProfile: rayCount > 0
+          ? Float64List.sublistView(values, rayStart, binStart)
+          : null,
+      spectrum: binCount > 0
+          ? Float64List.sublistView(values, binStart, binStart + binCount)
+          : null,
+    );
+  }
+
+  /// [count] doubles at [offset] in [data], viewed in place when they are
+  /// 8-byte aligned in the underlying buffer and copied otherwise.
+  static Float64List _doubles(ByteData data, int offset, int count) {
+    final start = data.offsetInBytes + offset;
+    if (start % Float64List.bytesPerElement == 0) {
+      return data.buffer.asFloat64List(start, count);
+    }
+    final copy = Float64List(count);
+    for (int i = 0; i < count; i++) {
+      copy[i] = data.getFloat64(offset + i * 8, Endian.little);
+    }
+    return copy;
+  }
+}
@@ -1,15 +1,96 @@
 import 'dart:io';
+import 'dart:isolate';
 import 'dart:math' as math;
 import 'package:image/image.dart' as img;
 import 'package:fftea/fftea.dart';
 import '../models/spectrum_summary.dart';
+import 'analysis_channel.dart';
+import 'native_analysis.dart';
 
 class AnalysisService {
+  /// Working resolution for native analysis. 48 MP photos are decoded at
+  /// half size; typical 12 MP photos are still analysed in full.
+  static const int workingPixels = 4000000;
+
+  /// Number of results kept in the on-disk cache before the least recently
+  /// used are evicted (about 100 bytes each).
+  static const int cacheCapacity = 65536;
+
+  /// Supersede key of the Interpret tab's analyses.
+  static const int interpretKey = 1;
+
+  final AnalysisChannel? _channel;
+  int? _cacheAddress;
+
+  /// With a [channel], native analysis runs on the runner's worker threads
+  /// instead of a background isolate.
+  AnalysisService({AnalysisChannel? channel}) : _channel = channel;
+
   /// Analyzes the given image file to extract spectral data.
   ///
-  /// This operation is computationally expensive and should ideally be run
-  /// in a separate isolate in a production Flutter app using [compute].
-  Future<SpectrumSummary> analyzeImage(File imageFile) async {
+  /// On Linux, JPEG and PNG files go through the native library: over the
+  /// runner's [AnalysisChannel] when there is one, or else through
+  /// [NativeAnalysis] on a background isolate. Other formats, and files the
+  /// native decoders reject, fall back to [analyzeImageDart]. With [detail],
+  /// channel results also carry the ray profile and its spectrum.
+  ///
+  /// On the channel, a non-zero [key] cancels any earlier analysis under
+  /// the same key still running, which then throws
+  /// [AnalysisCancelledException].
+  /// It also passes coarse estimates to [onPreview] while the full
+  /// analysis runs; the other paths never call it.
+  ///
+  /// Native results are cached on disk by file content, so picking an image
+  /// that was already analysed, even in an earlier session, returns without
+  /// decoding it again.
+  Future<SpectrumSummary> analyzeImage(File imageFile,
+      {bool detail = false,
+      int key = 0,
+      void Function(SpectrumSummary)? onPreview}) async {
+    final channel = _channel;
+    if (channel != null) {
+      final summary = await channel.analyzeFile(imageFile.path,
+          workingPixels: workingPixels,
+          rays: detail,
+          spectrum: detail,
+          key: key,
+          onPreview: onPreview);
+      if (summary != null) return summary;
+    }
+
+    final native = NativeAnalysis.instance;
+    if (native != null) {
+      final path = imageFile.path;
+      final cacheAddress = _cacheAddress ??= _openCache(native);
+      final summary = await Isolate.run(() => NativeAnalysis.instance!
+          .analyzeFile(path,
+              workingPixels: workingPixels, cacheAddress: cacheAddress));
+      if (summary != null) return summary;
+    }
+    return Isolate.run(() => AnalysisService().analyzeImageDart(imageFile));
+  }
+
+  /// Opens the result cache under the XDG cache directory. Returns 0, which
+  /// disables caching, if there is nowhere to put it.
+  static int _openCache(NativeAnalysis native) {
+    final env = Platform.environment;
+    final base = env['XDG_CACHE_HOME'] ??
+        (env['HOME'] != null ? '${env['HOME']}/.cache' : null);
+    if (base == null) return 0;
+    try {
+      final dir = Directory('$base/orbita')..createSync(recursive: true);
+      return native.openCache('${dir.path}/analysis-results.bin',
+          capacity: cacheCapacity);
+    } on FileSystemException {
+      return 0;
+    }
+  }
+
+  /// Pure Dart implementation of the analysis pipeline.
+  ///
+  /// This operation is computationally expensive; [analyzeImage] runs it on
+  /// a background isolate.
+  Future<SpectrumSummary> analyzeImageDart(File imageFile) async {
     // 1. Load image
     final bytes = await imageFile.readAsBytes();
     img.Image? originalImage = img.decodeImage(bytes);
@@ -0,0 +1,77 @@
+import 'package:flutter/services.dart';
+import 'native_renderer.dart';
+
+/// How the logogram on screen turns into the next one the texture renders.
+enum LogogramTransition {
+  /// Replaced at once.
+  none,
+
+  /// Moves point by point into the new logogram, growing and retracting
+  /// tendrils where the two differ.
+  morph,
+
+  /// Writes the new logogram onto a blank canvas: the loop first, then its
+  /// tendrils and particles.
+  write,
+}
+
+/// Client of the live preview texture the Linux runner registers (see
+/// linux/runner/logogram_texture.h).
+///
+/// The runner renders logograms natively on its own thread and hands the
+/// finished frames straight to the engine, so showing one only takes a
+/// `Texture` widget and a [render] request; no geometry is built and no
+/// pixels are copied on the Dart side.
+class LogogramTexture {
+  static const _channel = MethodChannel('orbita/logogram_texture');
+  static Future<int?>? _textureId;
+
+  /// Id of the preview texture, or null where the runner provides none.
+  static Future<int?> textureId() => _textureId ??= _fetchTextureId();
+
+  static Future<int?> _fetchTextureId() async {
+    try {
+      return await _channel.invokeMethod<int>('textureId');
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  /// Asks for the logogram described by the `HeptapodGeometry.shapeOf`
+  /// values and [seed] to be drawn with [style] as the next frame.
+  ///
+  /// With a [transition] other than [LogogramTransition.none], the runner
+  /// animates to it over [duration], generating every frame natively at
+  /// display rate. A request that arrives mid-animation continues from the
+  /// frame on screen. A morph needs a logogram of the same size on screen
+  /// and otherwise draws the new one at once.
+  ///
+  /// Completes as soon as the request is queued. Requests that arrive while
+  /// a frame is rendering replace each other, so only the newest is drawn.
+  static Future<void> render({
+    required double coreAmplitude,
+    required double nuanceChaos,
+    required double nuanceAmplitude,
+    required int seed,
+    required LogogramStyle style,
+    LogogramTransition transition = LogogramTransition.none,
+    Duration duration = Duration.zero,
+  }) {
+    return _channel.invokeMethod<void>('render', {
+      'coreAmplitude': coreAmplitude,
+      'nuanceChaos': nuanceChaos,
+      'nuanceAmplitude': nuanceAmplitude,
+      'seed': seed,
+      'width': style.width,
+      'height': style.height,
+      'backgroundArgb': style.backgroundArgb,
+      'strokeArgb': style.strokeArgb,
+      'strokeWidth': style.strokeWidth,
+      'strokeBlurSigma': style.strokeBlurSigma,
+      'particleArgb': style.particleArgb,
+      'particleRadius': style.particleRadius,
+      'transition': transition.index,
+      'durationMs': duration.inMilliseconds,
+    });
+  }
+}
@@ -0,0 +1,175 @@
+import 'dart:convert';
+import 'dart:ffi';
+import '../models/spectrum_summary.dart';
+import 'native_library.dart';
+
+/// Status codes returned by liborbita_native.
+///
+/// Mirrors `OrbitaStatus` in linux/native/orbita_native.h.
+class NativeStatus {
+  static const int ok = 0;
+  static const int invalidArgument = 1;
+  static const int io = 2;
+  static const int unsupportedFormat = 3;
+  static const int decode = 4;
+  static const int outOfMemory = 5;
+  static const int cancelled = 6;
+}
+
+final class OrbitaAnalysisParams extends Struct {
+  @Int32()
+  external int blurRadius;
+
+  @Int32()
+  external int threshold;
+
+  @Int32()
+  external int rayCount;
+
+  @Int32()
+  external int workingPixels;
+}
+
+final class OrbitaSpectrumSummary extends Struct {
+  @Array(5)
+  external Array<Double> dominantFrequencies;
+
+  @Double()
+  external double chaosLevel;
+
+  @Double()
+  external double density;
+}
+
+typedef _ParamsInitNative = Void Function(Pointer<OrbitaAnalysisParams>);
+typedef _ParamsInit = void Function(Pointer<OrbitaAnalysisParams>);
+typedef _AnalyzeFileNative = Int32 Function(
+    Pointer<Uint8>, Pointer<OrbitaAnalysisParams>, Pointer<OrbitaSpectrumSummary>);
+typedef _AnalyzeFile = int Function(
+    Pointer<Uint8>, Pointer<OrbitaAnalysisParams>, Pointer<OrbitaSpectrumSummary>);
+typedef _CacheOpenNative = Int32 Function(
+    Pointer<Uint8>, Int32, Pointer<Pointer<Void>>);
+typedef _CacheOpen = int Function(Pointer<Uint8>, int, Pointer<Pointer<Void>>);
+typedef _AnalyzeFileCachedNative = Int32 Function(Pointer<Void>,
+    Pointer<Uint8>, Pointer<OrbitaAnalysisParams>, Pointer<OrbitaSpectrumSummary>);
+typedef _AnalyzeFileCached = int Function(Pointer<Void>, Pointer<Uint8>,
+    Pointer<OrbitaAnalysisParams>, Pointer<OrbitaSpectrumSummary>);
+typedef _MallocNative = Pointer<Void> Function(IntPtr);
+typedef _Malloc = Pointer<Void> Function(int);
+typedef _FreeNative = Void Function(Pointer<Void>);
+typedef _Free = void Function(Pointer<Void>);
+
+/// FFI bindings to the native analysis library built from linux/native.
+///
+/// The library is only bundled with the Linux runner; on every other
+/// platform [instance] is null and callers use the Dart pipeline.
+class NativeAnalysis {
+  final _ParamsInit _paramsInit;
+  final _AnalyzeFile _analyzeFile;
+  final _CacheOpen _cacheOpen;
+  final _AnalyzeFileCached _analyzeFileCached;
+  final _Malloc _malloc;
+  final _Free _free;
+
+  NativeAnalysis._(DynamicLibrary lib)
+      : _paramsInit = lib.lookupFunction<_ParamsInitNative, _ParamsInit>(
+            'orbita_analysis_params_init'),
+        _analyzeFile = lib.lookupFunction<_AnalyzeFileNative, _AnalyzeFile>(
+            'orbita_analyze_file'),
+        _cacheOpen = lib.lookupFunction<_CacheOpenNative, _CacheOpen>(
+            'orbita_result_cache_open'),
+        _analyzeFileCached =
+            lib.lookupFunction<_AnalyzeFileCachedNative, _AnalyzeFileCached>(
+                'orbita_analyze_file_cached'),
+        _malloc = lib.lookupFunction<_MallocNative, _Malloc>('orbita_malloc'),
+        _free = lib.lookupFunction<_FreeNative, _Free>('orbita_free');
+
+  /// The loaded library, or null if it is not available. Loaded lazily once
+  /// per isolate.
+  static final NativeAnalysis? instance = _load();
+
+  static NativeAnalysis? _load() {
+    final lib = openOrbitaNative();
+    return lib == null ? null : NativeAnalysis._(lib);
+  }
+
+  /// Opens (or creates) the persistent result cache at [path], holding up
+  /// to [capacity] results.
+  ///
+  /// Returns the address of the native handle, or 0 if the file cannot be
+  /// opened. The handle is process-wide, so the address can be passed to
+  /// [analyzeFile] from any isolate.
+  int openCache(String path, {required int capacity}) {
+    final pathPtr = _toCString(path);
+    final handlePtr = _malloc(sizeOf<Pointer<Void>>()).cast<Pointer<Void>>();
+    try {
+      final status = _cacheOpen(pathPtr, capacity, handlePtr);
+      return status == NativeStatus.ok ? handlePtr.value.address : 0;
+    } finally {
+      _free(handlePtr.cast());
+      _free(pathPtr.cast());
+    }
+  }
+
+  /// Runs the native pipeline over the image at [path].
+  ///
+  /// Images with at least four times [workingPixels] pixels are reduced
+  /// while decoding; 0 analyses at full resolution.
+  ///
+  /// With a [cacheAddress] from [openCache], an image whose bytes were
+  /// already analysed is answered from the cache without decoding it.
+  ///
+  /// Blocks the calling isolate, so call it from a background isolate.
+  /// Returns null if the image cannot be decoded natively (a format other
+  /// than JPEG and PNG, or a variant the native decoders reject), and
+  /// throws on any other failure.
+  SpectrumSummary? analyzeFile(String path,
+      {int workingPixels = 0, int cacheAddress = 0}) {
+    final pathPtr = _toCString(path);
+    final paramsPtr =
+        _malloc(sizeOf<OrbitaAnalysisParams>()).cast<OrbitaAnalysisParams>();
+    final summaryPtr =
+        _malloc(sizeOf<OrbitaSpectrumSummary>()).cast<OrbitaSpectrumSummary>();
+
+    try {
+      _paramsInit(paramsPtr);
+      paramsPtr.ref.workingPixels = workingPixels;
+      final status = cacheAddress != 0
+          ? _analyzeFileCached(Pointer.fromAddress(cacheAddress), pathPtr,
+              paramsPtr, summaryPtr)
+          : _analyzeFile(pathPtr, paramsPtr, summaryPtr);
+      if (status == NativeStatus.unsupportedFormat ||
+          status == NativeStatus.decode) {
+        return null;
+      }
+      if (status != NativeStatus.ok) {
+        throw Exception('Native analysis failed with status $status');
+      }
+
+      return _toSummary(summaryPtr.ref);
+    } finally {
+      _free(summaryPtr.cast());
+      _free(paramsPtr.cast());
+      _free(pathPtr.cast());
+    }
+  }
+
+  static SpectrumSummary _toSummary(OrbitaSpectrumSummary summary) {
+    return SpectrumSummary(
+      dominantFrequencies:
+          List<double>.generate(5, (i) => summary.dominantFrequencies[i]),
+      chaosLevel: summary.chaosLevel,
+      density: summary.density,
+    );
+  }
+
+  /// Copies [value] into a NUL-terminated UTF-8 buffer from [_malloc].
+  Pointer<Uint8> _toCString(String value) {
+    final encoded = utf8.encode(value);
+    final pointer = _malloc(encoded.length + 1).cast<Uint8>();
+    final bytes = pointer.asTypedList(encoded.length + 1);
+    bytes.setAll(0, encoded);
+    bytes[encoded.length] = 0;
+    return pointer;
+  }
+}
@@ -0,0 +1,135 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'native_analysis.dart';
+import 'native_library.dart';
+
+/// Mirrors `OrbitaLogogramShape` in linux/native/orbita_native.h.
+final class OrbitaLogogramShape extends Struct {
+  @Double()
+  external double coreAmplitude;
+
+  @Double()
+  external double nuanceChaos;
+
+  @Double()
+  external double nuanceAmplitude;
+}
+
+typedef _AcquireNative = Int32 Function(Pointer<OrbitaLogogramShape>, Int32,
+    Double, Double, Pointer<Pointer<Void>>);
+typedef _Acquire = int Function(
+    Pointer<OrbitaLogogramShape>, int, double, double, Pointer<Pointer<Void>>);
+typedef _CountsNative = Void Function(
+    Pointer<Void>, Pointer<Int32>, Pointer<Int32>, Pointer<Int32>);
+typedef _Counts = void Function(
+    Pointer<Void>, Pointer<Int32>, Pointer<Int32>, Pointer<Int32>);
+typedef _CopyNative = Void Function(
+    Pointer<Void>, Pointer<Float>, Pointer<Int32>, Pointer<Float>);
+typedef _Copy = void Function(
+    Pointer<Void>, Pointer<Float>, Pointer<Int32>, Pointer<Float>);
+typedef _ReleaseNative = Void Function(Pointer<Void>);
+typedef _Release = void Function(Pointer<Void>);
+typedef _MallocNative = Pointer<Void> Function(IntPtr);
+typedef _Malloc = Pointer<Void> Function(int);
+typedef _FreeNative = Void Function(Pointer<Void>);
+typedef _Free = void Function(Pointer<Void>);
+
+/// Logogram geometry flattened as for `orbita_render_logogram`: x, y point
+/// pairs, (first point, point count, closed, layer) polyline records and
+/// x, y particle centres.
+typedef LogogramBuffers = ({
+  Float32List points,
+  Int32List polylines,
+  Float32List particles,
+});
+
+/// FFI bindings to the native logogram geometry builder and its cache.
+///
+/// Produces exactly what HeptapodGeometry.build does, but keeps recently
+/// built logograms in a process-wide cache shared by all isolates: asking
+/// again for the same logogram at the same size costs only the copy. Null
+/// where the native library is not available.
+class NativeGeometry {
+  final _Acquire _acquire;
+  final _Counts _counts;
+  final _Copy _copy;
+  final _Release _release;
+  final _Malloc _malloc;
+  final _Free _free;
+
+  NativeGeometry._(DynamicLibrary lib)
+      : _acquire = lib.lookupFunction<_AcquireNative, _Acquire>(
+            'orbita_logogram_acquire'),
+        _counts = lib.lookupFunction<_CountsNative, _Counts>(
+            'orbita_logogram_counts'),
+        _copy =
+            lib.lookupFunction<_CopyNative, _Copy>('orbita_logogram_copy'),
+        _release = lib.lookupFunction<_ReleaseNative, _Release>(
+            'orbita_logogram_release'),
+        _malloc = lib.lookupFunction<_MallocNative, _Malloc>('orbita_malloc'),
+        _free = lib.lookupFunction<_FreeNative, _Free>('orbita_free');
+
+  static final NativeGeometry? instance = _load();
+
+  static NativeGeometry? _load() {
+    final lib = openOrbitaNative();
+    return lib == null ? null : NativeGeometry._(lib);
+  }
+
+  /// Geometry of a logogram on a [width] x [height] canvas. Throws if the
+  /// native side rejects the input.
+  LogogramBuffers build({
+    required double coreAmplitude,
+    required double nuanceChaos,
+    required double nuanceAmplitude,
+    required int seed,
+    required double width,
+    required double height,
+  }) {
+    final shapePtr =
+        _malloc(sizeOf<OrbitaLogogramShape>()).cast<OrbitaLogogramShape>();
+    final handlePtr = _malloc(sizeOf<Pointer<Void>>()).cast<Pointer<Void>>();
+    final countsPtr = _malloc(3 * sizeOf<Int32>()).cast<Int32>();
+    Pointer<Void> handle = nullptr;
+    Pointer<Float> pointsPtr = nullptr;
+    Pointer<Int32> polylinesPtr = nullptr;
+    Pointer<Float> particlesPtr = nullptr;
+
+    try {
+      shapePtr.ref
+        ..coreAmplitude = coreAmplitude
+        ..nuanceChaos = nuanceChaos
+        ..nuanceAmplitude = nuanceAmplitude;
+      final status = _acquire(shapePtr, seed, width, height, handlePtr);
+      if (status != NativeStatus.ok) {
+        throw Exception('Native geometry failed with status $status');
+      }
+      handle = handlePtr.value;
+
+      _counts(handle, countsPtr, countsPtr + 1, countsPtr + 2);
+      final pointCount = countsPtr[0];
+      final polylineCount = countsPtr[1];
+      final particleCount = countsPtr[2];
+      pointsPtr = _malloc(pointCount * 8 + 4).cast<Float>();
+      polylinesPtr = _malloc(polylineCount * 16 + 4).cast<Int32>();
+      particlesPtr = _malloc(particleCount * 8 + 4).cast<Float>();
+      _copy(handle, pointsPtr, polylinesPtr, particlesPtr);
+
+      return (
+        points: Float32List.fromList(pointsPtr.asTypedList(pointCount * 2)),
+        polylines:
+            Int32List.fromList(polylinesPtr.asTypedList(polylineCount * 4)),
+        particles:
+            Float32List.fromList(particlesPtr.asTypedList(particleCount * 2)),
+      );
+    } finally {
+      if (handle != nullptr) _release(handle);
+      _free(particlesPtr.cast());
+      _free(polylinesPtr.cast());
+      _free(pointsPtr.cast());
+      _free(countsPtr.cast());
+      _free(handlePtr.cast());
+      _free(shapePtr.cast());
+    }
+  }
+}
@@ -0,0 +1,18 @@
+import 'dart:ffi';
+import 'dart:io';
+
+/// Name of the native library built from linux/native.
+const String orbitaNativeLibraryName = 'liborbita_native.so';
+
+/// Opens liborbita_native, or returns null where it is not available.
+///
+/// The library is only bundled with the Linux runner; on every other
+/// platform callers use their pure Dart fallback.
+DynamicLibrary? openOrbitaNative() {
+  if (!Platform.isLinux) return null;
+  try {
+    return DynamicLibrary.open(orbitaNativeLibraryName);
+  } on ArgumentError {
+    return null;
+  }
+}
@@ -0,0 +1,61 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'native_analysis.dart';
+import 'native_library.dart';
+
+typedef _SimplexNative = Int32 Function(
+    Int32, Double, Pointer<Double>, Pointer<Double>, Int32, Pointer<Double>);
+typedef _Simplex = int Function(
+    int, double, Pointer<Double>, Pointer<Double>, int, Pointer<Double>);
+typedef _MallocNative = Pointer<Void> Function(IntPtr);
+typedef _Malloc = Pointer<Void> Function(int);
+typedef _FreeNative = Void Function(Pointer<Void>);
+typedef _Free = void Function(Pointer<Void>);
+
+/// FFI bindings to the native batched simplex noise.
+///
+/// Results are bit-identical to package:fast_noise's
+/// `SimplexNoise(seed: seed, frequency: frequency).getNoise2`, so callers
+/// can switch between the two freely. Null where the native library is not
+/// available.
+class NativeNoise {
+  final _Simplex _simplex;
+  final _Malloc _malloc;
+  final _Free _free;
+
+  NativeNoise._(DynamicLibrary lib)
+      : _simplex = lib.lookupFunction<_SimplexNative, _Simplex>(
+            'orbita_simplex_noise2'),
+        _malloc = lib.lookupFunction<_MallocNative, _Malloc>('orbita_malloc'),
+        _free = lib.lookupFunction<_FreeNative, _Free>('orbita_free');
+
+  static final NativeNoise? instance = _load();
+
+  static NativeNoise? _load() {
+    final lib = openOrbitaNative();
+    return lib == null ? null : NativeNoise._(lib);
+  }
+
+  /// Evaluates 2D simplex noise at every (xs[i], ys[i]).
+  Float64List simplex2(
+      int seed, double frequency, Float64List xs, Float64List ys) {
+    final count = xs.length;
+    final bytes = count * sizeOf<Double>() + 8;
+    final xPtr = _malloc(bytes).cast<Double>();
+    final yPtr = _malloc(bytes).cast<Double>();
+    final outPtr = _malloc(bytes).cast<Double>();
+    try {
+      xPtr.asTypedList(count).setAll(0, xs);
+      yPtr.asTypedList(count).setAll(0, ys);
+      final status = _simplex(seed, frequency, xPtr, yPtr, count, outPtr);
+      if (status != NativeStatus.ok) {
+        throw Exception('Native noise failed with status $status');
+      }
+      return Float64List.fromList(outPtr.asTypedList(count));
+    } finally {
+      _free(outPtr.cast());
+      _free(yPtr.cast());
+      _free(xPtr.cast());
+    }
+  }
+}
@@ -0,0 +1,151 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'native_analysis.dart';
+import 'native_geometry.dart';
+import 'native_library.dart';
+
+/// Mirrors `OrbitaRenderStyle` in linux/native/orbita_native.h.
+final class OrbitaRenderStyle extends Struct {
+  @Int32()
+  external int width;
+
+  @Int32()
+  external int height;
+
+  @Uint32()
+  external int backgroundArgb;
+
+  @Uint32()
+  external int strokeArgb;
+
+  @Float()
+  external double strokeWidth;
+
+  @Float()
+  external double strokeBlurSigma;
+
+  @Uint32()
+  external int particleArgb;
+
+  @Float()
+  external double particleRadius;
+}
+
+/// Appearance of a rendered logogram. Colours are ARGB values as in
+/// `Color.value`.
+class LogogramStyle {
+  final int width;
+  final int height;
+  final int backgroundArgb;
+
+  /// Colour of each stacked stroke layer; its alpha is the opacity of one
+  /// layer.
+  final int strokeArgb;
+  final double strokeWidth;
+  final double strokeBlurSigma;
+  final int particleArgb;
+  final double particleRadius;
+
+  const LogogramStyle({
+    required this.width,
+    required this.height,
+    required this.backgroundArgb,
+    required this.strokeArgb,
+    required this.strokeWidth,
+    required this.strokeBlurSigma,
+    required this.particleArgb,
+    required this.particleRadius,
+  });
+
+  void _copyTo(OrbitaRenderStyle style) {
+    style
+      ..width = width
+      ..height = height
+      ..backgroundArgb = backgroundArgb
+      ..strokeArgb = strokeArgb
+      ..strokeWidth = strokeWidth
+      ..strokeBlurSigma = strokeBlurSigma
+      ..particleArgb = particleArgb
+      ..particleRadius = particleRadius;
+  }
+}
+
+typedef _ExportPngNative = Int32 Function(Pointer<OrbitaLogogramShape>, Int32,
+    Pointer<OrbitaRenderStyle>, Pointer<Uint8>);
+typedef _ExportPng = int Function(Pointer<OrbitaLogogramShape>, int,
+    Pointer<OrbitaRenderStyle>, Pointer<Uint8>);
+typedef _MallocNative = Pointer<Void> Function(IntPtr);
+typedef _Malloc = Pointer<Void> Function(int);
+typedef _FreeNative = Void Function(Pointer<Void>);
+typedef _Free = void Function(Pointer<Void>);
+
+/// FFI bindings to the native logogram rasterizer.
+///
+/// Draws a logogram the way HeptapodPainter does and writes it out as a
+/// PNG. Null where the native library is not available.
+class NativeRenderer {
+  final _ExportPng _exportPng;
+  final _Malloc _malloc;
+  final _Free _free;
+
+  NativeRenderer._(DynamicLibrary lib)
+      : _exportPng = lib.lookupFunction<_ExportPngNative, _ExportPng>(
+            'orbita_export_logogram_png'),
+        _malloc = lib.lookupFunction<_MallocNative, _Malloc>('orbita_malloc'),
+        _free = lib.lookupFunction<_FreeNative, _Free>('orbita_free');
+
+  static final NativeRenderer? instance = _load();
+
+  static NativeRenderer? _load() {
+    final lib = openOrbitaNative();
+    return lib == null ? null : NativeRenderer._(lib);
+  }
+
+  /// Renders the logogram whose geometry is described by the
+  /// `HeptapodGeometry.shapeOf` values and [seed] straight into a PNG file
+  /// at [path], as `orbita_export_logogram_png` does: rows are compressed
+  /// on all cores and streamed to the file as they are rendered, so neither
+  /// the image nor the PNG is ever held in memory.
+  ///
+  /// Blocks the calling isolate. Throws if rendering or writing fails, in
+  /// which case no file is left behind.
+  void exportPng({
+    required String path,
+    required double coreAmplitude,
+    required double nuanceChaos,
+    required double nuanceAmplitude,
+    required int seed,
+    required LogogramStyle style,
+  }) {
+    final shapePtr =
+        _malloc(sizeOf<OrbitaLogogramShape>()).cast<OrbitaLogogramShape>();
+    final stylePtr =
+        _malloc(sizeOf<OrbitaRenderStyle>()).cast<OrbitaRenderStyle>();
+    final pathPtr = _toCString(path);
+
+    try {
+      shapePtr.ref
+        ..coreAmplitude = coreAmplitude
+        ..nuanceChaos = nuanceChaos
+        ..nuanceAmplitude = nuanceAmplitude;
+      style._copyTo(stylePtr.ref);
+      final status = _exportPng(shapePtr, seed, stylePtr, pathPtr);
+      if (status != NativeStatus.ok) {
+        throw Exception('Native PNG export failed with status $status');
+      }
+    } finally {
+      _free(pathPtr.cast());
+      _free(stylePtr.cast());
+      _free(shapePtr.cast());
+    }
+  }
+
+  Pointer<Uint8> _toCString(String value) {
+    final encoded = utf8.encode(value);
+    final pointer = _malloc(encoded.length + 1).cast<Uint8>();
+    final bytes = pointer.asTypedList(encoded.length + 1);
+    bytes.setAll(0, encoded);
+    bytes[encoded.length] = 0;
+    return pointer;
+  }
+}
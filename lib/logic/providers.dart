@@ -1,6 +1,7 @@
 import 'dart:io';
 import 'package:flutter_riverpod/flutter_riverpod.dart';
 import '../data/services/gemini_service.dart';
+import '../data/services/analysis_channel.dart';
 import '../data/services/analysis_service.dart';
 import '../data/models/heptapod_spectrum.dart';
 import '../data/models/spectrum_summary.dart';
@@ -17,7 +18,8 @@ final geminiServiceProvider = Provider<GeminiService>((ref) {
 });
 
 final analysisServiceProvider = Provider<AnalysisService>((ref) {
-  return AnalysisService();
+  return AnalysisService(
+      channel: Platform.isLinux ? const AnalysisChannel() : null);
 });
 
 // State definitions
@@ -65,6 +67,10 @@ class HeptapodNotifier extends StateNotifier<HeptapodState> {
   final GeminiService _geminiService;
   final AnalysisService _analysisService;
 
+  /// Bumped by every [interpret] call, so a call that finds it changed
+  /// knows a newer image was picked and drops its result.
+  int _interpretGeneration = 0;
+
   HeptapodNotifier(this._geminiService, this._analysisService)
       : super(HeptapodState());
 
@@ -88,6 +94,7 @@ class HeptapodNotifier extends StateNotifier<HeptapodState> {
   }
 
   Future<void> interpret(File image) async {
+    final generation = ++_interpretGeneration;
     // Clear previous interpretation and set processing state
     state = state.copyWith(
       isProcessing: true,
@@ -98,17 +105,27 @@ class HeptapodNotifier extends StateNotifier<HeptapodState> {
     );
 
     try {
-      // 1. Analyze Image
-      final summary = await _analysisService.analyzeImage(image);
+      // 1. Analyze Image. Picking another image cancels this analysis
+      // natively. Coarse estimates are shown while it runs, marked as
+      // previews since their chaos level is provisional, but only the
+      // final summary is interpreted.
+      final summary = await _analysisService.analyzeImage(image,
+          key: AnalysisService.interpretKey, onPreview: (preview) {
+        if (generation != _interpretGeneration) return;
+        state = state.copyWith(analysisResult: preview);
+      });
+      if (generation != _interpretGeneration) return;
       state = state.copyWith(analysisResult: summary);
 
       // 2. Interpret Summary
       final poem = await _geminiService.spectrumToPhilosophy(summary);
+      if (generation != _interpretGeneration) return;
       state = state.copyWith(
         interpretation: poem,
         isProcessing: false,
       );
     } catch (e) {
+      if (generation != _interpretGeneration) return;
       state = state.copyWith(
         isProcessing: false,
         error: e.toString(),
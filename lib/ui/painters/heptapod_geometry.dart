@@ -0,0 +1,302 @@
+import 'dart:math';
+import 'dart:typed_data';
+import 'dart:ui';
+import 'package:fast_noise/fast_noise.dart';
+import '../../data/models/heptapod_spectrum.dart';
+import '../../data/services/native_geometry.dart';
+import '../../data/services/native_noise.dart';
+
+/// Everything [HeptapodPainter] draws for a spectrum, seed and canvas size,
+/// in canvas coordinates.
+///
+/// Shared by the Flutter painter and the native rasterizer used for
+/// exports, so both draw exactly the same logogram.
+///
+/// Flat buffers in the layout `orbita_render_logogram` takes, see
+/// [pointBuffer], [polylineBuffer] and [particleBuffer].
+class HeptapodGeometry {
+  /// Number of jittered copies of the skeleton and tendrils stacked to give
+  /// the ink its texture.
+  static const int layerCount = 50;
+
+  /// Frequency of the simplex noise every coordinate is shaped by.
+  static const double noiseFrequency = 0.01;
+
+  /// Stroke points as interleaved x, y pairs, in drawing order: each
+  /// layer's closed main loop, then its open tendrils.
+  final Float32List pointBuffer;
+
+  /// One (first point, point count, closed, layer) record per stroke,
+  /// indexing into [pointBuffer].
+  final Int32List polylineBuffer;
+
+  /// Particle centres as interleaved x, y pairs.
+  final Float32List particleBuffer;
+
+  HeptapodGeometry._(this.pointBuffer, this.polylineBuffer, this.particleBuffer);
+
+  /// The geometry for [spectrum], [seed] and [size], from the native
+  /// geometry cache when the library is available. Repaints and re-exports
+  /// of a recent logogram then reuse it instead of regenerating it, and a
+  /// new size or nuance layer reuses its seeded draws. Falls back to
+  /// [HeptapodGeometry.build].
+  factory HeptapodGeometry.of(
+    HeptapodSpectrum spectrum, {
+    required int seed,
+    required Size size,
+  }) {
+    final native = NativeGeometry.instance;
+    if (native == null) {
+      return HeptapodGeometry.build(spectrum, seed: seed, size: size);
+    }
+    final shape = shapeOf(spectrum);
+    final buffers = native.build(
+      coreAmplitude: shape.coreAmplitude,
+      nuanceChaos: shape.nuanceChaos,
+      nuanceAmplitude: shape.nuanceAmplitude,
+      seed: seed,
+      width: size.width,
+      height: size.height,
+    );
+    return HeptapodGeometry._(
+        buffers.points, buffers.polylines, buffers.particles);
+  }
+
+  /// Generates the geometry in Dart. Bit-identical to the native builder.
+  factory HeptapodGeometry.build(
+    HeptapodSpectrum spectrum, {
+    required int seed,
+    required Size size,
+  }) {
+    final noise = SimplexNoise(seed: seed, frequency: noiseFrequency);
+    final center = Offset(size.width / 2, size.height / 2);
+    final baseRadius = min(size.width, size.height) / 3.0;
+
+    // Generate the base structure points
+    List<Offset> mainLoop = [];
+    List<List<Offset>> tendrils = [];
+
+    // A. The "Fluid" Skeleton
+    const int steps = 360;
+
+    final shape = shapeOf(spectrum);
+    double coreAmp = shape.coreAmplitude;
+    double skeletonAmp = coreAmp * 30.0;
+    if (skeletonAmp == 0) skeletonAmp = 10.0;
+
+    // Both octaves of every step in one batch: n1 at even, n2 at odd
+    // indices.
+    final ringX = Float64List((steps + 1) * 2);
+    final ringY = Float64List((steps + 1) * 2);
+    for (int i = 0; i <= steps; i++) {
+      double theta = (i / steps) * 2 * pi;
+      ringX[i * 2] = cos(theta) * 1.0;
+      ringY[i * 2] = sin(theta) * 1.0;
+      ringX[i * 2 + 1] = cos(theta) * 3.0;
+      ringY[i * 2 + 1] = sin(theta) * 3.0;
+    }
+    final ring = _noise2(noise, seed, ringX, ringY);
+
+    for (int i = 0; i <= steps; i++) {
+      double theta = (i / steps) * 2 * pi;
+
+      double n1 = ring[i * 2];
+      double n2 = ring[i * 2 + 1];
+
+      double r = baseRadius + (skeletonAmp * (n1 + 0.5 * n2));
+
+      double x = center.dx + r * cos(theta);
+      double y = center.dy + r * sin(theta);
+      mainLoop.add(Offset(x, y));
+    }
+
+    // B. The "Spidery" Tendrils
+    // We look for angles where the spectrum (Nuance/Chaos) is active.
+    // Since chaos is a single factor per layer, tendrils are distributed
+    // randomly but consistently with the seed.
+    double maxChaos = shape.nuanceChaos;
+    double highFreqAmp = shape.nuanceAmplitude;
+
+    List<double> chaosAngles = [];
+
+    if (maxChaos > 0.1 || highFreqAmp > 0.1) {
+       int tendrilCount = (maxChaos * 10).toInt().clamp(3, 12);
+
+       for (int t = 0; t < tendrilCount; t++) {
+         double angle = _randomRange(seed + t, 0, 2 * pi);
+         chaosAngles.add(angle);
+
+         double n1 = noise.getNoise2(cos(angle) * 1.0, sin(angle) * 1.0);
+         double n2 = noise.getNoise2(cos(angle) * 3.0, sin(angle) * 3.0);
+         double startR = baseRadius + (skeletonAmp * (n1 + 0.5 * n2));
+         Offset startPoint = Offset(center.dx + startR * cos(angle), center.dy + startR * sin(angle));
+
+         double length = baseRadius * (0.5 + maxChaos);
+         _generateBranch(tendrils, startPoint, angle, length, 3, noise, t);
+       }
+    }
+
+    // C. The "Micro-Texture" Layers (Stacking)
+    final layers = _jitterLayers(noise, seed, mainLoop, tendrils);
+
+    // D. The "Splatter" Particle System
+    final particles = <Offset>[];
+    int particleCount = 20 + Random(seed).nextInt(30);
+    for (int i = 0; i < particleCount; i++) {
+       // Cluster around chaos angles if any, otherwise random
+       double angle;
+       if (chaosAngles.isNotEmpty && i < particleCount * 0.7) {
+         // 70% of particles near tendrils
+         double baseAngle = chaosAngles[i % chaosAngles.length];
+         angle = baseAngle + _randomRange(seed + i * 200, -0.3, 0.3); // Cluster width
+       } else {
+         angle = _randomRange(seed + i * 100, 0, 2 * pi);
+       }
+
+       double n = noise.getNoise2(cos(angle), sin(angle));
+       double r = baseRadius + (skeletonAmp * 2.0 * n) + _randomRange(i, -20, 50);
+
+       particles.add(Offset(center.dx + r * cos(angle), center.dy + r * sin(angle)));
+    }
+
+    return HeptapodGeometry._flatten(layers, particles);
+  }
+
+  /// Packs the strokes of each layer and the particles into flat buffers.
+  factory HeptapodGeometry._flatten(
+      List<List<List<Offset>>> layers, List<Offset> particles) {
+    final pointCount = layers.fold<int>(
+        0, (sum, layer) => layer.fold(sum, (sum, s) => sum + s.length));
+    final strokeCount = layers.fold<int>(0, (sum, layer) => sum + layer.length);
+    final points = Float32List(pointCount * 2);
+    final polylines = Int32List(strokeCount * 4);
+    int p = 0;
+    int s = 0;
+    for (int layer = 0; layer < layers.length; layer++) {
+      for (int k = 0; k < layers[layer].length; k++) {
+        final stroke = layers[layer][k];
+        polylines[s++] = p ~/ 2;
+        polylines[s++] = stroke.length;
+        polylines[s++] = k == 0 ? 1 : 0;
+        polylines[s++] = layer;
+        for (final point in stroke) {
+          points[p++] = point.dx;
+          points[p++] = point.dy;
+        }
+      }
+    }
+
+    final particleBuffer = Float32List(particles.length * 2);
+    for (int i = 0; i < particles.length; i++) {
+      particleBuffer[i * 2] = particles[i].dx;
+      particleBuffer[i * 2 + 1] = particles[i].dy;
+    }
+    return HeptapodGeometry._(points, polylines, particleBuffer);
+  }
+
+  /// The only properties of [spectrum] the geometry depends on, as
+  /// `OrbitaLogogramShape` in linux/native/orbita_native.h.
+  static ({double coreAmplitude, double nuanceChaos, double nuanceAmplitude})
+      shapeOf(HeptapodSpectrum spectrum) => (
+            coreAmplitude: spectrum.coreLayer
+                .fold(0.0, (sum, layer) => sum + layer.amplitude),
+            nuanceChaos: spectrum.nuanceLayer
+                .fold(0.0, (sum, layer) => max(sum, layer.chaosFactor)),
+            nuanceAmplitude: spectrum.nuanceLayer
+                .fold(0.0, (sum, layer) => sum + layer.amplitude),
+          );
+
+  /// `noise.getNoise2(xs[i], ys[i])` for every i. Uses the native batch
+  /// evaluator when it is available; both give bit-identical results.
+  static Float64List _noise2(
+      SimplexNoise noise, int seed, Float64List xs, Float64List ys) {
+    final native = NativeNoise.instance;
+    if (native != null) {
+      return native.simplex2(seed, noiseFrequency, xs, ys);
+    }
+    final out = Float64List(xs.length);
+    for (int i = 0; i < xs.length; i++) {
+      out[i] = noise.getNoise2(xs[i], ys[i]);
+    }
+    return out;
+  }
+
+  /// Builds [layerCount] copies of the main loop and tendrils, each point
+  /// shifted by up to 5 px of per-layer noise.
+  ///
+  /// The x and y offsets of every point in every layer are evaluated in a
+  /// single noise batch.
+  static List<List<List<Offset>>> _jitterLayers(SimplexNoise noise,
+      int seed, List<Offset> mainLoop, List<List<Offset>> tendrils) {
+    final polylines = [mainLoop, ...tendrils];
+    final pointCount = polylines.fold<int>(0, (sum, p) => sum + p.length);
+    final xs = Float64List(layerCount * pointCount * 2);
+    final ys = Float64List(layerCount * pointCount * 2);
+    int k = 0;
+    for (int layerID = 0; layerID < layerCount; layerID++) {
+      for (final polyline in polylines) {
+        for (final p in polyline) {
+          xs[k] = p.dx * 0.02;
+          ys[k++] = layerID.toDouble() * 10.0;
+          xs[k] = p.dy * 0.02;
+          ys[k++] = layerID.toDouble() * 10.0 + 1000;
+        }
+      }
+    }
+    final offsets = _noise2(noise, seed, xs, ys);
+
+    k = 0;
+    return [
+      for (int layerID = 0; layerID < layerCount; layerID++)
+        [
+          for (final polyline in polylines)
+            [
+              for (final p in polyline)
+                p.translate(offsets[k++] * 5.0, offsets[k++] * 5.0),
+            ],
+        ],
+    ];
+  }
+
+  static void _generateBranch(
+    List<List<Offset>> distinctPaths,
+    Offset start,
+    double angle,
+    double length,
+    int depth,
+    SimplexNoise noise,
+    int branchId
+  ) {
+    if (depth <= 0) return;
+
+    List<Offset> branchPoints = [];
+    branchPoints.add(start);
+
+    int segments = 20;
+    double segmentLen = length / segments;
+
+    Offset current = start;
+    double currentAngle = angle;
+
+    for (int i = 0; i < segments; i++) {
+       double curl = noise.getNoise2(current.dx * 0.01, current.dy * 0.01) * 2.0;
+       currentAngle += curl * 0.5;
+
+       double nextX = current.dx + segmentLen * cos(currentAngle);
+       double nextY = current.dy + segmentLen * sin(currentAngle);
+       current = Offset(nextX, nextY);
+       branchPoints.add(current);
+    }
+    distinctPaths.add(branchPoints);
+
+    if (depth > 1) {
+       _generateBranch(distinctPaths, current, currentAngle - 0.3, length * 0.6, depth - 1, noise, branchId + 1);
+       _generateBranch(distinctPaths, current, currentAngle + 0.3, length * 0.6, depth - 1, noise, branchId + 2);
+    }
+  }
+
+  static double _randomRange(int seed, double min, double max) {
+    var r = Random(seed);
+    return min + r.nextDouble() * (max - min);
+  }
+}
@@ -2,7 +2,10 @@ import 'package:flutter/material.dart';
 import 'package:flutter_riverpod/flutter_riverpod.dart';
 import '../../core/theme.dart';
 import '../../core/image_saver.dart';
+import '../../data/models/heptapod_spectrum.dart';
+import '../../data/services/logogram_texture.dart';
 import '../../logic/providers.dart';
+import '../painters/heptapod_geometry.dart';
 import '../painters/heptapod_painter.dart';
 
 class MaterializeTab extends ConsumerStatefulWidget {
@@ -84,15 +87,8 @@ class _MaterializeTabState extends ConsumerState<MaterializeTab> {
                     builder: (context, value, child) {
                       return Opacity(
                         opacity: value,
-                        child: LayoutBuilder(
-                          builder: (context, constraints) {
-                            return CustomPaint(
-                              size: Size(constraints.maxWidth, constraints.maxHeight),
-                              painter: HeptapodPainter(
-                                spectrum: state.generatedSpectrum!,
-                              ),
-                            );
-                          },
+                        child: _LogogramView(
+                          spectrum: state.generatedSpectrum!,
                         ),
                       );
                     },
@@ -130,3 +126,117 @@ class _MaterializeTabState extends ConsumerState<MaterializeTab> {
     );
   }
 }
+
+/// Shows [spectrum]'s logogram filling the available space.
+///
+/// Uses the runner's native preview texture where there is one, so the
+/// logogram is rasterized off the UI thread at full resolution, and falls
+/// back to [HeptapodPainter] elsewhere. On the texture the first logogram
+/// is written stroke by stroke and each new spectrum morphs out of the
+/// previous one.
+class _LogogramView extends StatefulWidget {
+  final HeptapodSpectrum spectrum;
+
+  const _LogogramView({required this.spectrum});
+
+  @override
+  State<_LogogramView> createState() => _LogogramViewState();
+}
+
+class _LogogramViewState extends State<_LogogramView> {
+  // Matches the fade-in around the view.
+  static const _writeDuration = Duration(seconds: 3);
+  static const _morphDuration = Duration(milliseconds: 1200);
+
+  bool _resolved = false;
+  int? _textureId;
+  // The last frame asked of the texture: spectrum and size in pixels.
+  (HeptapodSpectrum, int, int)? _requested;
+  // The layout size and pixel ratio of the latest build, requested from
+  // the texture once that frame is done.
+  Size _size = Size.zero;
+  double _pixelRatio = 1;
+  bool _frameRequestScheduled = false;
+
+  @override
+  void initState() {
+    super.initState();
+    LogogramTexture.textureId().then((id) {
+      if (mounted) {
+        setState(() {
+          _resolved = true;
+          _textureId = id;
+        });
+      }
+    });
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return LayoutBuilder(
+      builder: (context, constraints) {
+        final size = Size(constraints.maxWidth, constraints.maxHeight);
+        if (!_resolved) return SizedBox.fromSize(size: size);
+
+        final textureId = _textureId;
+        if (textureId == null) {
+          return CustomPaint(
+            size: size,
+            painter: HeptapodPainter(spectrum: widget.spectrum),
+          );
+        }
+        _size = size;
+        _pixelRatio = MediaQuery.devicePixelRatioOf(context);
+        _scheduleFrameRequest();
+        return SizedBox.fromSize(
+          size: size,
+          child: Texture(textureId: textureId),
+        );
+      },
+    );
+  }
+
+  /// Calls [_requestFrame] after the current frame, since a build must not
+  /// message the platform. Several builds in one frame request once.
+  void _scheduleFrameRequest() {
+    if (_frameRequestScheduled) return;
+    _frameRequestScheduled = true;
+    WidgetsBinding.instance.addPostFrameCallback((_) {
+      _frameRequestScheduled = false;
+      if (mounted) _requestFrame(_size, _pixelRatio);
+    });
+  }
+
+  /// Asks the texture for a new frame when the spectrum or the size in
+  /// pixels changed. Until it arrives the previous frame stays up, scaled.
+  /// A new spectrum is animated to; a new size is not.
+  void _requestFrame(Size size, double pixelRatio) {
+    final width = (size.width * pixelRatio).round();
+    final height = (size.height * pixelRatio).round();
+    if (width <= 0 || height <= 0) return;
+    final request = (widget.spectrum, width, height);
+    if (request == _requested) return;
+    final previous = _requested;
+    _requested = request;
+
+    final (transition, duration) = switch (previous) {
+      null => (LogogramTransition.write, _writeDuration),
+      (final spectrum, _, _) when spectrum != widget.spectrum => (
+          LogogramTransition.morph,
+          _morphDuration
+        ),
+      _ => (LogogramTransition.none, Duration.zero),
+    };
+
+    final shape = HeptapodGeometry.shapeOf(widget.spectrum);
+    LogogramTexture.render(
+      coreAmplitude: shape.coreAmplitude,
+      nuanceChaos: shape.nuanceChaos,
+      nuanceAmplitude: shape.nuanceAmplitude,
+      seed: HeptapodPainter.defaultSeed,
+      style: HeptapodPainter.nativeStyle(width, height, pixelRatio: pixelRatio),
+      transition: transition,
+      duration: duration,
+    );
+  }
+}
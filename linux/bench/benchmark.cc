@@ -0,0 +1,226 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include "json_writer.h"
+#include "mapped_file.h"
+
+namespace orbita {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Stops timing a benchmark after this many iterations even if it has not
+// run for the minimum time, so trivial bodies finish quickly.
+constexpr int kMaxIterations = 100000;
+
+// Reads the JSON string starting at |text[*pos]|, a quote, and moves
+// |*pos| past it. Only the escapes BenchmarkResultsJson() can produce for
+// benchmark names are understood.
+bool ReadJsonString(const std::string& text, size_t* pos, std::string* out) {
+  if (*pos >= text.size() || text[*pos] != '"') {
+    return false;
+  }
+  out->clear();
+  for (size_t i = *pos + 1; i < text.size(); ++i) {
+    char c = text[i];
+    if (c == '"') {
+      *pos = i + 1;
+      return true;
+    }
+    if (c == '\\') {
+      if (++i == text.size()) {
+        return false;
+      }
+      c = text[i];
+    }
+    out->push_back(c);
+  }
+  return false;
+}
+
+// Finds the value of |key| in |text| between |begin| and |end|, skipping
+// any spaces after the colon. Returns its position or npos.
+size_t FindValue(const std::string& text,
+                 const std::string& key,
+                 size_t begin,
+                 size_t end) {
+  const std::string quoted = "\"" + key + "\"";
+  size_t pos = text.find(quoted, begin);
+  if (pos == std::string::npos || pos >= end) {
+    return std::string::npos;
+  }
+  pos = text.find(':', pos + quoted.size());
+  if (pos == std::string::npos || pos >= end) {
+    return std::string::npos;
+  }
+  pos = text.find_first_not_of(" \t\r\n", pos + 1);
+  return pos < end ? pos : std::string::npos;
+}
+
+}  // namespace
+
+BenchmarkRunner::BenchmarkRunner(std::string filter,
+                                 double min_seconds,
+                                 int min_iterations)
+    : filter_(std::move(filter)),
+      min_seconds_(min_seconds),
+      min_iterations_(std::max(1, min_iterations)) {}
+
+bool BenchmarkRunner::Selected(const std::string& name) const {
+  return name.find(filter_) != std::string::npos;
+}
+
+void BenchmarkRunner::Run(const std::string& name,
+                          double items,
+                          double bytes,
+                          const std::function<void()>& body) {
+  if (!Selected(name)) {
+    return;
+  }
+  body();
+
+  std::vector<double> times;
+  const Clock::time_point start = Clock::now();
+  for (;;) {
+    const Clock::time_point before = Clock::now();
+    body();
+    const Clock::time_point after = Clock::now();
+    times.push_back(
+        std::chrono::duration<double, std::nano>(after - before).count());
+    const double elapsed =
+        std::chrono::duration<double>(after - start).count();
+    const int count = static_cast<int>(times.size());
+    if ((count >= min_iterations_ && elapsed >= min_seconds_) ||
+        count >= kMaxIterations) {
+      break;
+    }
+  }
+
+  BenchmarkResult result;
+  result.name = name;
+  result.iterations = static_cast<int>(times.size());
+  result.items = items;
+  result.bytes = bytes;
+  double total = 0;
+  for (const double time : times) {
+    total += time;
+  }
+  result.mean_ns = total / times.size();
+  std::sort(times.begin(), times.end());
+  result.min_ns = times.front();
+  const size_t middle = times.size() / 2;
+  result.median_ns = times.size() % 2 == 1
+                         ? times[middle]
+                         : (times[middle - 1] + times[middle]) / 2;
+
+  fprintf(stderr, "%-40s %8d it %12.3f ms median %12.3f ms min", name.c_str(),
+          result.iterations, result.median_ns / 1e6, result.min_ns / 1e6);
+  if (items > 0) {
+    fprintf(stderr, " %10.1f /s", items * 1e9 / result.median_ns);
+  }
+  if (bytes > 0) {
+    fprintf(stderr, " %8.1f MB/s", bytes * 1e3 / result.median_ns);
+  }
+  fprintf(stderr, "\n");
+  results_.push_back(result);
+}
+
+std::string BenchmarkResultsJson(const std::vector<BenchmarkResult>& results,
+                                 int threads) {
+  std::string json = "{\"version\": 1, \"threads\": ";
+  AppendJsonNumber(&json, threads);
+  json.append(", \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& result = results[i];
+    json.append(i > 0 ? ",\n  " : "\n  ");
+    json.append("{\"name\": ");
+    AppendJsonString(&json, result.name);
+    json.append(", \"iterations\": ");
+    AppendJsonNumber(&json, result.iterations);
+    json.append(", \"medianNs\": ");
+    AppendJsonNumber(&json, result.median_ns);
+    json.append(", \"minNs\": ");
+    AppendJsonNumber(&json, result.min_ns);
+    json.append(", \"meanNs\": ");
+    AppendJsonNumber(&json, result.mean_ns);
+    if (result.items > 0) {
+      json.append(", \"itemsPerSecond\": ");
+      AppendJsonNumber(&json, result.items * 1e9 / result.median_ns);
+    }
+    if (result.bytes > 0) {
+      json.append(", \"bytesPerSecond\": ");
+      AppendJsonNumber(&json, result.bytes * 1e9 / result.median_ns);
+    }
+    json.append("}");
+  }
+  json.append("\n]}\n");
+  return json;
+}
+
+bool ReadBenchmarkBaseline(const std::string& path,
+                           std::vector<BenchmarkResult>* out) {
+  MappedFile file;
+  if (!file.Open(path.c_str())) {
+    return false;
+  }
+  const std::string text(reinterpret_cast<const char*>(file.data()),
+                         file.size());
+  size_t pos = FindValue(text, "benchmarks", 0, text.size());
+  if (pos == std::string::npos || text[pos] != '[') {
+    return false;
+  }
+  out->clear();
+  // Each object runs from its opening brace to the next one.
+  for (size_t begin = text.find('{', pos); begin != std::string::npos;) {
+    const size_t next = text.find('{', begin + 1);
+    const size_t end = next == std::string::npos ? text.size() : next;
+    BenchmarkResult result;
+    size_t name = FindValue(text, "name", begin, end);
+    const size_t median = FindValue(text, "medianNs", begin, end);
+    if (name == std::string::npos || median == std::string::npos ||
+        !ReadJsonString(text, &name, &result.name)) {
+      return false;
+    }
+    char* number_end;
+    result.median_ns = strtod(text.c_str() + median, &number_end);
+    if (number_end == text.c_str() + median || !(result.median_ns > 0)) {
+      return false;
+    }
+    out->push_back(result);
+    begin = next;
+  }
+  return true;
+}
+
+int CompareWithBaseline(const std::vector<BenchmarkResult>& results,
+                        const std::vector<BenchmarkResult>& baseline,
+                        double tolerance) {
+  int regressions = 0;
+  fprintf(stderr, "\n%-40s %12s %12s %8s\n", "benchmark", "baseline ms",
+          "median ms", "change");
+  for (const BenchmarkResult& result : results) {
+    const auto base = std::find_if(
+        baseline.begin(), baseline.end(),
+        [&result](const BenchmarkResult& b) { return b.name == result.name; });
+    if (base == baseline.end()) {
+      fprintf(stderr, "%-40s %12s %12.3f %8s\n", result.name.c_str(), "-",
+              result.median_ns / 1e6, "new");
+      continue;
+    }
+    const double change = result.median_ns / base->median_ns - 1;
+    const bool regressed = change > tolerance;
+    regressions += regressed;
+    fprintf(stderr, "%-40s %12.3f %12.3f %+7.1f%%%s\n", result.name.c_str(),
+            base->median_ns / 1e6, result.median_ns / 1e6, change * 100,
+            regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+}  // namespace orbita
@@ -0,0 +1,75 @@
+#ifndef ORBITA_BENCH_BENCHMARK_H_
+#define ORBITA_BENCH_BENCHMARK_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace orbita {
+
+// Timing of one benchmark over all its measured iterations.
+struct BenchmarkResult {
+  std::string name;
+  int iterations = 0;
+  double median_ns = 0;
+  double min_ns = 0;
+  double mean_ns = 0;
+  // Items (images, frames) and bytes of input handled per iteration; 0
+  // where it does not apply.
+  double items = 0;
+  double bytes = 0;
+};
+
+// Runs benchmarks and collects their results.
+class BenchmarkRunner {
+ public:
+  // Runs only the benchmarks whose name contains |filter|. Each runs for
+  // at least |min_seconds| and |min_iterations| after one warm-up
+  // iteration.
+  BenchmarkRunner(std::string filter, double min_seconds, int min_iterations);
+
+  // True if a benchmark called |name| would run, so callers can skip
+  // preparing inputs for ones that will not.
+  bool Selected(const std::string& name) const;
+
+  // Times |body|, which handles |items| items and |bytes| bytes per call,
+  // and prints a line about it to stderr.
+  void Run(const std::string& name,
+           double items,
+           double bytes,
+           const std::function<void()>& body);
+
+  const std::vector<BenchmarkResult>& results() const { return results_; }
+
+ private:
+  const std::string filter_;
+  const double min_seconds_;
+  const int min_iterations_;
+  std::vector<BenchmarkResult> results_;
+};
+
+// The results as a JSON object:
+//
+//   {"version": 1, "threads": ..., "benchmarks": [{"name": ...,
+//    "iterations": ..., "medianNs": ..., "minNs": ..., "meanNs": ...,
+//    "itemsPerSecond": ..., "bytesPerSecond": ...}, ...]}
+//
+// The throughput fields are left out where they do not apply.
+std::string BenchmarkResultsJson(const std::vector<BenchmarkResult>& results,
+                                 int threads);
+
+// Reads the name and median of every benchmark in a file that
+// BenchmarkResultsJson() wrote. Returns false if it cannot.
+bool ReadBenchmarkBaseline(const std::string& path,
+                           std::vector<BenchmarkResult>* out);
+
+// Prints how each result compares with the baseline benchmark of the same
+// name to stderr. Returns how many are slower by more than |tolerance|, a
+// fraction of the baseline median.
+int CompareWithBaseline(const std::vector<BenchmarkResult>& results,
+                        const std::vector<BenchmarkResult>& baseline,
+                        double tolerance);
+
+}  // namespace orbita
+
+#endif  // ORBITA_BENCH_BENCHMARK_H_
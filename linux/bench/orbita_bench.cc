@@ -0,0 +1,468 @@
+// orbita_bench: benchmarks of the native analysis and painting hot paths
+// on synthetic logograms.
+//
+//   orbita_bench [--filter=TEXT] [--sizes=512,2048,7680x4320]
+//                [--min-time=SECONDS] [--min-iterations=N]
+//                [--json=FILE] [--baseline=FILE] [--tolerance=0.1]
+//                [--harmonics=N] [--noise=X] [--tendrils=N] [--ink=X]
+//                [--dark] [--seed=N] [--sample=FILE]
+//
+// Benchmarks are named group/stage/size:
+//
+//   analysis/...  the stages of AnalysisService.analyzeImage, each on its
+//                 own: PNG decoding, preprocessing (grayscale, blur,
+//                 threshold and centroid, which are one fused pass), ray
+//                 casting and the spectrum, then all of them together.
+//   paint/...     HeptapodPainter.paint: building the geometry, then
+//                 rasterising it and exporting it as a PNG.
+//   stream/...    a logogram being written, analysed frame by frame:
+//                 each frame on its own, then reusing the previous
+//                 frame's work.
+//   throughput/...  many images analysed at once across every thread.
+//   synthesis/...  logogram masks drawn straight from random spectra, as
+//                 `orbita --synthesize` generates them, on one thread.
+//
+// --json writes the results as JSON ("-" for stdout). --baseline compares
+// them with an earlier --json file and exits with status 1 if any median
+// is more than --tolerance slower, so a merge can be gated on it. --sample
+// writes the first size's synthetic logogram as a PNG to look at.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "benchmark.h"
+#include "fft.h"
+#include "image_decode.h"
+#include "logogram_export.h"
+#include "logogram_geometry.h"
+#include "logogram_raster.h"
+#include "logogram_synthesis.h"
+#include "parallel.h"
+#include "preprocess.h"
+#include "ray_cast.h"
+#include "stream_analysis.h"
+#include "synthetic_logogram.h"
+
+namespace orbita {
+
+namespace {
+
+// Images per throughput/analyze_batch iteration, per thread.
+constexpr int kBatchImagesPerThread = 4;
+
+// Frames in a stream benchmark's recording of a logogram being written.
+constexpr int kStreamFrames = 30;
+
+// Logogram painted by the paint benchmarks.
+constexpr OrbitaLogogramShape kPaintShape = {0.8, 0.45, 0.6};
+constexpr int32_t kPaintSeed = 1337;
+
+struct Size {
+  int width;
+  int height;
+  std::string label;
+};
+
+struct Options {
+  std::string filter;
+  std::vector<Size> sizes;
+  double min_seconds = 0.5;
+  int min_iterations = 5;
+  std::string json;
+  std::string baseline;
+  double tolerance = 0.1;
+  std::string sample;
+  SyntheticLogogramOptions logogram;
+};
+
+// Parses "N" or "WxH".
+bool ParseSize(const std::string& text, Size* out) {
+  char* end;
+  const long width = strtol(text.c_str(), &end, 10);
+  long height = width;
+  if (*end == 'x') {
+    height = strtol(end + 1, &end, 10);
+  }
+  if (*end != '\0' || width < 16 || height < 16 || width > 16384 ||
+      height > 16384) {
+    return false;
+  }
+  *out = Size{static_cast<int>(width), static_cast<int>(height), text};
+  return true;
+}
+
+bool ParseSizes(const std::string& text, std::vector<Size>* out) {
+  out->clear();
+  size_t begin = 0;
+  for (;;) {
+    const size_t comma = text.find(',', begin);
+    Size size;
+    if (!ParseSize(text.substr(begin, comma - begin), &size)) {
+      return false;
+    }
+    out->push_back(size);
+    if (comma == std::string::npos) {
+      return true;
+    }
+    begin = comma + 1;
+  }
+}
+
+bool ParseNumber(const char* text, double* out) {
+  char* end;
+  *out = strtod(text, &end);
+  return end != text && *end == '\0';
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  ParseSizes("512,2048", &options->sizes);
+  for (int i = 1; i < argc; ++i) {
+    const char* argument = argv[i];
+    const char* equals = strchr(argument, '=');
+    const std::string name =
+        equals != nullptr ? std::string(argument, equals - argument)
+                          : std::string(argument);
+    const char* value = equals != nullptr ? equals + 1 : nullptr;
+    double number = 0;
+    const bool numeric = value != nullptr && ParseNumber(value, &number);
+    SyntheticLogogramOptions& logogram = options->logogram;
+
+    if (name == "--dark" && value == nullptr) {
+      logogram.dark_background = true;
+    } else if (value == nullptr) {
+      return false;
+    } else if (name == "--filter") {
+      options->filter = value;
+    } else if (name == "--sizes") {
+      if (!ParseSizes(value, &options->sizes)) {
+        return false;
+      }
+    } else if (name == "--json") {
+      options->json = value;
+    } else if (name == "--baseline") {
+      options->baseline = value;
+    } else if (name == "--sample") {
+      options->sample = value;
+    } else if (!numeric) {
+      return false;
+    } else if (name == "--min-time" && number >= 0) {
+      options->min_seconds = number;
+    } else if (name == "--min-iterations" && number >= 1) {
+      options->min_iterations = static_cast<int>(number);
+    } else if (name == "--tolerance" && number >= 0) {
+      options->tolerance = number;
+    } else if (name == "--harmonics" && number >= 0) {
+      logogram.harmonics = static_cast<int>(number);
+    } else if (name == "--noise" && number >= 0) {
+      logogram.noise = number;
+    } else if (name == "--tendrils" && number >= 0) {
+      logogram.tendrils = static_cast<int>(number);
+    } else if (name == "--ink" && number > 0 && number < 1) {
+      logogram.ink_density = number;
+    } else if (name == "--seed" && number >= 0) {
+      logogram.seed = static_cast<uint64_t>(number);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WriteFile(const std::string& path, const void* data, size_t size) {
+  FILE* file = path == "-" ? stdout : fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  const bool written = fwrite(data, 1, size, file) == size;
+  return (file == stdout ? fflush(file) : fclose(file)) == 0 && written;
+}
+
+// A synthetic logogram at |size|, encoded as a PNG.
+std::vector<uint8_t> SyntheticPng(const Options& options,
+                                  const Size& size,
+                                  uint64_t seed) {
+  SyntheticLogogramOptions logogram = options.logogram;
+  logogram.width = size.width;
+  logogram.height = size.height;
+  logogram.seed = seed;
+  return EncodePng(GenerateSyntheticLogogram(logogram));
+}
+
+void AnalysisBenchmarks(const Options& options,
+                        const Size& size,
+                        BenchmarkRunner* runner) {
+  const std::string suffix = "/" + size.label;
+  const std::vector<std::string> names = {
+      "analysis/decode_png" + suffix, "analysis/preprocess" + suffix,
+      "analysis/ray_cast" + suffix, "analysis/analyze_png" + suffix};
+  bool any = false;
+  for (const std::string& name : names) {
+    any = any || runner->Selected(name);
+  }
+  if (!any) {
+    return;
+  }
+
+  OrbitaAnalysisParams params;
+  orbita_analysis_params_init(&params);
+  const std::vector<uint8_t> png =
+      SyntheticPng(options, size, options.logogram.seed);
+  const double pixels = static_cast<double>(size.width) * size.height;
+  DecodedImage image;
+  if (png.empty() ||
+      DecodeImage(png.data(), png.size(), params.working_pixels, &image) !=
+          ORBITA_OK) {
+    fprintf(stderr, "orbita_bench: cannot make a %s logogram\n",
+            size.label.c_str());
+    return;
+  }
+  ScratchVector<uint8_t> mask;
+  InkStats ink;
+  ExtractInkMask(image.view(), params.blur_radius, params.threshold, &mask,
+                 &ink);
+  const double center_x =
+      ink.ink_count > 0 ? ink.sum_x / ink.ink_count : size.width / 2.0;
+  const double center_y =
+      ink.ink_count > 0 ? ink.sum_y / ink.ink_count : size.height / 2.0;
+
+  runner->Run(names[0], 1, png.size(), [&] {
+    DecodedImage decoded;
+    DecodeImage(png.data(), png.size(), params.working_pixels, &decoded);
+  });
+  runner->Run(names[1], 1, pixels * image.channels, [&] {
+    ScratchVector<uint8_t> out;
+    InkStats stats;
+    ExtractInkMask(image.view(), params.blur_radius, params.threshold, &out,
+                   &stats);
+  });
+  runner->Run(names[2], 1, pixels, [&] {
+    CastRays(mask.data(), image.width, image.height, center_x, center_y,
+             params.ray_count);
+  });
+  runner->Run(names[3], 1, png.size(), [&] {
+    OrbitaSpectrumSummary summary;
+    AnalyzeEncoded(png.data(), png.size(), params, &summary);
+  });
+}
+
+void SpectrumBenchmark(BenchmarkRunner* runner) {
+  OrbitaAnalysisParams params;
+  orbita_analysis_params_init(&params);
+  std::vector<double> rays(params.ray_count);
+  for (int i = 0; i < params.ray_count; ++i) {
+    rays[i] = 300 + 20 * ((i * 7919) % 13) / 13.0;
+  }
+  const std::shared_ptr<const RealFftPlan> plan =
+      RealFftPlan::Get(params.ray_count);
+  runner->Run("analysis/spectrum/" + std::to_string(params.ray_count), 1, 0,
+              [&] {
+                OrbitaSpectrumSummary summary;
+                SummarizeRayProfile(*plan, rays.data(), &summary);
+              });
+}
+
+void PaintBenchmarks(const Size& size, BenchmarkRunner* runner) {
+  const std::string suffix = "/" + size.label;
+  runner->Run("paint/geometry" + suffix, 1, 0, [&] {
+    // A fresh cache, so the geometry is built every time.
+    LogogramGeometryCache cache(1, 1);
+    cache.Get(kPaintShape, kPaintSeed, size.width, size.height);
+  });
+
+  OrbitaRenderStyle style;
+  orbita_render_style_init(&style);
+  style.width = size.width;
+  style.height = size.height;
+  const std::shared_ptr<const LogogramGeometry> geometry =
+      LogogramGeometryCache::Shared().Get(kPaintShape, kPaintSeed,
+                                          size.width, size.height);
+  const double pixels = static_cast<double>(size.width) * size.height;
+
+  if (runner->Selected("paint/raster" + suffix)) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(pixels) * 4);
+    runner->Run("paint/raster" + suffix, 1, pixels * 4, [&] {
+      RasterizeLogogram(*geometry, style, rgba.data(), size.width * 4);
+    });
+  }
+
+  if (runner->Selected("paint/export_png" + suffix)) {
+    char path[] = "/tmp/orbita_bench_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+      fprintf(stderr, "orbita_bench: cannot create a temporary file\n");
+      return;
+    }
+    close(fd);
+    runner->Run("paint/export_png" + suffix, 1, pixels * 4, [&] {
+      ExportLogogramPng(*geometry, style, path);
+    });
+    unlink(path);
+  }
+}
+
+void StreamBenchmarks(const Options& options,
+                      const Size& size,
+                      BenchmarkRunner* runner) {
+  const std::string per_frame = "stream/per_frame/" + size.label;
+  const std::string reuse = "stream/reuse/" + size.label;
+  if (!runner->Selected(per_frame) && !runner->Selected(reuse)) {
+    return;
+  }
+  std::vector<LumaFrame> frames(kStreamFrames);
+  for (int i = 0; i < kStreamFrames; ++i) {
+    SyntheticLogogramOptions logogram = options.logogram;
+    logogram.width = size.width;
+    logogram.height = size.height;
+    logogram.reveal = (i + 1.0) / kStreamFrames;
+    const DecodedImage image = GenerateSyntheticLogogram(logogram);
+    frames[i].width = image.width;
+    frames[i].height = image.height;
+    frames[i].luma.resize(static_cast<size_t>(image.width) * image.height);
+    LumaPlane(image.view(), frames[i].luma.data());
+  }
+  const double pixels = static_cast<double>(size.width) * size.height;
+  OrbitaAnalysisParams params;
+  orbita_analysis_params_init(&params);
+
+  runner->Run(per_frame, kStreamFrames, pixels * kStreamFrames, [&] {
+    for (const LumaFrame& frame : frames) {
+      // A fresh analyser forgets the frame before.
+      StreamingAnalyzer analyzer(params, StreamOptions());
+      OrbitaSpectrumSummary summary;
+      analyzer.Analyze(frame, &summary);
+    }
+  });
+  runner->Run(reuse, kStreamFrames, pixels * kStreamFrames, [&] {
+    StreamingAnalyzer analyzer(params, StreamOptions());
+    for (const LumaFrame& frame : frames) {
+      OrbitaSpectrumSummary summary;
+      analyzer.Analyze(frame, &summary);
+    }
+  });
+}
+
+void SynthesisBenchmark(BenchmarkRunner* runner) {
+  SynthesisOptions options;
+  const std::string name = "synthesis/mask/" + std::to_string(options.size);
+  if (!runner->Selected(name)) {
+    return;
+  }
+  // Enough different spectra that the benchmark is not one shape's.
+  constexpr int kSpectra = 256;
+  std::vector<HeptapodSpectrum> spectra;
+  for (int i = 0; i < kSpectra; ++i) {
+    spectra.push_back(RandomSpectrum(i));
+  }
+  std::vector<uint8_t> mask(static_cast<size_t>(options.size) *
+                            options.size / 8);
+  runner->Run(name, kSpectra, 0, [&] {
+    for (int i = 0; i < kSpectra; ++i) {
+      SynthesizeLogogramMask(spectra[i], i, options, mask.data());
+    }
+  });
+}
+
+void ThroughputBenchmark(const Options& options,
+                         const Size& size,
+                         BenchmarkRunner* runner) {
+  const std::string name = "throughput/analyze_batch/" + size.label;
+  if (!runner->Selected(name)) {
+    return;
+  }
+  // Distinct images, as a batch would have.
+  const int count = ParallelConcurrency() * kBatchImagesPerThread;
+  std::vector<std::vector<uint8_t>> pngs(count);
+  double bytes = 0;
+  for (int i = 0; i < count; ++i) {
+    pngs[i] = SyntheticPng(options, size, options.logogram.seed + i);
+    bytes += pngs[i].size();
+  }
+  OrbitaAnalysisParams params;
+  orbita_analysis_params_init(&params);
+  runner->Run(name, count, bytes, [&] {
+    ParallelFor(count, [&](int i) {
+      OrbitaSpectrumSummary summary;
+      AnalyzeEncoded(pngs[i].data(), pngs[i].size(), params, &summary);
+    });
+  });
+}
+
+int Main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    fprintf(stderr,
+            "usage: orbita_bench [--filter=TEXT] [--sizes=512,2048,WxH]\n"
+            "  [--min-time=SECONDS] [--min-iterations=N] [--json=FILE]\n"
+            "  [--baseline=FILE] [--tolerance=FRACTION] [--harmonics=N]\n"
+            "  [--noise=X] [--tendrils=N] [--ink=X] [--dark] [--seed=N]\n"
+            "  [--sample=FILE]\n");
+    return 2;
+  }
+
+  std::vector<BenchmarkResult> baseline;
+  if (!options.baseline.empty() &&
+      !ReadBenchmarkBaseline(options.baseline, &baseline)) {
+    fprintf(stderr, "orbita_bench: cannot read baseline %s\n",
+            options.baseline.c_str());
+    return 2;
+  }
+
+  if (!options.sample.empty()) {
+    const std::vector<uint8_t> png =
+        SyntheticPng(options, options.sizes[0], options.logogram.seed);
+    if (png.empty() || !WriteFile(options.sample, png.data(), png.size())) {
+      fprintf(stderr, "orbita_bench: cannot write %s\n",
+              options.sample.c_str());
+      return 2;
+    }
+  }
+
+  BenchmarkRunner runner(options.filter, options.min_seconds,
+                         options.min_iterations);
+  for (const Size& size : options.sizes) {
+    AnalysisBenchmarks(options, size, &runner);
+  }
+  SpectrumBenchmark(&runner);
+  for (const Size& size : options.sizes) {
+    PaintBenchmarks(size, &runner);
+  }
+  for (const Size& size : options.sizes) {
+    StreamBenchmarks(options, size, &runner);
+  }
+  for (const Size& size : options.sizes) {
+    ThroughputBenchmark(options, size, &runner);
+  }
+  SynthesisBenchmark(&runner);
+
+  if (!options.json.empty()) {
+    const std::string json =
+        BenchmarkResultsJson(runner.results(), ParallelConcurrency());
+    if (!WriteFile(options.json, json.data(), json.size())) {
+      fprintf(stderr, "orbita_bench: cannot write %s\n",
+              options.json.c_str());
+      return 2;
+    }
+  }
+  if (!options.baseline.empty() &&
+      CompareWithBaseline(runner.results(), baseline, options.tolerance) >
+          0) {
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+}  // namespace orbita
+
+int main(int argc, char** argv) {
+  return orbita::Main(argc, argv);
+}
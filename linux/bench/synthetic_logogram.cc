@@ -0,0 +1,288 @@
+#include "synthetic_logogram.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "png_writer.h"
+
+namespace orbita {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Resolution of the ring's radius table.
+constexpr int kAngles = 4096;
+
+// Harmonics that make up the roughness of the ring.
+constexpr int kFirstNoiseHarmonic = 16;
+constexpr int kLastNoiseHarmonic = 48;
+
+// Peak of the sensor grain, in 8-bit levels either way.
+constexpr int kGrain = 3;
+
+// SplitMix64, so results do not depend on the standard library.
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1).
+  double Uniform() { return (Next() >> 11) * (1.0 / (uint64_t{1} << 53)); }
+
+ private:
+  uint64_t state_;
+};
+
+// Ink coverage in [0, 1] per pixel.
+class Coverage {
+ public:
+  Coverage(int width, int height)
+      : width_(width), height_(height),
+        values_(static_cast<size_t>(width) * height, 0.0f) {}
+
+  float at(int x, int y) const {
+    return values_[static_cast<size_t>(y) * width_ + x];
+  }
+
+  void Add(int x, int y, double coverage) {
+    float& value = values_[static_cast<size_t>(y) * width_ + x];
+    value = std::max(value, static_cast<float>(coverage));
+  }
+
+  // An anti-aliased disc of |radius| around (cx, cy).
+  void Disc(double cx, double cy, double radius) {
+    const int x0 = std::max(0, static_cast<int>(cx - radius - 1));
+    const int x1 = std::min(width_ - 1, static_cast<int>(cx + radius + 1));
+    const int y0 = std::max(0, static_cast<int>(cy - radius - 1));
+    const int y1 = std::min(height_ - 1, static_cast<int>(cy + radius + 1));
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        const double d = std::hypot(x + 0.5 - cx, y + 0.5 - cy);
+        const double c = radius + 0.5 - d;
+        if (c > 0) {
+          Add(x, y, std::min(c, 1.0));
+        }
+      }
+    }
+  }
+
+ private:
+  const int width_;
+  const int height_;
+  std::vector<float> values_;
+};
+
+// The ring's radius at kAngles evenly spaced angles.
+std::vector<double> RingRadii(const SyntheticLogogramOptions& options,
+                              double base_radius,
+                              Random* random) {
+  struct Term {
+    int harmonic;
+    double amplitude;
+    double phase;
+  };
+  std::vector<Term> terms;
+  for (int k = 2; k < options.harmonics + 2; ++k) {
+    terms.push_back(Term{k, options.harmonic_amplitude * random->Uniform(),
+                         2 * kPi * random->Uniform()});
+  }
+  const int noise_terms = kLastNoiseHarmonic - kFirstNoiseHarmonic + 1;
+  const double noise_scale = options.noise * std::sqrt(2.0 / noise_terms);
+  for (int k = kFirstNoiseHarmonic; k <= kLastNoiseHarmonic; ++k) {
+    terms.push_back(Term{k, noise_scale * random->Uniform(),
+                         2 * kPi * random->Uniform()});
+  }
+
+  std::vector<double> radii(kAngles);
+  for (int i = 0; i < kAngles; ++i) {
+    const double theta = 2 * kPi * i / kAngles;
+    double r = 1;
+    for (const Term& term : terms) {
+      r += term.amplitude * std::cos(term.harmonic * theta + term.phase);
+    }
+    radii[i] = base_radius * r;
+  }
+  return radii;
+}
+
+int AngleIndex(double theta) {
+  const int i = static_cast<int>(std::lround(theta / (2 * kPi) * kAngles));
+  return ((i % kAngles) + kAngles) % kAngles;
+}
+
+// Fraction of a turn |theta| lies at, in [0, 1).
+double TurnFraction(double theta) {
+  const double turn = theta / (2 * kPi);
+  return turn - std::floor(turn);
+}
+
+// Draws the part of the ring up to |reveal| of a turn, scanning only the
+// annulus it can touch.
+void DrawRing(const std::vector<double>& radii,
+              double cx,
+              double cy,
+              double half_width,
+              double reveal,
+              int width,
+              int height,
+              Coverage* coverage) {
+  const auto bounds = std::minmax_element(radii.begin(), radii.end());
+  const double inner = std::max(0.0, *bounds.first - half_width - 1);
+  const double outer = *bounds.second + half_width + 1;
+  for (int y = 0; y < height; ++y) {
+    const double dy = y + 0.5 - cy;
+    if (std::fabs(dy) > outer) {
+      continue;
+    }
+    const double outer_dx = std::sqrt(outer * outer - dy * dy);
+    const double inner_dx =
+        std::fabs(dy) < inner ? std::sqrt(inner * inner - dy * dy) : 0;
+    const int x0 = std::max(0, static_cast<int>(cx - outer_dx));
+    const int x1 = std::min(width - 1, static_cast<int>(cx + outer_dx));
+    for (int x = x0; x <= x1; ++x) {
+      const double dx = x + 0.5 - cx;
+      if (std::fabs(dx) < inner_dx) {
+        // Skip to the first pixel past the hole.
+        x = static_cast<int>(std::ceil(cx + inner_dx - 0.5)) - 1;
+        continue;
+      }
+      const double theta = std::atan2(dy, dx);
+      if (TurnFraction(theta) >= reveal) {
+        continue;
+      }
+      const double rho = std::hypot(dx, dy);
+      const double d = std::fabs(rho - radii[AngleIndex(theta)]);
+      const double c = half_width + 0.5 - d;
+      if (c > 0) {
+        coverage->Add(x, y, std::min(c, 1.0));
+      }
+    }
+  }
+}
+
+// A tendril grows outwards from the ring, curling to one side and
+// thinning towards its tip. It is only drawn once the ring is drawn up to
+// where it starts, but always takes its share of |random|.
+void DrawTendril(const std::vector<double>& radii,
+                 double cx,
+                 double cy,
+                 double half_width,
+                 double reveal,
+                 Random* random,
+                 Coverage* coverage) {
+  const double angle = 2 * kPi * random->Uniform();
+  const double base_radius = radii[AngleIndex(angle)];
+  const double length = base_radius * (0.2 + 0.4 * random->Uniform());
+  const double curl = (random->Uniform() - 0.5) * 1.6;
+  if (TurnFraction(angle) >= reveal) {
+    return;
+  }
+  double x = cx + base_radius * std::cos(angle);
+  double y = cy + base_radius * std::sin(angle);
+  for (double travelled = 0; travelled < length;) {
+    const double s = travelled / length;
+    const double radius = half_width * (0.8 - 0.6 * s);
+    coverage->Disc(x, y, radius);
+    const double step = std::max(0.5, radius * 0.5);
+    const double heading = angle + curl * std::sin(kPi * s);
+    x += step * std::cos(heading);
+    y += step * std::sin(heading);
+    travelled += step;
+  }
+}
+
+uint8_t ClampByte(double value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0.0), 255.0));
+}
+
+}  // namespace
+
+DecodedImage GenerateSyntheticLogogram(
+    const SyntheticLogogramOptions& options) {
+  const int w = options.width;
+  const int h = options.height;
+  Random random(options.seed);
+  const double cx = w / 2.0;
+  const double cy = h / 2.0;
+  const double base_radius = std::min(w, h) * 0.3;
+  const double half_width =
+      std::max(0.5, std::min(w, h) * options.ink_density / 2);
+
+  Coverage coverage(w, h);
+  const std::vector<double> radii = RingRadii(options, base_radius, &random);
+  DrawRing(radii, cx, cy, half_width, options.reveal, w, h, &coverage);
+  for (int i = 0; i < options.tendrils; ++i) {
+    DrawTendril(radii, cx, cy, half_width, options.reveal, &random,
+                &coverage);
+  }
+
+  // Warm paper and blue-black ink, or the other way round.
+  const double paper[3] = {242, 238, 228};
+  const double ink[3] = {28, 30, 40};
+  const double* background = options.dark_background ? ink : paper;
+  const double* foreground = options.dark_background ? paper : ink;
+
+  DecodedImage image;
+  image.width = w;
+  image.height = h;
+  image.channels = 4;
+  image.pixels.resize(static_cast<size_t>(w) * h * 4);
+  uint8_t* out = image.pixels.data();
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x, out += 4) {
+      const double c = coverage.at(x, y);
+      const double grain =
+          static_cast<int>(random.Next() % (2 * kGrain + 1)) - kGrain;
+      for (int channel = 0; channel < 3; ++channel) {
+        out[channel] = ClampByte(background[channel] +
+                                 (foreground[channel] - background[channel]) *
+                                     c +
+                                 grain);
+      }
+      out[3] = 255;
+    }
+  }
+  return image;
+}
+
+std::vector<uint8_t> EncodePng(const DecodedImage& image) {
+  std::vector<uint8_t> png;
+  FILE* file = tmpfile();
+  if (file == nullptr || image.channels != 4) {
+    if (file != nullptr) {
+      fclose(file);
+    }
+    return png;
+  }
+  const int fd = fileno(file);
+  PngWriter writer(/*threads=*/0);
+  OrbitaStatus status = writer.Start(fd, image.width, image.height);
+  if (status == ORBITA_OK) {
+    status = writer.WriteRows(image.pixels.data(), image.height,
+                              image.width * 4);
+  }
+  if (status == ORBITA_OK) {
+    status = writer.Finish();
+  }
+  const off_t size = lseek(fd, 0, SEEK_END);
+  if (status == ORBITA_OK && size > 0 && lseek(fd, 0, SEEK_SET) == 0) {
+    png.resize(static_cast<size_t>(size));
+    if (read(fd, png.data(), png.size()) != size) {
+      png.clear();
+    }
+  }
+  fclose(file);
+  return png;
+}
+
+}  // namespace orbita
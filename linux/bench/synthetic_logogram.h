@@ -0,0 +1,47 @@
+#ifndef ORBITA_BENCH_SYNTHETIC_LOGOGRAM_H_
+#define ORBITA_BENCH_SYNTHETIC_LOGOGRAM_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "image_decode.h"
+
+namespace orbita {
+
+// Parameters of a synthetic logogram photo: an inked ring whose radius
+// follows a few low harmonics, roughened by noise, with tendrils reaching
+// out of it and a little sensor grain over everything.
+struct SyntheticLogogramOptions {
+  int width = 1024;
+  int height = 1024;
+  // Harmonics 2..harmonics + 1 of the ring's radius, each with an
+  // amplitude up to harmonic_amplitude of the base radius.
+  int harmonics = 5;
+  double harmonic_amplitude = 0.06;
+  // Amplitude of the high-frequency roughness of the ring, as a fraction
+  // of the base radius.
+  double noise = 0.015;
+  int tendrils = 12;
+  // Stroke width as a fraction of the shorter side, which sets how much of
+  // the image is ink.
+  double ink_density = 0.02;
+  // Fraction of the logogram drawn so far, sweeping round from angle 0 as
+  // if it were being written; frames with rising |reveal| and the same
+  // seed differ only where new ink went down.
+  double reveal = 1.0;
+  // Light ink on a dark background instead of dark ink on paper.
+  bool dark_background = false;
+  uint64_t seed = 1;
+};
+
+// Renders the logogram |options| describe as 8-bit RGBA. The same options
+// always give the same pixels.
+DecodedImage GenerateSyntheticLogogram(const SyntheticLogogramOptions& options);
+
+// Encodes |image|, which must be RGBA, as a PNG. Returns an empty vector
+// if it cannot.
+std::vector<uint8_t> EncodePng(const DecodedImage& image);
+
+}  // namespace orbita
+
+#endif  // ORBITA_BENCH_SYNTHETIC_LOGOGRAM_H_
@@ -0,0 +1,429 @@
+#include "analysis.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "fft.h"
+#include "mapped_file.h"
+#include "preprocess.h"
+#include "ray_cast.h"
+#include "scratch_memory.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// Charges the time since the previous lap to one StageTimings field.
+class StageClock {
+ public:
+  explicit StageClock(StageTimings* timings)
+      : timings_(timings), start_(std::chrono::steady_clock::now()) {}
+
+  void Lap(double StageTimings::*stage) {
+    if (timings_ == nullptr) {
+      return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    timings_->*stage +=
+        std::chrono::duration<double, std::milli>(now - start_).count();
+    start_ = now;
+  }
+
+ private:
+  StageTimings* timings_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Levels below the working resolution that progressive analysis refines
+// through, each half the size of the next.
+constexpr int kRefinementLevels = 3;
+
+// Shorter side below which an image is not reduced any further.
+constexpr int kMinLevelSide = 32;
+
+int64_t PixelCount(const DecodedImage& image) {
+  return static_cast<int64_t>(image.width) * image.height;
+}
+
+// |image| reduced by half with a 2x2 box filter.
+DecodedImage HalfSize(const DecodedImage& image) {
+  DecodedImage half;
+  half.width = image.width / 2;
+  half.height = image.height / 2;
+  half.channels = image.channels;
+  half.scale = image.scale * 2;
+  half.pixels.resize(static_cast<size_t>(PixelCount(half)) * half.channels);
+  const int c = image.channels;
+  const size_t stride = static_cast<size_t>(image.width) * c;
+  uint8_t* out = half.pixels.data();
+  for (int y = 0; y < half.height; ++y) {
+    const uint8_t* top = image.pixels.data() + 2 * y * stride;
+    const uint8_t* bottom = top + stride;
+    for (int x = 0; x < half.width; ++x) {
+      for (int k = 0; k < c; ++k) {
+        const int i = 2 * x * c + k;
+        *out++ = static_cast<uint8_t>(
+            (top[i] + top[i + c] + bottom[i] + bottom[i + c] + 2) / 4);
+      }
+    }
+  }
+  return half;
+}
+
+// True if no dominant bin of |b| differs from that of |a| by more than
+// |tolerance| times the largest bin of |b|. The bins are normalised by the
+// average radius, so unlike the chaos level they do not depend on the
+// resolution they were measured at.
+bool Converged(const OrbitaSpectrumSummary& a,
+               const OrbitaSpectrumSummary& b,
+               double tolerance) {
+  double largest = 0;
+  for (const double bin : b.dominant_frequencies) {
+    largest = std::max(largest, std::fabs(bin));
+  }
+  for (int i = 0; i < ORBITA_DOMINANT_BIN_COUNT; ++i) {
+    if (std::fabs(a.dominant_frequencies[i] - b.dominant_frequencies[i]) >
+        tolerance * largest) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Chaos level at |scale| extrapolated from those of a coarse and a fine
+// level. Most of what a level adds to the chaos level comes from
+// pixel-sized steps in the ray profile, which grow against the radius in
+// proportion to the level's scale, so the extrapolation is linear in the
+// scale. Never above |fine|.
+double ExtrapolateChaos(double coarse,
+                        int coarse_scale,
+                        double fine,
+                        int fine_scale,
+                        int scale) {
+  const double slope = (coarse - fine) / (coarse_scale - fine_scale);
+  return std::clamp(fine - slope * (fine_scale - scale), 0.0, fine);
+}
+
+// DecodeImage() reduced by exactly |scale|, at most kMaxDecodeScale, for
+// an image of |width| x |height| whose sides are at least |scale|.
+OrbitaStatus DecodeAtScale(const uint8_t* data,
+                           size_t size,
+                           int width,
+                           int height,
+                           int scale,
+                           DecodedImage* out) {
+  // ChooseDecodeScale() stops at the first scale leaving fewer pixels.
+  const int64_t target_pixels =
+      static_cast<int64_t>(width / scale) * (height / scale);
+  return DecodeImage(data, size, target_pixels, out);
+}
+
+// AnalyzeImage over a decoded image, which may have been reduced.
+OrbitaStatus AnalyzeDecoded(const DecodedImage& image,
+                            const OrbitaAnalysisParams& params,
+                            OrbitaSpectrumSummary* out,
+                            StageTimings* timings,
+                            AnalysisDetail* detail,
+                            const CancellationToken* cancel) {
+  return AnalyzeImage(image.view(), ParamsForScale(params, image.scale),
+                      out, timings, detail, cancel);
+}
+
+}  // namespace
+
+bool ValidateAnalysisParams(const OrbitaAnalysisParams& params) {
+  const int rays = params.ray_count;
+  return params.blur_radius >= 0 && params.threshold >= 0 &&
+         params.threshold <= 256 && rays >= 64 && (rays & (rays - 1)) == 0 &&
+         params.working_pixels >= 0;
+}
+
+OrbitaAnalysisParams ParamsForScale(const OrbitaAnalysisParams& params,
+                                    int scale) {
+  OrbitaAnalysisParams scaled = params;
+  if (scale > 1 && params.blur_radius > 0) {
+    scaled.blur_radius =
+        std::max(1, (params.blur_radius + scale / 2) / scale);
+  }
+  return scaled;
+}
+
+OrbitaStatus AnalyzeImage(const ImageView& image,
+                          const OrbitaAnalysisParams& params,
+                          OrbitaSpectrumSummary* out,
+                          StageTimings* timings,
+                          AnalysisDetail* detail,
+                          const CancellationToken* cancel) {
+  ORBITA_TRACE_SPAN("analyze_image");
+  ScratchScope scratch;
+  if (image.data == nullptr || image.width <= 0 || image.height <= 0 ||
+      image.channels < 3 || !ValidateAnalysisParams(params)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  const int w = image.width;
+  const int h = image.height;
+  StageClock clock(timings);
+
+  ScratchVector<uint8_t> mask;
+  InkStats ink;
+  ExtractInkMask(image, params.blur_radius, params.threshold, &mask, &ink);
+  if (IsCancelled(cancel)) {
+    return ORBITA_ERROR_CANCELLED;
+  }
+
+  out->density = static_cast<double>(ink.ink_count) /
+                 (static_cast<double>(w) * static_cast<double>(h));
+  double center_x = w / 2.0;
+  double center_y = h / 2.0;
+  if (ink.ink_count > 0) {
+    center_x = ink.sum_x / static_cast<double>(ink.ink_count);
+    center_y = ink.sum_y / static_cast<double>(ink.ink_count);
+  }
+  clock.Lap(&StageTimings::preprocess_ms);
+
+  const std::vector<double> rays =
+      CastRays(mask.data(), w, h, center_x, center_y, params.ray_count);
+  clock.Lap(&StageTimings::ray_cast_ms);
+  if (IsCancelled(cancel)) {
+    return ORBITA_ERROR_CANCELLED;
+  }
+  const RealFftPlan& plan = *RealFftPlan::Get(params.ray_count);
+  SummarizeRayProfile(plan, rays.data(), out);
+  if (detail != nullptr) {
+    const int bins = params.ray_count / 2 + 1;
+    std::vector<double> re(bins);
+    std::vector<double> im(bins);
+    plan.Forward(rays.data(), re.data(), im.data());
+    detail->spectrum.resize(bins);
+    for (int k = 0; k < bins; ++k) {
+      detail->spectrum[k] = std::sqrt(re[k] * re[k] + im[k] * im[k]);
+    }
+    detail->rays = rays;
+  }
+  clock.Lap(&StageTimings::spectrum_ms);
+  return ORBITA_OK;
+}
+
+OrbitaStatus AnalyzeEncoded(const uint8_t* data,
+                            size_t size,
+                            const OrbitaAnalysisParams& params,
+                            OrbitaSpectrumSummary* out,
+                            StageTimings* timings,
+                            ResultCache* cache,
+                            AnalysisDetail* detail,
+                            const CancellationToken* cancel) {
+  ORBITA_TRACE_SPAN("analyze");
+  ScratchScope scratch;
+  if ((data == nullptr && size > 0) || !ValidateAnalysisParams(params)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  StageClock clock(timings);
+  CacheKey key;
+  if (cache != nullptr) {
+    key = MakeCacheKey(data, size, params);
+    if (detail == nullptr && cache->Lookup(key, out)) {
+      clock.Lap(&StageTimings::decode_ms);
+      return ORBITA_OK;
+    }
+  }
+  if (IsCancelled(cancel)) {
+    return ORBITA_ERROR_CANCELLED;
+  }
+  DecodedImage image;
+  OrbitaStatus status = DecodeImage(data, size, params.working_pixels, &image);
+  if (status != ORBITA_OK) {
+    return status;
+  }
+  clock.Lap(&StageTimings::decode_ms);
+  if (IsCancelled(cancel)) {
+    return ORBITA_ERROR_CANCELLED;
+  }
+  status = AnalyzeDecoded(image, params, out, timings, detail, cancel);
+  if (status == ORBITA_OK && cache != nullptr) {
+    cache->Insert(key, *out);
+  }
+  return status;
+}
+
+OrbitaStatus AnalyzeFile(const char* path,
+                         const OrbitaAnalysisParams& params,
+                         OrbitaSpectrumSummary* out,
+                         StageTimings* timings,
+                         ResultCache* cache,
+                         AnalysisDetail* detail,
+                         const CancellationToken* cancel) {
+  if (path == nullptr || !ValidateAnalysisParams(params)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  StageClock clock(timings);
+  MappedFile file;
+  if (!file.Open(path)) {
+    return ORBITA_ERROR_IO;
+  }
+  clock.Lap(&StageTimings::decode_ms);
+  return AnalyzeEncoded(file.data(), file.size(), params, out, timings, cache,
+                        detail, cancel);
+}
+
+OrbitaStatus AnalyzeEncodedProgressive(const uint8_t* data,
+                                       size_t size,
+                                       const OrbitaAnalysisParams& params,
+                                       const RefinementOptions& refinement,
+                                       OrbitaSpectrumSummary* out,
+                                       ResultCache* cache,
+                                       AnalysisDetail* detail,
+                                       const CancellationToken* cancel) {
+  ORBITA_TRACE_SPAN("analyze_progressive");
+  ScratchScope scratch;
+  if ((data == nullptr && size > 0) || !ValidateAnalysisParams(params)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  CacheKey key;
+  if (cache != nullptr) {
+    key = MakeCacheKey(data, size, params);
+    if (detail == nullptr && cache->Lookup(key, out)) {
+      return ORBITA_OK;
+    }
+  }
+
+  int width = 0;
+  int height = 0;
+  OrbitaStatus status = ReadImageSize(data, size, &width, &height);
+  if (status != ORBITA_OK) {
+    return status;
+  }
+  const int working_scale =
+      ChooseDecodeScale(width, height, params.working_pixels);
+  // Scales of the levels below the working resolution, finest first.
+  std::vector<int> scales;
+  for (int scale = working_scale * 2;
+       static_cast<int>(scales.size()) < kRefinementLevels &&
+       std::min(width, height) / scale >= kMinLevelSide;
+       scale *= 2) {
+    scales.push_back(scale);
+  }
+
+  const bool stop_early = refinement.tolerance > 0 && detail == nullptr;
+  OrbitaSpectrumSummary previous = {};
+  int previous_scale = 0;
+  // Analyses a level below the working resolution into |previous|.
+  // Returns true if it agrees with the level before and refinement can
+  // stop, in which case |*out| is its summary with the chaos level
+  // extrapolated to the working resolution.
+  auto refine = [&](const DecodedImage& level, OrbitaStatus* status) {
+    OrbitaSpectrumSummary summary;
+    *status = AnalyzeDecoded(level, params, &summary, nullptr, nullptr,
+                             cancel);
+    if (*status != ORBITA_OK) {
+      return false;
+    }
+    if (stop_early && previous_scale != 0 &&
+        Converged(previous, summary, refinement.tolerance)) {
+      *out = summary;
+      out->chaos_level =
+          ExtrapolateChaos(previous.chaos_level, previous_scale,
+                           summary.chaos_level, level.scale, working_scale);
+      return true;
+    }
+    previous = summary;
+    previous_scale = level.scale;
+    if (refinement.on_preview) {
+      refinement.on_preview(summary, level.scale);
+    }
+    return false;
+  };
+
+  // A JPEG's levels below half the working resolution are decoded on
+  // their own at reduced DCT scale, so they arrive, and may end the
+  // refinement, before the working resolution is ever decoded. A level
+  // coarser than kMaxDecodeScale is box-filtered down from that scale.
+  // The half level costs nearly as much to decode as the working
+  // resolution, so it is box-filtered down from it like every level of a
+  // PNG.
+  size_t filtered_levels = scales.size();
+  DecodedImage decoded;
+  if (IsJpeg(data, size) && scales.size() > 1) {
+    filtered_levels = 1;
+    for (size_t i = scales.size() - 1; i >= filtered_levels; --i) {
+      const int decode_scale = std::min(scales[i], kMaxDecodeScale);
+      if (decoded.scale != decode_scale || decoded.pixels.empty()) {
+        status = DecodeAtScale(data, size, width, height, decode_scale,
+                               &decoded);
+        if (status != ORBITA_OK) {
+          return status;
+        }
+      }
+      DecodedImage level;
+      const DecodedImage* source = &decoded;
+      while (source->scale < scales[i]) {
+        level = HalfSize(*source);
+        source = &level;
+      }
+      if (refine(*source, &status)) {
+        return ORBITA_OK;
+      }
+      if (status != ORBITA_OK) {
+        return status;
+      }
+    }
+  }
+  if (IsCancelled(cancel)) {
+    return ORBITA_ERROR_CANCELLED;
+  }
+
+  DecodedImage image;
+  if (decoded.scale == working_scale && !decoded.pixels.empty()) {
+    image = std::move(decoded);
+  } else {
+    status = DecodeImage(data, size, params.working_pixels, &image);
+    if (status != ORBITA_OK) {
+      return status;
+    }
+  }
+  // Finest first. Reserved so |source| stays valid.
+  std::vector<DecodedImage> levels;
+  levels.reserve(filtered_levels);
+  const DecodedImage* source = &image;
+  while (levels.size() < filtered_levels) {
+    levels.push_back(HalfSize(*source));
+    source = &levels.back();
+  }
+  for (auto level = levels.rbegin(); level != levels.rend(); ++level) {
+    if (refine(*level, &status)) {
+      return ORBITA_OK;
+    }
+    if (status != ORBITA_OK) {
+      return status;
+    }
+  }
+
+  status = AnalyzeDecoded(image, params, out, nullptr, detail, cancel);
+  if (status == ORBITA_OK && cache != nullptr) {
+    cache->Insert(key, *out);
+  }
+  return status;
+}
+
+OrbitaStatus AnalyzeFileProgressive(const char* path,
+                                    const OrbitaAnalysisParams& params,
+                                    const RefinementOptions& refinement,
+                                    OrbitaSpectrumSummary* out,
+                                    ResultCache* cache,
+                                    AnalysisDetail* detail,
+                                    const CancellationToken* cancel) {
+  if (path == nullptr || !ValidateAnalysisParams(params)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  MappedFile file;
+  if (!file.Open(path)) {
+    return ORBITA_ERROR_IO;
+  }
+  return AnalyzeEncodedProgressive(file.data(), file.size(), params,
+                                   refinement, out, cache, detail, cancel);
+}
+
+}  // namespace orbita
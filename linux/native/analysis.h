@@ -0,0 +1,130 @@
+#ifndef ORBITA_NATIVE_ANALYSIS_H_
+#define ORBITA_NATIVE_ANALYSIS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "image_decode.h"
+#include "job_scheduler.h"
+#include "orbita_native.h"
+#include "result_cache.h"
+
+namespace orbita {
+
+// Native port of AnalysisService.analyzeImage in
+// lib/data/services/analysis_service.dart. Each stage mirrors the Dart code
+// so that the two paths stay comparable; see orbita_native.h for the
+// tolerance between them.
+
+// Wall-clock time spent in each pipeline stage, in milliseconds.
+struct StageTimings {
+  double decode_ms = 0.0;
+  // Luma, blur, inversion, threshold and centroid sums.
+  double preprocess_ms = 0.0;
+  double ray_cast_ms = 0.0;
+  double spectrum_ms = 0.0;
+};
+
+// What a summary is computed from, for callers that show more than the
+// summary.
+struct AnalysisDetail {
+  // Mean ink distance along each ray: the ray profile, ray_count values.
+  std::vector<double> rays;
+  // |X[k]| of the ray profile's DFT for k = 0..ray_count / 2.
+  std::vector<double> spectrum;
+};
+
+// Returns false if |params| cannot be analysed (e.g. a ray count that is not
+// a power of two).
+bool ValidateAnalysisParams(const OrbitaAnalysisParams& params);
+
+// |params| for an image reduced by |scale|: the blur keeps its size
+// relative to the logogram.
+OrbitaAnalysisParams ParamsForScale(const OrbitaAnalysisParams& params,
+                                    int scale);
+
+// |timings| is optional; when given, each stage's time is added to it.
+// So is |detail|, which receives the ray profile and its spectrum. With a
+// |cancel| token, every function here checks it between stages and
+// returns ORBITA_ERROR_CANCELLED once it is set.
+OrbitaStatus AnalyzeImage(const ImageView& image,
+                          const OrbitaAnalysisParams& params,
+                          OrbitaSpectrumSummary* out,
+                          StageTimings* timings = nullptr,
+                          AnalysisDetail* detail = nullptr,
+                          const CancellationToken* cancel = nullptr);
+
+// Analyses the JPEG or PNG in |data|. With a |cache|, results are looked
+// up by content hash before decoding and stored afterwards; a hit leaves
+// |timings| at zero except for decode_ms, which covers hashing. Asking for
+// |detail| always decodes, as the cache only holds summaries.
+OrbitaStatus AnalyzeEncoded(const uint8_t* data,
+                            size_t size,
+                            const OrbitaAnalysisParams& params,
+                            OrbitaSpectrumSummary* out,
+                            StageTimings* timings = nullptr,
+                            ResultCache* cache = nullptr,
+                            AnalysisDetail* detail = nullptr,
+                            const CancellationToken* cancel = nullptr);
+
+// AnalyzeEncoded over the file at |path|, which is memory-mapped rather
+// than read into a buffer. On a cache hit, decode_ms covers reading and
+// hashing the file.
+OrbitaStatus AnalyzeFile(const char* path,
+                         const OrbitaAnalysisParams& params,
+                         OrbitaSpectrumSummary* out,
+                         StageTimings* timings = nullptr,
+                         ResultCache* cache = nullptr,
+                         AnalysisDetail* detail = nullptr,
+                         const CancellationToken* cancel = nullptr);
+
+// How AnalyzeEncodedProgressive() refines its result.
+struct RefinementOptions {
+  // Refinement stops once no dominant bin changes by more than this much,
+  // relative to the largest, from one level to the next. The chaos level
+  // is not compared, since it rises as the resolution drops. 0 always
+  // refines to the working resolution.
+  double tolerance = 0.02;
+  // Called with the summary of every level but the last, coarsest first.
+  // |scale| is how many source pixels each analysed pixel covers per side;
+  // the chaos level is the one measured at that scale.
+  std::function<void(const OrbitaSpectrumSummary& summary, int scale)>
+      on_preview;
+};
+
+// AnalyzeEncoded, coarse to fine: the image is analysed at 1/8, 1/4 and
+// 1/2 of the working resolution and then in full, reporting every level
+// but the last to |refinement.on_preview|. A JPEG's 1/8 and 1/4 levels are
+// decoded on their own at reduced DCT scale before the working resolution
+// is decoded; the 1/2 level, and every level of a PNG, is box-filtered
+// down from the working resolution.
+//
+// Once two levels in a row agree within |refinement.tolerance|, |out| is
+// the finer one's summary, with its chaos level extrapolated from the two
+// levels to the working resolution, and the working resolution is never
+// analysed. Such early results are not cached. Asking for |detail| always
+// refines to the working resolution.
+OrbitaStatus AnalyzeEncodedProgressive(const uint8_t* data,
+                                       size_t size,
+                                       const OrbitaAnalysisParams& params,
+                                       const RefinementOptions& refinement,
+                                       OrbitaSpectrumSummary* out,
+                                       ResultCache* cache = nullptr,
+                                       AnalysisDetail* detail = nullptr,
+                                       const CancellationToken* cancel =
+                                           nullptr);
+
+// AnalyzeEncodedProgressive over the file at |path|.
+OrbitaStatus AnalyzeFileProgressive(const char* path,
+                                    const OrbitaAnalysisParams& params,
+                                    const RefinementOptions& refinement,
+                                    OrbitaSpectrumSummary* out,
+                                    ResultCache* cache = nullptr,
+                                    AnalysisDetail* detail = nullptr,
+                                    const CancellationToken* cancel = nullptr);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_ANALYSIS_H_
@@ -0,0 +1,238 @@
+#include "batch_analysis.h"
+
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "analysis.h"
+#include "json_writer.h"
+#include "mapped_file.h"
+#include "scratch_memory.h"
+#include "similarity_index.h"
+#include "thread_pool.h"
+
+namespace orbita {
+
+namespace {
+
+bool HasImageExtension(const std::string& name) {
+  const size_t dot = name.rfind('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = name.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension == "jpg" || extension == "jpeg" || extension == "png";
+}
+
+// Recursive listing. Symlinked directories are not followed, so links
+// cannot send the walk round in circles.
+void WalkDirectory(const std::string& directory,
+                   std::vector<std::string>* paths) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  while (const dirent* entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+    const std::string path = directory + "/" + name;
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0) {
+      continue;
+    }
+    if (S_ISDIR(info.st_mode)) {
+      WalkDirectory(path, paths);
+    } else if (HasImageExtension(name) &&
+               (S_ISREG(info.st_mode) ||
+                (S_ISLNK(info.st_mode) && stat(path.c_str(), &info) == 0 &&
+                 S_ISREG(info.st_mode)))) {
+      paths->push_back(path);
+    }
+  }
+  closedir(dir);
+}
+
+std::string FormatResult(const std::string& path,
+                         const std::string& id,
+                         OrbitaStatus status,
+                         const OrbitaSpectrumSummary& summary,
+                         const StageTimings& timings,
+                         double total_ms) {
+  std::string line = "{\"path\":";
+  AppendJsonString(&line, path);
+  if (!id.empty()) {
+    line += ",\"id\":";
+    AppendJsonString(&line, id);
+  }
+  if (status != ORBITA_OK) {
+    line += ",\"error\":";
+    AppendJsonString(&line, orbita_status_string(status));
+    line += "}\n";
+    return line;
+  }
+  line += ",\"dominantFrequencies\":[";
+  for (int i = 0; i < ORBITA_DOMINANT_BIN_COUNT; ++i) {
+    if (i > 0) {
+      line += ',';
+    }
+    AppendJsonNumber(&line, summary.dominant_frequencies[i]);
+  }
+  line += "],\"chaosLevel\":";
+  AppendJsonNumber(&line, summary.chaos_level);
+  line += ",\"density\":";
+  AppendJsonNumber(&line, summary.density);
+  line += ",\"timings\":{\"decodeMs\":";
+  AppendJsonNumber(&line, timings.decode_ms);
+  line += ",\"preprocessMs\":";
+  AppendJsonNumber(&line, timings.preprocess_ms);
+  line += ",\"rayCastMs\":";
+  AppendJsonNumber(&line, timings.ray_cast_ms);
+  line += ",\"spectrumMs\":";
+  AppendJsonNumber(&line, timings.spectrum_ms);
+  line += ",\"totalMs\":";
+  AppendJsonNumber(&line, total_ms);
+  line += "}}\n";
+  return line;
+}
+
+// AnalyzeFile, also adding the image to |index|.
+OrbitaStatus AnalyzeAndIndex(const std::string& path,
+                             const OrbitaAnalysisParams& params,
+                             SimilarityIndex* index,
+                             OrbitaSpectrumSummary* summary,
+                             StageTimings* timings,
+                             std::string* id) {
+  MappedFile file;
+  if (!file.Open(path.c_str())) {
+    return ORBITA_ERROR_IO;
+  }
+  const uint64_t key = ImageId(file.data(), file.size());
+  *id = FormatImageId(key);
+  AnalysisDetail detail;
+  OrbitaStatus status = AnalyzeEncoded(file.data(), file.size(), params,
+                                       summary, timings, nullptr, &detail);
+  if (status != ORBITA_OK) {
+    return status;
+  }
+  float features[kSpectralFeatureSize];
+  SpectralFeatures(detail.spectrum, features);
+  return index->Insert(key, features);
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+std::vector<std::string> CollectImagePaths(const std::string& input) {
+  std::vector<std::string> paths;
+  struct stat info;
+  if (stat(input.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+    std::string directory = input;
+    while (directory.size() > 1 && directory.back() == '/') {
+      directory.pop_back();
+    }
+    WalkDirectory(directory, &paths);
+  } else {
+    glob_t matches;
+    if (glob(input.c_str(), GLOB_TILDE | GLOB_BRACE, nullptr, &matches) == 0) {
+      for (size_t i = 0; i < matches.gl_pathc; ++i) {
+        if (stat(matches.gl_pathv[i], &info) == 0 && S_ISREG(info.st_mode)) {
+          paths.push_back(matches.gl_pathv[i]);
+        }
+      }
+    }
+    globfree(&matches);
+  }
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+int RunBatchAnalysis(const BatchAnalysisOptions& options) {
+  const std::vector<std::string> paths = CollectImagePaths(options.input);
+  if (paths.empty()) {
+    fprintf(stderr, "orbita: no images match %s\n", options.input.c_str());
+    return 1;
+  }
+  FILE* out = options.output == "-" ? stdout
+                                    : fopen(options.output.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "orbita: cannot write %s: %s\n", options.output.c_str(),
+            strerror(errno));
+    return 1;
+  }
+
+  SimilarityIndex index;
+  if (!options.index.empty()) {
+    const OrbitaStatus status = index.Open(options.index.c_str(), true);
+    if (status != ORBITA_OK) {
+      fprintf(stderr, "orbita: cannot open index %s: %s\n",
+              options.index.c_str(), orbita_status_string(status));
+      if (out != stdout) {
+        fclose(out);
+      }
+      return 1;
+    }
+  }
+
+  SetScratchLimit(options.memory_limit);
+  const auto start = std::chrono::steady_clock::now();
+  std::mutex output_mutex;
+  std::atomic<size_t> failures{0};
+  {
+    ThreadPool pool(options.jobs);
+    for (const std::string& path : paths) {
+      pool.Submit([&, path] {
+        const auto begin = std::chrono::steady_clock::now();
+        OrbitaSpectrumSummary summary;
+        StageTimings timings;
+        std::string id;
+        const OrbitaStatus status = CatchOutOfMemory([&] {
+          return options.index.empty()
+                     ? AnalyzeFile(path.c_str(), options.params, &summary,
+                                   &timings)
+                     : AnalyzeAndIndex(path, options.params, &index,
+                                       &summary, &timings, &id);
+        });
+        if (status != ORBITA_OK) {
+          ++failures;
+        }
+        const std::string line = FormatResult(
+            path, id, status, summary, timings, MillisecondsSince(begin));
+        std::lock_guard<std::mutex> lock(output_mutex);
+        fwrite(line.data(), 1, line.size(), out);
+        fflush(out);
+      });
+    }
+    pool.Wait();
+  }
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  const ScratchUsage usage = GetScratchUsage();
+  fprintf(stderr,
+          "orbita: analysed %zu images (%zu failed) in %.2f s, peak scratch "
+          "memory %.0f MB\n",
+          paths.size(), failures.load(), MillisecondsSince(start) / 1000.0,
+          usage.peak_bytes / 1e6);
+  return failures == 0 ? 0 : 1;
+}
+
+}  // namespace orbita
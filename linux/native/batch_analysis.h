@@ -0,0 +1,49 @@
+#ifndef ORBITA_NATIVE_BATCH_ANALYSIS_H_
+#define ORBITA_NATIVE_BATCH_ANALYSIS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Options for `orbita --analyze`.
+struct BatchAnalysisOptions {
+  // A directory, searched recursively for .jpg, .jpeg and .png files, or a
+  // glob(7) pattern.
+  std::string input;
+  // JSON Lines output file; "-" writes to stdout.
+  std::string output = "-";
+  // Images analysed concurrently; <= 0 uses every hardware thread.
+  int jobs = 0;
+  // SimilarityIndex file each image's spectral features are added to, under
+  // its ImageId(); empty for none.
+  std::string index;
+  // Most bytes of scratch memory the jobs may hold at once (see
+  // SetScratchLimit()); 0 for no limit.
+  int64_t memory_limit = 0;
+  OrbitaAnalysisParams params;
+};
+
+// Expands |input| (see BatchAnalysisOptions::input) into a sorted file list.
+std::vector<std::string> CollectImagePaths(const std::string& input);
+
+// Analyses every image matched by |options.input| on a work-stealing pool
+// and streams one JSON object per image to |options.output|, in completion
+// order:
+//
+//   {"path": ..., "dominantFrequencies": [...], "chaosLevel": ...,
+//    "density": ..., "timings": {"decodeMs": ..., "preprocessMs": ...,
+//    "rayCastMs": ..., "spectrumMs": ..., "totalMs": ...}}
+//
+// With an index, each object also carries the image's "id" as 16 hex
+// digits. Images that fail produce {"path": ..., "error": ...} instead.
+// Returns the process exit code: 0 if every image was analysed, 1
+// otherwise.
+int RunBatchAnalysis(const BatchAnalysisOptions& options);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_BATCH_ANALYSIS_H_
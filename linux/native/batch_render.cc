@@ -0,0 +1,95 @@
+#include "batch_render.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "file_util.h"
+#include "hash.h"
+#include "logogram_export.h"
+#include "logogram_geometry.h"
+#include "scratch_memory.h"
+#include "spectrum_archive.h"
+#include "thread_pool.h"
+
+namespace orbita {
+
+int32_t SeedForLine(int32_t seed, uint64_t line) {
+  uint8_t bytes[8];
+  for (int i = 0; i < 8; ++i) {
+    bytes[i] = static_cast<uint8_t>(line >> (8 * i));
+  }
+  return static_cast<int32_t>(static_cast<uint32_t>(
+      Hash64(bytes, sizeof(bytes), static_cast<uint32_t>(seed))));
+}
+
+int RunBatchRender(const BatchRenderOptions& options) {
+  const OrbitaRenderStyle& style = options.style;
+  if (style.width <= 0 || style.height <= 0) {
+    fprintf(stderr, "orbita: invalid size\n");
+    return 1;
+  }
+  std::vector<HeptapodSpectrum> spectra;
+  std::vector<uint64_t> lines;
+  if (!ReadSpectra(options.input, &spectra, &lines)) {
+    return 1;
+  }
+  if (!MakeDirectories(options.output_dir)) {
+    fprintf(stderr, "orbita: cannot create %s: %s\n",
+            options.output_dir.c_str(), strerror(errno));
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::mutex error_mutex;
+  std::atomic<size_t> failures{0};
+  {
+    ThreadPool pool(options.jobs);
+    for (size_t i = 0; i < spectra.size(); ++i) {
+      pool.Submit([&, i] {
+        const int32_t seed = options.seed_from_id
+                                 ? SeedForLine(options.seed, lines[i])
+                                 : options.seed;
+        char name[40];
+        snprintf(name, sizeof(name), "/logogram_%06llu.png",
+                 static_cast<unsigned long long>(lines[i]));
+        const std::string path = options.output_dir + name;
+        // Every job builds its geometry and compresses its own PNG on its
+        // own thread, so the jobs alone fill the cores; rasterising still
+        // shares ParallelFor's. Every spectrum is drawn once, so nothing
+        // is worth caching.
+        const OrbitaStatus status = CatchOutOfMemory([&] {
+          return ExportLogogramPng(
+              *LogogramGeometryCache::Build(ShapeOf(spectra[i]), seed,
+                                            style.width, style.height),
+              style, path.c_str(), /*cancel=*/nullptr,
+              /*compression_threads=*/1);
+        });
+        if (status != ORBITA_OK) {
+          ++failures;
+          std::lock_guard<std::mutex> lock(error_mutex);
+          fprintf(stderr, "orbita: cannot write %s: %s\n", path.c_str(),
+                  orbita_status_string(status));
+        }
+      });
+    }
+    pool.Wait();
+  }
+
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  fprintf(stderr,
+          "orbita: rendered %zu logograms (%zu failed) into %s in %.2f s "
+          "(%.1f/s)\n",
+          spectra.size(), failures.load(), options.output_dir.c_str(),
+          seconds, seconds > 0 ? spectra.size() / seconds : 0.0);
+  return failures == 0 ? 0 : 1;
+}
+
+}  // namespace orbita
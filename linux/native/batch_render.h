@@ -0,0 +1,44 @@
+#ifndef ORBITA_NATIVE_BATCH_RENDER_H_
+#define ORBITA_NATIVE_BATCH_RENDER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Options for `orbita --render`.
+struct BatchRenderOptions {
+  // SpectrumArchive or JSON Lines file of spectra (see ReadSpectra()).
+  std::string input;
+  // Directory for the PNG files, created if missing.
+  std::string output_dir;
+  // Logograms rendered concurrently; <= 0 uses every hardware thread.
+  int jobs = 0;
+  // HeptapodPainter.defaultSeed, which ImageSaver exports with.
+  int32_t seed = 1337;
+  // Draw each logogram with a seed of its own, derived from |seed| and the
+  // spectrum's line in the input, instead of |seed| itself.
+  bool seed_from_id = false;
+  // Canvas and colours, as ImageSaver exports them by default.
+  OrbitaRenderStyle style;
+};
+
+// Seed of the logogram of the spectrum on |line| of the input when each
+// gets its own: the low 32 bits of XXH64 of |line| as a little-endian
+// uint64, with |seed| as the hash seed. The same catalogue line therefore
+// always gets the same logogram, however many jobs render it.
+int32_t SeedForLine(int32_t seed, uint64_t line);
+
+// Renders the logogram of every spectrum in |options.input| with
+// ExportLogogramPng(), several at a time on a work-stealing pool, into
+// logogram_<line>.png in |options.output_dir|, where <line> is the
+// spectrum's line in the JSON Lines file it came from (kept by --ingest),
+// zero-padded to six digits. Returns the process exit code: 0 if every
+// logogram was written, 1 otherwise.
+int RunBatchRender(const BatchRenderOptions& options);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_BATCH_RENDER_H_
@@ -0,0 +1,384 @@
+#include "fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
+#include "parallel.h"
+#include "simd.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// First bin summed into chaosLevel; everything below is "shape".
+constexpr int kChaosFirstBin = 20;
+
+// Profiles handed to one worker at a time by the batched entry points.
+constexpr int kProfilesPerTask = 32;
+
+// One radix-2 decimation-in-time stage over split arrays of |n| points.
+// |wr| and |wi| point at this stage's |half| twiddles.
+void StageScalar(double* re,
+                 double* im,
+                 const double* wr,
+                 const double* wi,
+                 int n,
+                 int half) {
+  for (int start = 0; start < n; start += 2 * half) {
+    double* ar = re + start;
+    double* ai = im + start;
+    double* br = ar + half;
+    double* bi = ai + half;
+    for (int k = 0; k < half; ++k) {
+      const double tr = br[k] * wr[k] - bi[k] * wi[k];
+      const double ti = br[k] * wi[k] + bi[k] * wr[k];
+      br[k] = ar[k] - tr;
+      bi[k] = ai[k] - ti;
+      ar[k] += tr;
+      ai[k] += ti;
+    }
+  }
+}
+
+double MagnitudeSumScalar(const double* re, const double* im, int count) {
+  double sum = 0.0;
+  for (int k = 0; k < count; ++k) {
+    sum += std::sqrt(re[k] * re[k] + im[k] * im[k]);
+  }
+  return sum;
+}
+
+#if ORBITA_X86
+
+__attribute__((target("avx2"))) void StageAvx2(double* re,
+                                               double* im,
+                                               const double* wr,
+                                               const double* wi,
+                                               int n,
+                                               int half) {
+  for (int start = 0; start < n; start += 2 * half) {
+    double* ar = re + start;
+    double* ai = im + start;
+    double* br = ar + half;
+    double* bi = ai + half;
+    for (int k = 0; k < half; k += 4) {
+      const __m256d xr = _mm256_loadu_pd(br + k);
+      const __m256d xi = _mm256_loadu_pd(bi + k);
+      const __m256d cr = _mm256_loadu_pd(wr + k);
+      const __m256d ci = _mm256_loadu_pd(wi + k);
+      const __m256d tr =
+          _mm256_sub_pd(_mm256_mul_pd(xr, cr), _mm256_mul_pd(xi, ci));
+      const __m256d ti =
+          _mm256_add_pd(_mm256_mul_pd(xr, ci), _mm256_mul_pd(xi, cr));
+      const __m256d yr = _mm256_loadu_pd(ar + k);
+      const __m256d yi = _mm256_loadu_pd(ai + k);
+      _mm256_storeu_pd(br + k, _mm256_sub_pd(yr, tr));
+      _mm256_storeu_pd(bi + k, _mm256_sub_pd(yi, ti));
+      _mm256_storeu_pd(ar + k, _mm256_add_pd(yr, tr));
+      _mm256_storeu_pd(ai + k, _mm256_add_pd(yi, ti));
+    }
+  }
+}
+
+__attribute__((target("avx2"))) double MagnitudeSumAvx2(const double* re,
+                                                        const double* im,
+                                                        int count) {
+  __m256d acc = _mm256_setzero_pd();
+  int k = 0;
+  for (; k + 4 <= count; k += 4) {
+    const __m256d r = _mm256_loadu_pd(re + k);
+    const __m256d i = _mm256_loadu_pd(im + k);
+    acc = _mm256_add_pd(
+        acc, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(r, r),
+                                          _mm256_mul_pd(i, i))));
+  }
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         MagnitudeSumScalar(re + k, im + k, count - k);
+}
+
+#if defined(__SSE2__)
+void StageSse2(double* re,
+               double* im,
+               const double* wr,
+               const double* wi,
+               int n,
+               int half) {
+  for (int start = 0; start < n; start += 2 * half) {
+    double* ar = re + start;
+    double* ai = im + start;
+    double* br = ar + half;
+    double* bi = ai + half;
+    for (int k = 0; k < half; k += 2) {
+      const __m128d xr = _mm_loadu_pd(br + k);
+      const __m128d xi = _mm_loadu_pd(bi + k);
+      const __m128d cr = _mm_loadu_pd(wr + k);
+      const __m128d ci = _mm_loadu_pd(wi + k);
+      const __m128d tr = _mm_sub_pd(_mm_mul_pd(xr, cr), _mm_mul_pd(xi, ci));
+      const __m128d ti = _mm_add_pd(_mm_mul_pd(xr, ci), _mm_mul_pd(xi, cr));
+      const __m128d yr = _mm_loadu_pd(ar + k);
+      const __m128d yi = _mm_loadu_pd(ai + k);
+      _mm_storeu_pd(br + k, _mm_sub_pd(yr, tr));
+      _mm_storeu_pd(bi + k, _mm_sub_pd(yi, ti));
+      _mm_storeu_pd(ar + k, _mm_add_pd(yr, tr));
+      _mm_storeu_pd(ai + k, _mm_add_pd(yi, ti));
+    }
+  }
+}
+#endif  // defined(__SSE2__)
+
+#elif ORBITA_NEON_F64
+
+void StageNeon(double* re,
+               double* im,
+               const double* wr,
+               const double* wi,
+               int n,
+               int half) {
+  for (int start = 0; start < n; start += 2 * half) {
+    double* ar = re + start;
+    double* ai = im + start;
+    double* br = ar + half;
+    double* bi = ai + half;
+    for (int k = 0; k < half; k += 2) {
+      const float64x2_t xr = vld1q_f64(br + k);
+      const float64x2_t xi = vld1q_f64(bi + k);
+      const float64x2_t cr = vld1q_f64(wr + k);
+      const float64x2_t ci = vld1q_f64(wi + k);
+      const float64x2_t tr = vsubq_f64(vmulq_f64(xr, cr), vmulq_f64(xi, ci));
+      const float64x2_t ti = vaddq_f64(vmulq_f64(xr, ci), vmulq_f64(xi, cr));
+      const float64x2_t yr = vld1q_f64(ar + k);
+      const float64x2_t yi = vld1q_f64(ai + k);
+      vst1q_f64(br + k, vsubq_f64(yr, tr));
+      vst1q_f64(bi + k, vsubq_f64(yi, ti));
+      vst1q_f64(ar + k, vaddq_f64(yr, tr));
+      vst1q_f64(ai + k, vaddq_f64(yi, ti));
+    }
+  }
+}
+
+#endif
+
+// Picks the widest butterfly kernel whose vector width divides |half|.
+void Stage(double* re,
+           double* im,
+           const double* wr,
+           const double* wi,
+           int n,
+           int half) {
+#if ORBITA_X86
+  if (half >= 4 && CpuHasAvx2()) {
+    StageAvx2(re, im, wr, wi, n, half);
+    return;
+  }
+#if defined(__SSE2__)
+  if (half >= 2) {
+    StageSse2(re, im, wr, wi, n, half);
+    return;
+  }
+#endif
+#elif ORBITA_NEON_F64
+  if (half >= 2) {
+    StageNeon(re, im, wr, wi, n, half);
+    return;
+  }
+#endif
+  StageScalar(re, im, wr, wi, n, half);
+}
+
+double MagnitudeSum(const double* re, const double* im, int count) {
+#if ORBITA_X86
+  if (CpuHasAvx2()) {
+    return MagnitudeSumAvx2(re, im, count);
+  }
+#endif
+  return MagnitudeSumScalar(re, im, count);
+}
+
+}  // namespace
+
+std::shared_ptr<const RealFftPlan> RealFftPlan::Get(int size) {
+  static std::mutex mutex;
+  static auto* plans =
+      new std::unordered_map<int, std::shared_ptr<const RealFftPlan>>();
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<const RealFftPlan>& plan = (*plans)[size];
+  if (!plan) {
+    plan = std::make_shared<RealFftPlan>(size);
+  }
+  return plan;
+}
+
+RealFftPlan::RealFftPlan(int size)
+    : size_(size),
+      half_(size / 2),
+      bit_reverse_(half_),
+      twiddle_re_(half_),
+      twiddle_im_(half_),
+      unpack_re_(half_ + 1),
+      unpack_im_(half_ + 1) {
+  int bits = 0;
+  while ((1 << bits) < half_) {
+    ++bits;
+  }
+  for (int i = 0; i < half_; ++i) {
+    int reversed = 0;
+    for (int b = 0; b < bits; ++b) {
+      reversed |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    bit_reverse_[i] = reversed;
+  }
+  for (int half = 1; half < half_; half *= 2) {
+    for (int k = 0; k < half; ++k) {
+      const double angle = -M_PI * k / half;
+      twiddle_re_[half + k] = std::cos(angle);
+      twiddle_im_[half + k] = std::sin(angle);
+    }
+  }
+  for (int k = 0; k <= half_; ++k) {
+    const double angle = -2.0 * M_PI * k / size_;
+    unpack_re_[k] = std::cos(angle);
+    unpack_im_[k] = std::sin(angle);
+  }
+}
+
+void RealFftPlan::Forward(const double* input, double* re, double* im) const {
+  thread_local std::vector<double> zr;
+  thread_local std::vector<double> zi;
+  zr.resize(half_);
+  zi.resize(half_);
+
+  // Pack even samples as real and odd samples as imaginary parts.
+  for (int m = 0; m < half_; ++m) {
+    zr[bit_reverse_[m]] = input[2 * m];
+    zi[bit_reverse_[m]] = input[2 * m + 1];
+  }
+  for (int half = 1; half < half_; half *= 2) {
+    Stage(zr.data(), zi.data(), twiddle_re_.data() + half,
+          twiddle_im_.data() + half, half_, half);
+  }
+
+  // Split Z into the spectra of the even (E) and odd (O) samples and
+  // recombine: X[k] = E[k] + exp(-2*pi*i*k/N) * O[k].
+  re[0] = zr[0] + zi[0];
+  im[0] = 0.0;
+  re[half_] = zr[0] - zi[0];
+  im[half_] = 0.0;
+  for (int k = 1; k < half_; ++k) {
+    const double ar = zr[k];
+    const double ai = zi[k];
+    const double br = zr[half_ - k];
+    const double bi = -zi[half_ - k];
+    const double er = 0.5 * (ar + br);
+    const double ei = 0.5 * (ai + bi);
+    const double odd_r = 0.5 * (ai - bi);
+    const double odd_i = -0.5 * (ar - br);
+    re[k] = er + unpack_re_[k] * odd_r - unpack_im_[k] * odd_i;
+    im[k] = ei + unpack_re_[k] * odd_i + unpack_im_[k] * odd_r;
+  }
+}
+
+void RealFftPlan::Inverse(const double* re,
+                          const double* im,
+                          double* output) const {
+  thread_local std::vector<double> zr;
+  thread_local std::vector<double> zi;
+  zr.resize(half_);
+  zi.resize(half_);
+
+  // Undo the recombination: E[k] = (X[k] + conj(X[N/2 - k])) / 2 and
+  // O[k] = (X[k] - conj(X[N/2 - k])) * exp(2*pi*i*k/N) / 2, then
+  // Z[k] = E[k] + i * O[k]. Z is stored conjugated and bit-reversed, so
+  // that the forward butterflies compute the conjugate of its inverse.
+  for (int k = 0; k < half_; ++k) {
+    const double ar = re[k];
+    const double ai = k == 0 ? 0.0 : im[k];
+    const double br = re[half_ - k];
+    const double bi = k == 0 ? 0.0 : -im[half_ - k];
+    const double er = 0.5 * (ar + br);
+    const double ei = 0.5 * (ai + bi);
+    const double dr = 0.5 * (ar - br);
+    const double di = 0.5 * (ai - bi);
+    const double odd_r = dr * unpack_re_[k] + di * unpack_im_[k];
+    const double odd_i = di * unpack_re_[k] - dr * unpack_im_[k];
+    zr[bit_reverse_[k]] = er - odd_i;
+    zi[bit_reverse_[k]] = -(ei + odd_r);
+  }
+  for (int half = 1; half < half_; half *= 2) {
+    Stage(zr.data(), zi.data(), twiddle_re_.data() + half,
+          twiddle_im_.data() + half, half_, half);
+  }
+
+  // Even samples are the real parts and odd samples the imaginary parts.
+  const double scale = 1.0 / half_;
+  for (int m = 0; m < half_; ++m) {
+    output[2 * m] = zr[m] * scale;
+    output[2 * m + 1] = -zi[m] * scale;
+  }
+}
+
+void RealFftBatch(const double* inputs,
+                  int count,
+                  int size,
+                  double* re,
+                  double* im) {
+  const std::shared_ptr<const RealFftPlan> plan = RealFftPlan::Get(size);
+  const size_t bins = size / 2 + 1;
+  const int tasks = (count + kProfilesPerTask - 1) / kProfilesPerTask;
+  ParallelFor(tasks, [&](int task) {
+    const int end = std::min(count, (task + 1) * kProfilesPerTask);
+    for (int i = task * kProfilesPerTask; i < end; ++i) {
+      plan->Forward(inputs + static_cast<size_t>(i) * size, re + i * bins,
+                    im + i * bins);
+    }
+  });
+}
+
+void SummarizeRayProfile(const RealFftPlan& plan,
+                         const double* profile,
+                         OrbitaSpectrumSummary* out) {
+  ORBITA_TRACE_SPAN("spectrum");
+  thread_local std::vector<double> re;
+  thread_local std::vector<double> im;
+  const int nyquist = plan.size() / 2;
+  re.resize(nyquist + 1);
+  im.resize(nyquist + 1);
+  plan.Forward(profile, re.data(), im.data());
+
+  for (int i = 0; i < ORBITA_DOMINANT_BIN_COUNT; ++i) {
+    const int k = i + 1;
+    out->dominant_frequencies[i] = std::sqrt(re[k] * re[k] + im[k] * im[k]);
+  }
+  out->chaos_level = MagnitudeSum(re.data() + kChaosFirstBin,
+                                  im.data() + kChaosFirstBin,
+                                  nyquist - kChaosFirstBin);
+
+  const double average_radius = std::fabs(re[0]);
+  if (average_radius > 0) {
+    out->chaos_level /= average_radius;
+    for (double& bin : out->dominant_frequencies) {
+      bin /= average_radius;
+    }
+  }
+}
+
+void SummarizeRayProfiles(const double* profiles,
+                          int count,
+                          int size,
+                          OrbitaSpectrumSummary* out) {
+  const std::shared_ptr<const RealFftPlan> plan = RealFftPlan::Get(size);
+  const int tasks = (count + kProfilesPerTask - 1) / kProfilesPerTask;
+  ParallelFor(tasks, [&](int task) {
+    const int end = std::min(count, (task + 1) * kProfilesPerTask);
+    for (int i = task * kProfilesPerTask; i < end; ++i) {
+      SummarizeRayProfile(*plan, profiles + static_cast<size_t>(i) * size,
+                          out + i);
+    }
+  });
+}
+
+}  // namespace orbita
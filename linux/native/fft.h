@@ -0,0 +1,74 @@
+#ifndef ORBITA_NATIVE_FFT_H_
+#define ORBITA_NATIVE_FFT_H_
+
+#include <memory>
+#include <vector>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// DFT of a real signal whose length is a power of two, and its inverse.
+//
+// The signal is packed into a half-length complex FFT (split real/imaginary
+// arrays, SIMD radix-2 butterflies) and unpacked with precomputed twiddles.
+// Plans are immutable and cached per size, so transforming thousands of ray
+// profiles pays the setup once.
+class RealFftPlan {
+ public:
+  // Returns the shared plan for |size| (a power of two >= 4), building it on
+  // first use. Thread-safe.
+  static std::shared_ptr<const RealFftPlan> Get(int size);
+
+  explicit RealFftPlan(int size);
+
+  int size() const { return size_; }
+
+  // Writes bins 0..size/2 of the DFT of |input| to |re| and |im|, each of
+  // which must hold size / 2 + 1 values.
+  void Forward(const double* input, double* re, double* im) const;
+
+  // Inverse of Forward(): writes the size real samples whose DFT has bins
+  // 0..size/2 |re| and |im| to |output|. The imaginary parts of bins 0
+  // and size/2 are ignored.
+  void Inverse(const double* re, const double* im, double* output) const;
+
+ private:
+  int size_;
+  int half_;
+  // Bit-reversal permutation of the half-length transform.
+  std::vector<int> bit_reverse_;
+  // Butterfly twiddles; stage with half-width h uses entries [h, 2h).
+  std::vector<double> twiddle_re_;
+  std::vector<double> twiddle_im_;
+  // exp(-2*pi*i*k/size) for k in [0, size/2], used to unpack the result.
+  std::vector<double> unpack_re_;
+  std::vector<double> unpack_im_;
+};
+
+// Transforms |count| real signals of |size| samples stored back to back.
+// Bins for signal i land at re/im + i * (size / 2 + 1). Signals are spread
+// across worker threads.
+void RealFftBatch(const double* inputs,
+                  int count,
+                  int size,
+                  double* re,
+                  double* im);
+
+// Fills dominant_frequencies (|X[1]|..|X[5]|) and chaos_level
+// (sum of |X[k]| for 20 <= k < size/2) of |out| from one ray profile, both
+// normalised by |X[0]| when it is non-zero. density is left untouched.
+// |size| must be a power of two >= 64.
+void SummarizeRayProfile(const RealFftPlan& plan,
+                         const double* profile,
+                         OrbitaSpectrumSummary* out);
+
+// SummarizeRayProfile over |count| back-to-back profiles, in parallel.
+void SummarizeRayProfiles(const double* profiles,
+                          int count,
+                          int size,
+                          OrbitaSpectrumSummary* out);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_FFT_H_
@@ -0,0 +1,21 @@
+#include "file_util.h"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+
+namespace orbita {
+
+bool MakeDirectories(const std::string& path) {
+  for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1)) {
+    const std::string prefix = path.substr(0, slash);
+    if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+      return false;
+    }
+    if (slash == std::string::npos) {
+      return true;
+    }
+  }
+}
+
+}  // namespace orbita
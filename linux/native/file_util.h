@@ -0,0 +1,14 @@
+#ifndef ORBITA_NATIVE_FILE_UTIL_H_
+#define ORBITA_NATIVE_FILE_UTIL_H_
+
+#include <string>
+
+namespace orbita {
+
+// mkdir -p: creates |path| and any missing parents. Returns false, with
+// errno set, if one cannot be created.
+bool MakeDirectories(const std::string& path);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_FILE_UTIL_H_
@@ -0,0 +1,340 @@
+#include "frame_source.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "mapped_file.h"
+#include "preprocess.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// Reduces the |width| x |height| luma plane at |src|, rows |stride| bytes
+// apart, by |scale| with a box filter into |out|.
+void ReducePlane(const uint8_t* src,
+                 int width,
+                 int height,
+                 size_t stride,
+                 int scale,
+                 LumaFrame* out) {
+  out->scale = scale;
+  out->width = std::max(1, width / scale);
+  out->height = std::max(1, height / scale);
+  out->luma.resize(static_cast<size_t>(out->width) * out->height);
+  if (scale == 1) {
+    for (int y = 0; y < height; ++y) {
+      memcpy(out->luma.data() + static_cast<size_t>(y) * width,
+             src + y * stride, width);
+    }
+    return;
+  }
+  const int area = scale * scale;
+  std::vector<uint32_t> sums(out->width);
+  for (int y = 0; y < out->height; ++y) {
+    std::fill(sums.begin(), sums.end(), 0);
+    for (int j = 0; j < scale; ++j) {
+      const uint8_t* row =
+          src + (static_cast<size_t>(y) * scale + j) * stride;
+      for (int x = 0; x < out->width; ++x) {
+        for (int i = 0; i < scale; ++i) {
+          sums[x] += row[x * scale + i];
+        }
+      }
+    }
+    uint8_t* dst = out->luma.data() + static_cast<size_t>(y) * out->width;
+    for (int x = 0; x < out->width; ++x) {
+      dst[x] = static_cast<uint8_t>((sums[x] + area / 2) / area);
+    }
+  }
+}
+
+// Reduces a frame of |channels| interleaved channels to luma.
+void ReduceFrame(const uint8_t* src,
+                 int width,
+                 int height,
+                 int channels,
+                 int64_t target_pixels,
+                 LumaFrame* out) {
+  const int scale = ChooseDecodeScale(width, height, target_pixels);
+  const size_t stride = static_cast<size_t>(width) * channels;
+  if (channels == 1) {
+    ReducePlane(src, width, height, stride, scale, out);
+    return;
+  }
+  ScratchVector<uint8_t> luma(static_cast<size_t>(width) * height);
+  LumaPlane(ImageView{src, width, height, static_cast<int>(stride), channels},
+            luma.data());
+  ReducePlane(luma.data(), width, height, width, scale, out);
+}
+
+// Frames stored back to back in one mapped file.
+class PackedFrameSource : public FrameSource {
+ public:
+  OrbitaStatus ReadFrame(int index,
+                         int64_t target_pixels,
+                         LumaFrame* out) override {
+    if (index < 0 || index >= frame_count_) {
+      return ORBITA_ERROR_INVALID_ARGUMENT;
+    }
+    ORBITA_TRACE_SPAN("frame.read");
+    ReduceFrame(file_.data() + offsets_[index], width_, height_, channels_,
+                target_pixels, out);
+    return ORBITA_OK;
+  }
+
+ protected:
+  MappedFile file_;
+  int width_ = 0;
+  int height_ = 0;
+  int channels_ = 1;
+  // Where each frame's pixels start in |file_|.
+  std::vector<size_t> offsets_;
+};
+
+class RawFrameSource : public PackedFrameSource {
+ public:
+  OrbitaStatus Open(const char* path, const RawVideoFormat& format) {
+    if (format.width <= 0 || format.height <= 0 ||
+        (format.channels != 1 && format.channels != 3 &&
+         format.channels != 4)) {
+      return ORBITA_ERROR_INVALID_ARGUMENT;
+    }
+    if (!file_.Open(path)) {
+      return ORBITA_ERROR_IO;
+    }
+    width_ = format.width;
+    height_ = format.height;
+    channels_ = format.channels;
+    const size_t frame_size =
+        static_cast<size_t>(width_) * height_ * channels_;
+    for (size_t offset = 0; offset + frame_size <= file_.size();
+         offset += frame_size) {
+      offsets_.push_back(offset);
+    }
+    frame_count_ = static_cast<int>(offsets_.size());
+    return ORBITA_OK;
+  }
+};
+
+// YUV4MPEG2, as written by ffmpeg -f yuv4mpegpipe: a header line of
+// space-separated parameters, then for each frame a FRAME line followed by
+// the Y plane and any chroma planes. Only the Y plane is read.
+class Y4mFrameSource : public PackedFrameSource {
+ public:
+  static bool Matches(const uint8_t* data, size_t size) {
+    static const char kMagic[] = "YUV4MPEG2 ";
+    return size >= sizeof(kMagic) - 1 &&
+           memcmp(data, kMagic, sizeof(kMagic) - 1) == 0;
+  }
+
+  OrbitaStatus Open(const char* path) {
+    if (!file_.Open(path)) {
+      return ORBITA_ERROR_IO;
+    }
+    const char* data = reinterpret_cast<const char*>(file_.data());
+    const size_t size = file_.size();
+    if (!Matches(file_.data(), size)) {
+      return ORBITA_ERROR_UNSUPPORTED_FORMAT;
+    }
+    const char* end = static_cast<const char*>(memchr(data, '\n', size));
+    if (end == nullptr) {
+      return ORBITA_ERROR_DECODE;
+    }
+    std::string colour = "420jpeg";
+    const std::string header(data, end);
+    for (size_t pos = header.find(' '); pos != std::string::npos;) {
+      const size_t next = header.find(' ', pos + 1);
+      const std::string token = header.substr(
+          pos + 1, next == std::string::npos ? next : next - pos - 1);
+      pos = next;
+      if (token.empty()) {
+        continue;
+      }
+      const char* value = token.c_str() + 1;
+      switch (token[0]) {
+        case 'W':
+          width_ = atoi(value);
+          break;
+        case 'H':
+          height_ = atoi(value);
+          break;
+        case 'F': {
+          char* colon;
+          const double numerator = strtod(value, &colon);
+          const double denominator = *colon == ':' ? atof(colon + 1) : 0;
+          frame_rate_ = denominator > 0 ? numerator / denominator : 0;
+          break;
+        }
+        case 'C':
+          colour = value;
+          break;
+      }
+    }
+    if (width_ <= 0 || height_ <= 0) {
+      return ORBITA_ERROR_DECODE;
+    }
+    // 8-bit layouts only; 420p10 and the like store 16-bit samples.
+    const size_t luma = static_cast<size_t>(width_) * height_;
+    const size_t half_width = (width_ + 1) / 2;
+    size_t chroma;
+    if (colour == "420" || colour == "420jpeg" || colour == "420paldv" ||
+        colour == "420mpeg2") {
+      chroma = 2 * half_width * ((height_ + 1) / 2);
+    } else if (colour == "422") {
+      chroma = 2 * half_width * height_;
+    } else if (colour == "444") {
+      chroma = 2 * luma;
+    } else if (colour == "444alpha") {
+      chroma = 3 * luma;
+    } else if (colour == "mono") {
+      chroma = 0;
+    } else {
+      return ORBITA_ERROR_UNSUPPORTED_FORMAT;
+    }
+
+    // Each FRAME line may carry parameters of its own, so frames are
+    // found by walking the lines rather than by arithmetic.
+    static const char kFrame[] = "FRAME";
+    size_t pos = end - data + 1;
+    while (pos + sizeof(kFrame) - 1 <= size &&
+           memcmp(data + pos, kFrame, sizeof(kFrame) - 1) == 0) {
+      const char* line_end = static_cast<const char*>(
+          memchr(data + pos, '\n', size - pos));
+      if (line_end == nullptr) {
+        break;
+      }
+      const size_t pixels = line_end - data + 1;
+      if (pixels + luma + chroma > size) {
+        break;
+      }
+      offsets_.push_back(pixels);
+      pos = pixels + luma + chroma;
+    }
+    frame_count_ = static_cast<int>(offsets_.size());
+    return ORBITA_OK;
+  }
+};
+
+bool IsFrameFile(const std::string& name) {
+  const size_t dot = name.rfind('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = name.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension == "jpg" || extension == "jpeg" || extension == "png";
+}
+
+// The last run of digits in |name|, or -1 if it has none.
+long FrameNumber(const std::string& name) {
+  const size_t last = name.find_last_of("0123456789");
+  if (last == std::string::npos) {
+    return -1;
+  }
+  size_t first = last;
+  while (first > 0 && isdigit(static_cast<unsigned char>(name[first - 1]))) {
+    --first;
+  }
+  return strtol(name.c_str() + first, nullptr, 10);
+}
+
+class DirectoryFrameSource : public FrameSource {
+ public:
+  OrbitaStatus Open(const char* path) {
+    DIR* dir = opendir(path);
+    if (dir == nullptr) {
+      return ORBITA_ERROR_IO;
+    }
+    std::vector<std::pair<long, std::string>> frames;
+    while (const dirent* entry = readdir(dir)) {
+      const std::string name = entry->d_name;
+      if (IsFrameFile(name)) {
+        frames.emplace_back(FrameNumber(name), name);
+      }
+    }
+    closedir(dir);
+    std::sort(frames.begin(), frames.end());
+
+    std::string directory = path;
+    while (directory.size() > 1 && directory.back() == '/') {
+      directory.pop_back();
+    }
+    for (const auto& frame : frames) {
+      paths_.push_back(directory + "/" + frame.second);
+    }
+    frame_count_ = static_cast<int>(paths_.size());
+    return ORBITA_OK;
+  }
+
+  OrbitaStatus ReadFrame(int index,
+                         int64_t target_pixels,
+                         LumaFrame* out) override {
+    if (index < 0 || index >= frame_count_) {
+      return ORBITA_ERROR_INVALID_ARGUMENT;
+    }
+    ORBITA_TRACE_SPAN("frame.read");
+    MappedFile file;
+    if (!file.Open(paths_[index].c_str())) {
+      return ORBITA_ERROR_IO;
+    }
+    DecodedImage image;
+    const OrbitaStatus status =
+        DecodeImage(file.data(), file.size(), target_pixels, &image);
+    if (status != ORBITA_OK) {
+      return status;
+    }
+    out->width = image.width;
+    out->height = image.height;
+    out->scale = image.scale;
+    out->luma.resize(static_cast<size_t>(image.width) * image.height);
+    LumaPlane(image.view(), out->luma.data());
+    return ORBITA_OK;
+  }
+
+ private:
+  std::vector<std::string> paths_;
+};
+
+}  // namespace
+
+OrbitaStatus OpenFrameSource(const char* path,
+                             const RawVideoFormat* raw,
+                             std::unique_ptr<FrameSource>* out) {
+  if (path == nullptr || out == nullptr) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  struct stat info;
+  if (stat(path, &info) != 0) {
+    return ORBITA_ERROR_IO;
+  }
+  OrbitaStatus status;
+  if (S_ISDIR(info.st_mode)) {
+    auto source = std::make_unique<DirectoryFrameSource>();
+    status = source->Open(path);
+    *out = std::move(source);
+  } else if (raw != nullptr) {
+    auto source = std::make_unique<RawFrameSource>();
+    status = source->Open(path, *raw);
+    *out = std::move(source);
+  } else {
+    auto source = std::make_unique<Y4mFrameSource>();
+    status = source->Open(path);
+    *out = std::move(source);
+  }
+  if (status != ORBITA_OK) {
+    out->reset();
+  }
+  return status;
+}
+
+}  // namespace orbita
@@ -0,0 +1,73 @@
+#ifndef ORBITA_NATIVE_FRAME_SOURCE_H_
+#define ORBITA_NATIVE_FRAME_SOURCE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "image_decode.h"
+#include "orbita_native.h"
+#include "scratch_memory.h"
+
+namespace orbita {
+
+// One frame of an image sequence, reduced to the luma the analysis reads.
+struct LumaFrame {
+  int width = 0;
+  int height = 0;
+  // Each pixel covers scale x scale source pixels.
+  int scale = 1;
+  ScratchVector<uint8_t> luma;
+
+  ImageView view() const {
+    return ImageView{luma.data(), width, height, width, 1};
+  }
+};
+
+// Layout of a headerless video file: 8-bit frames packed back to back.
+struct RawVideoFormat {
+  int width = 0;
+  int height = 0;
+  // 1 for luma, 3 for RGB, 4 for RGBA.
+  int channels = 1;
+};
+
+// Frames of a recording, read in any order.
+class FrameSource {
+ public:
+  virtual ~FrameSource() = default;
+
+  int frame_count() const { return frame_count_; }
+  // Frames per second, or 0 where the source does not say.
+  double frame_rate() const { return frame_rate_; }
+
+  // Reads frame |index| into |out|, reduced by
+  // ChooseDecodeScale(width, height, target_pixels) like DecodeImage().
+  // May be called from any thread, but not concurrently.
+  virtual OrbitaStatus ReadFrame(int index,
+                                 int64_t target_pixels,
+                                 LumaFrame* out) = 0;
+
+ protected:
+  int frame_count_ = 0;
+  double frame_rate_ = 0;
+};
+
+// Opens |path| as one of:
+//
+// - a directory of numbered JPEG or PNG frames, such as `orbita --morph`
+//   writes, ordered by the last number in each file name;
+// - a YUV4MPEG2 (.y4m) file of 8-bit frames, whose Y plane is read as
+//   luma as it is;
+// - with a |raw| format, a headerless file of frames in that format.
+//
+// Files are memory-mapped, so frames are never copied before they are
+// reduced to luma. Returns ORBITA_ERROR_UNSUPPORTED_FORMAT for any other
+// file.
+OrbitaStatus OpenFrameSource(const char* path,
+                             const RawVideoFormat* raw,
+                             std::unique_ptr<FrameSource>* out);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_FRAME_SOURCE_H_
@@ -0,0 +1,15 @@
+#ifndef ORBITA_NATIVE_HASH_H_
+#define ORBITA_NATIVE_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace orbita {
+
+// XXH64 of |size| bytes. Not cryptographic; used to key cached results by
+// content. Runs at memory bandwidth on large inputs.
+uint64_t Hash64(const void* data, size_t size, uint64_t seed);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_HASH_H_
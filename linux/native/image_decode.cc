@@ -0,0 +1,339 @@
+#include "image_decode.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+bool IsPng(const uint8_t* data, size_t size) {
+  static const uint8_t kSignature[8] = {0x89, 'P',  'N',  'G',
+                                        '\r', '\n', 0x1A, '\n'};
+  return size >= sizeof(kSignature) &&
+         memcmp(data, kSignature, sizeof(kSignature)) == 0;
+}
+
+// Box-filters incoming RGB rows by |scale| in both directions, writing
+// finished rows into |out| as soon as |scale| input rows have arrived.
+// Trailing rows and columns that do not fill a whole box are dropped.
+class RowDownsampler {
+ public:
+  // Sizes |out| for a |width| x |height| image reduced by |scale|. Call
+  // before the first Push().
+  void Start(int width, int height, int scale, DecodedImage* out) {
+    width_ = width;
+    scale_ = scale;
+    out_ = out;
+    rows_ = 0;
+    out->width = width / scale;
+    out->height = height / scale;
+    out->channels = 3;
+    out->scale = scale;
+    out->pixels.resize(static_cast<size_t>(out->width) * out->height * 3);
+    if (scale > 1) {
+      sums_.assign(static_cast<size_t>(out->width) * 3, 0);
+    }
+  }
+
+  void Push(const uint8_t* row) {
+    const int out_y = rows_ / scale_;
+    ++rows_;
+    if (out_y >= out_->height) {
+      return;
+    }
+    uint8_t* dst =
+        out_->pixels.data() + static_cast<size_t>(out_y) * out_->width * 3;
+    if (scale_ == 1) {
+      memcpy(dst, row, static_cast<size_t>(width_) * 3);
+      return;
+    }
+    const int used = out_->width * scale_;
+    for (int x = 0; x < used; ++x) {
+      uint32_t* sum = sums_.data() + (x / scale_) * 3;
+      sum[0] += row[x * 3];
+      sum[1] += row[x * 3 + 1];
+      sum[2] += row[x * 3 + 2];
+    }
+    if (rows_ % scale_ != 0) {
+      return;
+    }
+    const uint32_t area = scale_ * scale_;
+    for (size_t i = 0; i < sums_.size(); ++i) {
+      dst[i] = static_cast<uint8_t>((sums_[i] + area / 2) / area);
+      sums_[i] = 0;
+    }
+  }
+
+ private:
+  int width_ = 0;
+  int scale_ = 1;
+  DecodedImage* out_ = nullptr;
+  int rows_ = 0;
+  std::vector<uint32_t> sums_;
+};
+
+struct JpegErrorManager {
+  jpeg_error_mgr base;
+  jmp_buf jump;
+};
+
+void JpegErrorExit(j_common_ptr cinfo) {
+  auto* manager = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+  longjmp(manager->jump, 1);
+}
+
+void JpegSilence(j_common_ptr cinfo) {}
+
+// Converts |width| CMYK pixels to RGB. Files written by Adobe software,
+// which nearly all CMYK JPEGs are, store every channel inverted.
+void CmykToRgb(const uint8_t* cmyk, int width, bool inverted, uint8_t* rgb) {
+  for (int x = 0; x < width; ++x, cmyk += 4, rgb += 3) {
+    const int k = inverted ? cmyk[3] : 255 - cmyk[3];
+    for (int c = 0; c < 3; ++c) {
+      const int ink = inverted ? cmyk[c] : 255 - cmyk[c];
+      rgb[c] = static_cast<uint8_t>((ink * k + 127) / 255);
+    }
+  }
+}
+
+OrbitaStatus DecodeJpeg(const uint8_t* data,
+                        size_t size,
+                        int64_t target_pixels,
+                        DecodedImage* out) {
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager error;
+  cinfo.err = jpeg_std_error(&error.base);
+  error.base.error_exit = JpegErrorExit;
+  error.base.output_message = JpegSilence;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return ORBITA_ERROR_DECODE;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, data, static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+  // The IDCT itself produces the reduced image; libjpeg supports exactly
+  // the 1/2, 1/4 and 1/8 scales ChooseDecodeScale picks from.
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = ChooseDecodeScale(static_cast<int>(cinfo.image_width),
+                                        static_cast<int>(cinfo.image_height),
+                                        target_pixels);
+  // libjpeg cannot turn CMYK or YCCK into RGB itself; it hands back CMYK,
+  // which CmykToRgb() converts a row at a time.
+  const bool cmyk = cinfo.jpeg_color_space == JCS_CMYK ||
+                    cinfo.jpeg_color_space == JCS_YCCK;
+  cinfo.out_color_space = cmyk ? JCS_CMYK : JCS_RGB;
+  jpeg_start_decompress(&cinfo);
+
+  out->width = static_cast<int>(cinfo.output_width);
+  out->height = static_cast<int>(cinfo.output_height);
+  out->channels = 3;
+  out->scale = static_cast<int>(cinfo.scale_denom);
+  out->pixels.resize(static_cast<size_t>(out->width) * out->height * 3);
+  const size_t stride = static_cast<size_t>(out->width) * 3;
+  if (cmyk) {
+    // From libjpeg's pool, so it is freed with |cinfo| even on a longjmp.
+    JSAMPARRAY row = (*cinfo.mem->alloc_sarray)(
+        reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE,
+        cinfo.output_width * 4, 1);
+    while (cinfo.output_scanline < cinfo.output_height) {
+      uint8_t* dst = out->pixels.data() + cinfo.output_scanline * stride;
+      jpeg_read_scanlines(&cinfo, row, 1);
+      CmykToRgb(row[0], out->width, cinfo.saw_Adobe_marker, dst);
+    }
+  }
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW rows[4];
+    const JDIMENSION first = cinfo.output_scanline;
+    const JDIMENSION count =
+        std::min<JDIMENSION>(4, cinfo.output_height - first);
+    for (JDIMENSION i = 0; i < count; ++i) {
+      rows[i] = out->pixels.data() + (first + i) * stride;
+    }
+    jpeg_read_scanlines(&cinfo, rows, count);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return ORBITA_OK;
+}
+
+struct PngSource {
+  const uint8_t* data;
+  size_t size;
+  size_t offset;
+};
+
+void PngRead(png_structp png, png_bytep out, png_size_t length) {
+  auto* source = static_cast<PngSource*>(png_get_io_ptr(png));
+  if (source->size - source->offset < length) {
+    png_error(png, "truncated");
+  }
+  memcpy(out, source->data + source->offset, length);
+  source->offset += length;
+}
+
+void PngError(png_structp png, png_const_charp message) {
+  png_longjmp(png, 1);
+}
+
+void PngWarning(png_structp png, png_const_charp message) {}
+
+OrbitaStatus DecodePng(const uint8_t* data,
+                       size_t size,
+                       int64_t target_pixels,
+                       DecodedImage* out) {
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr,
+                                           PngError, PngWarning);
+  if (png == nullptr) {
+    return ORBITA_ERROR_OUT_OF_MEMORY;
+  }
+  png_infop info = png_create_info_struct(png);
+  if (info == nullptr) {
+    png_destroy_read_struct(&png, nullptr, nullptr);
+    return ORBITA_ERROR_OUT_OF_MEMORY;
+  }
+  // Locals changed after setjmp() are indeterminate once libpng longjmps
+  // back, so everything the rows need is allocated up front and only its
+  // contents change.
+  struct Rows {
+    PngSource source;
+    ScratchVector<uint8_t> buffer;
+    std::vector<png_bytep> pointers;
+    RowDownsampler downsampler;
+  };
+  const std::unique_ptr<Rows> state(new Rows{{data, size, 0}, {}, {}, {}});
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_read_struct(&png, &info, nullptr);
+    return ORBITA_ERROR_DECODE;
+  }
+
+  png_set_read_fn(png, &state->source, PngRead);
+  png_read_info(png, info);
+  // Normalise to 8-bit RGB. Alpha is dropped without compositing, matching
+  // the Dart pipeline, which reads the colour channels untouched.
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_gray_to_rgb(png);
+  png_set_strip_alpha(png);
+  const int passes = png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+
+  const int width = static_cast<int>(png_get_image_width(png, info));
+  const int height = static_cast<int>(png_get_image_height(png, info));
+  const size_t stride = static_cast<size_t>(width) * 3;
+  RowDownsampler& downsampler = state->downsampler;
+  downsampler.Start(width, height,
+                    ChooseDecodeScale(width, height, target_pixels), out);
+
+  ScratchVector<uint8_t>& buffer = state->buffer;
+  if (passes > 1) {
+    // Interlaced rows only become final after the last pass, so these have
+    // to be assembled at full size before they can be reduced.
+    buffer.resize(stride * height);
+    std::vector<png_bytep>& rows = state->pointers;
+    rows.resize(height);
+    for (int y = 0; y < height; ++y) {
+      rows[y] = buffer.data() + y * stride;
+    }
+    png_read_image(png, rows.data());
+    for (int y = 0; y < height; ++y) {
+      downsampler.Push(rows[y]);
+    }
+  } else {
+    buffer.resize(stride);
+    for (int y = 0; y < height; ++y) {
+      png_read_row(png, buffer.data(), nullptr);
+      downsampler.Push(buffer.data());
+    }
+  }
+
+  png_destroy_read_struct(&png, &info, nullptr);
+  return ORBITA_OK;
+}
+
+}  // namespace
+
+bool IsJpeg(const uint8_t* data, size_t size) {
+  return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+OrbitaStatus ReadImageSize(const uint8_t* data,
+                           size_t size,
+                           int* width,
+                           int* height) {
+  if (IsJpeg(data, size)) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.base);
+    error.base.error_exit = JpegErrorExit;
+    error.base.output_message = JpegSilence;
+    if (setjmp(error.jump)) {
+      jpeg_destroy_decompress(&cinfo);
+      return ORBITA_ERROR_DECODE;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, static_cast<unsigned long>(size));
+    jpeg_read_header(&cinfo, TRUE);
+    *width = static_cast<int>(cinfo.image_width);
+    *height = static_cast<int>(cinfo.image_height);
+    jpeg_destroy_decompress(&cinfo);
+    return ORBITA_OK;
+  }
+  if (IsPng(data, size)) {
+    // The IHDR chunk comes first: its length and type follow the 8-byte
+    // signature, then the big-endian width and height.
+    if (size < 24 || memcmp(data + 12, "IHDR", 4) != 0) {
+      return ORBITA_ERROR_DECODE;
+    }
+    const auto read_u31 = [](const uint8_t* p) {
+      return static_cast<int>((static_cast<uint32_t>(p[0] & 0x7F) << 24) |
+                              (p[1] << 16) | (p[2] << 8) | p[3]);
+    };
+    *width = read_u31(data + 16);
+    *height = read_u31(data + 20);
+    return ORBITA_OK;
+  }
+  return ORBITA_ERROR_UNSUPPORTED_FORMAT;
+}
+
+int ChooseDecodeScale(int width, int height, int64_t target_pixels) {
+  int scale = 1;
+  if (target_pixels <= 0) {
+    return scale;
+  }
+  while (scale < kMaxDecodeScale) {
+    const int64_t next = static_cast<int64_t>(width / (scale * 2)) *
+                         (height / (scale * 2));
+    if (next < target_pixels) {
+      break;
+    }
+    scale *= 2;
+  }
+  return scale;
+}
+
+OrbitaStatus DecodeImage(const uint8_t* data,
+                         size_t size,
+                         int64_t target_pixels,
+                         DecodedImage* out) {
+  ORBITA_TRACE_SPAN("decode");
+  if (IsJpeg(data, size)) {
+    return DecodeJpeg(data, size, target_pixels, out);
+  }
+  if (IsPng(data, size)) {
+    return DecodePng(data, size, target_pixels, out);
+  }
+  return ORBITA_ERROR_UNSUPPORTED_FORMAT;
+}
+
+}  // namespace orbita
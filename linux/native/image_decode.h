@@ -0,0 +1,74 @@
+#ifndef ORBITA_NATIVE_IMAGE_DECODE_H_
+#define ORBITA_NATIVE_IMAGE_DECODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "orbita_native.h"
+#include "scratch_memory.h"
+
+namespace orbita {
+
+// Non-owning view of interleaved 8-bit pixels. Only the first three channels
+// (R, G, B) are read; a fourth alpha channel is ignored, as in the Dart
+// pipeline. The preprocessing stages also take single-channel luma.
+struct ImageView {
+  const uint8_t* data = nullptr;
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  int channels = 0;
+};
+
+// Decoded 8-bit RGB or RGBA image owning its pixels.
+struct DecodedImage {
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  // Each decoded pixel covers scale x scale source pixels.
+  int scale = 1;
+  ScratchVector<uint8_t> pixels;
+
+  ImageView view() const {
+    return ImageView{pixels.data(), width, height, width * channels, channels};
+  }
+};
+
+// Largest reduction DecodeImage() applies, the smallest scale libjpeg's
+// IDCT can produce.
+constexpr int kMaxDecodeScale = 8;
+
+// True if |data| holds a JPEG, which DecodeImage() reduces while decoding
+// for a fraction of the cost of a full decode.
+bool IsJpeg(const uint8_t* data, size_t size);
+
+// Reads the size of the JPEG or PNG in |data| from its header without
+// decoding any pixels. Fails as DecodeImage() would for anything else.
+OrbitaStatus ReadImageSize(const uint8_t* data,
+                           size_t size,
+                           int* width,
+                           int* height);
+
+// Largest power-of-two downscale in {1, 2, 4, 8} that still leaves at least
+// |target_pixels| pixels. Returns 1 when |target_pixels| <= 0.
+int ChooseDecodeScale(int width, int height, int64_t target_pixels);
+
+// Decodes the JPEG or PNG in |data| into 8-bit RGB, reduced by
+// ChooseDecodeScale(width, height, target_pixels).
+//
+// JPEGs are decoded at reduced DCT scale, so the skipped detail is never
+// computed; PNGs are decoded row by row and box-filtered as rows arrive, so
+// the full resolution image is never held in memory (except for interlaced
+// PNGs).
+//
+// Returns ORBITA_ERROR_UNSUPPORTED_FORMAT for any other container so the
+// caller can fall back to package:image.
+OrbitaStatus DecodeImage(const uint8_t* data,
+                         size_t size,
+                         int64_t target_pixels,
+                         DecodedImage* out);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_IMAGE_DECODE_H_
@@ -0,0 +1,247 @@
+#include "job_scheduler.h"
+
+#include <algorithm>
+#include <future>
+#include <utility>
+
+#include "scratch_memory.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+std::mutex shared_mutex;
+std::shared_ptr<JobScheduler>* shared_scheduler = nullptr;
+// Set by DeferShared() until the scheduler starts or is stopped.
+bool shared_deferred = false;
+int shared_deferred_threads = 0;
+
+// Trace span names, by priority.
+constexpr const char* kJobSpanNames[kJobPriorityCount] = {
+    "job.preview", "job.interpret", "job.export", "job.batch"};
+
+bool IsBackground(JobPriority priority) {
+  return priority == JobPriority::kExport || priority == JobPriority::kBatch;
+}
+
+// Background jobs may use every thread but one.
+int BackgroundLimit(int threads) {
+  return threads <= 0 ? kJobPriorityCount - 1 : std::max(1, threads - 1);
+}
+
+}  // namespace
+
+JobScheduler::JobScheduler(int threads)
+    : background_limit_(BackgroundLimit(threads)) {
+  if (threads <= 0) {
+    threads = kJobPriorityCount;
+  }
+  for (int i = 0; i < threads; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+JobScheduler::~JobScheduler() {
+  Stop();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void JobScheduler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    for (std::deque<Entry>& queue : queues_) {
+      for (Entry& entry : queue) {
+        entry.token->Cancel();
+      }
+    }
+    for (auto& latest : latest_) {
+      latest.second->Cancel();
+    }
+  }
+  wake_.notify_all();
+}
+
+void JobScheduler::StartShared(int threads) {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  shared_deferred = false;
+  if (shared_scheduler == nullptr) {
+    shared_scheduler = new std::shared_ptr<JobScheduler>(
+        std::make_shared<JobScheduler>(threads));
+  }
+}
+
+void JobScheduler::DeferShared(int threads) {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  if (shared_scheduler == nullptr) {
+    shared_deferred = true;
+    shared_deferred_threads = threads;
+  }
+}
+
+void JobScheduler::StopShared() {
+  std::shared_ptr<JobScheduler>* stopped;
+  {
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    shared_deferred = false;
+    stopped = shared_scheduler;
+    shared_scheduler = nullptr;
+  }
+  if (stopped == nullptr) {
+    return;
+  }
+  // The workers are joined once the last RunScheduled caller still holding
+  // the scheduler lets go of it.
+  (*stopped)->Stop();
+  delete stopped;
+}
+
+std::shared_ptr<JobScheduler> JobScheduler::Shared() {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  if (shared_deferred) {
+    shared_deferred = false;
+    shared_scheduler = new std::shared_ptr<JobScheduler>(
+        std::make_shared<JobScheduler>(shared_deferred_threads));
+  }
+  return shared_scheduler != nullptr ? *shared_scheduler : nullptr;
+}
+
+std::shared_ptr<CancellationToken> JobScheduler::Submit(JobPriority priority,
+                                                        const std::string& key,
+                                                        Job job) {
+  auto token = std::make_shared<CancellationToken>();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+      // The workers may be gone already, so report the cancellation here.
+      lock.unlock();
+      token->Cancel();
+      job(*token);
+      return token;
+    }
+    if (!key.empty()) {
+      std::shared_ptr<CancellationToken>& latest = latest_[key];
+      if (latest != nullptr) {
+        latest->Cancel();
+      }
+      latest = token;
+    }
+    queues_[static_cast<int>(priority)].push_back(
+        Entry{priority, key, std::move(job), token});
+    ORBITA_TRACE_COUNTER("jobs.queued", QueuedLocked());
+  }
+  wake_.notify_one();
+  return token;
+}
+
+void JobScheduler::Cancel(const std::string& key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = latest_.find(key);
+    if (it == latest_.end()) {
+      return;
+    }
+    it->second->Cancel();
+  }
+  // Lets an idle worker report a queued job's cancellation right away.
+  wake_.notify_all();
+}
+
+bool JobScheduler::PickLocked(Entry* entry, bool* background) {
+  *background = false;
+  for (std::deque<Entry>& queue : queues_) {
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+      if (it->token->cancelled()) {
+        *entry = std::move(*it);
+        queue.erase(it);
+        return true;
+      }
+    }
+  }
+  for (int i = 0; i < kJobPriorityCount; ++i) {
+    std::deque<Entry>& queue = queues_[i];
+    if (queue.empty()) {
+      continue;
+    }
+    if (IsBackground(queue.front().priority)) {
+      if (background_running_ >= background_limit_) {
+        return false;
+      }
+      ++background_running_;
+      *background = true;
+    }
+    *entry = std::move(queue.front());
+    queue.pop_front();
+    return true;
+  }
+  return false;
+}
+
+size_t JobScheduler::QueuedLocked() const {
+  size_t queued = 0;
+  for (const std::deque<Entry>& queue : queues_) {
+    queued += queue.size();
+  }
+  return queued;
+}
+
+void JobScheduler::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    Entry entry;
+    bool background;
+    if (!PickLocked(&entry, &background)) {
+      // Queued jobs are all cancelled by the time |stopping_| is set, so
+      // they have been picked before this returns.
+      if (stopping_) {
+        return;
+      }
+      wake_.wait(lock);
+      continue;
+    }
+    ORBITA_TRACE_COUNTER("jobs.queued", QueuedLocked());
+    lock.unlock();
+    {
+      ORBITA_TRACE_SPAN(kJobSpanNames[static_cast<int>(entry.priority)]);
+      entry.job(*entry.token);
+    }
+    lock.lock();
+
+    if (background) {
+      --background_running_;
+      wake_.notify_one();
+    }
+    if (!entry.key.empty()) {
+      auto it = latest_.find(entry.key);
+      if (it != latest_.end() && it->second == entry.token) {
+        latest_.erase(it);
+      }
+    }
+  }
+}
+
+OrbitaStatus RunScheduled(
+    JobPriority priority,
+    const std::string& key,
+    const std::function<OrbitaStatus(const CancellationToken* token)>& job) {
+  std::shared_ptr<JobScheduler> scheduler = JobScheduler::Shared();
+  if (scheduler == nullptr) {
+    return CatchOutOfMemory([&job] { return job(nullptr); });
+  }
+  auto done = std::make_shared<std::promise<OrbitaStatus>>();
+  std::future<OrbitaStatus> status = done->get_future();
+  scheduler->Submit(priority, key,
+                    [&job, done](const CancellationToken& token) {
+                      done->set_value(
+                          token.cancelled()
+                              ? ORBITA_ERROR_CANCELLED
+                              : CatchOutOfMemory(
+                                    [&job, &token] { return job(&token); }));
+                    });
+  return status.get();
+}
+
+}  // namespace orbita
@@ -0,0 +1,137 @@
+#ifndef ORBITA_NATIVE_JOB_SCHEDULER_H_
+#define ORBITA_NATIVE_JOB_SCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Classes of top-level work, most urgent first.
+enum class JobPriority {
+  // Live logogram preview frames.
+  kPreview = 0,
+  // Analysing the image the user just picked.
+  kInterpret = 1,
+  // Writing a full-resolution logogram to disk.
+  kExport = 2,
+  // Headless batch work.
+  kBatch = 3,
+};
+
+constexpr int kJobPriorityCount = 4;
+
+// Set once a job's result is no longer wanted. Long-running work checks it
+// between stages and stops early with ORBITA_ERROR_CANCELLED.
+class CancellationToken {
+ public:
+  bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+  void Cancel() { cancelled_.store(true, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> cancelled_{false};
+};
+
+// True if |token| is given and has been cancelled.
+inline bool IsCancelled(const CancellationToken* token) {
+  return token != nullptr && token->cancelled();
+}
+
+// Runs top-level jobs (one analysis, one export, one preview frame) on a
+// few threads, always starting the most urgent job queued. Jobs spread
+// their own inner loops with ParallelFor, so the scheduler only decides
+// which job gets to start, and:
+//  - one thread is kept for preview and interpret jobs, so an export or a
+//    batch can never make the user wait for the next free thread;
+//  - a job submitted under the key of an earlier one supersedes it: the
+//    earlier job is cancelled whether it is still queued or running, so
+//    only the latest request per key keeps consuming CPU;
+//  - cancelled jobs are run ahead of everything else, which for a queued
+//    job means only reporting the cancellation to its caller.
+// Every submitted job runs exactly once.
+class JobScheduler {
+ public:
+  using Job = std::function<void(const CancellationToken& token)>;
+
+  // |threads| <= 0 uses one thread per priority class.
+  explicit JobScheduler(int threads);
+  // Cancels all jobs, lets the queued ones report it and joins the threads.
+  ~JobScheduler();
+
+  JobScheduler(const JobScheduler&) = delete;
+  JobScheduler& operator=(const JobScheduler&) = delete;
+
+  // Starts and stops the process-wide scheduler. Work already running on
+  // it when it stops is cancelled and finishes first.
+  static void StartShared(int threads);
+  static void StopShared();
+  // Has the process-wide scheduler start with |threads| the first time
+  // Shared() is called, unless StopShared() comes first. Keeps thread
+  // creation out of app startup.
+  static void DeferShared(int threads);
+  // The process-wide scheduler, or null when none is running.
+  static std::shared_ptr<JobScheduler> Shared();
+
+  // Queues |job| at |priority|. A non-empty |key| cancels every earlier job
+  // submitted under the same key. Returns the job's token, through which
+  // it can also be cancelled directly. |job| must not throw; see
+  // CatchOutOfMemory().
+  std::shared_ptr<CancellationToken> Submit(JobPriority priority,
+                                            const std::string& key,
+                                            Job job);
+
+  // Cancels the latest job submitted under |key|, if it has not finished.
+  void Cancel(const std::string& key);
+
+ private:
+  struct Entry {
+    JobPriority priority;
+    std::string key;
+    Job job;
+    std::shared_ptr<CancellationToken> token;
+  };
+
+  // Cancels every job and makes the workers exit once the queues drain.
+  void Stop();
+  void WorkerLoop();
+  // Takes the next job that may start now into |entry|. Sets |background|
+  // if it took one of the background slots.
+  bool PickLocked(Entry* entry, bool* background);
+  // Jobs waiting in every queue.
+  size_t QueuedLocked() const;
+
+  const int background_limit_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<Entry> queues_[kJobPriorityCount];
+  // Token of the latest job per key, until that job finishes.
+  std::unordered_map<std::string, std::shared_ptr<CancellationToken>>
+      latest_;
+  // Export and batch jobs running.
+  int background_running_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+// Runs |job| at |priority| under |key| on the shared scheduler and waits
+// for its status, or runs it on the calling thread when no scheduler is
+// running. A job cancelled before it starts returns ORBITA_ERROR_CANCELLED
+// without being called, and one that runs out of memory returns
+// ORBITA_ERROR_OUT_OF_MEMORY.
+OrbitaStatus RunScheduled(
+    JobPriority priority,
+    const std::string& key,
+    const std::function<OrbitaStatus(const CancellationToken* token)>& job);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_JOB_SCHEDULER_H_
@@ -0,0 +1,20 @@
+#ifndef ORBITA_NATIVE_JSON_WRITER_H_
+#define ORBITA_NATIVE_JSON_WRITER_H_
+
+#include <string>
+
+namespace orbita {
+
+// Minimal helpers for the JSON the headless tools emit. Callers assemble
+// objects themselves; these only take care of escaping and number format.
+
+// Appends |value| as a quoted JSON string.
+void AppendJsonString(std::string* out, const std::string& value);
+
+// Appends |value| with enough digits to round-trip, or null if it is not
+// finite.
+void AppendJsonNumber(std::string* out, double value);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_JSON_WRITER_H_
@@ -0,0 +1,55 @@
+#include "logogram_export.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "png_writer.h"
+#include "scratch_memory.h"
+#include "tracing.h"
+
+namespace orbita {
+
+OrbitaStatus ExportLogogramPng(const LogogramGeometry& geometry,
+                               const OrbitaRenderStyle& style,
+                               const char* path,
+                               const CancellationToken* cancel,
+                               int compression_threads) {
+  ORBITA_TRACE_SPAN("export_png");
+  ScratchScope scratch;
+  if (path == nullptr) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return ORBITA_ERROR_IO;
+  }
+
+  OrbitaStatus status;
+  {
+    PngWriter writer(compression_threads);
+    status = writer.Start(fd, style.width, style.height);
+    if (status == ORBITA_OK) {
+      status = RasterizeLogogramBands(
+          geometry, style,
+          [&writer, cancel](int first_row, int row_count,
+                            const uint8_t* rgba, int stride) {
+            if (IsCancelled(cancel)) {
+              return ORBITA_ERROR_CANCELLED;
+            }
+            return writer.WriteRows(rgba, row_count, stride);
+          });
+    }
+    if (status == ORBITA_OK) {
+      status = writer.Finish();
+    }
+  }
+  if (close(fd) != 0 && status == ORBITA_OK) {
+    status = ORBITA_ERROR_IO;
+  }
+  if (status != ORBITA_OK) {
+    unlink(path);
+  }
+  return status;
+}
+
+}  // namespace orbita
@@ -0,0 +1,31 @@
+#ifndef ORBITA_NATIVE_LOGOGRAM_EXPORT_H_
+#define ORBITA_NATIVE_LOGOGRAM_EXPORT_H_
+
+#include "job_scheduler.h"
+#include "logogram_raster.h"
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Renders |geometry| in |style| into a PNG file at |path|, replacing any
+// existing file. Bands of rows go from RasterizeLogogramBands straight to a
+// PngWriter as they are finished, so neither the pixels nor the encoded
+// file are ever held whole: peak memory is one band plus the chunks being
+// compressed. A partly written file is removed on failure.
+//
+// |cancel| is checked before each band; once it is set, the export stops
+// with ORBITA_ERROR_CANCELLED.
+//
+// Compression runs on |compression_threads| threads of its own (see
+// PngWriter), by default one per hardware thread for a single export the
+// user is waiting on. Callers running many exports at once should pass 1,
+// which compresses on the calling thread.
+OrbitaStatus ExportLogogramPng(const LogogramGeometry& geometry,
+                               const OrbitaRenderStyle& style,
+                               const char* path,
+                               const CancellationToken* cancel = nullptr,
+                               int compression_threads = 0);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_LOGOGRAM_EXPORT_H_
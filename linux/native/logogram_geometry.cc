@@ -0,0 +1,540 @@
+#include "logogram_geometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "simplex_noise.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// The constants below mirror HeptapodGeometry, and every computation
+// follows the Dart code operation by operation. Like simplex_noise.cc,
+// this file is built with -ffp-contract=off.
+constexpr int kLayerCount = 50;
+constexpr double kNoiseFrequency = 0.01;
+constexpr int kSkeletonSteps = 360;
+constexpr int kBranchSegments = 20;
+constexpr int kBranchDepth = 3;
+constexpr double kPi = 3.1415926535897932;
+
+constexpr int kSharedShapeCapacity = 8;
+constexpr int kSharedSizesPerShape = 4;
+
+// dart:math's Random(seed) as implemented by the Dart VM: the seed is
+// hashed with Thomas Wang's 64-bit mix into the state of a 32-bit
+// multiply-with-carry generator, which is then stepped four times.
+class DartRandom {
+ public:
+  explicit DartRandom(int64_t seed) {
+    uint64_t n = static_cast<uint64_t>(seed);
+    n = (~n) + (n << 21);
+    n ^= n >> 24;
+    n *= 265;
+    n ^= n >> 14;
+    n *= 21;
+    n ^= n >> 28;
+    n += n << 31;
+    if (n == 0) {
+      n = 0x5a17;
+    }
+    lo_ = static_cast<uint32_t>(n);
+    hi_ = static_cast<uint32_t>(n >> 32);
+    for (int i = 0; i < 4; ++i) {
+      NextState();
+    }
+  }
+
+  // Random.nextInt(max) for 0 < max <= 2^32.
+  uint32_t NextInt(uint64_t max) {
+    if ((max & (max - 1)) == 0) {
+      NextState();
+      return static_cast<uint32_t>(lo_ & (max - 1));
+    }
+    uint64_t value;
+    uint64_t result;
+    do {
+      NextState();
+      value = lo_;
+      result = value % max;
+    } while (value - result + max > (uint64_t{1} << 32));
+    return static_cast<uint32_t>(result);
+  }
+
+  double NextDouble() {
+    const double high = NextInt(uint64_t{1} << 26);
+    const double low = NextInt(uint64_t{1} << 27);
+    return (high * 134217728.0 + low) / 9007199254740992.0;
+  }
+
+ private:
+  void NextState() {
+    const uint64_t state = uint64_t{0xffffda61} * lo_ + hi_;
+    lo_ = static_cast<uint32_t>(state);
+    hi_ = static_cast<uint32_t>(state >> 32);
+  }
+
+  uint32_t lo_;
+  uint32_t hi_;
+};
+
+// HeptapodGeometry._randomRange.
+double RandomRange(int64_t seed, double min, double max) {
+  DartRandom random(seed);
+  return min + random.NextDouble() * (max - min);
+}
+
+double Noise(int32_t seed, double x, double y) {
+  return SimplexNoise2(seed, kNoiseFrequency, x, y);
+}
+
+// HeptapodGeometry._jitterLayers for a run of points: kLayerCount copies
+// of (x[i], y[i]), layer by layer, each point shifted by up to 5 px of
+// per-layer noise.
+void JitterLayers(int32_t seed,
+                  const std::vector<double>& x,
+                  const std::vector<double>& y,
+                  std::vector<double>* layer_x,
+                  std::vector<double>* layer_y) {
+  const size_t count = x.size();
+  const size_t total = count * kLayerCount;
+  std::vector<double> noise_x(total * 2);
+  std::vector<double> noise_y(total * 2);
+  size_t k = 0;
+  for (int layer = 0; layer < kLayerCount; ++layer) {
+    for (size_t i = 0; i < count; ++i) {
+      noise_x[k] = x[i] * 0.02;
+      noise_y[k++] = layer * 10.0;
+      noise_x[k] = y[i] * 0.02;
+      noise_y[k++] = layer * 10.0 + 1000;
+    }
+  }
+  std::vector<double> offsets(total * 2);
+  SimplexNoise2Batch(seed, kNoiseFrequency, noise_x.data(), noise_y.data(),
+                     static_cast<int>(total * 2), offsets.data());
+
+  layer_x->resize(total);
+  layer_y->resize(total);
+  for (size_t j = 0; j < total; ++j) {
+    const size_t i = j % count;
+    (*layer_x)[j] = x[i] + offsets[j * 2] * 5.0;
+    (*layer_y)[j] = y[i] + offsets[j * 2 + 1] * 5.0;
+  }
+}
+
+struct Branches {
+  std::vector<double> x;
+  std::vector<double> y;
+  // Point count of each branch, in generation order.
+  std::vector<int> sizes;
+  // StrokePolyline::generation of each branch.
+  std::vector<int> generations;
+};
+
+// HeptapodGeometry._generateBranch.
+void GenerateBranch(int32_t seed,
+                    double start_x,
+                    double start_y,
+                    double angle,
+                    double length,
+                    int depth,
+                    Branches* branches) {
+  if (depth <= 0) {
+    return;
+  }
+  const double segment_length = length / kBranchSegments;
+  double x = start_x;
+  double y = start_y;
+  branches->x.push_back(x);
+  branches->y.push_back(y);
+  for (int i = 0; i < kBranchSegments; ++i) {
+    const double curl = Noise(seed, x * 0.01, y * 0.01) * 2.0;
+    angle += curl * 0.5;
+    x = x + segment_length * std::cos(angle);
+    y = y + segment_length * std::sin(angle);
+    branches->x.push_back(x);
+    branches->y.push_back(y);
+  }
+  branches->sizes.push_back(kBranchSegments + 1);
+  branches->generations.push_back(kBranchDepth + 1 - depth);
+
+  if (depth > 1) {
+    GenerateBranch(seed, x, y, angle - 0.3, length * 0.6, depth - 1,
+                   branches);
+    GenerateBranch(seed, x, y, angle + 0.3, length * 0.6, depth - 1,
+                   branches);
+  }
+}
+
+// (int)value clamped to [lo, hi], as Dart's value.toInt().clamp(lo, hi)
+// for finite values.
+int TruncateClamp(double value, int lo, int hi) {
+  if (!(value > lo)) {
+    return lo;
+  }
+  if (!(value < hi)) {
+    return hi;
+  }
+  return static_cast<int>(value);
+}
+
+}  // namespace
+
+struct LogogramGeometryCache::Skeleton {
+  double core_amplitude = 0;
+  int32_t seed = 0;
+  // Radial noise amplitude of the main loop.
+  double amplitude = 0;
+  // Direction of each of the kSkeletonSteps + 1 main loop points, and its
+  // radial offset from the base radius, amplitude * (n1 + 0.5 * n2).
+  std::vector<double> cos_theta;
+  std::vector<double> sin_theta;
+  std::vector<double> offset;
+};
+
+struct LogogramGeometryCache::Tendrils {
+  std::shared_ptr<const Skeleton> skeleton;
+  double max_chaos = 0;
+  // Angle of each tendril and the radial offset of its root.
+  std::vector<double> angles;
+  std::vector<double> offsets;
+  // Angle of each particle and the two terms added to the base radius:
+  // skeleton noise, then the particle's own scatter.
+  std::vector<double> particle_angles;
+  std::vector<double> particle_offsets;
+  std::vector<double> particle_scatter;
+};
+
+struct LogogramGeometryCache::Loops {
+  // kLayerCount jittered copies of the main loop, back to back, in canvas
+  // coordinates.
+  std::vector<float> x;
+  std::vector<float> y;
+};
+
+struct LogogramGeometryCache::Entry {
+  struct Placement {
+    double width;
+    double height;
+    std::shared_ptr<const Loops> loops;
+    std::shared_ptr<const LogogramGeometry> geometry;
+  };
+
+  OrbitaLogogramShape shape;
+  int32_t seed;
+  std::shared_ptr<const Tendrils> tendrils;
+  // Most recently used first.
+  std::list<Placement> placements;
+};
+
+LogogramGeometryCache::LogogramGeometryCache(int shape_capacity,
+                                             int sizes_per_shape)
+    : shape_capacity_(std::max(shape_capacity, 1)),
+      sizes_per_shape_(std::max(sizes_per_shape, 1)) {}
+
+LogogramGeometryCache::~LogogramGeometryCache() = default;
+
+LogogramGeometryCache& LogogramGeometryCache::Shared() {
+  static LogogramGeometryCache* cache =
+      new LogogramGeometryCache(kSharedShapeCapacity, kSharedSizesPerShape);
+  return *cache;
+}
+
+std::shared_ptr<const LogogramGeometryCache::Skeleton>
+LogogramGeometryCache::FindSkeleton(double core_amplitude,
+                                    int32_t seed) const {
+  for (const Entry& entry : entries_) {
+    const Skeleton& skeleton = *entry.tendrils->skeleton;
+    if (skeleton.core_amplitude == core_amplitude && skeleton.seed == seed) {
+      return entry.tendrils->skeleton;
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<const LogogramGeometryCache::Loops>
+LogogramGeometryCache::FindLoops(const Skeleton* skeleton,
+                                 double width,
+                                 double height) const {
+  for (const Entry& entry : entries_) {
+    if (entry.tendrils->skeleton.get() != skeleton) {
+      continue;
+    }
+    for (const Entry::Placement& placement : entry.placements) {
+      if (placement.width == width && placement.height == height) {
+        return placement.loops;
+      }
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<const LogogramGeometryCache::Skeleton>
+LogogramGeometryCache::DrawSkeleton(double core_amplitude, int32_t seed) {
+  ORBITA_TRACE_SPAN("geometry.skeleton");
+  auto skeleton = std::make_shared<Skeleton>();
+  skeleton->core_amplitude = core_amplitude;
+  skeleton->seed = seed;
+  skeleton->amplitude = core_amplitude * 30.0;
+  if (skeleton->amplitude == 0) {
+    skeleton->amplitude = 10.0;
+  }
+
+  // Both octaves of every step in one batch.
+  const int count = kSkeletonSteps + 1;
+  skeleton->cos_theta.resize(count);
+  skeleton->sin_theta.resize(count);
+  std::vector<double> ring_x(count * 2);
+  std::vector<double> ring_y(count * 2);
+  for (int i = 0; i < count; ++i) {
+    const double theta = (static_cast<double>(i) / kSkeletonSteps) * 2 * kPi;
+    skeleton->cos_theta[i] = std::cos(theta);
+    skeleton->sin_theta[i] = std::sin(theta);
+    ring_x[i * 2] = skeleton->cos_theta[i] * 1.0;
+    ring_y[i * 2] = skeleton->sin_theta[i] * 1.0;
+    ring_x[i * 2 + 1] = skeleton->cos_theta[i] * 3.0;
+    ring_y[i * 2 + 1] = skeleton->sin_theta[i] * 3.0;
+  }
+  std::vector<double> ring(count * 2);
+  SimplexNoise2Batch(seed, kNoiseFrequency, ring_x.data(), ring_y.data(),
+                     count * 2, ring.data());
+
+  skeleton->offset.resize(count);
+  for (int i = 0; i < count; ++i) {
+    skeleton->offset[i] =
+        skeleton->amplitude * (ring[i * 2] + 0.5 * ring[i * 2 + 1]);
+  }
+  return skeleton;
+}
+
+std::shared_ptr<const LogogramGeometryCache::Tendrils>
+LogogramGeometryCache::DrawTendrils(std::shared_ptr<const Skeleton> skeleton,
+                                    const OrbitaLogogramShape& shape,
+                                    int32_t seed) {
+  ORBITA_TRACE_SPAN("geometry.tendrils");
+  auto tendrils = std::make_shared<Tendrils>();
+  const double amplitude = skeleton->amplitude;
+  tendrils->max_chaos = shape.nuance_chaos;
+
+  if (shape.nuance_chaos > 0.1 || shape.nuance_amplitude > 0.1) {
+    const int tendril_count = TruncateClamp(shape.nuance_chaos * 10, 3, 12);
+    for (int t = 0; t < tendril_count; ++t) {
+      const double angle = RandomRange(int64_t{seed} + t, 0, 2 * kPi);
+      const double n1 =
+          Noise(seed, std::cos(angle) * 1.0, std::sin(angle) * 1.0);
+      const double n2 =
+          Noise(seed, std::cos(angle) * 3.0, std::sin(angle) * 3.0);
+      tendrils->angles.push_back(angle);
+      tendrils->offsets.push_back(amplitude * (n1 + 0.5 * n2));
+    }
+  }
+
+  const std::vector<double>& chaos_angles = tendrils->angles;
+  DartRandom count_random(seed);
+  const int particle_count = 20 + static_cast<int>(count_random.NextInt(30));
+  for (int i = 0; i < particle_count; ++i) {
+    double angle;
+    if (!chaos_angles.empty() && i < particle_count * 0.7) {
+      const double base_angle = chaos_angles[i % chaos_angles.size()];
+      angle = base_angle + RandomRange(int64_t{seed} + i * 200, -0.3, 0.3);
+    } else {
+      angle = RandomRange(int64_t{seed} + i * 100, 0, 2 * kPi);
+    }
+    const double n = Noise(seed, std::cos(angle), std::sin(angle));
+    tendrils->particle_angles.push_back(angle);
+    tendrils->particle_offsets.push_back(amplitude * 2.0 * n);
+    tendrils->particle_scatter.push_back(RandomRange(i, -20, 50));
+  }
+
+  tendrils->skeleton = std::move(skeleton);
+  return tendrils;
+}
+
+std::shared_ptr<const LogogramGeometryCache::Loops>
+LogogramGeometryCache::PlaceLoops(const Skeleton& skeleton,
+                                  double width,
+                                  double height) {
+  ORBITA_TRACE_SPAN("geometry.loops");
+  const double center_x = width / 2;
+  const double center_y = height / 2;
+  const double base_radius = std::min(width, height) / 3.0;
+
+  const size_t count = skeleton.offset.size();
+  std::vector<double> x(count);
+  std::vector<double> y(count);
+  for (size_t i = 0; i < count; ++i) {
+    const double r = base_radius + skeleton.offset[i];
+    x[i] = center_x + r * skeleton.cos_theta[i];
+    y[i] = center_y + r * skeleton.sin_theta[i];
+  }
+  std::vector<double> layer_x;
+  std::vector<double> layer_y;
+  JitterLayers(skeleton.seed, x, y, &layer_x, &layer_y);
+
+  auto loops = std::make_shared<Loops>();
+  loops->x.assign(layer_x.begin(), layer_x.end());
+  loops->y.assign(layer_y.begin(), layer_y.end());
+  return loops;
+}
+
+// Each layer's main loop followed by its tendrils, then the particles, as
+// HeptapodGeometry lays them out.
+std::shared_ptr<const LogogramGeometry> LogogramGeometryCache::Place(
+    const Tendrils& tendrils,
+    const Loops& loops,
+    double width,
+    double height) {
+  ORBITA_TRACE_SPAN("geometry.place");
+  const Skeleton& skeleton = *tendrils.skeleton;
+  const int32_t seed = skeleton.seed;
+  const double center_x = width / 2;
+  const double center_y = height / 2;
+  const double base_radius = std::min(width, height) / 3.0;
+
+  Branches branches;
+  const double length = base_radius * (0.5 + tendrils.max_chaos);
+  for (size_t t = 0; t < tendrils.angles.size(); ++t) {
+    const double angle = tendrils.angles[t];
+    const double start_radius = base_radius + tendrils.offsets[t];
+    GenerateBranch(seed, center_x + start_radius * std::cos(angle),
+                   center_y + start_radius * std::sin(angle), angle, length,
+                   kBranchDepth, &branches);
+  }
+  std::vector<double> branch_x;
+  std::vector<double> branch_y;
+  JitterLayers(seed, branches.x, branches.y, &branch_x, &branch_y);
+
+  const size_t loop_size = skeleton.offset.size();
+  const size_t tendril_size = branches.x.size();
+  const size_t point_count = (loop_size + tendril_size) * kLayerCount;
+
+  auto geometry = std::make_shared<LogogramGeometry>();
+  geometry->x.reserve(point_count);
+  geometry->y.reserve(point_count);
+  geometry->polylines.reserve((1 + branches.sizes.size()) * kLayerCount);
+  for (int layer = 0; layer < kLayerCount; ++layer) {
+    StrokePolyline loop;
+    loop.first_point = static_cast<int>(geometry->x.size());
+    loop.point_count = static_cast<int>(loop_size);
+    loop.closed = true;
+    loop.layer = layer;
+    geometry->polylines.push_back(loop);
+    geometry->x.insert(geometry->x.end(), loops.x.begin() + layer * loop_size,
+                       loops.x.begin() + (layer + 1) * loop_size);
+    geometry->y.insert(geometry->y.end(), loops.y.begin() + layer * loop_size,
+                       loops.y.begin() + (layer + 1) * loop_size);
+
+    size_t i = layer * tendril_size;
+    for (size_t b = 0; b < branches.sizes.size(); ++b) {
+      const int branch_size = branches.sizes[b];
+      StrokePolyline branch;
+      branch.first_point = static_cast<int>(geometry->x.size());
+      branch.point_count = branch_size;
+      branch.layer = layer;
+      branch.generation = branches.generations[b];
+      geometry->polylines.push_back(branch);
+      for (int j = 0; j < branch_size; ++j, ++i) {
+        geometry->x.push_back(static_cast<float>(branch_x[i]));
+        geometry->y.push_back(static_cast<float>(branch_y[i]));
+      }
+    }
+  }
+
+  const size_t particle_count = tendrils.particle_angles.size();
+  geometry->particle_x.resize(particle_count);
+  geometry->particle_y.resize(particle_count);
+  for (size_t i = 0; i < particle_count; ++i) {
+    const double angle = tendrils.particle_angles[i];
+    const double r = base_radius + tendrils.particle_offsets[i] +
+                     tendrils.particle_scatter[i];
+    geometry->particle_x[i] =
+        static_cast<float>(center_x + r * std::cos(angle));
+    geometry->particle_y[i] =
+        static_cast<float>(center_y + r * std::sin(angle));
+  }
+  return geometry;
+}
+
+namespace {
+
+bool SameShape(const OrbitaLogogramShape& a, const OrbitaLogogramShape& b) {
+  return a.core_amplitude == b.core_amplitude &&
+         a.nuance_chaos == b.nuance_chaos &&
+         a.nuance_amplitude == b.nuance_amplitude;
+}
+
+}  // namespace
+
+std::shared_ptr<const LogogramGeometry> LogogramGeometryCache::Get(
+    const OrbitaLogogramShape& shape,
+    int32_t seed,
+    double width,
+    double height) {
+  // Geometry is built under the lock: it takes a few milliseconds, and two
+  // callers asking for the same logogram should not both build it.
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto entry = std::find_if(entries_.begin(), entries_.end(),
+                            [&](const Entry& candidate) {
+                              return candidate.seed == seed &&
+                                     SameShape(candidate.shape, shape);
+                            });
+  if (entry != entries_.end()) {
+    entries_.splice(entries_.begin(), entries_, entry);
+  } else {
+    std::shared_ptr<const Skeleton> skeleton =
+        FindSkeleton(shape.core_amplitude, seed);
+    if (skeleton == nullptr) {
+      skeleton = DrawSkeleton(shape.core_amplitude, seed);
+    }
+    entries_.push_front(Entry{
+        shape, seed, DrawTendrils(std::move(skeleton), shape, seed), {}});
+    if (entries_.size() > static_cast<size_t>(shape_capacity_)) {
+      entries_.pop_back();
+    }
+  }
+
+  std::list<Entry::Placement>& placements = entries_.front().placements;
+  auto placement = std::find_if(placements.begin(), placements.end(),
+                                [&](const Entry::Placement& candidate) {
+                                  return candidate.width == width &&
+                                         candidate.height == height;
+                                });
+  if (placement != placements.end()) {
+    placements.splice(placements.begin(), placements, placement);
+  } else {
+    const Tendrils& tendrils = *entries_.front().tendrils;
+    // Another nuance layer over the same skeleton may already have jittered
+    // its main loop at this size.
+    std::shared_ptr<const Loops> loops =
+        FindLoops(tendrils.skeleton.get(), width, height);
+    if (loops == nullptr) {
+      loops = PlaceLoops(*tendrils.skeleton, width, height);
+    }
+    std::shared_ptr<const LogogramGeometry> geometry =
+        Place(tendrils, *loops, width, height);
+    placements.push_front({width, height, std::move(loops),
+                           std::move(geometry)});
+    if (placements.size() > static_cast<size_t>(sizes_per_shape_)) {
+      placements.pop_back();
+    }
+  }
+  return placements.front().geometry;
+}
+
+std::shared_ptr<const LogogramGeometry> LogogramGeometryCache::Build(
+    const OrbitaLogogramShape& shape,
+    int32_t seed,
+    double width,
+    double height) {
+  const std::shared_ptr<const Tendrils> tendrils =
+      DrawTendrils(DrawSkeleton(shape.core_amplitude, seed), shape, seed);
+  return Place(*tendrils, *PlaceLoops(*tendrils->skeleton, width, height),
+               width, height);
+}
+
+}  // namespace orbita
@@ -0,0 +1,107 @@
+#ifndef ORBITA_NATIVE_LOGOGRAM_GEOMETRY_H_
+#define ORBITA_NATIVE_LOGOGRAM_GEOMETRY_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#include "logogram_raster.h"
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Bounded in-memory cache of logogram geometry, the native counterpart of
+// HeptapodGeometry.build in lib/ui/painters/heptapod_geometry.dart and
+// bit-identical to it at every canvas size.
+//
+// The painter's noise is sampled at canvas coordinates, so most of the
+// geometry has to be generated for each size. What does not depend on the
+// size is drawn once per (shape, seed) and kept in two parts:
+//  - the skeleton: the main loop's radial noise, which depends on
+//    core_amplitude and the seed only;
+//  - the tendrils and particles: their seeded angles and radial offsets,
+//    which also depend on the nuance fields.
+// Each recently used canvas size then keeps its placed geometry, so a
+// repaint or re-export is a lookup. Placing a known shape at a new size
+// evaluates only the tendril curl and the layer jitter, and a new nuance
+// layer reuses the jittered main loop of a size its skeleton was already
+// placed at.
+//
+// Safe to share between threads. Returned geometry stays valid after it is
+// evicted.
+class LogogramGeometryCache {
+ public:
+  // Keeps up to |shape_capacity| (shape, seed) pairs, each placed at up to
+  // |sizes_per_shape| canvas sizes.
+  LogogramGeometryCache(int shape_capacity, int sizes_per_shape);
+  ~LogogramGeometryCache();
+
+  LogogramGeometryCache(const LogogramGeometryCache&) = delete;
+  LogogramGeometryCache& operator=(const LogogramGeometryCache&) = delete;
+
+  // The process-wide cache behind the C ABI.
+  static LogogramGeometryCache& Shared();
+
+  // Geometry of |shape| and |seed| placed on a |width| x |height| canvas.
+  std::shared_ptr<const LogogramGeometry> Get(
+      const OrbitaLogogramShape& shape,
+      int32_t seed,
+      double width,
+      double height);
+
+  // Same as Get() on a fresh cache, without taking any lock, for callers
+  // that draw each logogram once.
+  static std::shared_ptr<const LogogramGeometry> Build(
+      const OrbitaLogogramShape& shape,
+      int32_t seed,
+      double width,
+      double height);
+
+ private:
+  struct Skeleton;
+  struct Tendrils;
+  struct Loops;
+  struct Entry;
+
+  // The size-independent draws of section A of HeptapodGeometry.build.
+  static std::shared_ptr<const Skeleton> DrawSkeleton(double core_amplitude,
+                                                      int32_t seed);
+  // The size-independent draws of sections B and D, over an existing
+  // skeleton.
+  static std::shared_ptr<const Tendrils> DrawTendrils(
+      std::shared_ptr<const Skeleton> skeleton,
+      const OrbitaLogogramShape& shape,
+      int32_t seed);
+  // The main loop and its section C layer copies on a |width| x |height|
+  // canvas.
+  static std::shared_ptr<const Loops> PlaceLoops(const Skeleton& skeleton,
+                                                 double width,
+                                                 double height);
+  // Everything else on a |width| x |height| canvas: the tendrils and their
+  // layer copies, interleaved with |loops|, then the particles.
+  static std::shared_ptr<const LogogramGeometry> Place(
+      const Tendrils& tendrils,
+      const Loops& loops,
+      double width,
+      double height);
+
+  // Returns the cached skeleton for |core_amplitude| and |seed|, if any.
+  std::shared_ptr<const Skeleton> FindSkeleton(double core_amplitude,
+                                               int32_t seed) const;
+  // Returns the main loops of |skeleton| already placed on a |width| x
+  // |height| canvas, if any.
+  std::shared_ptr<const Loops> FindLoops(const Skeleton* skeleton,
+                                         double width,
+                                         double height) const;
+
+  const int shape_capacity_;
+  const int sizes_per_shape_;
+  std::mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+};
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_LOGOGRAM_GEOMETRY_H_
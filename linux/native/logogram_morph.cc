@@ -0,0 +1,252 @@
+#include "logogram_morph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace orbita {
+
+namespace {
+
+// Timeline of a morph, as fractions of the whole animation: unpaired
+// source branches are gone by kRetractEnd, and unpaired target branches
+// start growing at kGrowStart.
+constexpr double kRetractEnd = 0.6;
+constexpr double kGrowStart = 0.4;
+
+// Timeline of writing: the loops are drawn until kWriteLoopEnd, the
+// tendrils grow in between kWriteTendrilStart and kWriteTendrilEnd, and
+// the particles land from kWriteParticleStart on.
+constexpr double kWriteLoopEnd = 0.6;
+constexpr double kWriteTendrilStart = 0.5;
+constexpr double kWriteTendrilEnd = 0.9;
+constexpr double kWriteParticleStart = 0.85;
+
+double Clamp01(double value) {
+  return std::min(std::max(value, 0.0), 1.0);
+}
+
+// 0 before |start|, 1 after |end| and linear in between.
+double Ramp(double progress, double start, double end) {
+  return Clamp01((progress - start) / (end - start));
+}
+
+double SmoothStep(double t) {
+  return t * t * (3 - 2 * t);
+}
+
+// Exact at both ends: the difference of two floats is exact in double.
+float Lerp(float a, float b, double t) {
+  return static_cast<float>(a + (static_cast<double>(b) - a) * t);
+}
+
+// Indices of the polylines of |geometry| in each layer, loops and branches
+// apart, in drawing order.
+struct LayerPolylines {
+  std::vector<int> loops;
+  std::vector<int> branches;
+};
+
+std::vector<LayerPolylines> SplitLayers(const LogogramGeometry* geometry) {
+  std::vector<LayerPolylines> layers;
+  if (geometry == nullptr) {
+    return layers;
+  }
+  for (size_t i = 0; i < geometry->polylines.size(); ++i) {
+    const StrokePolyline& polyline = geometry->polylines[i];
+    if (polyline.layer >= static_cast<int>(layers.size())) {
+      layers.resize(polyline.layer + 1);
+    }
+    LayerPolylines& layer = layers[polyline.layer];
+    (polyline.generation == 0 ? layer.loops : layer.branches)
+        .push_back(static_cast<int>(i));
+  }
+  return layers;
+}
+
+}  // namespace
+
+LogogramMorph::LogogramMorph(std::shared_ptr<const LogogramGeometry> from,
+                             std::shared_ptr<const LogogramGeometry> to)
+    : from_(std::move(from)), to_(std::move(to)) {
+  const std::vector<LayerPolylines> from_layers = SplitLayers(from_.get());
+  const std::vector<LayerPolylines> to_layers = SplitLayers(to_.get());
+  const LayerPolylines none;
+
+  // Pairs polylines at the same place in a layer. Ones of different
+  // lengths cannot move point by point, so each side animates alone.
+  auto pair = [this](const std::vector<int>& from_indices,
+                     const std::vector<int>& to_indices, int layer) {
+    const size_t count = std::max(from_indices.size(), to_indices.size());
+    for (size_t i = 0; i < count; ++i) {
+      Stroke from_stroke;
+      Stroke to_stroke;
+      from_stroke.layer = to_stroke.layer = layer;
+      if (i < from_indices.size()) {
+        from_stroke.from = from_indices[i];
+      }
+      if (i < to_indices.size()) {
+        to_stroke.to = to_indices[i];
+      }
+      if (from_stroke.from >= 0 && to_stroke.to >= 0 &&
+          from_->polylines[from_stroke.from].point_count ==
+              to_->polylines[to_stroke.to].point_count) {
+        from_stroke.to = to_stroke.to;
+        strokes_.push_back(from_stroke);
+        continue;
+      }
+      if (from_stroke.from >= 0) {
+        strokes_.push_back(from_stroke);
+      }
+      if (to_stroke.to >= 0) {
+        strokes_.push_back(to_stroke);
+      }
+    }
+  };
+
+  const size_t layer_count = std::max(from_layers.size(), to_layers.size());
+  for (size_t layer = 0; layer < layer_count; ++layer) {
+    const LayerPolylines& from_layer =
+        layer < from_layers.size() ? from_layers[layer] : none;
+    const LayerPolylines& to_layer =
+        layer < to_layers.size() ? to_layers[layer] : none;
+    pair(from_layer.loops, to_layer.loops, static_cast<int>(layer));
+    pair(from_layer.branches, to_layer.branches, static_cast<int>(layer));
+  }
+
+  for (const LogogramGeometry* geometry : {from_.get(), to_.get()}) {
+    if (geometry == nullptr) {
+      continue;
+    }
+    for (const StrokePolyline& polyline : geometry->polylines) {
+      generations_ = std::max(generations_, polyline.generation);
+    }
+  }
+}
+
+void LogogramMorph::AppendPart(const LogogramGeometry& geometry,
+                               int index,
+                               double fraction,
+                               double scale,
+                               int layer,
+                               LogogramGeometry* out) {
+  const StrokePolyline& source = geometry.polylines[index];
+  if (fraction <= 0 || source.point_count < 2) {
+    return;
+  }
+  StrokePolyline polyline = source;
+  polyline.first_point = static_cast<int>(out->x.size());
+  polyline.layer = layer;
+  const float* x = geometry.x.data() + source.first_point;
+  const float* y = geometry.y.data() + source.first_point;
+  const auto s = static_cast<float>(scale);
+
+  if (fraction >= 1) {
+    for (int i = 0; i < source.point_count; ++i) {
+      out->x.push_back(x[i] * s);
+      out->y.push_back(y[i] * s);
+    }
+    out->polylines.push_back(polyline);
+    return;
+  }
+
+  const double end = fraction * (source.point_count - 1);
+  const int whole = static_cast<int>(end);
+  const double part = end - whole;
+  for (int i = 0; i <= whole; ++i) {
+    out->x.push_back(x[i] * s);
+    out->y.push_back(y[i] * s);
+  }
+  if (part > 0) {
+    out->x.push_back(Lerp(x[whole], x[whole + 1], part) * s);
+    out->y.push_back(Lerp(y[whole], y[whole + 1], part) * s);
+  }
+  polyline.point_count = static_cast<int>(out->x.size()) -
+                         polyline.first_point;
+  polyline.closed = false;
+  if (polyline.point_count < 2) {
+    out->x.resize(polyline.first_point);
+    out->y.resize(polyline.first_point);
+    return;
+  }
+  out->polylines.push_back(polyline);
+}
+
+void LogogramMorph::Frame(double progress,
+                          double scale,
+                          LogogramGeometry* out) const {
+  progress = Clamp01(progress);
+  const bool writing = from_ == nullptr;
+  const double blend = SmoothStep(progress);
+  const double loop = writing ? Ramp(progress, 0, kWriteLoopEnd) : 1;
+  const double retract = 1 - Ramp(progress, 0, kRetractEnd);
+  const double grow =
+      writing ? Ramp(progress, kWriteTendrilStart, kWriteTendrilEnd)
+              : Ramp(progress, kGrowStart, 1);
+  const auto s = static_cast<float>(scale);
+
+  out->x.clear();
+  out->y.clear();
+  out->polylines.clear();
+  out->particle_x.clear();
+  out->particle_y.clear();
+
+  for (const Stroke& stroke : strokes_) {
+    if (stroke.from >= 0 && stroke.to >= 0) {
+      const StrokePolyline& a = from_->polylines[stroke.from];
+      const StrokePolyline& b = to_->polylines[stroke.to];
+      StrokePolyline polyline = b;
+      polyline.first_point = static_cast<int>(out->x.size());
+      polyline.layer = stroke.layer;
+      for (int i = 0; i < b.point_count; ++i) {
+        out->x.push_back(Lerp(from_->x[a.first_point + i],
+                              to_->x[b.first_point + i], blend) *
+                         s);
+        out->y.push_back(Lerp(from_->y[a.first_point + i],
+                              to_->y[b.first_point + i], blend) *
+                         s);
+      }
+      out->polylines.push_back(polyline);
+      continue;
+    }
+
+    const bool outgoing = stroke.from >= 0;
+    const LogogramGeometry& geometry = outgoing ? *from_ : *to_;
+    const int index = outgoing ? stroke.from : stroke.to;
+    const int generation = geometry.polylines[index].generation;
+    // A tendril's branches take turns: the trunk grows first, and leaves
+    // retract first.
+    const double tree = outgoing ? retract : grow;
+    const double fraction =
+        generation == 0
+            ? (outgoing ? retract : (writing ? loop : grow))
+            : Clamp01(tree * generations_ - (generation - 1));
+    AppendPart(geometry, index, fraction, scale, stroke.layer, out);
+  }
+
+  const size_t to_particles = to_->particle_x.size();
+  if (writing) {
+    const auto visible = static_cast<size_t>(std::ceil(
+        to_particles * Ramp(progress, kWriteParticleStart, 1)));
+    for (size_t i = 0; i < visible; ++i) {
+      out->particle_x.push_back(to_->particle_x[i] * s);
+      out->particle_y.push_back(to_->particle_y[i] * s);
+    }
+    return;
+  }
+  const size_t from_particles = from_->particle_x.size();
+  const size_t paired = std::min(from_particles, to_particles);
+  for (size_t i = 0; i < paired; ++i) {
+    out->particle_x.push_back(
+        Lerp(from_->particle_x[i], to_->particle_x[i], blend) * s);
+    out->particle_y.push_back(
+        Lerp(from_->particle_y[i], to_->particle_y[i], blend) * s);
+  }
+  const LogogramGeometry& rest = blend < 0.5 ? *from_ : *to_;
+  for (size_t i = paired; i < rest.particle_x.size(); ++i) {
+    out->particle_x.push_back(rest.particle_x[i] * s);
+    out->particle_y.push_back(rest.particle_y[i] * s);
+  }
+}
+
+}  // namespace orbita
@@ -0,0 +1,68 @@
+#ifndef ORBITA_NATIVE_LOGOGRAM_MORPH_H_
+#define ORBITA_NATIVE_LOGOGRAM_MORPH_H_
+
+#include <memory>
+#include <vector>
+
+#include "logogram_raster.h"
+
+namespace orbita {
+
+// Animates the change from one logogram to another on the same canvas, or
+// the writing of one onto a blank canvas.
+//
+// Geometry depends on a spectrum only through its OrbitaLogogramShape, and
+// logograms of one seed share their structure: every layer holds a main
+// loop of the same length, and tendril t grows from the same angle in
+// both. So rather than rebuilding geometry for in-between spectra, the
+// two placed geometries are blended directly:
+//  - polylines at the same place in a layer (the loops, and the branches
+//    of tendrils both logograms have) move point by point to their target;
+//  - branches only the source has retract, leaves first, and branches only
+//    the target has grow out from the loop;
+//  - particles pair up the same way; the unpaired ones swap over halfway.
+// When writing, the loops are drawn along their length first, then the
+// tendrils grow and the particles land.
+//
+// The pairing is worked out once; each frame is a single pass over the
+// points with no noise evaluated, cheap enough for every display refresh.
+class LogogramMorph {
+ public:
+  // Morphs |from| into |to|. A null |from| writes |to| instead.
+  LogogramMorph(std::shared_ptr<const LogogramGeometry> from,
+                std::shared_ptr<const LogogramGeometry> to);
+
+  // Stores the geometry |progress| of the way through the animation, from
+  // 0 to 1, into |out|, reusing its storage. Coordinates are multiplied by
+  // |scale|, which draws the frame on a canvas |scale| times the size.
+  void Frame(double progress, double scale, LogogramGeometry* out) const;
+
+ private:
+  // A polyline of the animated frame and where its points come from; -1
+  // where only one side has it.
+  struct Stroke {
+    int from = -1;
+    int to = -1;
+    int layer = 0;
+  };
+
+  // Appends the first |fraction| of polyline |index| of |geometry|, ending
+  // part way along a segment, to |out|.
+  static void AppendPart(const LogogramGeometry& geometry,
+                         int index,
+                         double fraction,
+                         double scale,
+                         int layer,
+                         LogogramGeometry* out);
+
+  std::shared_ptr<const LogogramGeometry> from_;
+  std::shared_ptr<const LogogramGeometry> to_;
+  // In drawing order.
+  std::vector<Stroke> strokes_;
+  // Deepest branch generation in either logogram.
+  int generations_ = 1;
+};
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_LOGOGRAM_MORPH_H_
@@ -0,0 +1,499 @@
+#include "logogram_raster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "parallel.h"
+#include "scratch_memory.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// Tiles are square; a tile's scratch buffers (including the blur margin)
+// stay within a few hundred KB.
+constexpr int kTileSize = 128;
+constexpr int kMaxDimension = 32768;
+
+struct Segment {
+  float x0;
+  float y0;
+  float x1;
+  float y1;
+  int layer;
+};
+
+// Premultiplied colour with components in [0, 1].
+struct Color {
+  float r = 0.0f;
+  float g = 0.0f;
+  float b = 0.0f;
+  float a = 0.0f;
+};
+
+Color Premultiplied(uint32_t argb) {
+  const float a = ((argb >> 24) & 0xFF) / 255.0f;
+  Color color;
+  color.r = ((argb >> 16) & 0xFF) / 255.0f * a;
+  color.g = ((argb >> 8) & 0xFF) / 255.0f * a;
+  color.b = (argb & 0xFF) / 255.0f * a;
+  color.a = a;
+  return color;
+}
+
+// srcOver of |src| at |coverage| onto |dst|.
+inline void BlendOver(const Color& src, float coverage, Color* dst) {
+  const float keep = 1.0f - src.a * coverage;
+  dst->r = src.r * coverage + dst->r * keep;
+  dst->g = src.g * coverage + dst->g * keep;
+  dst->b = src.b * coverage + dst->b * keep;
+  dst->a = src.a * coverage + dst->a * keep;
+}
+
+inline uint8_t ToByte(float value) {
+  return static_cast<uint8_t>(
+      std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+// Normalised Gaussian taps out to 3 sigma. A non-positive sigma gives the
+// identity kernel.
+std::vector<float> GaussianTaps(float sigma) {
+  if (!(sigma > 0.0f)) {
+    return {1.0f};
+  }
+  const int radius = static_cast<int>(std::ceil(3.0f * sigma));
+  std::vector<float> taps(2 * radius + 1);
+  float sum = 0.0f;
+  for (int i = -radius; i <= radius; ++i) {
+    taps[i + radius] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+    sum += taps[i + radius];
+  }
+  for (float& tap : taps) {
+    tap /= sum;
+  }
+  return taps;
+}
+
+// Per-thread buffers for one tile plus its blur margin.
+struct TileScratch {
+  // Optical depth from layers already finished at each pixel.
+  std::vector<float> depth;
+  // Coverage of the layer currently open at each pixel, and its number.
+  std::vector<float> layer_coverage;
+  std::vector<int> layer;
+  // Depth after the horizontal and after both blur passes.
+  std::vector<float> horizontal;
+  std::vector<float> blurred;
+  std::vector<Color> pixels;
+};
+
+// Adds |coverage| of |layer| at |index|. Coverage within one layer is
+// merged with max, so a layer counts at most once per pixel; the layer is
+// folded into depth when a later one reaches the pixel.
+inline void Stamp(int index, int layer, float coverage, TileScratch* tile) {
+  if (tile->layer[index] != layer) {
+    tile->depth[index] += tile->layer_coverage[index];
+    tile->layer[index] = layer;
+    tile->layer_coverage[index] = coverage;
+  } else if (coverage > tile->layer_coverage[index]) {
+    tile->layer_coverage[index] = coverage;
+  }
+}
+
+struct RasterJob {
+  const LogogramGeometry* geometry = nullptr;
+  const OrbitaRenderStyle* style = nullptr;
+  // Row first_row of the canvas is row 0 of |rgba|.
+  uint8_t* rgba = nullptr;
+  int stride = 0;
+  int first_row = 0;
+  int tiles_x = 0;
+  int tiles_y = 0;
+  std::vector<Segment> segments;
+  // Segments touching tile t are bin_segments[bin_start[t], bin_start[t+1]).
+  std::vector<int> bin_start;
+  std::vector<int> bin_segments;
+  std::vector<float> taps;
+  int margin = 0;
+  // Distance from a segment at which its coverage reaches zero.
+  float reach = 0.0f;
+  Color background;
+  // Stroke colour at full opacity; its alpha goes into log_transmittance.
+  Color stroke;
+  float log_transmittance = 0.0f;
+  Color particle;
+};
+
+// Rasterises one anti-aliased segment into the tile whose scratch origin is
+// (origin_x, origin_y). Rows are limited to the segment's vertical reach
+// and, within a row, columns to the part of the segment within reach of
+// that row, so only the pixels near the stroke are visited.
+void StampSegment(const Segment& segment,
+                  float reach,
+                  int origin_x,
+                  int origin_y,
+                  int span_width,
+                  int span_height,
+                  TileScratch* tile) {
+  const float dx = segment.x1 - segment.x0;
+  const float dy = segment.y1 - segment.y0;
+  const float length_sq = dx * dx + dy * dy;
+  const float inverse_length_sq = length_sq > 0.0f ? 1.0f / length_sq : 0.0f;
+  const float top = std::min(segment.y0, segment.y1) - reach;
+  const float bottom = std::max(segment.y0, segment.y1) + reach;
+  const int row_begin =
+      std::max(0, static_cast<int>(std::ceil(top - origin_y - 0.5f)));
+  const int row_end = std::min(
+      span_height - 1, static_cast<int>(std::floor(bottom - origin_y - 0.5f)));
+
+  for (int row = row_begin; row <= row_end; ++row) {
+    const float cy = origin_y + row + 0.5f;
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    if (std::fabs(dy) > 1e-6f) {
+      const float ta = (cy - reach - segment.y0) / dy;
+      const float tb = (cy + reach - segment.y0) / dy;
+      t0 = std::max(t0, std::min(ta, tb));
+      t1 = std::min(t1, std::max(ta, tb));
+      if (t0 > t1) {
+        continue;
+      }
+    }
+    const float xa = segment.x0 + dx * t0;
+    const float xb = segment.x0 + dx * t1;
+    const float left = std::min(xa, xb) - reach - origin_x;
+    const float right = std::max(xa, xb) + reach - origin_x;
+    const int column_begin =
+        std::max(0, static_cast<int>(std::ceil(left - 0.5f)));
+    const int column_end =
+        std::min(span_width - 1, static_cast<int>(std::floor(right - 0.5f)));
+    const float ry = cy - segment.y0;
+    const int row_offset = row * span_width;
+    for (int column = column_begin; column <= column_end; ++column) {
+      const float rx = origin_x + column + 0.5f - segment.x0;
+      const float t = std::min(
+          1.0f, std::max(0.0f, (rx * dx + ry * dy) * inverse_length_sq));
+      const float ex = rx - t * dx;
+      const float ey = ry - t * dy;
+      const float coverage =
+          std::min(1.0f, reach - std::sqrt(ex * ex + ey * ey));
+      if (coverage > 0.0f) {
+        Stamp(row_offset + column, segment.layer, coverage, tile);
+      }
+    }
+  }
+}
+
+// Separable Gaussian over the scratch depth, producing the tile interior.
+void BlurDepth(const std::vector<float>& taps,
+               int width,
+               int height,
+               int span_width,
+               int span_height,
+               TileScratch* tile) {
+  const int diameter = static_cast<int>(taps.size());
+  tile->horizontal.assign(static_cast<size_t>(width) * span_height, 0.0f);
+  for (int y = 0; y < span_height; ++y) {
+    const float* in = tile->depth.data() + y * span_width;
+    float* out = tile->horizontal.data() + y * width;
+    for (int k = 0; k < diameter; ++k) {
+      const float tap = taps[k];
+      for (int x = 0; x < width; ++x) {
+        out[x] += tap * in[x + k];
+      }
+    }
+  }
+  tile->blurred.assign(static_cast<size_t>(width) * height, 0.0f);
+  for (int y = 0; y < height; ++y) {
+    float* out = tile->blurred.data() + y * width;
+    for (int k = 0; k < diameter; ++k) {
+      const float tap = taps[k];
+      const float* in = tile->horizontal.data() + (y + k) * width;
+      for (int x = 0; x < width; ++x) {
+        out[x] += tap * in[x];
+      }
+    }
+  }
+}
+
+void RenderTile(const RasterJob& job, int tile_index, TileScratch* tile) {
+  const OrbitaRenderStyle& style = *job.style;
+  const LogogramGeometry& geometry = *job.geometry;
+  const int x_begin = (tile_index % job.tiles_x) * kTileSize;
+  const int y_begin = (tile_index / job.tiles_x) * kTileSize;
+  const int width = std::min(kTileSize, style.width - x_begin);
+  const int height = std::min(kTileSize, style.height - y_begin);
+  const float particle_reach = style.particle_radius + 0.5f;
+
+  // Particles are few, so each tile simply tests them all.
+  std::vector<int> particles;
+  for (size_t i = 0; i < geometry.particle_x.size(); ++i) {
+    const float px = geometry.particle_x[i];
+    const float py = geometry.particle_y[i];
+    if (px + particle_reach > x_begin &&
+        px - particle_reach < x_begin + width &&
+        py + particle_reach > y_begin &&
+        py - particle_reach < y_begin + height) {
+      particles.push_back(static_cast<int>(i));
+    }
+  }
+
+  const int first = job.bin_start[tile_index];
+  const int last = job.bin_start[tile_index + 1];
+  if (first == last && particles.empty()) {
+    const uint8_t pixel[4] = {
+        ToByte(job.background.a > 0 ? job.background.r / job.background.a
+                                    : 0.0f),
+        ToByte(job.background.a > 0 ? job.background.g / job.background.a
+                                    : 0.0f),
+        ToByte(job.background.a > 0 ? job.background.b / job.background.a
+                                    : 0.0f),
+        ToByte(job.background.a)};
+    for (int y = 0; y < height; ++y) {
+      uint8_t* out = job.rgba +
+                     static_cast<size_t>(y_begin + y - job.first_row) *
+                         job.stride +
+                     x_begin * 4;
+      for (int x = 0; x < width; ++x) {
+        memcpy(out + x * 4, pixel, 4);
+      }
+    }
+    return;
+  }
+
+  tile->pixels.assign(static_cast<size_t>(width) * height, job.background);
+  if (first < last) {
+    const int margin = job.margin;
+    const int span_width = width + 2 * margin;
+    const int span_height = height + 2 * margin;
+    const size_t span = static_cast<size_t>(span_width) * span_height;
+    tile->depth.assign(span, 0.0f);
+    tile->layer_coverage.assign(span, 0.0f);
+    tile->layer.assign(span, -1);
+    for (int i = first; i < last; ++i) {
+      StampSegment(job.segments[job.bin_segments[i]], job.reach,
+                   x_begin - margin, y_begin - margin, span_width, span_height,
+                   tile);
+    }
+    for (size_t i = 0; i < span; ++i) {
+      tile->depth[i] += tile->layer_coverage[i];
+    }
+    BlurDepth(job.taps, width, height, span_width, span_height, tile);
+    for (size_t i = 0; i < tile->pixels.size(); ++i) {
+      const float depth = tile->blurred[i];
+      if (depth > 1e-6f) {
+        BlendOver(job.stroke, 1.0f - std::exp(depth * job.log_transmittance),
+                  &tile->pixels[i]);
+      }
+    }
+  }
+
+  for (const int i : particles) {
+    const float px = geometry.particle_x[i];
+    const float py = geometry.particle_y[i];
+    const int x0 = std::max(
+        0, static_cast<int>(std::ceil(px - particle_reach - x_begin - 0.5f)));
+    const int x1 =
+        std::min(width - 1, static_cast<int>(std::floor(
+                                px + particle_reach - x_begin - 0.5f)));
+    const int y0 = std::max(
+        0, static_cast<int>(std::ceil(py - particle_reach - y_begin - 0.5f)));
+    const int y1 =
+        std::min(height - 1, static_cast<int>(std::floor(
+                                 py + particle_reach - y_begin - 0.5f)));
+    for (int y = y0; y <= y1; ++y) {
+      const float ey = y_begin + y + 0.5f - py;
+      for (int x = x0; x <= x1; ++x) {
+        const float ex = x_begin + x + 0.5f - px;
+        const float coverage =
+            std::min(1.0f, particle_reach - std::sqrt(ex * ex + ey * ey));
+        if (coverage > 0.0f) {
+          BlendOver(job.particle, coverage, &tile->pixels[y * width + x]);
+        }
+      }
+    }
+  }
+
+  for (int y = 0; y < height; ++y) {
+    uint8_t* out = job.rgba +
+                   static_cast<size_t>(y_begin + y - job.first_row) *
+                       job.stride +
+                   x_begin * 4;
+    const Color* in = tile->pixels.data() + y * width;
+    for (int x = 0; x < width; ++x) {
+      const float a = in[x].a;
+      const float scale = a > 0.0f ? 1.0f / a : 0.0f;
+      out[x * 4] = ToByte(in[x].r * scale);
+      out[x * 4 + 1] = ToByte(in[x].g * scale);
+      out[x * 4 + 2] = ToByte(in[x].b * scale);
+      out[x * 4 + 3] = ToByte(a);
+    }
+  }
+}
+
+bool ValidGeometry(const LogogramGeometry& geometry) {
+  const size_t points = geometry.x.size();
+  if (geometry.y.size() != points ||
+      geometry.particle_y.size() != geometry.particle_x.size()) {
+    return false;
+  }
+  int layer = 0;
+  for (const StrokePolyline& polyline : geometry.polylines) {
+    if (polyline.first_point < 0 || polyline.point_count < 0 ||
+        static_cast<size_t>(polyline.first_point) +
+                static_cast<size_t>(polyline.point_count) >
+            points ||
+        polyline.layer < layer) {
+      return false;
+    }
+    layer = polyline.layer;
+  }
+  return true;
+}
+
+// Flattens the polylines into segments and buckets them by the tiles their
+// stroke and blur can reach, keeping drawing order within each bucket.
+void BinSegments(RasterJob* job) {
+  const LogogramGeometry& geometry = *job->geometry;
+  for (const StrokePolyline& polyline : geometry.polylines) {
+    const int first = polyline.first_point;
+    const int count = polyline.point_count;
+    const int segment_count = polyline.closed && count > 2 ? count : count - 1;
+    for (int i = 0; i < segment_count; ++i) {
+      const int a = first + i;
+      const int b = first + (i + 1) % count;
+      job->segments.push_back(Segment{geometry.x[a], geometry.y[a],
+                                      geometry.x[b], geometry.y[b],
+                                      polyline.layer});
+    }
+  }
+
+  const float extent = job->reach + job->margin;
+  const int tile_count = job->tiles_x * job->tiles_y;
+  // Counting pass, then a fill pass into one flat array.
+  std::vector<int> counts(tile_count + 1, 0);
+  auto for_each_tile = [&](const Segment& s, auto&& visit) {
+    const float left = std::min(s.x0, s.x1) - extent;
+    const float right = std::max(s.x0, s.x1) + extent;
+    const float top = std::min(s.y0, s.y1) - extent;
+    const float bottom = std::max(s.y0, s.y1) + extent;
+    if (!(right >= 0.0f && bottom >= 0.0f &&
+          left < job->style->width && top < job->style->height)) {
+      return;
+    }
+    // Clamp before converting so far-off points cannot overflow an int.
+    const float max_x = static_cast<float>(job->style->width - 1);
+    const float max_y = static_cast<float>(job->style->height - 1);
+    const int tx0 = static_cast<int>(std::max(left, 0.0f)) / kTileSize;
+    const int tx1 = static_cast<int>(std::min(right, max_x)) / kTileSize;
+    const int ty0 = static_cast<int>(std::max(top, 0.0f)) / kTileSize;
+    const int ty1 = static_cast<int>(std::min(bottom, max_y)) / kTileSize;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+      for (int tx = tx0; tx <= tx1; ++tx) {
+        visit(ty * job->tiles_x + tx);
+      }
+    }
+  };
+  for (const Segment& segment : job->segments) {
+    for_each_tile(segment, [&](int tile) { ++counts[tile + 1]; });
+  }
+  for (int t = 0; t < tile_count; ++t) {
+    counts[t + 1] += counts[t];
+  }
+  job->bin_start = counts;
+  job->bin_segments.resize(counts[tile_count]);
+  for (size_t i = 0; i < job->segments.size(); ++i) {
+    for_each_tile(job->segments[i], [&](int tile) {
+      job->bin_segments[counts[tile]++] = static_cast<int>(i);
+    });
+  }
+}
+
+// Validates the input and prepares everything but the output pointer.
+OrbitaStatus PrepareJob(const LogogramGeometry& geometry,
+                        const OrbitaRenderStyle& style,
+                        RasterJob* job) {
+  ORBITA_TRACE_SPAN("raster.prepare");
+  if (style.width <= 0 || style.height <= 0 ||
+      style.width > kMaxDimension || style.height > kMaxDimension ||
+      !(style.stroke_width > 0.0f) || !(style.particle_radius >= 0.0f) ||
+      !ValidGeometry(geometry)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+
+  job->geometry = &geometry;
+  job->style = &style;
+  job->tiles_x = (style.width + kTileSize - 1) / kTileSize;
+  job->tiles_y = (style.height + kTileSize - 1) / kTileSize;
+  job->taps = GaussianTaps(style.stroke_blur_sigma);
+  job->margin = static_cast<int>(job->taps.size() / 2);
+  job->reach = style.stroke_width * 0.5f + 0.5f;
+  job->background = Premultiplied(style.background_argb);
+  job->stroke = Premultiplied(style.stroke_argb | 0xFF000000u);
+  const float stroke_alpha = ((style.stroke_argb >> 24) & 0xFF) / 255.0f;
+  // A fully opaque stroke saturates after one layer.
+  job->log_transmittance = stroke_alpha < 1.0f ? std::log1p(-stroke_alpha)
+                                               : -1e6f;
+  job->particle = Premultiplied(style.particle_argb);
+  BinSegments(job);
+  return ORBITA_OK;
+}
+
+// Renders tiles [first_tile, first_tile + count) in parallel.
+void RenderTiles(const RasterJob& job, int first_tile, int count) {
+  ParallelFor(count, [&job, first_tile](int tile) {
+    ORBITA_TRACE_SPAN("raster.tile");
+    thread_local TileScratch scratch;
+    RenderTile(job, first_tile + tile, &scratch);
+  });
+}
+
+}  // namespace
+
+OrbitaStatus RasterizeLogogram(const LogogramGeometry& geometry,
+                               const OrbitaRenderStyle& style,
+                               uint8_t* rgba,
+                               int stride) {
+  ORBITA_TRACE_SPAN("raster");
+  if (rgba == nullptr || stride < style.width * 4) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  RasterJob job;
+  const OrbitaStatus status = PrepareJob(geometry, style, &job);
+  if (status != ORBITA_OK) {
+    return status;
+  }
+  job.rgba = rgba;
+  job.stride = stride;
+  RenderTiles(job, 0, job.tiles_x * job.tiles_y);
+  return ORBITA_OK;
+}
+
+OrbitaStatus RasterizeLogogramBands(const LogogramGeometry& geometry,
+                                    const OrbitaRenderStyle& style,
+                                    const RowSink& sink) {
+  ORBITA_TRACE_SPAN("raster");
+  ScratchScope scratch;
+  RasterJob job;
+  OrbitaStatus status = PrepareJob(geometry, style, &job);
+  if (status != ORBITA_OK) {
+    return status;
+  }
+  job.stride = style.width * 4;
+  ScratchVector<uint8_t> band(static_cast<size_t>(job.stride) * kTileSize);
+  job.rgba = band.data();
+  for (int ty = 0; ty < job.tiles_y; ++ty) {
+    job.first_row = ty * kTileSize;
+    RenderTiles(job, ty * job.tiles_x, job.tiles_x);
+    const int rows = std::min(kTileSize, style.height - job.first_row);
+    status = sink(job.first_row, rows, band.data(), job.stride);
+    if (status != ORBITA_OK) {
+      return status;
+    }
+  }
+  return ORBITA_OK;
+}
+
+}  // namespace orbita
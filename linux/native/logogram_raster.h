@@ -0,0 +1,76 @@
+#ifndef ORBITA_NATIVE_LOGOGRAM_RASTER_H_
+#define ORBITA_NATIVE_LOGOGRAM_RASTER_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// A run of points in LogogramGeometry, stroked as connected segments.
+struct StrokePolyline {
+  int first_point = 0;
+  int point_count = 0;
+  // Adds a segment from the last point back to the first.
+  bool closed = false;
+  // Polylines in the same layer form one path: where they overlap, the ink
+  // is not darkened twice.
+  int layer = 0;
+  // Branchings between this polyline and the main loop: 0 for the loop,
+  // 1 for a tendril's trunk, 2 for the branches off it and so on. Only
+  // animations use it; the raster ignores it.
+  int generation = 0;
+};
+
+// Everything HeptapodPainter draws, in pixel coordinates. Mirrors
+// HeptapodGeometry in lib/ui/painters/heptapod_geometry.dart.
+struct LogogramGeometry {
+  std::vector<float> x;
+  std::vector<float> y;
+  // In drawing order, so layer numbers never decrease.
+  std::vector<StrokePolyline> polylines;
+  std::vector<float> particle_x;
+  std::vector<float> particle_y;
+};
+
+// Renders |geometry| into |style.width| x |style.height| straight-alpha
+// RGBA pixels at |rgba|, |stride| bytes per row.
+//
+// The canvas is split into tiles rendered in parallel. Strokes are
+// anti-aliased by distance to each segment and accumulated per pixel as
+// optical depth: the number of layers covering it, where two polylines of
+// one layer covering the same pixel count once. A single Gaussian pass
+// (stroke_blur_sigma) over that depth stands in for the painter's
+// per-stroke blur MaskFilter. Because depth is additive, blurring it once
+// equals blurring each layer separately, and 1 - (1 - alpha)^depth
+// reproduces srcOver stacking exactly wherever coverage is 0 or 1.
+// Particles are then composited one by one, unblurred, as drawCircle does.
+//
+// Each tile carries a margin for the blur, so no full-frame float buffer is
+// ever allocated.
+OrbitaStatus RasterizeLogogram(const LogogramGeometry& geometry,
+                               const OrbitaRenderStyle& style,
+                               uint8_t* rgba,
+                               int stride);
+
+// Receives |row_count| finished rows of the canvas starting at
+// |first_row|, |stride| bytes apart. The rows are only valid during the
+// call. Anything but ORBITA_OK stops rendering.
+using RowSink = std::function<OrbitaStatus(int first_row,
+                                           int row_count,
+                                           const uint8_t* rgba,
+                                           int stride)>;
+
+// RasterizeLogogram one band of tiles at a time: each band is rendered in
+// parallel into a buffer of 128 rows and handed to |sink| top to bottom,
+// so a canvas of any height needs only one band of pixels. Returns the
+// first failure reported by |sink|.
+OrbitaStatus RasterizeLogogramBands(const LogogramGeometry& geometry,
+                                    const OrbitaRenderStyle& style,
+                                    const RowSink& sink);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_LOGOGRAM_RASTER_H_
@@ -0,0 +1,471 @@
+#include "logogram_synthesis.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "fft.h"
+#include "file_util.h"
+#include "parallel.h"
+#include "simd.h"
+#include "spectrum_archive.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+constexpr char kShardMagic[8] = {'O', 'R', 'B', 'S', 'H', 'A', 'R', 'D'};
+constexpr uint32_t kShardVersion = 1;
+constexpr size_t kShardHeaderSize = 64;
+
+// Angles the contour is sampled at.
+constexpr int kContourSamples = 1024;
+constexpr int kNyquist = kContourSamples / 2;
+// First bin chaos is spread over, as in AnalyzeImage()'s chaos level.
+constexpr int kChaosFirstBin = 20;
+// Largest swing of the contour, as a fraction of its mean radius.
+constexpr double kMaxExcursion = 0.5;
+constexpr int kPhaseSteps = 256;
+// Records rendered between two writes of a shard.
+constexpr int kRecordsPerChunk = 4096;
+// Records handed to one worker at a time.
+constexpr int kRecordsPerTask = 64;
+
+constexpr double kPi = 3.1415926535897932;
+
+// One layer as a shard record stores it.
+struct ShardLayer {
+  float frequency;
+  float amplitude;
+  float chaos_factor;
+  uint32_t layer;
+};
+
+struct RecordHeader {
+  uint64_t seed;
+  uint32_t layer_count;
+  uint32_t reserved;
+  ShardLayer layers[kShardMaxLayers];
+};
+
+static_assert(sizeof(RecordHeader) % 8 == 0, "masks must stay aligned");
+
+// SplitMix64: cheap, and good enough to pick phases and parameters.
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [min, max).
+  double Range(double min, double max) {
+    return min + (Next() >> 11) * 0x1.0p-53 * (max - min);
+  }
+
+ private:
+  uint64_t state_;
+};
+
+// Unit phasors a contour's phases are drawn from, and the 1/k weights,
+// summing to 1, that chaos is spread over the bins with.
+struct SynthesisTables {
+  SynthesisTables() {
+    for (int i = 0; i < kPhaseSteps; ++i) {
+      phase_re[i] = std::cos(2.0 * kPi * i / kPhaseSteps);
+      phase_im[i] = std::sin(2.0 * kPi * i / kPhaseSteps);
+    }
+    double total = 0;
+    for (int k = kChaosFirstBin; k < kNyquist; ++k) {
+      total += 1.0 / k;
+    }
+    for (int k = kChaosFirstBin; k < kNyquist; ++k) {
+      chaos_weight[k] = 1.0 / k / total;
+    }
+  }
+
+  double phase_re[kPhaseSteps];
+  double phase_im[kPhaseSteps];
+  double chaos_weight[kNyquist] = {};
+};
+
+const SynthesisTables& Tables() {
+  static const SynthesisTables* tables = new SynthesisTables();
+  return *tables;
+}
+
+// The contour sample each pixel centre of a size x size mask falls on, and
+// its distance from the centre. Built once per size and shared.
+class PolarGrid {
+ public:
+  static std::shared_ptr<const PolarGrid> Get(int size) {
+    static std::mutex mutex;
+    static auto* grids =
+        new std::unordered_map<int, std::shared_ptr<const PolarGrid>>();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<const PolarGrid>& grid = (*grids)[size];
+    if (!grid) {
+      grid = std::make_shared<PolarGrid>(size);
+    }
+    return grid;
+  }
+
+  explicit PolarGrid(int size)
+      : size_(size),
+        samples_(static_cast<size_t>(size) * size),
+        radii_(static_cast<size_t>(size) * size) {
+    const double centre = size / 2.0;
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        const double dx = x + 0.5 - centre;
+        const double dy = y + 0.5 - centre;
+        const size_t i = static_cast<size_t>(y) * size + x;
+        const long sample =
+            std::lround(std::atan2(dy, dx) * kContourSamples / (2.0 * kPi));
+        samples_[i] = static_cast<int32_t>(
+            (sample % kContourSamples + kContourSamples) % kContourSamples);
+        radii_[i] = static_cast<float>(std::sqrt(dx * dx + dy * dy));
+      }
+    }
+  }
+
+  int size() const { return size_; }
+  const int32_t* samples(int y) const {
+    return samples_.data() + static_cast<size_t>(y) * size_;
+  }
+  const float* radii(int y) const {
+    return radii_.data() + static_cast<size_t>(y) * size_;
+  }
+
+ private:
+  int size_;
+  std::vector<int32_t> samples_;
+  std::vector<float> radii_;
+};
+
+// Layers of |spectrum|, core first, as a record stores them. Returns how
+// many there are.
+int CollectLayers(const HeptapodSpectrum& spectrum, ShardLayer* out) {
+  int count = 0;
+  const std::vector<WaveLayer>* groups[] = {
+      &spectrum.core, &spectrum.narrative, &spectrum.nuance};
+  for (uint32_t group = 0; group < 3; ++group) {
+    for (const WaveLayer& layer : *groups[group]) {
+      if (count == kShardMaxLayers) {
+        return count;
+      }
+      out[count++] = {static_cast<float>(layer.frequency),
+                      static_cast<float>(layer.amplitude),
+                      static_cast<float>(layer.chaos_factor), group};
+    }
+  }
+  return count;
+}
+
+// Radius of the contour at each of the kContourSamples angles, for a mask
+// of |size| pixels with a ring |half_width| pixels either side of it.
+void BuildContour(const ShardLayer* layers,
+                  int layer_count,
+                  uint64_t seed,
+                  int size,
+                  double half_width,
+                  float* contour) {
+  const SynthesisTables& tables = Tables();
+  thread_local std::vector<double> magnitude;
+  thread_local std::vector<uint8_t> phase;
+  thread_local std::vector<double> re;
+  thread_local std::vector<double> im;
+  thread_local std::vector<double> profile;
+  magnitude.assign(kNyquist + 1, 0.0);
+  phase.assign(kNyquist + 1, 0);
+  re.assign(kNyquist + 1, 0.0);
+  im.assign(kNyquist + 1, 0.0);
+  profile.resize(kContourSamples);
+
+  Random random(seed);
+  double total = 0;
+  double chaos = 0;
+  for (int i = 0; i < layer_count; ++i) {
+    const double amplitude = std::fabs(layers[i].amplitude);
+    const double frequency =
+        std::min<double>(layers[i].frequency, kNyquist - 1);
+    chaos += amplitude * std::max(0.0f, layers[i].chaos_factor);
+    if (!(frequency >= 1) || amplitude == 0) {
+      continue;
+    }
+    const int bin = static_cast<int>(frequency);
+    const double fraction = frequency - bin;
+    const uint8_t layer_phase = static_cast<uint8_t>(random.Next());
+    // Later layers on a bin take over its phase.
+    magnitude[bin] += amplitude * (1 - fraction);
+    phase[bin] = layer_phase;
+    if (fraction > 0) {
+      magnitude[bin + 1] += amplitude * fraction;
+      phase[bin + 1] = layer_phase;
+    }
+    total += amplitude;
+  }
+  if (chaos > 0) {
+    for (int k = kChaosFirstBin; k < kNyquist; ++k) {
+      const double noise = chaos * tables.chaos_weight[k];
+      const uint8_t noise_phase = static_cast<uint8_t>(random.Next());
+      re[k] += noise * tables.phase_re[noise_phase];
+      im[k] += noise * tables.phase_im[noise_phase];
+    }
+    total += chaos;
+  }
+
+  const double mean_radius =
+      (size / 2.0 - half_width - 1) / (1 + kMaxExcursion);
+  if (total == 0) {
+    std::fill(contour, contour + kContourSamples,
+              static_cast<float>(mean_radius));
+    return;
+  }
+  for (int k = 1; k < kNyquist; ++k) {
+    re[k] += magnitude[k] * tables.phase_re[phase[k]];
+    im[k] += magnitude[k] * tables.phase_im[phase[k]];
+  }
+  // A bin of magnitude m swings the inverse by 2m / kContourSamples, so
+  // this scale bounds the profile by 1 however the phases line up.
+  const double scale = kContourSamples / (2.0 * total);
+  for (int k = 1; k < kNyquist; ++k) {
+    re[k] *= scale;
+    im[k] *= scale;
+  }
+  RealFftPlan::Get(kContourSamples)->Inverse(re.data(), im.data(),
+                                             profile.data());
+  for (int i = 0; i < kContourSamples; ++i) {
+    contour[i] =
+        static_cast<float>(mean_radius * (1 + kMaxExcursion * profile[i]));
+  }
+}
+
+void RenderRowScalar(const int32_t* samples,
+                     const float* radii,
+                     const float* contour,
+                     float half_width,
+                     int size,
+                     uint8_t* row) {
+  for (int x = 0; x < size; x += 8) {
+    uint8_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+      const float distance = std::fabs(radii[x + i] - contour[samples[x + i]]);
+      bits |= static_cast<uint8_t>(distance <= half_width) << i;
+    }
+    row[x / 8] = bits;
+  }
+}
+
+#if ORBITA_X86
+
+__attribute__((target("avx2"))) void RenderRowAvx2(const int32_t* samples,
+                                                   const float* radii,
+                                                   const float* contour,
+                                                   float half_width,
+                                                   int size,
+                                                   uint8_t* row) {
+  const __m256 width = _mm256_set1_ps(half_width);
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  for (int x = 0; x < size; x += 8) {
+    const __m256i index = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(samples + x));
+    const __m256 radius = _mm256_i32gather_ps(contour, index, 4);
+    const __m256 distance =
+        _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(radii + x),
+                                             radius));
+    row[x / 8] = static_cast<uint8_t>(
+        _mm256_movemask_ps(_mm256_cmp_ps(distance, width, _CMP_LE_OQ)));
+  }
+}
+
+#endif
+
+// Sets the bits of |mask| within |half_width| of |contour| along each
+// pixel's ray from the centre.
+void RenderRing(const PolarGrid& grid,
+                const float* contour,
+                float half_width,
+                uint8_t* mask) {
+  const int size = grid.size();
+  const size_t stride = size / 8;
+#if ORBITA_X86
+  if (CpuHasAvx2()) {
+    for (int y = 0; y < size; ++y) {
+      RenderRowAvx2(grid.samples(y), grid.radii(y), contour, half_width, size,
+                    mask + y * stride);
+    }
+    return;
+  }
+#endif
+  for (int y = 0; y < size; ++y) {
+    RenderRowScalar(grid.samples(y), grid.radii(y), contour, half_width, size,
+                    mask + y * stride);
+  }
+}
+
+bool ValidOptions(const SynthesisOptions& options) {
+  return options.size >= 8 && options.size <= 8192 && options.size % 8 == 0 &&
+         options.stroke_width > 0 && options.stroke_width < 0.5;
+}
+
+void Synthesize(const PolarGrid& grid,
+                const ShardLayer* layers,
+                int layer_count,
+                uint64_t seed,
+                const SynthesisOptions& options,
+                uint8_t* mask) {
+  const double half_width = options.stroke_width * options.size / 2;
+  float contour[kContourSamples];
+  BuildContour(layers, layer_count, seed, options.size, half_width, contour);
+  RenderRing(grid, contour, static_cast<float>(half_width), mask);
+}
+
+}  // namespace
+
+bool SynthesizeLogogramMask(const HeptapodSpectrum& spectrum,
+                            uint64_t seed,
+                            const SynthesisOptions& options,
+                            uint8_t* mask) {
+  if (!ValidOptions(options) || mask == nullptr) {
+    return false;
+  }
+  ShardLayer layers[kShardMaxLayers];
+  const int count = CollectLayers(spectrum, layers);
+  Synthesize(*PolarGrid::Get(options.size), layers, count, seed, options,
+             mask);
+  return true;
+}
+
+HeptapodSpectrum RandomSpectrum(uint64_t seed) {
+  Random random(seed ^ 0x5eed5eed5eed5eedull);
+  const double chaos = random.Range(0.1, 0.8);
+  auto layers = [&](int max_count, double min_frequency,
+                    double max_frequency, double min_amplitude,
+                    double max_amplitude) {
+    std::vector<WaveLayer> out(1 + random.Next() % max_count);
+    for (WaveLayer& layer : out) {
+      layer.frequency = random.Range(min_frequency, max_frequency);
+      layer.amplitude = random.Range(min_amplitude, max_amplitude);
+      layer.chaos_factor = chaos * random.Range(0.5, 1.0);
+    }
+    return out;
+  };
+  HeptapodSpectrum spectrum;
+  spectrum.core = layers(2, 2, 6, 0.5, 1.0);
+  spectrum.narrative = layers(3, 8, 20, 0.2, 0.5);
+  spectrum.nuance = layers(4, 20, 60, 0.05, 0.2);
+  return spectrum;
+}
+
+int RunSynthesis(const SynthesisRunOptions& options) {
+  const SynthesisOptions& synthesis = options.synthesis;
+  if (!ValidOptions(synthesis) || options.count < 0 ||
+      options.shard_size < 1) {
+    fprintf(stderr, "orbita: invalid size, stroke width or shard size\n");
+    return 1;
+  }
+  std::vector<HeptapodSpectrum> spectra;
+  if (!options.spectra.empty() &&
+      !ReadSpectra(options.spectra, &spectra, nullptr)) {
+    return 1;
+  }
+  if (!MakeDirectories(options.output_dir)) {
+    fprintf(stderr, "orbita: cannot create %s: %s\n",
+            options.output_dir.c_str(), strerror(errno));
+    return 1;
+  }
+
+  const std::shared_ptr<const PolarGrid> grid =
+      PolarGrid::Get(synthesis.size);
+  const size_t mask_bytes =
+      static_cast<size_t>(synthesis.size) * synthesis.size / 8;
+  const size_t record_size = sizeof(RecordHeader) + mask_bytes;
+  std::vector<uint8_t> chunk(record_size * kRecordsPerChunk);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int64_t first = 0, shard = 0; first < options.count; ++shard) {
+    const int64_t shard_count =
+        std::min<int64_t>(options.shard_size, options.count - first);
+    char name[32];
+    snprintf(name, sizeof(name), "/shard_%05lld.bin",
+             static_cast<long long>(shard));
+    const std::string path = options.output_dir + name;
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == nullptr) {
+      fprintf(stderr, "orbita: cannot write %s: %s\n", path.c_str(),
+              strerror(errno));
+      return 1;
+    }
+    uint8_t header[kShardHeaderSize] = {};
+    const uint32_t fields[] = {kShardVersion,
+                               static_cast<uint32_t>(synthesis.size),
+                               static_cast<uint32_t>(shard_count),
+                               static_cast<uint32_t>(record_size),
+                               static_cast<uint32_t>(sizeof(RecordHeader))};
+    memcpy(header, kShardMagic, sizeof(kShardMagic));
+    memcpy(header + sizeof(kShardMagic), fields, sizeof(fields));
+    bool written = fwrite(header, 1, sizeof(header), out) == sizeof(header);
+
+    for (int64_t done = 0; written && done < shard_count;) {
+      const int records =
+          static_cast<int>(std::min<int64_t>(kRecordsPerChunk,
+                                             shard_count - done));
+      const int64_t base = first + done;
+      ORBITA_TRACE_SPAN("synthesis.chunk");
+      ParallelFor((records + kRecordsPerTask - 1) / kRecordsPerTask,
+                  [&](int task) {
+        const int end = std::min(records, (task + 1) * kRecordsPerTask);
+        for (int i = task * kRecordsPerTask; i < end; ++i) {
+          uint8_t* record = chunk.data() + i * record_size;
+          RecordHeader params = {};
+          params.seed = options.seed + static_cast<uint64_t>(base + i);
+          HeptapodSpectrum drawn;
+          const HeptapodSpectrum* spectrum = &drawn;
+          if (spectra.empty()) {
+            drawn = RandomSpectrum(params.seed);
+          } else {
+            spectrum = &spectra[(base + i) % spectra.size()];
+          }
+          params.layer_count = CollectLayers(*spectrum, params.layers);
+          memcpy(record, &params, sizeof(params));
+          // Rendered from the stored single-precision parameters, so a
+          // record always reproduces its own mask.
+          Synthesize(*grid, params.layers, params.layer_count, params.seed,
+                     synthesis, record + sizeof(params));
+        }
+      });
+      written = fwrite(chunk.data(), record_size, records, out) ==
+                static_cast<size_t>(records);
+      done += records;
+    }
+    if (fclose(out) != 0 || !written) {
+      fprintf(stderr, "orbita: cannot write %s: %s\n", path.c_str(),
+              strerror(errno));
+      return 1;
+    }
+    first += shard_count;
+  }
+
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  fprintf(stderr,
+          "orbita: synthesised %lld logograms into %s in %.2f s (%.0f/s)\n",
+          static_cast<long long>(options.count), options.output_dir.c_str(),
+          seconds, seconds > 0 ? options.count / seconds : 0.0);
+  return 0;
+}
+
+}  // namespace orbita
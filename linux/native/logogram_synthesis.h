@@ -0,0 +1,86 @@
+#ifndef ORBITA_NATIVE_LOGOGRAM_SYNTHESIS_H_
+#define ORBITA_NATIVE_LOGOGRAM_SYNTHESIS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "spectrum_json.h"
+
+namespace orbita {
+
+// Layers of a spectrum a synthesised logogram uses and a shard record
+// stores; any beyond them are dropped.
+constexpr int kShardMaxLayers = 16;
+
+// Logograms drawn straight from spectrum parameters for building datasets,
+// without the Gemini round trip or HeptapodPainter. The shape is not the
+// painter's: the layers are read as a radial spectrum instead.
+//
+// Each layer puts its amplitude into the contour's spectrum at its
+// frequency, split between the two nearest whole frequencies when it falls
+// between them, with a phase drawn from the seed. Its chaosFactor adds
+// amplitude * chaosFactor more spread as 1/k over the bins from 20 up,
+// which is where AnalyzeImage() measures chaos. One inverse FFT turns this
+// into the radius at 1024 angles, and the logogram is the ring around that
+// contour. Amplitudes only count relative to each other: the ring swings
+// at most halfway in and out from its mean radius.
+struct SynthesisOptions {
+  // Side of the square mask in pixels, a multiple of 8.
+  int size = 256;
+  // Radial width of the ring as a fraction of size.
+  double stroke_width = 0.025;
+};
+
+// Renders the logogram of |spectrum| and |seed| into |mask|: size rows of
+// size / 8 bytes, where bit x % 8 of byte x / 8 (least significant first)
+// is set on ink. Returns false if |options| are invalid. Thread-safe.
+bool SynthesizeLogogramMask(const HeptapodSpectrum& spectrum,
+                            uint64_t seed,
+                            const SynthesisOptions& options,
+                            uint8_t* mask);
+
+// A spectrum drawn from |seed| within the ranges GeminiService asks for:
+// one or two core layers at frequencies 2-6 with high amplitude, one to
+// three narrative layers at 8-20, one to four nuance layers at 20-60 with
+// low amplitude, and a chaos level between 0.1 and 0.8 shared by all of
+// them.
+HeptapodSpectrum RandomSpectrum(uint64_t seed);
+
+// Options for `orbita --synthesize`.
+struct SynthesisRunOptions {
+  // Logograms to generate.
+  int64_t count = 0;
+  // Directory the shards are written to, created if needed.
+  std::string output_dir;
+  // SpectrumArchive or JSON Lines file of spectra, used in turn; empty
+  // draws every spectrum with RandomSpectrum().
+  std::string spectra;
+  // Logogram i is drawn with seed + i.
+  uint64_t seed = 0;
+  // Logograms per shard file.
+  int shard_size = 65536;
+  SynthesisOptions synthesis;
+};
+
+// Generates |options.count| logograms on all cores into shard_00000.bin
+// onwards in |options.output_dir|. Each shard is a 64-byte header
+//
+//   char magic[8] = "ORBSHARD"; uint32 version = 1, size, count,
+//   record_size, mask_offset; 36 bytes reserved
+//
+// followed by |count| fixed-size records, so record i starts at
+// 64 + i * record_size:
+//
+//   uint64 seed; uint32 layer_count; uint32 reserved;
+//   kShardMaxLayers x {float frequency, amplitude, chaos_factor;
+//                      uint32 layer (0 core, 1 narrative, 2 nuance)};
+//   the mask, as SynthesizeLogogramMask() writes it, at mask_offset.
+//
+// Numbers are little-endian. Returns the process exit code: 0 on success,
+// 1 if the spectra cannot be read or a shard cannot be written.
+int RunSynthesis(const SynthesisRunOptions& options);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_LOGOGRAM_SYNTHESIS_H_
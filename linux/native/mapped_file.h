@@ -0,0 +1,33 @@
+#ifndef ORBITA_NATIVE_MAPPED_FILE_H_
+#define ORBITA_NATIVE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace orbita {
+
+// Read-only memory mapping of a whole file. Decoders read straight from the
+// page cache instead of copying the file into a heap buffer first.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Maps |path|. Returns false if it cannot be opened or mapped. Empty files
+  // map successfully with size() == 0.
+  bool Open(const char* path);
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_MAPPED_FILE_H_
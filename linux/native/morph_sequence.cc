@@ -0,0 +1,114 @@
+#include "morph_sequence.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "file_util.h"
+#include "logogram_export.h"
+#include "logogram_geometry.h"
+#include "logogram_morph.h"
+#include "mapped_file.h"
+#include "spectrum_json.h"
+#include "thread_pool.h"
+
+namespace orbita {
+
+namespace {
+
+// Reads the spectrum JSON file at |path|, reporting failures on stderr.
+bool ReadSpectrum(const std::string& path, HeptapodSpectrum* out) {
+  MappedFile file;
+  if (!file.Open(path.c_str())) {
+    fprintf(stderr, "orbita: cannot read %s: %s\n", path.c_str(),
+            strerror(errno));
+    return false;
+  }
+  const std::string text(reinterpret_cast<const char*>(file.data()),
+                         file.size());
+  if (!ParseSpectrumJson(text, out)) {
+    fprintf(stderr, "orbita: %s is not a spectrum\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int RunMorphSequence(const MorphSequenceOptions& options) {
+  if (options.frames < 1 || options.style.width <= 0 ||
+      options.style.height <= 0) {
+    fprintf(stderr, "orbita: invalid frame count or size\n");
+    return 1;
+  }
+  HeptapodSpectrum to;
+  if (!ReadSpectrum(options.to, &to)) {
+    return 1;
+  }
+  LogogramGeometryCache& cache = LogogramGeometryCache::Shared();
+  const OrbitaRenderStyle& style = options.style;
+  std::shared_ptr<const LogogramGeometry> from_geometry;
+  if (!options.from.empty()) {
+    HeptapodSpectrum from;
+    if (!ReadSpectrum(options.from, &from)) {
+      return 1;
+    }
+    from_geometry =
+        cache.Get(ShapeOf(from), options.seed, style.width, style.height);
+  }
+  const LogogramMorph morph(
+      from_geometry,
+      cache.Get(ShapeOf(to), options.seed, style.width, style.height));
+
+  if (!MakeDirectories(options.output_dir)) {
+    fprintf(stderr, "orbita: cannot create %s: %s\n",
+            options.output_dir.c_str(), strerror(errno));
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<bool> failed{false};
+  {
+    // Frames are written several at a time, each compressed on the thread
+    // that renders it, rather than one at a time with a compression pool
+    // started for every frame.
+    ThreadPool pool(/*threads=*/0);
+    for (int i = 0; i < options.frames; ++i) {
+      pool.Submit([&, i] {
+        if (failed) {
+          return;
+        }
+        const double progress =
+            options.frames > 1 ? static_cast<double>(i) / (options.frames - 1)
+                               : 1.0;
+        LogogramGeometry frame;
+        morph.Frame(progress, 1.0, &frame);
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%04d.png", i);
+        const std::string path = options.output_dir + name;
+        const OrbitaStatus status =
+            ExportLogogramPng(frame, style, path.c_str(), /*cancel=*/nullptr,
+                              /*compression_threads=*/1);
+        if (status != ORBITA_OK && !failed.exchange(true)) {
+          fprintf(stderr, "orbita: cannot write %s: %s\n", path.c_str(),
+                  orbita_status_string(status));
+        }
+      });
+    }
+    pool.Wait();
+  }
+  if (failed) {
+    return 1;
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  fprintf(stderr, "orbita: wrote %d frames to %s in %.2f s\n", options.frames,
+          options.output_dir.c_str(), seconds);
+  return 0;
+}
+
+}  // namespace orbita
@@ -0,0 +1,35 @@
+#ifndef ORBITA_NATIVE_MORPH_SEQUENCE_H_
+#define ORBITA_NATIVE_MORPH_SEQUENCE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Options for `orbita --morph`.
+struct MorphSequenceOptions {
+  // Spectrum JSON file (see ParseSpectrumJson) the animation starts from,
+  // or empty to write |to| onto a blank canvas.
+  std::string from;
+  // Spectrum JSON file the animation ends at.
+  std::string to;
+  // Directory for the frames, created if missing.
+  std::string output_dir;
+  // Frames in the sequence, including both ends.
+  int frames = 60;
+  // HeptapodPainter.defaultSeed.
+  int32_t seed = 1337;
+  OrbitaRenderStyle style;
+};
+
+// Renders the LogogramMorph from |options.from| to |options.to| as a
+// sequence of PNG files, frame_0000.png onwards, evenly spaced in time.
+// Returns the process exit code: 0 if every frame was written, 1
+// otherwise.
+int RunMorphSequence(const MorphSequenceOptions& options);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_MORPH_SEQUENCE_H_
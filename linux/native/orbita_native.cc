@@ -0,0 +1,290 @@
+// C ABI entry points. Keep these thin: argument checks and forwarding into
+// the orbita:: C++ implementation only.
+
+#include "orbita_native.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+
+#include "analysis.h"
+#include "fft.h"
+#include "job_scheduler.h"
+#include "logogram_export.h"
+#include "logogram_geometry.h"
+#include "logogram_raster.h"
+#include "result_cache.h"
+#include "scratch_memory.h"
+#include "simplex_noise.h"
+
+struct OrbitaResultCache {
+  orbita::ResultCache cache;
+};
+
+struct OrbitaLogogram {
+  std::shared_ptr<const orbita::LogogramGeometry> geometry;
+};
+
+extern "C" {
+
+const char* orbita_status_string(int32_t status) {
+  switch (status) {
+    case ORBITA_OK:
+      return "ok";
+    case ORBITA_ERROR_INVALID_ARGUMENT:
+      return "invalid_argument";
+    case ORBITA_ERROR_IO:
+      return "io";
+    case ORBITA_ERROR_UNSUPPORTED_FORMAT:
+      return "unsupported_format";
+    case ORBITA_ERROR_DECODE:
+      return "decode";
+    case ORBITA_ERROR_OUT_OF_MEMORY:
+      return "out_of_memory";
+    case ORBITA_ERROR_CANCELLED:
+      return "cancelled";
+  }
+  return "unknown";
+}
+
+void orbita_analysis_params_init(OrbitaAnalysisParams* params) {
+  if (params == nullptr) {
+    return;
+  }
+  params->blur_radius = 8;
+  params->threshold = 128;
+  params->ray_count = 512;
+  params->working_pixels = 0;
+}
+
+int32_t orbita_analyze_file(const char* path,
+                            const OrbitaAnalysisParams* params,
+                            OrbitaSpectrumSummary* out) {
+  if (params == nullptr || out == nullptr) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  return orbita::CatchOutOfMemory(
+      [&] { return orbita::AnalyzeFile(path, *params, out); });
+}
+
+int32_t orbita_result_cache_open(const char* path,
+                                 int32_t capacity,
+                                 OrbitaResultCache** out) {
+  if (path == nullptr || out == nullptr || capacity < 2) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  return orbita::CatchOutOfMemory([&] {
+    std::unique_ptr<OrbitaResultCache> cache(new OrbitaResultCache);
+    if (!cache->cache.Open(path, capacity)) {
+      return ORBITA_ERROR_IO;
+    }
+    *out = cache.release();
+    return ORBITA_OK;
+  });
+}
+
+int32_t orbita_analyze_file_cached(OrbitaResultCache* cache,
+                                   const char* path,
+                                   const OrbitaAnalysisParams* params,
+                                   OrbitaSpectrumSummary* out) {
+  if (cache == nullptr || params == nullptr || out == nullptr) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  return orbita::CatchOutOfMemory([&] {
+    return orbita::AnalyzeFile(path, *params, out, nullptr, &cache->cache);
+  });
+}
+
+int32_t orbita_analyze_rgba(const uint8_t* pixels,
+                            int32_t width,
+                            int32_t height,
+                            int32_t stride,
+                            const OrbitaAnalysisParams* params,
+                            OrbitaSpectrumSummary* out) {
+  if (params == nullptr || out == nullptr || stride < width * 4) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  const orbita::ImageView view{pixels, width, height, stride, 4};
+  return orbita::CatchOutOfMemory(
+      [&] { return orbita::AnalyzeImage(view, *params, out); });
+}
+
+int32_t orbita_real_fft_batch(const double* inputs,
+                              int32_t count,
+                              int32_t size,
+                              double* re,
+                              double* im) {
+  if (inputs == nullptr || re == nullptr || im == nullptr || count < 0 ||
+      size < 4 || (size & (size - 1)) != 0) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  return orbita::CatchOutOfMemory([&] {
+    orbita::RealFftBatch(inputs, count, size, re, im);
+    return ORBITA_OK;
+  });
+}
+
+int32_t orbita_summarize_ray_profiles(const double* profiles,
+                                      int32_t count,
+                                      int32_t size,
+                                      OrbitaSpectrumSummary* out) {
+  if (profiles == nullptr || out == nullptr || count < 0 || size < 64 ||
+      (size & (size - 1)) != 0) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  return orbita::CatchOutOfMemory([&] {
+    orbita::SummarizeRayProfiles(profiles, count, size, out);
+    return ORBITA_OK;
+  });
+}
+
+void orbita_render_style_init(OrbitaRenderStyle* style) {
+  if (style == nullptr) {
+    return;
+  }
+  style->width = 2048;
+  style->height = 2048;
+  style->background_argb = 0xFF101010;
+  style->stroke_argb = 0x0AE0E0E0;
+  style->stroke_width = 1.0f;
+  style->stroke_blur_sigma = 1.0f;
+  style->particle_argb = 0x99E0E0E0;
+  style->particle_radius = 1.5f;
+}
+
+int32_t orbita_render_logogram(const OrbitaRenderStyle* style,
+                               const float* points,
+                               int32_t point_count,
+                               const int32_t* polylines,
+                               int32_t polyline_count,
+                               const float* particles,
+                               int32_t particle_count,
+                               uint8_t* rgba,
+                               int32_t stride) {
+  if (style == nullptr || point_count < 0 || polyline_count < 0 ||
+      particle_count < 0 || (point_count > 0 && points == nullptr) ||
+      (polyline_count > 0 && polylines == nullptr) ||
+      (particle_count > 0 && particles == nullptr)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  return orbita::CatchOutOfMemory([&] {
+    orbita::LogogramGeometry geometry;
+    geometry.x.resize(point_count);
+    geometry.y.resize(point_count);
+    for (int32_t i = 0; i < point_count; ++i) {
+      geometry.x[i] = points[i * 2];
+      geometry.y[i] = points[i * 2 + 1];
+    }
+    geometry.polylines.resize(polyline_count);
+    for (int32_t i = 0; i < polyline_count; ++i) {
+      orbita::StrokePolyline& polyline = geometry.polylines[i];
+      polyline.first_point = polylines[i * 4];
+      polyline.point_count = polylines[i * 4 + 1];
+      polyline.closed = polylines[i * 4 + 2] != 0;
+      polyline.layer = polylines[i * 4 + 3];
+    }
+    geometry.particle_x.resize(particle_count);
+    geometry.particle_y.resize(particle_count);
+    for (int32_t i = 0; i < particle_count; ++i) {
+      geometry.particle_x[i] = particles[i * 2];
+      geometry.particle_y[i] = particles[i * 2 + 1];
+    }
+    return orbita::RasterizeLogogram(geometry, *style, rgba, stride);
+  });
+}
+
+int32_t orbita_logogram_acquire(const OrbitaLogogramShape* shape,
+                                int32_t seed,
+                                double width,
+                                double height,
+                                OrbitaLogogram** out) {
+  if (shape == nullptr || out == nullptr || !(width > 0) || !(height > 0) ||
+      !std::isfinite(width) || !std::isfinite(height)) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  return orbita::CatchOutOfMemory([&] {
+    *out = new OrbitaLogogram{orbita::LogogramGeometryCache::Shared().Get(
+        *shape, seed, width, height)};
+    return ORBITA_OK;
+  });
+}
+
+void orbita_logogram_counts(const OrbitaLogogram* logogram,
+                            int32_t* point_count,
+                            int32_t* polyline_count,
+                            int32_t* particle_count) {
+  const orbita::LogogramGeometry& geometry = *logogram->geometry;
+  *point_count = static_cast<int32_t>(geometry.x.size());
+  *polyline_count = static_cast<int32_t>(geometry.polylines.size());
+  *particle_count = static_cast<int32_t>(geometry.particle_x.size());
+}
+
+void orbita_logogram_copy(const OrbitaLogogram* logogram,
+                          float* points,
+                          int32_t* polylines,
+                          float* particles) {
+  const orbita::LogogramGeometry& geometry = *logogram->geometry;
+  for (size_t i = 0; i < geometry.x.size(); ++i) {
+    points[i * 2] = geometry.x[i];
+    points[i * 2 + 1] = geometry.y[i];
+  }
+  for (size_t i = 0; i < geometry.polylines.size(); ++i) {
+    const orbita::StrokePolyline& polyline = geometry.polylines[i];
+    polylines[i * 4] = polyline.first_point;
+    polylines[i * 4 + 1] = polyline.point_count;
+    polylines[i * 4 + 2] = polyline.closed ? 1 : 0;
+    polylines[i * 4 + 3] = polyline.layer;
+  }
+  for (size_t i = 0; i < geometry.particle_x.size(); ++i) {
+    particles[i * 2] = geometry.particle_x[i];
+    particles[i * 2 + 1] = geometry.particle_y[i];
+  }
+}
+
+void orbita_logogram_release(OrbitaLogogram* logogram) {
+  delete logogram;
+}
+
+int32_t orbita_export_logogram_png(const OrbitaLogogramShape* shape,
+                                   int32_t seed,
+                                   const OrbitaRenderStyle* style,
+                                   const char* path) {
+  if (shape == nullptr || style == nullptr || path == nullptr ||
+      style->width <= 0 || style->height <= 0) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  // Queued behind interactive work when the app runs a scheduler, which
+  // also reports running out of memory.
+  return orbita::RunScheduled(
+      orbita::JobPriority::kExport, /*key=*/"",
+      [=](const orbita::CancellationToken* cancel) {
+        std::shared_ptr<const orbita::LogogramGeometry> geometry =
+            orbita::LogogramGeometryCache::Shared().Get(
+                *shape, seed, style->width, style->height);
+        return orbita::ExportLogogramPng(*geometry, *style, path, cancel);
+      });
+}
+
+int32_t orbita_simplex_noise2(int32_t seed,
+                              double frequency,
+                              const double* x,
+                              const double* y,
+                              int32_t count,
+                              double* out) {
+  if (count < 0 || (count > 0 && (x == nullptr || y == nullptr ||
+                                  out == nullptr))) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  orbita::SimplexNoise2Batch(seed, frequency, x, y, count, out);
+  return ORBITA_OK;
+}
+
+void* orbita_malloc(size_t size) {
+  return malloc(size);
+}
+
+void orbita_free(void* pointer) {
+  free(pointer);
+}
+
+}  // extern "C"
@@ -0,0 +1,237 @@
+#ifndef ORBITA_NATIVE_ORBITA_NATIVE_H_
+#define ORBITA_NATIVE_ORBITA_NATIVE_H_
+
+// C ABI of liborbita_native.so.
+//
+// This is the only surface the Dart side binds to (see
+// lib/data/services/native_analysis.dart), so everything here must stay
+// plain C: fixed-width integers, POD structs and status codes.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ORBITA_EXPORT __attribute__((visibility("default")))
+
+// Number of dominant frequency bins (1..5) reported in a summary.
+#define ORBITA_DOMINANT_BIN_COUNT 5
+
+typedef enum {
+  ORBITA_OK = 0,
+  ORBITA_ERROR_INVALID_ARGUMENT = 1,
+  ORBITA_ERROR_IO = 2,
+  // The file is in a format the native decoder does not handle; callers are
+  // expected to fall back to the Dart pipeline.
+  ORBITA_ERROR_UNSUPPORTED_FORMAT = 3,
+  ORBITA_ERROR_DECODE = 4,
+  ORBITA_ERROR_OUT_OF_MEMORY = 5,
+  // A newer request superseded this one, or the app is shutting down.
+  ORBITA_ERROR_CANCELLED = 6,
+} OrbitaStatus;
+
+// Short lower-case name of a status code, e.g. "decode". Never null.
+ORBITA_EXPORT const char* orbita_status_string(int32_t status);
+
+// Parameters of the logogram analysis pipeline. Initialise with
+// orbita_analysis_params_init() so new fields pick up their defaults.
+typedef struct {
+  // Gaussian blur radius in pixels (sigma = 2/3 * radius).
+  int32_t blur_radius;
+  // Luma threshold separating ink from background.
+  int32_t threshold;
+  // Number of rays cast from the centroid. Must be a power of two >= 64.
+  int32_t ray_count;
+  // Working resolution for file inputs. Images with at least four times as
+  // many pixels are reduced by 2, 4 or 8 while decoding, and blur_radius is
+  // scaled to match. 0 analyses at full resolution.
+  int32_t working_pixels;
+} OrbitaAnalysisParams;
+
+// Mirrors SpectrumSummary in lib/data/models/spectrum_summary.dart.
+typedef struct {
+  double dominant_frequencies[ORBITA_DOMINANT_BIN_COUNT];
+  double chaos_level;
+  double density;
+} OrbitaSpectrumSummary;
+
+// Fills |params| with the defaults used by AnalysisService.analyzeImage:
+// radius 8, threshold 128, 512 rays, full resolution.
+ORBITA_EXPORT void orbita_analysis_params_init(OrbitaAnalysisParams* params);
+
+// Runs decode, grayscale, blur, inversion, threshold, centroid, ray casting
+// and FFT over the JPEG or PNG file at |path|.
+//
+// At full resolution, results match the Dart pipeline in AnalysisService to
+// within 1e-3 absolute on density and 2% relative on dominant_frequencies
+// and chaos_level. The remaining difference comes from the Q14 fixed-point
+// blur, which can move individual pixels across the threshold at ink edges.
+// A reduced working resolution trades some of that agreement for decode
+// speed: density and dominant_frequencies are scale-invariant and barely
+// move, while chaos_level, which is dominated by pixel-scale steps in the
+// ray profile, rises as the resolution drops.
+ORBITA_EXPORT int32_t orbita_analyze_file(const char* path,
+                                          const OrbitaAnalysisParams* params,
+                                          OrbitaSpectrumSummary* out);
+
+// Persistent store of analysis results keyed by file content and
+// parameters.
+typedef struct OrbitaResultCache OrbitaResultCache;
+
+// Opens or creates the result cache file at |path|, holding up to
+// |capacity| results (>= 2) before the least recently used are evicted.
+// On success stores a handle in |*out|, which may be used from any thread
+// and stays open for the life of the process.
+ORBITA_EXPORT int32_t orbita_result_cache_open(const char* path,
+                                               int32_t capacity,
+                                               OrbitaResultCache** out);
+
+// orbita_analyze_file() backed by |cache|: a file whose bytes were already
+// analysed with the same parameters is answered from the cache without
+// decoding it, and fresh results are added to the cache.
+ORBITA_EXPORT int32_t orbita_analyze_file_cached(
+    OrbitaResultCache* cache,
+    const char* path,
+    const OrbitaAnalysisParams* params,
+    OrbitaSpectrumSummary* out);
+
+// Same as orbita_analyze_file() for already-decoded 8-bit RGBA pixels.
+ORBITA_EXPORT int32_t orbita_analyze_rgba(const uint8_t* pixels,
+                                          int32_t width,
+                                          int32_t height,
+                                          int32_t stride,
+                                          const OrbitaAnalysisParams* params,
+                                          OrbitaSpectrumSummary* out);
+
+// Batched real-input FFT over |count| signals of |size| samples stored back
+// to back. |size| must be a power of two >= 4. Writes size / 2 + 1 bins per
+// signal to |re| and |im|, signal i starting at i * (size / 2 + 1).
+ORBITA_EXPORT int32_t orbita_real_fft_batch(const double* inputs,
+                                            int32_t count,
+                                            int32_t size,
+                                            double* re,
+                                            double* im);
+
+// Turns |count| ray profiles of |size| samples (a power of two >= 64) into
+// the spectral half of a summary: dominant_frequencies and chaos_level,
+// computed exactly as orbita_analyze_file() does. density is not touched.
+ORBITA_EXPORT int32_t orbita_summarize_ray_profiles(
+    const double* profiles,
+    int32_t count,
+    int32_t size,
+    OrbitaSpectrumSummary* out);
+
+// Appearance of a rendered logogram. Colours are 0xAARRGGBB, as in
+// Flutter's Color.value.
+typedef struct {
+  int32_t width;
+  int32_t height;
+  uint32_t background_argb;
+  // Colour of each stacked stroke layer; the alpha is the opacity of one
+  // layer.
+  uint32_t stroke_argb;
+  float stroke_width;
+  // Sigma of the blur MaskFilter on the strokes, in pixels.
+  float stroke_blur_sigma;
+  uint32_t particle_argb;
+  float particle_radius;
+} OrbitaRenderStyle;
+
+// Fills |style| with HeptapodPainter's look on the app background at
+// 2048 x 2048, as exported by ImageSaver.
+ORBITA_EXPORT void orbita_render_style_init(OrbitaRenderStyle* style);
+
+// Rasterises logogram geometry built by HeptapodGeometry
+// (lib/ui/painters/heptapod_geometry.dart) the way HeptapodPainter draws
+// it, on all cores.
+//
+// |points| holds |point_count| x, y pairs in pixels. |polylines| holds
+// |polyline_count| groups of four values: first point, point count, closed
+// (0 or 1) and layer, with layers in non-decreasing order. |particles|
+// holds |particle_count| x, y centres. Writes straight-alpha RGBA8 rows of
+// |stride| bytes to |rgba|.
+ORBITA_EXPORT int32_t orbita_render_logogram(const OrbitaRenderStyle* style,
+                                             const float* points,
+                                             int32_t point_count,
+                                             const int32_t* polylines,
+                                             int32_t polyline_count,
+                                             const float* particles,
+                                             int32_t particle_count,
+                                             uint8_t* rgba,
+                                             int32_t stride);
+
+// The parts of a HeptapodSpectrum that logogram geometry depends on.
+typedef struct {
+  // Sum of the core layer amplitudes.
+  double core_amplitude;
+  // Largest chaosFactor in the nuance layer.
+  double nuance_chaos;
+  // Sum of the nuance layer amplitudes.
+  double nuance_amplitude;
+} OrbitaLogogramShape;
+
+// Geometry of one logogram, shared with a process-wide cache.
+typedef struct OrbitaLogogram OrbitaLogogram;
+
+// The geometry HeptapodGeometry.build produces for |shape| and |seed| on a
+// |width| x |height| canvas, taken from the cache when the same logogram
+// was recently built at that size. A known shape at a new size reuses its
+// seeded draws, and a new nuance layer reuses the jittered main loop. On
+// success stores a handle in |*out|, valid until orbita_logogram_release().
+ORBITA_EXPORT int32_t orbita_logogram_acquire(const OrbitaLogogramShape* shape,
+                                              int32_t seed,
+                                              double width,
+                                              double height,
+                                              OrbitaLogogram** out);
+
+// Sizes of the buffers orbita_logogram_copy() fills, in the units of
+// orbita_render_logogram(): points, polylines and particles.
+ORBITA_EXPORT void orbita_logogram_counts(const OrbitaLogogram* logogram,
+                                          int32_t* point_count,
+                                          int32_t* polyline_count,
+                                          int32_t* particle_count);
+
+// Copies the geometry out in the layout orbita_render_logogram() takes.
+ORBITA_EXPORT void orbita_logogram_copy(const OrbitaLogogram* logogram,
+                                        float* points,
+                                        int32_t* polylines,
+                                        float* particles);
+
+ORBITA_EXPORT void orbita_logogram_release(OrbitaLogogram* logogram);
+
+// Renders the logogram orbita_logogram_acquire() describes for |shape| and
+// |seed|, in |style| at style->width x style->height, into a PNG file at
+// |path|. Rows are compressed on all cores and streamed to the file as they
+// are rendered, so memory stays at a few megabytes even for 8K exports.
+// The file is removed again if anything fails.
+//
+// When the app runs a job scheduler, the export waits its turn behind
+// preview and analysis work, and returns ORBITA_ERROR_CANCELLED if the app
+// shuts down first.
+ORBITA_EXPORT int32_t orbita_export_logogram_png(
+    const OrbitaLogogramShape* shape,
+    int32_t seed,
+    const OrbitaRenderStyle* style,
+    const char* path);
+
+// out[i] = package:fast_noise
+// SimplexNoise(seed: seed, frequency: frequency).getNoise2(x[i], y[i]),
+// bit for bit, for i < count. Vectorised with AVX2 or NEON.
+ORBITA_EXPORT int32_t orbita_simplex_noise2(int32_t seed,
+                                            double frequency,
+                                            const double* x,
+                                            const double* y,
+                                            int32_t count,
+                                            double* out);
+
+// Allocator shared with Dart so that FFI callers do not need package:ffi.
+ORBITA_EXPORT void* orbita_malloc(size_t size);
+ORBITA_EXPORT void orbita_free(void* pointer);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ORBITA_NATIVE_ORBITA_NATIVE_H_
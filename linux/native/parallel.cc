@@ -0,0 +1,112 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace orbita {
+
+namespace {
+
+// One ParallelFor call. Indices are claimed with an atomic counter so any
+// mix of workers and the caller can drain it.
+struct Batch {
+  const std::function<void(int)>* body = nullptr;
+  int count = 0;
+  std::atomic<int> next{0};
+  std::atomic<int> done{0};
+  std::mutex mutex;
+  std::condition_variable finished;
+
+  // Claims and runs indices until none are left.
+  void Drain() {
+    int completed = 0;
+    for (int i = next++; i < count; i = next++) {
+      (*body)(i);
+      ++completed;
+    }
+    if (completed > 0 && (done += completed) == count) {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished.notify_all();
+    }
+  }
+};
+
+class WorkerPool {
+ public:
+  static WorkerPool& Shared() {
+    // Leaked on purpose: workers must outlive static destructors that may
+    // still be analysing on other threads.
+    static WorkerPool* pool = new WorkerPool(
+        std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return *pool;
+  }
+
+  int concurrency() const { return worker_count_ + 1; }
+
+  void Run(int count, const std::function<void(int)>& body) {
+    auto batch = std::make_shared<Batch>();
+    batch->body = &body;
+    batch->count = count;
+    const int helpers = std::min(count - 1, worker_count_);
+    if (helpers > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (int i = 0; i < helpers; ++i) {
+        queue_.push_back(batch);
+      }
+      wake_.notify_all();
+    }
+    batch->Drain();
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&] { return batch->done == count; });
+  }
+
+ private:
+  explicit WorkerPool(unsigned workers)
+      : worker_count_(static_cast<int>(workers)) {
+    for (unsigned i = 0; i < workers; ++i) {
+      std::thread([this] { WorkerLoop(); }).detach();
+    }
+  }
+
+  void WorkerLoop() {
+    for (;;) {
+      std::shared_ptr<Batch> batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return !queue_.empty(); });
+        batch = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      batch->Drain();
+    }
+  }
+
+  const int worker_count_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::shared_ptr<Batch>> queue_;
+};
+
+}  // namespace
+
+void ParallelFor(int count, const std::function<void(int)>& body) {
+  if (count <= 0) {
+    return;
+  }
+  if (count == 1) {
+    body(0);
+    return;
+  }
+  WorkerPool::Shared().Run(count, body);
+}
+
+int ParallelConcurrency() {
+  return WorkerPool::Shared().concurrency();
+}
+
+}  // namespace orbita
@@ -0,0 +1,19 @@
+#ifndef ORBITA_NATIVE_PARALLEL_H_
+#define ORBITA_NATIVE_PARALLEL_H_
+
+#include <functional>
+
+namespace orbita {
+
+// Runs body(0) .. body(count - 1) across a process-wide pool of worker
+// threads and returns once all of them have finished. The calling thread
+// takes part, so nested or concurrent calls always make progress even when
+// every worker is busy.
+void ParallelFor(int count, const std::function<void(int)>& body);
+
+// Number of threads ParallelFor can use, including the caller.
+int ParallelConcurrency();
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_PARALLEL_H_
@@ -0,0 +1,409 @@
+#include "png_writer.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// Uncompressed bytes per chunk. pigz uses 128 KB with a shared dictionary;
+// independent chunks need to be larger to compress as well.
+constexpr size_t kChunkBytes = 512 * 1024;
+// Chunks compressing or waiting to be written, per worker, and at most in
+// all. The cap keeps memory the same on any number of cores: a chunk
+// holds about 1 MB while it is compressed and only its output after.
+constexpr size_t kChunksInFlightPerThread = 2;
+constexpr size_t kMaxChunksInFlight = 8;
+constexpr int kBytesPerPixel = 4;
+
+constexpr uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                   '\n'};
+// CMF and FLG of a zlib stream with a 32 KB window at the default level.
+constexpr uint8_t kZlibHeader[2] = {0x78, 0x9C};
+
+enum FilterType : uint8_t {
+  kFilterNone = 0,
+  kFilterSub = 1,
+  kFilterUp = 2,
+  kFilterAverage = 3,
+  kFilterPaeth = 4,
+};
+
+void StoreBigEndian(uint32_t value, uint8_t* out) {
+  out[0] = static_cast<uint8_t>(value >> 24);
+  out[1] = static_cast<uint8_t>(value >> 16);
+  out[2] = static_cast<uint8_t>(value >> 8);
+  out[3] = static_cast<uint8_t>(value);
+}
+
+// Row byte |x| filtered with |kType|, given the byte to its left (a),
+// above (b) and above-left (c). Branch-free so that the loops below
+// vectorise.
+template <uint8_t kType>
+inline uint8_t Filtered(int x, int a, int b, int c) {
+  switch (kType) {
+    case kFilterSub:
+      return static_cast<uint8_t>(x - a);
+    case kFilterUp:
+      return static_cast<uint8_t>(x - b);
+    case kFilterAverage:
+      return static_cast<uint8_t>(x - ((a + b) >> 1));
+    case kFilterPaeth: {
+      const int pa = std::abs(b - c);
+      const int pb = std::abs(a - c);
+      const int pc = std::abs(a + b - 2 * c);
+      const int predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+      return static_cast<uint8_t>(x - predicted);
+    }
+  }
+  return static_cast<uint8_t>(x);
+}
+
+// Calls visit(i, filtered byte) for row bytes [begin, end). The first
+// pixel has no left neighbours, which PNG treats as zero.
+template <uint8_t kType, typename Visit>
+inline void ForEachFiltered(const uint8_t* row,
+                            const uint8_t* prior,
+                            size_t begin,
+                            size_t end,
+                            Visit&& visit) {
+  size_t i = begin;
+  for (; i < end && i < kBytesPerPixel; ++i) {
+    visit(i, Filtered<kType>(row[i], 0, prior[i], 0));
+  }
+  for (; i < end; ++i) {
+    visit(i, Filtered<kType>(row[i], row[i - kBytesPerPixel], prior[i],
+                             prior[i - kBytesPerPixel]));
+  }
+}
+
+template <uint8_t kType>
+void ApplyFilter(const uint8_t* row,
+                 const uint8_t* prior,
+                 size_t size,
+                 uint8_t* out) {
+  ForEachFiltered<kType>(row, prior, 0, size,
+                         [out](size_t i, uint8_t v) { out[i] = v; });
+}
+
+// libpng's heuristic: the sum of the filtered bytes read as signed values.
+// Gives up once the sum reaches |limit|, since the filter cannot win then.
+template <uint8_t kType>
+uint64_t FilterCost(const uint8_t* row,
+                    const uint8_t* prior,
+                    size_t size,
+                    uint64_t limit) {
+  constexpr size_t kBlock = 1024;
+  uint64_t cost = 0;
+  for (size_t begin = 0; begin < size && cost < limit; begin += kBlock) {
+    uint32_t block_cost = 0;
+    ForEachFiltered<kType>(
+        row, prior, begin, std::min(size, begin + kBlock),
+        [&block_cost](size_t, uint8_t v) {
+          block_cost += v < 128 ? v : 256 - v;
+        });
+    cost += block_cost;
+  }
+  return cost;
+}
+
+}  // namespace
+
+struct PngWriter::Chunk {
+  // The row above the first one; all zeros at the top of the image.
+  std::vector<uint8_t> previous;
+  std::vector<uint8_t> rows;
+  int row_count = 0;
+  // Ends the zlib stream.
+  bool last = false;
+
+  // Filled in by Compress().
+  std::vector<uint8_t> compressed;
+  uint32_t adler = 1;
+  size_t filtered_size = 0;
+  std::promise<bool> done;
+  std::future<bool> ready = done.get_future();
+
+  // Filters every row and deflates the result into |compressed|.
+  bool Compress(size_t row_bytes, int level);
+};
+
+bool PngWriter::Chunk::Compress(size_t row_bytes, int level) {
+  ORBITA_TRACE_SPAN("png.compress");
+  const size_t line = row_bytes + 1;
+  std::vector<uint8_t> filtered(line * row_count);
+  for (int r = 0; r < row_count; ++r) {
+    const uint8_t* row = rows.data() + r * row_bytes;
+    const uint8_t* prior =
+        r == 0 ? previous.data() : rows.data() + (r - 1) * row_bytes;
+    // Costs only; the winner is applied once. Flat rows, the bulk of a
+    // logogram, cost nothing under Up and end the search early.
+    uint8_t best = kFilterUp;
+    uint64_t best_cost =
+        FilterCost<kFilterUp>(row, prior, row_bytes, UINT64_MAX);
+    auto consider = [&](uint8_t type, uint64_t cost) {
+      if (cost < best_cost) {
+        best = type;
+        best_cost = cost;
+      }
+    };
+    if (best_cost > 0) {
+      consider(kFilterSub,
+               FilterCost<kFilterSub>(row, prior, row_bytes, best_cost));
+    }
+    if (best_cost > 0) {
+      consider(kFilterNone,
+               FilterCost<kFilterNone>(row, prior, row_bytes, best_cost));
+    }
+    if (best_cost > 0) {
+      consider(kFilterAverage,
+               FilterCost<kFilterAverage>(row, prior, row_bytes, best_cost));
+    }
+    if (best_cost > 0) {
+      consider(kFilterPaeth,
+               FilterCost<kFilterPaeth>(row, prior, row_bytes, best_cost));
+    }
+
+    uint8_t* out = filtered.data() + r * line;
+    out[0] = best;
+    switch (best) {
+      case kFilterNone:
+        ApplyFilter<kFilterNone>(row, prior, row_bytes, out + 1);
+        break;
+      case kFilterSub:
+        ApplyFilter<kFilterSub>(row, prior, row_bytes, out + 1);
+        break;
+      case kFilterUp:
+        ApplyFilter<kFilterUp>(row, prior, row_bytes, out + 1);
+        break;
+      case kFilterAverage:
+        ApplyFilter<kFilterAverage>(row, prior, row_bytes, out + 1);
+        break;
+      default:
+        ApplyFilter<kFilterPaeth>(row, prior, row_bytes, out + 1);
+        break;
+    }
+  }
+  rows.clear();
+  rows.shrink_to_fit();
+
+  filtered_size = filtered.size();
+  adler = static_cast<uint32_t>(
+      adler32(1, filtered.data(), static_cast<uInt>(filtered.size())));
+
+  z_stream stream = {};
+  // Raw deflate: the zlib header and trailer are written by PngWriter.
+  if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK) {
+    return false;
+  }
+  // A sync flush adds an empty stored block after the bound's worst case.
+  compressed.resize(deflateBound(&stream, filtered.size()) + 16);
+  stream.next_in = filtered.data();
+  stream.avail_in = static_cast<uInt>(filtered.size());
+  stream.next_out = compressed.data();
+  stream.avail_out = static_cast<uInt>(compressed.size());
+  const int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  const bool ok = last ? result == Z_STREAM_END
+                       : result == Z_OK && stream.avail_in == 0 &&
+                             stream.avail_out > 0;
+  compressed.resize(stream.total_out);
+  compressed.shrink_to_fit();
+  deflateEnd(&stream);
+  return ok;
+}
+
+PngWriter::PngWriter(int threads, int level)
+    : pool_(threads == 1 ? nullptr : std::make_unique<ThreadPool>(threads)),
+      level_(level) {
+  max_in_flight_ =
+      pool_ == nullptr ? 1
+                       : std::min(pool_->size() * kChunksInFlightPerThread,
+                                  kMaxChunksInFlight);
+}
+
+PngWriter::~PngWriter() = default;
+
+OrbitaStatus PngWriter::Start(int fd, int width, int height) {
+  if (fd < 0 || width <= 0 || height <= 0 ||
+      static_cast<uint64_t>(width) * kBytesPerPixel + 1 > UINT32_MAX / 2) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  fd_ = fd;
+  width_ = width;
+  height_ = height;
+  row_bytes_ = static_cast<size_t>(width) * kBytesPerPixel;
+  rows_per_chunk_ =
+      static_cast<int>(std::max<size_t>(1, kChunkBytes / row_bytes_));
+  previous_row_.assign(row_bytes_, 0);
+
+  uint8_t header[13];
+  StoreBigEndian(static_cast<uint32_t>(width), header);
+  StoreBigEndian(static_cast<uint32_t>(height), header + 4);
+  header[8] = 8;   // Bit depth.
+  header[9] = 6;   // Colour type: RGBA.
+  header[10] = 0;  // Deflate.
+  header[11] = 0;  // Adaptive filtering.
+  header[12] = 0;  // Not interlaced.
+  status_ = WriteAll(kSignature, sizeof(kSignature));
+  if (status_ == ORBITA_OK) {
+    status_ = WriteChunk("IHDR", nullptr, 0, header, sizeof(header), nullptr,
+                         0);
+  }
+  return status_;
+}
+
+OrbitaStatus PngWriter::WriteRows(const uint8_t* rgba,
+                                  int row_count,
+                                  int stride) {
+  if (status_ != ORBITA_OK) {
+    return status_;
+  }
+  if (fd_ < 0 || rgba == nullptr || row_count < 0 ||
+      stride < static_cast<int>(row_bytes_) ||
+      row_count > height_ - rows_received_) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  for (int r = 0; r < row_count && status_ == ORBITA_OK; ++r) {
+    if (current_ == nullptr) {
+      current_ = std::make_shared<Chunk>();
+      current_->previous = previous_row_;
+      current_->rows.reserve(row_bytes_ * rows_per_chunk_);
+    }
+    const uint8_t* row = rgba + static_cast<size_t>(r) * stride;
+    current_->rows.insert(current_->rows.end(), row, row + row_bytes_);
+    ++current_->row_count;
+    ++rows_received_;
+    if (current_->row_count == rows_per_chunk_ ||
+        rows_received_ == height_) {
+      std::copy(row, row + row_bytes_, previous_row_.begin());
+      Submit();
+    }
+  }
+  return status_;
+}
+
+OrbitaStatus PngWriter::Finish() {
+  while (!in_flight_.empty() && status_ == ORBITA_OK) {
+    status_ = WriteOldest();
+  }
+  if (status_ != ORBITA_OK) {
+    return status_;
+  }
+  if (fd_ < 0 || rows_received_ != height_) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  status_ = WriteChunk("IEND", nullptr, 0, nullptr, 0, nullptr, 0);
+  return status_;
+}
+
+void PngWriter::Submit() {
+  std::shared_ptr<Chunk> chunk = std::move(current_);
+  chunk->last = rows_received_ == height_;
+  in_flight_.push_back(chunk);
+  const size_t row_bytes = row_bytes_;
+  const int level = level_;
+  auto compress = [chunk, row_bytes, level] {
+    chunk->done.set_value(chunk->Compress(row_bytes, level));
+  };
+  if (pool_ == nullptr) {
+    compress();
+  } else {
+    pool_->Submit(compress);
+  }
+
+  // Write whatever is already done, and block on the oldest chunk once too
+  // many are pending.
+  while (!in_flight_.empty() && status_ == ORBITA_OK &&
+         (in_flight_.size() > max_in_flight_ ||
+          in_flight_.front()->ready.wait_for(std::chrono::seconds(0)) ==
+              std::future_status::ready)) {
+    status_ = WriteOldest();
+  }
+}
+
+OrbitaStatus PngWriter::WriteOldest() {
+  std::shared_ptr<Chunk> chunk = std::move(in_flight_.front());
+  in_flight_.pop_front();
+  if (!chunk->ready.get()) {
+    return ORBITA_ERROR_OUT_OF_MEMORY;
+  }
+  adler_ = static_cast<uint32_t>(
+      adler32_combine(adler_, chunk->adler,
+                      static_cast<z_off_t>(chunk->filtered_size)));
+  uint8_t trailer[4];
+  StoreBigEndian(adler_, trailer);
+  const OrbitaStatus status = WriteChunk(
+      "IDAT", header_written_ ? nullptr : kZlibHeader,
+      header_written_ ? 0 : sizeof(kZlibHeader), chunk->compressed.data(),
+      chunk->compressed.size(), chunk->last ? trailer : nullptr,
+      chunk->last ? sizeof(trailer) : 0);
+  header_written_ = true;
+  return status;
+}
+
+OrbitaStatus PngWriter::WriteChunk(const char type[4],
+                                   const uint8_t* prefix,
+                                   size_t prefix_size,
+                                   const uint8_t* data,
+                                   size_t size,
+                                   const uint8_t* suffix,
+                                   size_t suffix_size) {
+  uint8_t head[8];
+  StoreBigEndian(static_cast<uint32_t>(prefix_size + size + suffix_size),
+                 head);
+  std::copy(type, type + 4, head + 4);
+  uLong crc = crc32(0, head + 4, 4);
+  // crc32() restarts when given a null buffer, so skip absent parts.
+  if (prefix_size > 0) {
+    crc = crc32(crc, prefix, static_cast<uInt>(prefix_size));
+  }
+  if (size > 0) {
+    crc = crc32(crc, data, static_cast<uInt>(size));
+  }
+  if (suffix_size > 0) {
+    crc = crc32(crc, suffix, static_cast<uInt>(suffix_size));
+  }
+  uint8_t tail[4];
+  StoreBigEndian(static_cast<uint32_t>(crc), tail);
+
+  OrbitaStatus status = WriteAll(head, sizeof(head));
+  if (status == ORBITA_OK) {
+    status = WriteAll(prefix, prefix_size);
+  }
+  if (status == ORBITA_OK) {
+    status = WriteAll(data, size);
+  }
+  if (status == ORBITA_OK) {
+    status = WriteAll(suffix, suffix_size);
+  }
+  if (status == ORBITA_OK) {
+    status = WriteAll(tail, sizeof(tail));
+  }
+  return status;
+}
+
+OrbitaStatus PngWriter::WriteAll(const uint8_t* data, size_t size) {
+  while (size > 0) {
+    const ssize_t written = write(fd_, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return ORBITA_ERROR_IO;
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return ORBITA_OK;
+}
+
+}  // namespace orbita
@@ -0,0 +1,86 @@
+#ifndef ORBITA_NATIVE_PNG_WRITER_H_
+#define ORBITA_NATIVE_PNG_WRITER_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "orbita_native.h"
+#include "thread_pool.h"
+
+namespace orbita {
+
+// Streams an 8-bit RGBA PNG to a file descriptor as its rows arrive.
+//
+// Rows are gathered into chunks of about 512 KB. Each chunk is filtered
+// and deflated independently on a worker thread, as pigz --independent
+// does: every chunk ends on a byte boundary with a sync flush, so the
+// compressed chunks concatenate into one zlib stream whose Adler-32 is
+// combined from theirs. Chunks are written out in order as IDAT chunks
+// as soon as they are done. At most two per thread and eight in all are
+// in flight, each holding about 1 MB while it is filtered and deflated, so
+// chunks take under 10 MB whatever the image size or core count.
+//
+// Filters are picked per row with libpng's minimum-sum-of-absolute-
+// differences heuristic. Output does not depend on the thread count.
+class PngWriter {
+ public:
+  // Compresses on |threads| workers; <= 0 uses one per hardware thread,
+  // and 1 compresses on the calling thread, starting none. |level| is a
+  // zlib compression level.
+  explicit PngWriter(int threads, int level = 6);
+  ~PngWriter();
+
+  PngWriter(const PngWriter&) = delete;
+  PngWriter& operator=(const PngWriter&) = delete;
+
+  // Writes the signature and header of a |width| x |height| image to |fd|,
+  // which stays owned by the caller.
+  OrbitaStatus Start(int fd, int width, int height);
+
+  // Appends |row_count| rows of straight-alpha RGBA, |stride| bytes apart.
+  OrbitaStatus WriteRows(const uint8_t* rgba, int row_count, int stride);
+
+  // Waits for the remaining chunks and writes the trailer. Fails if fewer
+  // rows than the height were written.
+  OrbitaStatus Finish();
+
+ private:
+  struct Chunk;
+
+  void Submit();
+  // Writes the oldest chunk in flight once it is compressed.
+  OrbitaStatus WriteOldest();
+  OrbitaStatus WriteChunk(const char type[4],
+                          const uint8_t* prefix,
+                          size_t prefix_size,
+                          const uint8_t* data,
+                          size_t size,
+                          const uint8_t* suffix,
+                          size_t suffix_size);
+  OrbitaStatus WriteAll(const uint8_t* data, size_t size);
+
+  // Null when compressing on the calling thread.
+  std::unique_ptr<ThreadPool> pool_;
+  const int level_;
+  int fd_ = -1;
+  int width_ = 0;
+  int height_ = 0;
+  size_t row_bytes_ = 0;
+  int rows_per_chunk_ = 0;
+  int rows_received_ = 0;
+  bool header_written_ = false;
+  uint32_t adler_ = 1;
+  OrbitaStatus status_ = ORBITA_OK;
+  // Last row of the previous chunk, which the Up, Average and Paeth
+  // filters of the next chunk's first row refer to.
+  std::vector<uint8_t> previous_row_;
+  std::shared_ptr<Chunk> current_;
+  std::deque<std::shared_ptr<Chunk>> in_flight_;
+  size_t max_in_flight_ = 0;
+};
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_PNG_WRITER_H_
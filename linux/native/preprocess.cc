@@ -0,0 +1,485 @@
+#include "preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "simd.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// Blur coefficients are Q14 so that an 8-bit sample times a coefficient,
+// summed over pairs of taps, fits the 16x16->32 multiply-add instructions.
+constexpr int kShift = 14;
+constexpr int32_t kOne = 1 << kShift;
+
+// Output columns per strip. With the default radius the ring of 17 blurred
+// rows for one strip is 17 KB, comfortably inside L1/L2.
+constexpr int kStripWidth = 1024;
+
+// Padding after each scratch row so full-width vector loads at the right
+// edge stay in bounds.
+constexpr int kSlack = 32;
+
+struct Kernel {
+  int radius = 0;
+  // 2 * radius + 1 Q14 coefficients summing exactly to kOne.
+  std::vector<int16_t> taps;
+  // Coefficients of taps (2i, 2i + 1) packed into one int32 for madd.
+  std::vector<int32_t> pairs;
+};
+
+// Same Gaussian as package:image (sigma = 2/3 * radius), quantised to Q14.
+// Any rounding error is folded into the centre tap so flat regions keep
+// their exact value.
+Kernel MakeKernel(int radius) {
+  Kernel kernel;
+  kernel.radius = radius;
+  kernel.taps.assign(2 * radius + 1, 0);
+  if (radius == 0) {
+    kernel.taps[0] = kOne;
+  } else {
+    const double sigma = radius * (2.0 / 3.0);
+    const double s = 2.0 * sigma * sigma;
+    std::vector<double> weights(kernel.taps.size());
+    double sum = 0.0;
+    for (int x = -radius; x <= radius; ++x) {
+      weights[x + radius] = std::exp(-(x * x) / s);
+      sum += weights[x + radius];
+    }
+    int32_t total = 0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+      kernel.taps[i] =
+          static_cast<int16_t>(std::lround(weights[i] / sum * kOne));
+      total += kernel.taps[i];
+    }
+    kernel.taps[radius] =
+        static_cast<int16_t>(kernel.taps[radius] + kOne - total);
+  }
+  for (size_t i = 0; i < kernel.taps.size(); i += 2) {
+    const uint16_t even = static_cast<uint16_t>(kernel.taps[i]);
+    const uint16_t odd = i + 1 < kernel.taps.size()
+                             ? static_cast<uint16_t>(kernel.taps[i + 1])
+                             : 0;
+    kernel.pairs.push_back(static_cast<int32_t>(even | (uint32_t(odd) << 16)));
+  }
+  return kernel;
+}
+
+// package:image's edge reflection, clamped so radii larger than the image
+// still index valid pixels.
+inline int ReflectClamp(int max, int x) {
+  if (x < 0) {
+    x = -x;
+  }
+  if (x >= max) {
+    x = max - (x - max) - 1;
+  }
+  return std::min(std::max(x, 0), max - 1);
+}
+
+// Rec. 601 luma in 16.16 fixed point; the weights sum to exactly 65536.
+inline uint8_t Luma(const uint8_t* p) {
+  return static_cast<uint8_t>((19595 * p[0] + 38470 * p[1] + 7471 * p[2]) >>
+                              16);
+}
+
+// How a row of Q14 sums is turned into output bytes: either the truncated
+// 8-bit value, or the ink bit (sum < limit) ^ flip.
+struct Finish {
+  bool threshold = false;
+  int32_t limit = 0;
+  uint8_t flip = 0;
+};
+
+// Computes out[x] = finish(sum_j taps[j] * srcs[j][x]) for x in
+// [begin, end). The horizontal pass passes shifted pointers into one padded
+// row, the vertical pass one pointer per ring row.
+void WeightedSumScalar(const uint8_t* const* srcs,
+                       const Kernel& kernel,
+                       int begin,
+                       int end,
+                       const Finish& finish,
+                       uint8_t* out) {
+  const size_t taps = kernel.taps.size();
+  for (int x = begin; x < end; ++x) {
+    int32_t sum = 0;
+    for (size_t j = 0; j < taps; ++j) {
+      sum += kernel.taps[j] * srcs[j][x];
+    }
+    out[x] = finish.threshold
+                 ? static_cast<uint8_t>((sum < finish.limit) ^ finish.flip)
+                 : static_cast<uint8_t>(sum >> kShift);
+  }
+}
+
+// Each SIMD variant handles as many whole vectors as fit in |width| and
+// returns the first column it did not process.
+using WeightedSumFn = int (*)(const uint8_t* const*,
+                              const Kernel&,
+                              int,
+                              const Finish&,
+                              uint8_t*);
+
+#if ORBITA_X86
+
+__attribute__((target("avx2"))) int WeightedSumAvx2(
+    const uint8_t* const* srcs,
+    const Kernel& kernel,
+    int width,
+    const Finish& finish,
+    uint8_t* out) {
+  const int taps = static_cast<int>(kernel.taps.size());
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i limit = _mm256_set1_epi32(finish.limit);
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i flip = _mm_set1_epi8(static_cast<char>(finish.flip));
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    // Unpacking within 128-bit lanes leaves pixels [0-3, 8-11] in |lo| and
+    // [4-7, 12-15] in |hi|; the lane-wise packs below restore the order.
+    __m256i lo = zero;
+    __m256i hi = zero;
+    for (int j = 0; j < taps; j += 2) {
+      const __m256i a = _mm256_cvtepu8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcs[j] + x)));
+      const __m256i b =
+          j + 1 < taps
+              ? _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(srcs[j + 1] + x)))
+              : zero;
+      const __m256i c = _mm256_set1_epi32(kernel.pairs[j / 2]);
+      lo = _mm256_add_epi32(
+          lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), c));
+      hi = _mm256_add_epi32(
+          hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), c));
+    }
+    __m128i bytes;
+    if (finish.threshold) {
+      const __m256i words = _mm256_packs_epi32(_mm256_cmpgt_epi32(limit, lo),
+                                               _mm256_cmpgt_epi32(limit, hi));
+      const __m256i packed = _mm256_permute4x64_epi64(
+          _mm256_packs_epi16(words, words), 0x08);
+      bytes = _mm_xor_si128(
+          _mm_and_si128(_mm256_castsi256_si128(packed), one), flip);
+    } else {
+      const __m256i words = _mm256_packs_epi32(_mm256_srai_epi32(lo, kShift),
+                                               _mm256_srai_epi32(hi, kShift));
+      const __m256i packed = _mm256_permute4x64_epi64(
+          _mm256_packus_epi16(words, words), 0x08);
+      bytes = _mm256_castsi256_si128(packed);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), bytes);
+  }
+  return x;
+}
+
+#if defined(__SSE2__)
+int WeightedSumSse2(const uint8_t* const* srcs,
+                    const Kernel& kernel,
+                    int width,
+                    const Finish& finish,
+                    uint8_t* out) {
+  const int taps = static_cast<int>(kernel.taps.size());
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i limit = _mm_set1_epi32(finish.limit);
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i flip = _mm_set1_epi8(static_cast<char>(finish.flip));
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i lo = zero;
+    __m128i hi = zero;
+    for (int j = 0; j < taps; j += 2) {
+      const __m128i a = _mm_unpacklo_epi8(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(srcs[j] + x)),
+          zero);
+      const __m128i b =
+          j + 1 < taps
+              ? _mm_unpacklo_epi8(
+                    _mm_loadl_epi64(
+                        reinterpret_cast<const __m128i*>(srcs[j + 1] + x)),
+                    zero)
+              : zero;
+      const __m128i c = _mm_set1_epi32(kernel.pairs[j / 2]);
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), c));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), c));
+    }
+    __m128i bytes;
+    if (finish.threshold) {
+      const __m128i words = _mm_packs_epi32(_mm_cmpgt_epi32(limit, lo),
+                                            _mm_cmpgt_epi32(limit, hi));
+      bytes = _mm_xor_si128(_mm_and_si128(_mm_packs_epi16(words, words), one),
+                            flip);
+    } else {
+      const __m128i words = _mm_packs_epi32(_mm_srai_epi32(lo, kShift),
+                                            _mm_srai_epi32(hi, kShift));
+      bytes = _mm_packus_epi16(words, words);
+    }
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), bytes);
+  }
+  return x;
+}
+#endif  // defined(__SSE2__)
+
+#elif ORBITA_NEON
+
+int WeightedSumNeon(const uint8_t* const* srcs,
+                    const Kernel& kernel,
+                    int width,
+                    const Finish& finish,
+                    uint8_t* out) {
+  const int taps = static_cast<int>(kernel.taps.size());
+  const uint32x4_t limit = vdupq_n_u32(static_cast<uint32_t>(finish.limit));
+  const uint8x8_t one = vdup_n_u8(1);
+  const uint8x8_t flip = vdup_n_u8(finish.flip);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint32x4_t lo = vdupq_n_u32(0);
+    uint32x4_t hi = vdupq_n_u32(0);
+    for (int j = 0; j < taps; ++j) {
+      const uint16x8_t v = vmovl_u8(vld1_u8(srcs[j] + x));
+      const uint16_t c = static_cast<uint16_t>(kernel.taps[j]);
+      lo = vmlal_n_u16(lo, vget_low_u16(v), c);
+      hi = vmlal_n_u16(hi, vget_high_u16(v), c);
+    }
+    uint8x8_t bytes;
+    if (finish.threshold) {
+      const uint16x8_t words = vcombine_u16(vmovn_u32(vcltq_u32(lo, limit)),
+                                            vmovn_u32(vcltq_u32(hi, limit)));
+      bytes = veor_u8(vand_u8(vmovn_u16(words), one), flip);
+    } else {
+      bytes = vmovn_u16(vcombine_u16(vshrn_n_u32(lo, kShift),
+                                     vshrn_n_u32(hi, kShift)));
+    }
+    vst1_u8(out + x, bytes);
+  }
+  return x;
+}
+
+#endif
+
+WeightedSumFn SelectWeightedSum() {
+#if ORBITA_X86
+  if (CpuHasAvx2()) {
+    return WeightedSumAvx2;
+  }
+#if defined(__SSE2__)
+  return WeightedSumSse2;
+#endif
+#elif ORBITA_NEON
+  return WeightedSumNeon;
+#endif
+  return nullptr;
+}
+
+void WeightedSum(const uint8_t* const* srcs,
+                 const Kernel& kernel,
+                 int width,
+                 const Finish& finish,
+                 uint8_t* out) {
+  static const WeightedSumFn simd = SelectWeightedSum();
+  const int done = simd != nullptr ? simd(srcs, kernel, width, finish, out) : 0;
+  WeightedSumScalar(srcs, kernel, done, width, finish, out);
+}
+
+// Luma of the pixel at |p|: the pixel itself in a single-channel image.
+inline uint8_t PixelLuma(const ImageView& image, const uint8_t* p) {
+  return image.channels == 1 ? *p : Luma(p);
+}
+
+// Luma of |count| columns starting at |begin| (which may be negative or run
+// past the right edge; those columns are reflected).
+void LumaRow(const ImageView& image, int y, int begin, int count,
+             uint8_t* out) {
+  const uint8_t* row = image.data + static_cast<size_t>(y) * image.stride;
+  for (int i = 0; i < count; ++i) {
+    int x = begin + i;
+    if (x < 0 || x >= image.width) {
+      x = ReflectClamp(image.width, x);
+    }
+    out[i] = PixelLuma(image, row + x * image.channels);
+  }
+}
+
+// The blurred value at one pixel, computed with exactly the arithmetic of
+// the streaming passes. Used for the four corners, which decide inversion
+// before the first mask row is written.
+int BlurredPixel(const ImageView& image, const Kernel& kernel, int x, int y) {
+  const int r = kernel.radius;
+  int32_t vertical = 0;
+  for (int j = -r; j <= r; ++j) {
+    const uint8_t* row = image.data + static_cast<size_t>(ReflectClamp(
+                                          image.height, y + j)) *
+                                          image.stride;
+    int32_t horizontal = 0;
+    for (int i = -r; i <= r; ++i) {
+      const int column = ReflectClamp(image.width, x + i);
+      horizontal +=
+          kernel.taps[i + r] * PixelLuma(image, row + column * image.channels);
+    }
+    vertical += kernel.taps[j + r] * (horizontal >> kShift);
+  }
+  return vertical >> kShift;
+}
+
+bool DarkCorners(const ImageView& image, const Kernel& kernel) {
+  const int w = image.width;
+  const int h = image.height;
+  const int corners = BlurredPixel(image, kernel, 0, 0) +
+                      BlurredPixel(image, kernel, w - 1, 0) +
+                      BlurredPixel(image, kernel, 0, h - 1) +
+                      BlurredPixel(image, kernel, w - 1, h - 1);
+  return corners / (4.0 * 255.0) < 0.5;
+}
+
+// Light background: ink <=> v < t <=> sum < t << kShift.
+// Dark background: ink <=> 255 - v < t <=> !(sum < (256 - t) << kShift).
+Finish InkFinish(int threshold, bool dark_background) {
+  Finish ink;
+  ink.threshold = true;
+  ink.limit = (dark_background ? 256 - threshold : threshold) << kShift;
+  ink.flip = dark_background ? 1 : 0;
+  return ink;
+}
+
+// Writes the mask over |rect| and adds its ink to |stats|. With
+// |changed|, each row is compared with what the mask held before: |stats|
+// moves only by the pixels that flipped, and |*changed| receives their
+// bounding box.
+void InkMaskRect(const ImageView& image,
+                 const Kernel& kernel,
+                 const Finish& ink,
+                 const PixelRect& rect,
+                 uint8_t* mask,
+                 InkStats* stats,
+                 PixelRect* changed) {
+  const int w = image.width;
+  const int h = image.height;
+  const int radius = kernel.radius;
+  const int taps = static_cast<int>(kernel.taps.size());
+  const Finish store;
+
+  const int strip = std::min(rect.x1 - rect.x0, kStripWidth);
+  const size_t ring_stride = strip + kSlack;
+  std::vector<uint8_t> padded(strip + 2 * radius + kSlack);
+  std::vector<uint8_t> ring(ring_stride * taps);
+  std::vector<uint8_t> fresh(changed != nullptr ? strip + kSlack : 0);
+  std::vector<const uint8_t*> srcs(taps);
+  auto ring_row = [&](int y) {
+    return ring.data() + (y % taps) * ring_stride;
+  };
+
+  // Output rows only reflect rows of their own window, so the horizontal
+  // pass can start |radius| rows above the rectangle.
+  const int first_row = std::max(0, rect.y0 - radius);
+  for (int x0 = rect.x0; x0 < rect.x1; x0 += strip) {
+    const int width = std::min(strip, rect.x1 - x0);
+    int next_out = rect.y0;
+    for (int y = first_row; y < h && next_out < rect.y1; ++y) {
+      LumaRow(image, y, x0 - radius, width + 2 * radius, padded.data());
+      for (int j = 0; j < taps; ++j) {
+        srcs[j] = padded.data() + j;
+      }
+      WeightedSum(srcs.data(), kernel, width, store, ring_row(y));
+
+      // Emit every mask row whose vertical window is now complete.
+      while (next_out < rect.y1 && std::min(next_out + radius, h - 1) <= y) {
+        for (int j = 0; j < taps; ++j) {
+          srcs[j] = ring_row(ReflectClamp(h, next_out - radius + j));
+        }
+        uint8_t* out = mask + static_cast<size_t>(next_out) * w + x0;
+        if (changed == nullptr) {
+          WeightedSum(srcs.data(), kernel, width, ink, out);
+          uint64_t count = 0;
+          uint64_t sum_x = 0;
+          for (int x = 0; x < width; ++x) {
+            count += out[x];
+            sum_x += out[x] ? x0 + x : 0;
+          }
+          stats->ink_count += count;
+          stats->sum_x += static_cast<double>(sum_x);
+          stats->sum_y += static_cast<double>(count) * next_out;
+        } else {
+          WeightedSum(srcs.data(), kernel, width, ink, fresh.data());
+          int64_t count = 0;
+          int64_t sum_x = 0;
+          for (int x = 0; x < width; ++x) {
+            if (fresh[x] == out[x]) {
+              continue;
+            }
+            const int delta = fresh[x] ? 1 : -1;
+            count += delta;
+            sum_x += delta * (x0 + x);
+            changed->x0 = std::min(changed->x0, x0 + x);
+            changed->x1 = std::max(changed->x1, x0 + x + 1);
+            changed->y0 = std::min(changed->y0, next_out);
+            changed->y1 = std::max(changed->y1, next_out + 1);
+            out[x] = fresh[x];
+          }
+          // Unsigned wrap-around subtracts removed ink exactly.
+          stats->ink_count += static_cast<uint64_t>(count);
+          stats->sum_x += static_cast<double>(sum_x);
+          stats->sum_y += static_cast<double>(count) * next_out;
+        }
+        ++next_out;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void ExtractInkMask(const ImageView& image,
+                    int radius,
+                    int threshold,
+                    ScratchVector<uint8_t>* mask,
+                    InkStats* stats) {
+  ORBITA_TRACE_SPAN("preprocess");
+  const int w = image.width;
+  const int h = image.height;
+  const Kernel kernel = MakeKernel(radius);
+
+  *stats = InkStats();
+  stats->dark_background = DarkCorners(image, kernel);
+  mask->resize(static_cast<size_t>(w) * h);
+  InkMaskRect(image, kernel, InkFinish(threshold, stats->dark_background),
+              PixelRect{0, 0, w, h}, mask->data(), stats, nullptr);
+}
+
+void LumaPlane(const ImageView& image, uint8_t* out) {
+  for (int y = 0; y < image.height; ++y) {
+    LumaRow(image, y, 0, image.width,
+            out + static_cast<size_t>(y) * image.width);
+  }
+}
+
+bool HasDarkBackground(const ImageView& image, int radius) {
+  return DarkCorners(image, MakeKernel(radius));
+}
+
+std::vector<PixelRect> UpdateInkMask(const ImageView& image,
+                                     int radius,
+                                     int threshold,
+                                     const std::vector<PixelRect>& rects,
+                                     ScratchVector<uint8_t>* mask,
+                                     InkStats* stats) {
+  ORBITA_TRACE_SPAN("preprocess.update");
+  const Kernel kernel = MakeKernel(radius);
+  const Finish ink = InkFinish(threshold, stats->dark_background);
+  std::vector<PixelRect> changed;
+  for (const PixelRect& rect : rects) {
+    if (rect.empty()) {
+      continue;
+    }
+    PixelRect box{rect.x1, rect.y1, rect.x0, rect.y0};
+    InkMaskRect(image, kernel, ink, rect, mask->data(), stats, &box);
+    if (!box.empty()) {
+      changed.push_back(box);
+    }
+  }
+  return changed;
+}
+
+}  // namespace orbita
@@ -0,0 +1,73 @@
+#ifndef ORBITA_NATIVE_PREPROCESS_H_
+#define ORBITA_NATIVE_PREPROCESS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "image_decode.h"
+#include "scratch_memory.h"
+
+namespace orbita {
+
+// Ink statistics gathered while the mask is written, so the centroid and
+// density never need a second pass over the image.
+struct InkStats {
+  uint64_t ink_count = 0;
+  double sum_x = 0.0;
+  double sum_y = 0.0;
+  bool dark_background = false;
+};
+
+// The pixels [x0, x1) x [y0, y1).
+struct PixelRect {
+  int x0 = 0;
+  int y0 = 0;
+  int x1 = 0;
+  int y1 = 0;
+
+  bool empty() const { return x0 >= x1 || y0 >= y1; }
+};
+
+// Fused grayscale + Gaussian blur + inversion + threshold.
+//
+// Produces a width * height mask with 1 for ink and 0 for background, the
+// same classification AnalysisService makes with img.grayscale,
+// img.gaussianBlur, img.invert and `luminance < threshold`. The image is
+// streamed in column strips through a ring of horizontally blurred rows, so
+// each source pixel is read once and each mask byte written once; the
+// intermediate rows stay in cache.
+//
+// Blur arithmetic is Q14 fixed point (AVX2, SSE2 or NEON where available),
+// truncating after each pass like package:image does for 8-bit images.
+void ExtractInkMask(const ImageView& image,
+                    int radius,
+                    int threshold,
+                    ScratchVector<uint8_t>* mask,
+                    InkStats* stats);
+
+// Writes the luma ExtractInkMask() sees at each pixel of |image| to
+// |out|, width * height bytes without padding.
+void LumaPlane(const ImageView& image, uint8_t* out);
+
+// The background ExtractInkMask() would find in |image|, judged from its
+// blurred corners.
+bool HasDarkBackground(const ImageView& image, int radius);
+
+// Brings a |mask| that ExtractInkMask() wrote for an earlier frame of the
+// same size up to date with |image| inside |rects|, bit for bit, assuming
+// the background is still stats->dark_background. The rectangles must
+// cover every pixel whose blur window reaches a changed source pixel.
+//
+// |stats| moves by the mask pixels that flipped, so the centroid and
+// density follow the ink without another pass. Returns the bounding box
+// of those pixels for each rectangle in which any flipped.
+std::vector<PixelRect> UpdateInkMask(const ImageView& image,
+                                     int radius,
+                                     int threshold,
+                                     const std::vector<PixelRect>& rects,
+                                     ScratchVector<uint8_t>* mask,
+                                     InkStats* stats);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_PREPROCESS_H_
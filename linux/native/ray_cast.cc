@@ -0,0 +1,162 @@
+#include "ray_cast.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+struct Ray {
+  double dir_x = 0.0;
+  double dir_y = 0.0;
+  // Number of samples (r = 0, 1, ...) before the ray leaves the image.
+  int length = 0;
+};
+
+// Rounds like Dart's double.round() (half away from zero).
+inline long RoundHalfAway(double value) {
+  return std::lround(value);
+}
+
+// Counts the leading in-bounds samples of a ray. The exit step is estimated
+// analytically per axis and then corrected against the exact rounded
+// positions, so the result matches stepping until the first miss.
+int RayLength(const Ray& ray,
+              double center_x,
+              double center_y,
+              int width,
+              int height,
+              int limit) {
+  auto inside = [&](int r) {
+    const long px = RoundHalfAway(center_x + ray.dir_x * r);
+    const long py = RoundHalfAway(center_y + ray.dir_y * r);
+    return px >= 0 && px < width && py >= 0 && py < height;
+  };
+  double exit = limit;
+  if (ray.dir_x > 0) {
+    exit = std::min(exit, (width - 0.5 - center_x) / ray.dir_x);
+  } else if (ray.dir_x < 0) {
+    exit = std::min(exit, (-0.5 - center_x) / ray.dir_x);
+  }
+  if (ray.dir_y > 0) {
+    exit = std::min(exit, (height - 0.5 - center_y) / ray.dir_y);
+  } else if (ray.dir_y < 0) {
+    exit = std::min(exit, (-0.5 - center_y) / ray.dir_y);
+  }
+  int length = static_cast<int>(
+      std::min<double>(limit, std::max(0.0, std::ceil(exit))));
+  while (length > 0 && !inside(length - 1)) {
+    --length;
+  }
+  while (length < limit && inside(length)) {
+    ++length;
+  }
+  return length;
+}
+
+void CastBlock(const uint8_t* mask,
+               int width,
+               int height,
+               double center_x,
+               double center_y,
+               int first_ray,
+               int ray_count,
+               int limit,
+               double* distances) {
+  thread_local std::vector<uint8_t> grid;
+
+  const int count = std::min(kRaySectorSize, ray_count - first_ray);
+  Ray rays[kRaySectorSize];
+  int max_length = 0;
+  for (int k = 0; k < count; ++k) {
+    const double angle = (first_ray + k) * (2 * M_PI / ray_count);
+    rays[k].dir_x = std::cos(angle);
+    rays[k].dir_y = std::sin(angle);
+    rays[k].length =
+        RayLength(rays[k], center_x, center_y, width, height, limit);
+    max_length = std::max(max_length, rays[k].length);
+  }
+
+  // Polar resampling: radius outer, ray inner, so consecutive reads land on
+  // neighbouring mask pixels while the image is still in cache.
+  grid.resize(static_cast<size_t>(count) * max_length);
+  for (int r = 0; r < max_length; ++r) {
+    for (int k = 0; k < count; ++k) {
+      if (r >= rays[k].length) {
+        continue;
+      }
+      const long px = RoundHalfAway(center_x + rays[k].dir_x * r);
+      const long py = RoundHalfAway(center_y + rays[k].dir_y * r);
+      grid[static_cast<size_t>(k) * max_length + r] =
+          mask[static_cast<size_t>(py) * width + px];
+    }
+  }
+
+  // Centre of ink per ray: a reduction over one contiguous grid row.
+  for (int k = 0; k < count; ++k) {
+    const uint8_t* row = grid.data() + static_cast<size_t>(k) * max_length;
+    uint64_t weighted = 0;
+    uint64_t total = 0;
+    for (int r = 0; r < rays[k].length; ++r) {
+      weighted += static_cast<uint64_t>(r) * row[r];
+      total += row[r];
+    }
+    distances[first_ray + k] =
+        total > 0 ? static_cast<double>(weighted) / total : 0.0;
+  }
+}
+
+}  // namespace
+
+std::vector<double> CastRays(const uint8_t* mask,
+                             int width,
+                             int height,
+                             double center_x,
+                             double center_y,
+                             int ray_count) {
+  ORBITA_TRACE_SPAN("ray_cast");
+  std::vector<double> distances(ray_count);
+  // Samples are taken for r < sqrt(w^2 + h^2).
+  const double max_radius =
+      std::sqrt(static_cast<double>(width) * width +
+                static_cast<double>(height) * height);
+  const int limit = static_cast<int>(std::ceil(max_radius));
+  const int blocks = (ray_count + kRaySectorSize - 1) / kRaySectorSize;
+  ParallelFor(blocks, [&](int block) {
+    CastBlock(mask, width, height, center_x, center_y, block * kRaySectorSize,
+              ray_count, limit, distances.data());
+  });
+  return distances;
+}
+
+void RecastRays(const uint8_t* mask,
+                int width,
+                int height,
+                double center_x,
+                double center_y,
+                const std::vector<uint8_t>& stale_sectors,
+                std::vector<double>* distances) {
+  ORBITA_TRACE_SPAN("ray_cast.recast");
+  const int ray_count = static_cast<int>(distances->size());
+  const double max_radius =
+      std::sqrt(static_cast<double>(width) * width +
+                static_cast<double>(height) * height);
+  const int limit = static_cast<int>(std::ceil(max_radius));
+  std::vector<int> sectors;
+  for (size_t i = 0; i < stale_sectors.size(); ++i) {
+    if (stale_sectors[i] != 0) {
+      sectors.push_back(static_cast<int>(i));
+    }
+  }
+  ParallelFor(static_cast<int>(sectors.size()), [&](int i) {
+    CastBlock(mask, width, height, center_x, center_y,
+              sectors[i] * kRaySectorSize, ray_count, limit,
+              distances->data());
+  });
+}
+
+}  // namespace orbita
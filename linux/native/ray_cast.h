@@ -0,0 +1,47 @@
+#ifndef ORBITA_NATIVE_RAY_CAST_H_
+#define ORBITA_NATIVE_RAY_CAST_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace orbita {
+
+// Rays resampled together. A sector's polar grid rows are written one byte
+// per radius step, so 64 rays keep 64 cache lines hot at a time.
+constexpr int kRaySectorSize = 64;
+
+// Density ray casting over a 0/1 ink mask.
+//
+// Returns, for each of |ray_count| rays evenly spaced over 2*pi from
+// (center_x, center_y), the mean distance of the ink samples along that ray
+// (0 for rays without ink). Sampling matches AnalysisService: unit steps,
+// positions rounded half away from zero, stopping at the first sample
+// outside the image.
+//
+// Rays are processed in sectors of kRaySectorSize. Each sector is first
+// resampled into a polar (ray, radius) grid by sweeping the radius in the
+// outer loop, so neighbouring rays touch neighbouring mask pixels, and each
+// ray's centre of ink is then a reduction over one contiguous grid row.
+// Sectors run in parallel and the cost per ray does not depend on the ray
+// count.
+std::vector<double> CastRays(const uint8_t* mask,
+                             int width,
+                             int height,
+                             double center_x,
+                             double center_y,
+                             int ray_count);
+
+// Casts again, into |distances| from an earlier CastRays() from the same
+// centre, only the rays of the sectors with a non-zero entry in
+// |stale_sectors|: sector i holds rays i * kRaySectorSize onwards.
+void RecastRays(const uint8_t* mask,
+                int width,
+                int height,
+                double center_x,
+                double center_y,
+                const std::vector<uint8_t>& stale_sectors,
+                std::vector<double>* distances);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_RAY_CAST_H_
@@ -0,0 +1,273 @@
+#include "result_cache.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hash.h"
+
+namespace orbita {
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'R', 'B', 'C', 'A', 'C', 'H', 'E'};
+// Bump whenever the record layout or the analysis pipeline changes in a
+// way that alters results, so stale stores are discarded.
+constexpr uint32_t kFormatVersion = 1;
+constexpr int kMaxCapacity = 1 << 24;
+
+// Holds an exclusive flock(2) on the store for the current scope.
+class FileLock {
+ public:
+  explicit FileLock(int fd) : fd_(fd) { flock(fd_, LOCK_EX); }
+  ~FileLock() { flock(fd_, LOCK_UN); }
+
+ private:
+  const int fd_;
+};
+
+// Creates a file of |size| zero bytes and renames it to |path|, so that it
+// replaces any file there without touching that file's contents or size.
+// Returns its descriptor, or -1 on failure.
+int CreateReplacement(const char* path, size_t size) {
+  std::string temporary = std::string(path) + ".XXXXXX";
+  const int fd = mkostemp(&temporary[0], O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fchmod(fd, 0644) != 0 || ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+      rename(temporary.c_str(), path) != 0) {
+    close(fd);
+    unlink(temporary.c_str());
+    return -1;
+  }
+  return fd;
+}
+
+uint32_t IndexSizeFor(uint32_t capacity) {
+  uint32_t size = 4;
+  while (size < capacity * 2) {
+    size *= 2;
+  }
+  return size;
+}
+
+}  // namespace
+
+struct ResultCache::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t index_size;
+  // Records in use; records [0, count) are valid.
+  uint32_t count;
+  // Logical clock stamped on records when they are read or written.
+  uint64_t clock;
+  // Set while a mutation is in progress, so a store left behind by a crash
+  // is recognised and reset.
+  uint32_t dirty;
+  uint8_t reserved[28];
+};
+
+struct ResultCache::Record {
+  uint64_t content;
+  uint64_t params;
+  uint64_t last_used;
+  OrbitaSpectrumSummary summary;
+};
+
+CacheKey MakeCacheKey(const uint8_t* data,
+                      size_t size,
+                      const OrbitaAnalysisParams& params) {
+  const int32_t fields[] = {params.blur_radius, params.threshold,
+                            params.ray_count, params.working_pixels};
+  CacheKey key;
+  key.content = Hash64(data, size, 0);
+  key.params = Hash64(fields, sizeof(fields), kFormatVersion);
+  return key;
+}
+
+ResultCache::~ResultCache() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+ResultCache::Header* ResultCache::header() const {
+  return reinterpret_cast<Header*>(data_);
+}
+
+uint32_t* ResultCache::index() const {
+  return reinterpret_cast<uint32_t*>(data_ + sizeof(Header));
+}
+
+ResultCache::Record* ResultCache::records() const {
+  return reinterpret_cast<Record*>(data_ + sizeof(Header) +
+                                   index_size_ * sizeof(uint32_t));
+}
+
+bool ResultCache::Open(const char* path, int capacity) {
+  if (data_ != nullptr || path == nullptr || capacity < 2 ||
+      capacity > kMaxCapacity) {
+    return false;
+  }
+  static_assert(sizeof(Header) == 64, "records must stay 8-byte aligned");
+  capacity_ = static_cast<uint32_t>(capacity);
+  index_size_ = IndexSizeFor(capacity_);
+  size_ = sizeof(Header) + index_size_ * sizeof(uint32_t) +
+          capacity_ * sizeof(Record);
+
+  fd_ = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    return false;
+  }
+  // A new file comes out of ftruncate() all zeros, which Reset() below
+  // recognises as a store to create.
+  struct stat info;
+  bool sized = false;
+  {
+    FileLock lock(fd_);
+    // Nobody can have mapped an empty file, so it is safe to size here.
+    sized = fstat(fd_, &info) == 0 &&
+            (info.st_size != 0 ||
+             ftruncate(fd_, static_cast<off_t>(size_)) == 0);
+  }
+  if (!sized) {
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  if (info.st_size != 0 && static_cast<size_t>(info.st_size) != size_) {
+    // Another store may have the file mapped at its own size, and resizing
+    // it would fault that mapping's next access. A new file takes its name
+    // instead; the other store keeps the old one until it reopens.
+    close(fd_);
+    fd_ = CreateReplacement(path, size_);
+    if (fd_ < 0) {
+      return false;
+    }
+  }
+  void* mapping =
+      mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  data_ = static_cast<uint8_t*>(mapping);
+
+  FileLock lock(fd_);
+  const Header* h = header();
+  if (memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 ||
+      h->version != kFormatVersion || h->capacity != capacity_ ||
+      h->index_size != index_size_ || h->count > capacity_ || h->dirty) {
+    Reset();
+  }
+  return true;
+}
+
+void ResultCache::Reset() {
+  memset(data_, 0, sizeof(Header) + index_size_ * sizeof(uint32_t));
+  Header* h = header();
+  memcpy(h->magic, kMagic, sizeof(kMagic));
+  h->version = kFormatVersion;
+  h->capacity = capacity_;
+  h->index_size = index_size_;
+}
+
+uint32_t* ResultCache::FindSlot(const CacheKey& key) const {
+  uint32_t* slots = index();
+  const uint32_t mask = index_size_ - 1;
+  const Record* base = records();
+  // Index entries are record numbers plus one; 0 marks an empty slot. The
+  // index is never more than half full, so the probe always terminates.
+  for (uint32_t slot = static_cast<uint32_t>(key.content ^ key.params) & mask;;
+       slot = (slot + 1) & mask) {
+    if (slots[slot] == 0) {
+      return &slots[slot];
+    }
+    const Record& record = base[slots[slot] - 1];
+    if (record.content == key.content && record.params == key.params) {
+      return &slots[slot];
+    }
+  }
+}
+
+bool ResultCache::Lookup(const CacheKey& key, OrbitaSpectrumSummary* out) {
+  if (data_ == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  FileLock lock(fd_);
+  const uint32_t slot = *FindSlot(key);
+  if (slot == 0) {
+    return false;
+  }
+  Record& record = records()[slot - 1];
+  record.last_used = ++header()->clock;
+  *out = record.summary;
+  return true;
+}
+
+void ResultCache::Insert(const CacheKey& key,
+                         const OrbitaSpectrumSummary& summary) {
+  if (data_ == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  FileLock lock(fd_);
+  Header* h = header();
+  h->dirty = 1;
+  uint32_t* slot = FindSlot(key);
+  if (*slot == 0) {
+    if (h->count == capacity_) {
+      Evict();
+      slot = FindSlot(key);
+    }
+    Record& record = records()[h->count];
+    record.content = key.content;
+    record.params = key.params;
+    *slot = ++h->count;
+  }
+  Record& record = records()[*slot - 1];
+  record.summary = summary;
+  record.last_used = ++h->clock;
+  h->dirty = 0;
+}
+
+void ResultCache::Evict() {
+  Header* h = header();
+  Record* base = records();
+  std::vector<Record> kept(base, base + h->count);
+  const size_t keep = capacity_ / 2;
+  std::nth_element(kept.begin(), kept.begin() + keep, kept.end(),
+                   [](const Record& a, const Record& b) {
+                     return a.last_used > b.last_used;
+                   });
+  std::copy(kept.begin(), kept.begin() + keep, base);
+  h->count = static_cast<uint32_t>(keep);
+  RebuildIndex();
+}
+
+void ResultCache::RebuildIndex() {
+  memset(index(), 0, index_size_ * sizeof(uint32_t));
+  const Record* base = records();
+  for (uint32_t i = 0; i < header()->count; ++i) {
+    const CacheKey key{base[i].content, base[i].params};
+    *FindSlot(key) = i + 1;
+  }
+}
+
+}  // namespace orbita
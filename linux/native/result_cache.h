@@ -0,0 +1,84 @@
+#ifndef ORBITA_NATIVE_RESULT_CACHE_H_
+#define ORBITA_NATIVE_RESULT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Identifies one analysis: the encoded image bytes plus every parameter
+// that changes the result.
+struct CacheKey {
+  uint64_t content = 0;
+  uint64_t params = 0;
+};
+
+CacheKey MakeCacheKey(const uint8_t* data,
+                      size_t size,
+                      const OrbitaAnalysisParams& params);
+
+// Persistent, content-addressed store of analysis results.
+//
+// The whole store is one fixed-size file mapped MAP_SHARED: a header, an
+// open-addressing hash index at most half full, and a record area that is
+// only ever appended to. A lookup hashes into the index and touches one
+// slot run and one record, so it costs the same however many results are
+// stored, and nothing is deserialised on open.
+//
+// When the record area fills up, the least recently used half of the
+// records is dropped and the rest are compacted in place, which bounds the
+// file at under 100 bytes per record.
+//
+// Safe to share between threads, and between processes through flock(2).
+// A store that is damaged or from an older format is discarded and
+// recreated empty. One sized for a different capacity is left as it is, in
+// case another store still has it mapped, and a new empty file takes its
+// name.
+class ResultCache {
+ public:
+  ResultCache() = default;
+  ~ResultCache();
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  // Opens or creates the store at |path| holding up to |capacity| results
+  // (at least 2). Returns false if the file cannot be created or mapped.
+  bool Open(const char* path, int capacity);
+
+  // Copies the result stored for |key| into |out| and marks it as recently
+  // used. Returns false on a miss.
+  bool Lookup(const CacheKey& key, OrbitaSpectrumSummary* out);
+
+  // Stores |summary| under |key|, replacing any previous result.
+  void Insert(const CacheKey& key, const OrbitaSpectrumSummary& summary);
+
+ private:
+  struct Header;
+  struct Record;
+
+  Header* header() const;
+  uint32_t* index() const;
+  Record* records() const;
+
+  void Reset();
+  // Slot holding |key|, or the empty slot where it belongs.
+  uint32_t* FindSlot(const CacheKey& key) const;
+  void RebuildIndex();
+  // Keeps the most recently used half of the records.
+  void Evict();
+
+  std::mutex mutex_;
+  int fd_ = -1;
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  uint32_t capacity_ = 0;
+  uint32_t index_size_ = 0;
+};
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_RESULT_CACHE_H_
@@ -0,0 +1,285 @@
+#include "scratch_memory.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <new>
+#include <set>
+#include <vector>
+
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// Smallest buffer taken from the pool.
+constexpr size_t kMinScratchBytes = 64 << 10;
+// Most bytes left pooled between jobs.
+constexpr int64_t kMaxCachedBytes = 64 << 20;
+// Ahead of each block, keeping what follows it aligned for any type.
+constexpr size_t kHeaderBytes = 64;
+
+struct BlockHeader {
+  // The scope that allocated the block, or 0.
+  uint64_t scope;
+};
+
+static_assert(sizeof(BlockHeader) <= kHeaderBytes, "header must fit");
+
+// The calling thread's outermost ScratchScope.
+struct ScopeState {
+  uint64_t id = 0;
+  int depth = 0;
+  // Bytes of blocks it allocated and has not freed.
+  int64_t held = 0;
+};
+
+thread_local ScopeState current_scope;
+
+// Bytes mapped for a |bytes|-byte buffer: four classes to each power of
+// two, so at most a quarter is wasted.
+size_t ClassBytes(size_t bytes) {
+  const size_t total = bytes + kHeaderBytes;
+  const int shift = 63 - __builtin_clzll(total) - 2;
+  const size_t step = size_t{1} << shift;
+  return (total + step - 1) / step * step;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+class ScratchPool {
+ public:
+  static ScratchPool& Shared() {
+    static ScratchPool* pool = new ScratchPool();
+    return *pool;
+  }
+
+  void SetLimit(int64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    limit_ = std::max<int64_t>(bytes, 0);
+    if (limit_ > 0 && used_ + cached_ > limit_) {
+      TrimLocked(used_ + cached_ - limit_);
+    }
+    released_.notify_all();
+  }
+
+  ScratchUsage Usage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ScratchUsage{used_, cached_, peak_, limit_, waits_, wait_ms_};
+  }
+
+  void* Allocate(size_t bytes) {
+    const size_t block_bytes = ClassBytes(bytes);
+    const int64_t size = static_cast<int64_t>(block_bytes);
+    ScopeState& scope = current_scope;
+    void* block = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      bool waiting = false;
+      uint64_t ticket = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for (;;) {
+        std::vector<void*>& pooled = free_[block_bytes];
+        if (!pooled.empty()) {
+          block = pooled.back();
+          pooled.pop_back();
+          cached_ -= size;
+          break;
+        }
+        if (limit_ == 0 || used_ + cached_ + size <= limit_) {
+          break;
+        }
+        if (cached_ > 0) {
+          TrimLocked(used_ + cached_ + size - limit_);
+          continue;
+        }
+        if (scope.depth == 0) {
+          break;
+        }
+        // Jobs already holding memory are nearer to finishing, so they go
+        // ahead of ones yet to start.
+        std::set<uint64_t>& queue =
+            scope.held > 0 ? waiting_holders_ : waiting_starters_;
+        if (!waiting) {
+          waiting = true;
+          ticket = next_ticket_++;
+          queue.insert(ticket);
+          // Others may have been waiting for this job to wait too.
+          released_.notify_all();
+        }
+        if (static_cast<int>(waiting_holders_.size()) == holders_ &&
+            *(holders_ > 0 ? waiting_holders_ : waiting_starters_).begin() ==
+                ticket) {
+          break;
+        }
+        released_.wait(lock);
+      }
+      if (waiting) {
+        (scope.held > 0 ? waiting_holders_ : waiting_starters_).erase(ticket);
+        ++waits_;
+        wait_ms_ += MillisecondsSince(start);
+        released_.notify_all();
+      }
+      // Counted before mapping, so no other job can claim the same room.
+      used_ += size;
+      peak_ = std::max(peak_, used_ + cached_);
+      if (scope.depth > 0) {
+        holders_ += scope.held == 0;
+        scope.held += size;
+      }
+      RecordCountersLocked();
+    }
+
+    if (block == nullptr) {
+      block = mmap(nullptr, block_bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (block == MAP_FAILED) {
+        Release(size, scope.depth > 0 ? scope.id : 0);
+        throw std::bad_alloc();
+      }
+    }
+    static_cast<BlockHeader*>(block)->scope =
+        scope.depth > 0 ? scope.id : 0;
+    return static_cast<uint8_t*>(block) + kHeaderBytes;
+  }
+
+  void Free(void* pointer, size_t bytes) {
+    const size_t block_bytes = ClassBytes(bytes);
+    void* block = static_cast<uint8_t*>(pointer) - kHeaderBytes;
+    const uint64_t owner = static_cast<BlockHeader*>(block)->scope;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const int64_t size = static_cast<int64_t>(block_bytes);
+      const int64_t room = limit_ > 0 ? std::min(kMaxCachedBytes, limit_)
+                                      : kMaxCachedBytes;
+      if (cached_ + size <= room) {
+        free_[block_bytes].push_back(block);
+        cached_ += size;
+        block = nullptr;
+      }
+      ReleaseLocked(size, owner);
+    }
+    if (block != nullptr) {
+      munmap(block, block_bytes);
+    }
+  }
+
+  void EndScope(ScopeState* scope) {
+    if (scope->held > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --holders_;
+      released_.notify_all();
+    }
+    scope->held = 0;
+  }
+
+ private:
+  ScratchPool() = default;
+
+  void Release(int64_t size, uint64_t owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ReleaseLocked(size, owner);
+  }
+
+  void ReleaseLocked(int64_t size, uint64_t owner) {
+    used_ -= size;
+    ScopeState& scope = current_scope;
+    // Blocks freed by another thread, or after their scope ended, leave the
+    // scope counted as a holder until it ends.
+    if (owner != 0 && scope.depth > 0 && owner == scope.id) {
+      scope.held -= size;
+      holders_ -= scope.held == 0;
+    }
+    RecordCountersLocked();
+    released_.notify_all();
+  }
+
+  // Returns pooled blocks to the system, largest first, until at least
+  // |bytes| are freed or none are left.
+  void TrimLocked(int64_t bytes) {
+    for (auto it = free_.rbegin(); it != free_.rend() && bytes > 0; ++it) {
+      std::vector<void*>& pooled = it->second;
+      while (!pooled.empty() && bytes > 0) {
+        munmap(pooled.back(), it->first);
+        pooled.pop_back();
+        cached_ -= static_cast<int64_t>(it->first);
+        bytes -= static_cast<int64_t>(it->first);
+      }
+    }
+  }
+
+  void RecordCountersLocked() {
+    if (TracingEnabled()) {
+      RecordTraceCounter("scratch_mb", used_ / 1e6);
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable released_;
+  // Pooled blocks by size class.
+  std::map<size_t, std::vector<void*>> free_;
+  int64_t limit_ = 0;
+  int64_t used_ = 0;
+  int64_t cached_ = 0;
+  int64_t peak_ = 0;
+  int64_t waits_ = 0;
+  double wait_ms_ = 0;
+  // Scopes holding blocks.
+  int holders_ = 0;
+  // Waiting allocations by arrival: of scopes holding blocks, and of
+  // scopes yet to allocate any.
+  std::set<uint64_t> waiting_holders_;
+  std::set<uint64_t> waiting_starters_;
+  uint64_t next_ticket_ = 0;
+};
+
+std::atomic<uint64_t> next_scope_id{1};
+
+}  // namespace
+
+void SetScratchLimit(int64_t bytes) {
+  ScratchPool::Shared().SetLimit(bytes);
+}
+
+ScratchUsage GetScratchUsage() {
+  return ScratchPool::Shared().Usage();
+}
+
+void* AllocateScratch(size_t bytes) {
+  if (bytes < kMinScratchBytes) {
+    return ::operator new(bytes);
+  }
+  return ScratchPool::Shared().Allocate(bytes);
+}
+
+void FreeScratch(void* block, size_t bytes) {
+  if (bytes < kMinScratchBytes) {
+    ::operator delete(block);
+    return;
+  }
+  ScratchPool::Shared().Free(block, bytes);
+}
+
+ScratchScope::ScratchScope() {
+  if (current_scope.depth++ == 0) {
+    current_scope.id = next_scope_id.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+ScratchScope::~ScratchScope() {
+  if (--current_scope.depth == 0) {
+    ScratchPool::Shared().EndScope(&current_scope);
+  }
+}
+
+}  // namespace orbita
@@ -0,0 +1,117 @@
+#ifndef ORBITA_NATIVE_SCRATCH_MEMORY_H_
+#define ORBITA_NATIVE_SCRATCH_MEMORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// The large temporary buffers of analysis and export (decoded images, ink
+// masks, luma frames, PNG bands) come from one process-wide pool, so that
+// overlapping jobs stay within a memory budget instead of spiking resident
+// memory until the process is killed.
+//
+// Blocks are mapped straight from the kernel in size classes, four to each
+// power of two. A freed block either goes to the next job that needs its
+// class or back to the system; it never fragments the heap. Up to 64 MB
+// of blocks stay pooled between jobs. Buffers under 64 KB come from the
+// heap as usual and are not counted.
+//
+// With a budget set, an allocation that would take the pool over it first
+// returns pooled blocks to the system. If that is not enough and the
+// calling thread is inside a ScratchScope, it waits for other jobs to free
+// theirs. A job only goes over the budget when every job holding scratch
+// memory is itself waiting. The one of them that has waited longest then
+// goes ahead, so jobs can never wait on each other forever, while jobs yet
+// to allocate anything keep waiting until no job holds memory. Allocations
+// outside any scope are counted but never wait.
+
+// Memory held by scratch buffers.
+struct ScratchUsage {
+  // Bytes in buffers in use.
+  int64_t used_bytes = 0;
+  // Bytes pooled for the next job.
+  int64_t cached_bytes = 0;
+  // Highest used_bytes + cached_bytes so far.
+  int64_t peak_bytes = 0;
+  // The budget, or 0 for none.
+  int64_t limit_bytes = 0;
+  // Allocations that waited for memory, and their total wait.
+  int64_t waits = 0;
+  double wait_ms = 0;
+};
+
+// Sets the budget in bytes; 0 removes it. Jobs waiting for memory
+// re-check at once.
+void SetScratchLimit(int64_t bytes);
+
+ScratchUsage GetScratchUsage();
+
+// Returns a block of at least |bytes| bytes, aligned for any type. Throws
+// std::bad_alloc if the system is out of memory.
+void* AllocateScratch(size_t bytes);
+// Frees a block from AllocateScratch(|bytes|).
+void FreeScratch(void* block, size_t bytes);
+
+// Returns |body|()'s status, or ORBITA_ERROR_OUT_OF_MEMORY if it throws
+// std::bad_alloc. Wraps the places an allocation failure must stop: the C
+// ABI and every job run on a scheduler or pool thread.
+template <typename Body>
+OrbitaStatus CatchOutOfMemory(const Body& body) {
+  try {
+    return body();
+  } catch (const std::bad_alloc&) {
+    return ORBITA_ERROR_OUT_OF_MEMORY;
+  }
+}
+
+// Marks the calling thread as running one job from construction to
+// destruction; see above. Scopes nest, and inner ones belong to the
+// outermost.
+class ScratchScope {
+ public:
+  ScratchScope();
+  ~ScratchScope();
+
+  ScratchScope(const ScratchScope&) = delete;
+  ScratchScope& operator=(const ScratchScope&) = delete;
+};
+
+// Standard allocator drawing from the scratch pool.
+template <typename T>
+class ScratchAllocator {
+ public:
+  using value_type = T;
+
+  ScratchAllocator() = default;
+  template <typename U>
+  ScratchAllocator(const ScratchAllocator<U>&) {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(AllocateScratch(count * sizeof(T)));
+  }
+  void deallocate(T* block, size_t count) {
+    FreeScratch(block, count * sizeof(T));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const ScratchAllocator<T>&, const ScratchAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ScratchAllocator<T>&, const ScratchAllocator<U>&) {
+  return false;
+}
+
+template <typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_SCRATCH_MEMORY_H_
@@ -0,0 +1,35 @@
+#ifndef ORBITA_NATIVE_SIMD_H_
+#define ORBITA_NATIVE_SIMD_H_
+
+// Instruction-set selection shared by the SIMD kernels.
+//
+// x86 builds always have SSE2 and compile AVX2 variants with
+// __attribute__((target("avx2"))), picked at runtime with CpuHasAvx2().
+// ARM builds use NEON unconditionally; double-precision NEON kernels are
+// additionally guarded by ORBITA_NEON_F64 (AArch64 only).
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ORBITA_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ORBITA_NEON 1
+#if defined(__aarch64__)
+#define ORBITA_NEON_F64 1
+#endif
+#endif
+
+namespace orbita {
+
+inline bool CpuHasAvx2() {
+#if ORBITA_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_SIMD_H_
@@ -0,0 +1,640 @@
+#include "similarity_index.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+#include "analysis.h"
+#include "hash.h"
+#include "json_writer.h"
+#include "mapped_file.h"
+#include "simd.h"
+
+namespace orbita {
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'R', 'B', 'I', 'N', 'D', 'E', 'X'};
+// Bump whenever the record layout or the features change, so that old
+// indexes are refused rather than misread.
+constexpr uint32_t kFormatVersion = 1;
+// Links per entry on the upper layers, and on the bottom layer, which
+// carries most of the search.
+constexpr int kLinks = 16;
+constexpr int kBottomLinks = 2 * kLinks;
+// Candidates kept while linking a new entry.
+constexpr int kBuildEf = 128;
+constexpr int kDefaultEf = 64;
+constexpr int kMaxLevel = 12;
+constexpr uint32_t kInitialCapacity = 1024;
+constexpr uint32_t kMaxCapacity = 1u << 28;
+constexpr uint32_t kNone = 0xffffffffu;
+
+using Candidate = std::pair<float, uint32_t>;
+
+float FeatureDistanceScalar(const float* a, const float* b, int count) {
+  float sum = 0;
+  for (int i = 0; i < count; ++i) {
+    const float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+#if ORBITA_X86
+
+__attribute__((target("avx2"))) float FeatureDistanceAvx2(const float* a,
+                                                          const float* b) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for (int i = 0; i < kSpectralFeatureSize; i += 16) {
+    const __m256 d0 =
+        _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    const __m256 d1 =
+        _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(d0, d0));
+    acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(d1, d1));
+  }
+  const __m256 acc = _mm256_add_ps(acc0, acc1);
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc),
+                          _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+#if defined(__SSE2__)
+float FeatureDistanceSse2(const float* a, const float* b) {
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (int i = 0; i < kSpectralFeatureSize; i += 8) {
+    const __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    const __m128 d1 =
+        _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+  }
+  __m128 sum = _mm_add_ps(acc0, acc1);
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+#endif  // defined(__SSE2__)
+
+#elif ORBITA_NEON
+
+float FeatureDistanceNeon(const float* a, const float* b) {
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  for (int i = 0; i < kSpectralFeatureSize; i += 8) {
+    const float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+    const float32x4_t d1 =
+        vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc0 = vmlaq_f32(acc0, d0, d0);
+    acc1 = vmlaq_f32(acc1, d1, d1);
+  }
+  const float32x4_t acc = vaddq_f32(acc0, acc1);
+  const float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+  return vget_lane_f32(vpadd_f32(half, half), 0);
+}
+
+#endif
+
+// Top layer of the entry with |id|: layer l with probability
+// kLinks^-l (1 - 1 / kLinks). Drawn from the id rather than a generator,
+// so relinking an index rebuilds the same layers.
+int LevelFor(uint64_t id) {
+  const uint64_t bits = Hash64(&id, sizeof(id), kFormatVersion);
+  const double uniform = ((bits >> 11) + 0.5) * 0x1.0p-53;
+  const int level =
+      static_cast<int>(-std::log(uniform) / std::log(double{kLinks}));
+  return std::min(level, kMaxLevel);
+}
+
+// Entries a search has already looked at, reused across searches on the
+// same thread so that large indexes need no clearing between them.
+class VisitedSet {
+ public:
+  void Reset(uint32_t count) {
+    if (marks_.size() < count) {
+      marks_.resize(count, 0);
+    }
+    if (++epoch_ == 0) {
+      std::fill(marks_.begin(), marks_.end(), 0);
+      epoch_ = 1;
+    }
+  }
+
+  // Marks |index| and returns true if it was not marked yet.
+  bool Insert(uint32_t index) {
+    if (marks_[index] == epoch_) {
+      return false;
+    }
+    marks_[index] = epoch_;
+    return true;
+  }
+
+ private:
+  std::vector<uint32_t> marks_;
+  uint32_t epoch_ = 0;
+};
+
+}  // namespace
+
+struct SimilarityIndex::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t dimension;
+  // Entries [0, count) are in use.
+  uint32_t count;
+  uint32_t capacity;
+  // Upper-layer link blocks [0, upper_count) are in use.
+  uint32_t upper_count;
+  uint32_t upper_capacity;
+  // Where every search starts: an entry on the top layer, or kNone.
+  uint32_t entry;
+  uint32_t top_level;
+  // Set while the graph is being changed, so that an index left behind by
+  // a crash is recognised and relinked.
+  uint32_t dirty;
+  uint8_t reserved[20];
+};
+
+struct SimilarityIndex::Node {
+  uint64_t id;
+  uint32_t level;
+  // Link blocks of layers 1..level are upper .. upper + level - 1.
+  uint32_t upper;
+  float features[kSpectralFeatureSize];
+  uint32_t link_count;
+  uint32_t links[kBottomLinks];
+  uint32_t reserved;
+};
+
+struct SimilarityIndex::UpperLinks {
+  uint32_t count;
+  uint32_t links[kLinks];
+};
+
+void SpectralFeatures(const std::vector<double>& spectrum, float* out) {
+  const double dc = spectrum.empty() ? 0.0 : spectrum[0];
+  for (int k = 0; k < kSpectralFeatureSize; ++k) {
+    const size_t bin = k + 1;
+    out[k] = dc > 0 && bin < spectrum.size()
+                 ? static_cast<float>(spectrum[bin] / dc)
+                 : 0.0f;
+  }
+}
+
+uint64_t ImageId(const uint8_t* data, size_t size) {
+  return Hash64(data, size, 0);
+}
+
+std::string FormatImageId(uint64_t id) {
+  char text[17];
+  snprintf(text, sizeof(text), "%016" PRIx64, id);
+  return text;
+}
+
+float FeatureDistance(const float* a, const float* b) {
+#if ORBITA_X86
+  if (CpuHasAvx2()) {
+    return FeatureDistanceAvx2(a, b);
+  }
+#if defined(__SSE2__)
+  return FeatureDistanceSse2(a, b);
+#endif
+#elif ORBITA_NEON
+  return FeatureDistanceNeon(a, b);
+#endif
+  return FeatureDistanceScalar(a, b, kSpectralFeatureSize);
+}
+
+size_t SimilarityIndex::FileSize(uint32_t capacity,
+                                 uint32_t upper_capacity) {
+  return sizeof(Header) + capacity * sizeof(Node) +
+         upper_capacity * sizeof(UpperLinks);
+}
+
+SimilarityIndex::~SimilarityIndex() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+SimilarityIndex::Header* SimilarityIndex::header() const {
+  return reinterpret_cast<Header*>(data_);
+}
+
+SimilarityIndex::Node* SimilarityIndex::node(uint32_t index) const {
+  return reinterpret_cast<Node*>(data_ + sizeof(Header)) + index;
+}
+
+SimilarityIndex::UpperLinks* SimilarityIndex::upper(uint32_t block) const {
+  return reinterpret_cast<UpperLinks*>(data_ + sizeof(Header) +
+                                       header()->capacity * sizeof(Node)) +
+         block;
+}
+
+uint32_t* SimilarityIndex::Links(uint32_t index,
+                                 int level,
+                                 uint32_t** count) const {
+  Node* n = node(index);
+  if (level == 0) {
+    *count = &n->link_count;
+    return n->links;
+  }
+  UpperLinks* block = upper(n->upper + level - 1);
+  *count = &block->count;
+  return block->links;
+}
+
+bool SimilarityIndex::Map() {
+  void* mapping =
+      mmap(nullptr, size_, PROT_READ | (writable_ ? PROT_WRITE : 0),
+           MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<uint8_t*>(mapping);
+  return true;
+}
+
+OrbitaStatus SimilarityIndex::Open(const char* path, bool writable) {
+  if (data_ != nullptr || path == nullptr) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  static_assert(sizeof(Header) == 64, "records must stay 8-byte aligned");
+  static_assert(sizeof(Node) % 8 == 0, "records must stay 8-byte aligned");
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  writable_ = writable;
+  fd_ = writable ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)
+                 : open(path, O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0 || flock(fd_, (writable ? LOCK_EX : LOCK_SH) | LOCK_NB) != 0) {
+    return ORBITA_ERROR_IO;
+  }
+  struct stat info;
+  if (fstat(fd_, &info) != 0) {
+    return ORBITA_ERROR_IO;
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  if (size_ == 0 && writable) {
+    size_ = FileSize(kInitialCapacity, kInitialCapacity / 8);
+    if (ftruncate(fd_, static_cast<off_t>(size_)) != 0 || !Map()) {
+      return ORBITA_ERROR_IO;
+    }
+    Header* h = header();
+    memcpy(h->magic, kMagic, sizeof(kMagic));
+    h->version = kFormatVersion;
+    h->dimension = kSpectralFeatureSize;
+    h->capacity = kInitialCapacity;
+    h->upper_capacity = kInitialCapacity / 8;
+    h->entry = kNone;
+    return ORBITA_OK;
+  }
+  if (size_ < sizeof(Header)) {
+    return ORBITA_ERROR_DECODE;
+  }
+  if (!Map()) {
+    return ORBITA_ERROR_IO;
+  }
+
+  // A crash while the file grew can leave it longer than the header says,
+  // but never shorter.
+  const Header* h = header();
+  if (memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 ||
+      h->version != kFormatVersion || h->dimension != kSpectralFeatureSize ||
+      h->capacity > kMaxCapacity || h->count > h->capacity ||
+      h->upper_count > h->upper_capacity ||
+      FileSize(h->capacity, h->upper_capacity) > size_ ||
+      (h->dirty && !writable)) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    return ORBITA_ERROR_DECODE;
+  }
+  if (writable) {
+    if (h->dirty) {
+      Relink();
+    }
+    ids_.reserve(h->count);
+    for (uint32_t i = 0; i < h->count; ++i) {
+      ids_.emplace(node(i)->id, i);
+    }
+  }
+  return ORBITA_OK;
+}
+
+size_t SimilarityIndex::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return data_ == nullptr ? 0 : header()->count;
+}
+
+bool SimilarityIndex::Reserve(int levels) {
+  const Header* h = header();
+  const uint32_t capacity = h->capacity;
+  const uint32_t upper_capacity = h->upper_capacity;
+  if (h->count < capacity && h->upper_count + levels <= upper_capacity) {
+    return true;
+  }
+  const uint32_t new_capacity =
+      h->count < capacity ? capacity : capacity * 2;
+  uint32_t new_upper_capacity = std::max(upper_capacity, new_capacity / 8);
+  while (h->upper_count + levels > new_upper_capacity) {
+    new_upper_capacity *= 2;
+  }
+  if (new_capacity > kMaxCapacity) {
+    return false;
+  }
+  const size_t new_size = FileSize(new_capacity, new_upper_capacity);
+  if (new_size > size_) {
+    if (ftruncate(fd_, static_cast<off_t>(new_size)) != 0) {
+      return false;
+    }
+    void* mapping = mremap(data_, size_, new_size, MREMAP_MAYMOVE);
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+    data_ = static_cast<uint8_t*>(mapping);
+    size_ = new_size;
+  }
+  // The upper-layer links follow the records, so they move up to make
+  // room. Until the header is updated the index counts as dirty.
+  Header* mutable_header = header();
+  mutable_header->dirty = 1;
+  const UpperLinks* from = upper(0);
+  UpperLinks* to = reinterpret_cast<UpperLinks*>(
+      data_ + sizeof(Header) + new_capacity * sizeof(Node));
+  memmove(to, from, mutable_header->upper_count * sizeof(UpperLinks));
+  mutable_header->capacity = new_capacity;
+  mutable_header->upper_capacity = new_upper_capacity;
+  return true;
+}
+
+OrbitaStatus SimilarityIndex::Insert(uint64_t id, const float* features) {
+  if (features == nullptr) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (data_ == nullptr || !writable_) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  if (ids_.count(id) != 0) {
+    return ORBITA_OK;
+  }
+  const int level = LevelFor(id);
+  if (!Reserve(level)) {
+    return ORBITA_ERROR_IO;
+  }
+  Header* h = header();
+  h->dirty = 1;
+  const uint32_t index = h->count;
+  Node* n = node(index);
+  n->id = id;
+  n->level = level;
+  n->upper = h->upper_count;
+  memcpy(n->features, features, sizeof(n->features));
+  n->link_count = 0;
+  for (int l = 1; l <= level; ++l) {
+    upper(n->upper + l - 1)->count = 0;
+  }
+  h->upper_count += level;
+  h->count = index + 1;
+  ids_.emplace(id, index);
+  Link(index);
+  h->dirty = 0;
+  return ORBITA_OK;
+}
+
+void SimilarityIndex::Link(uint32_t index) {
+  Header* h = header();
+  const Node* n = node(index);
+  const int level = static_cast<int>(n->level);
+  if (h->entry == kNone) {
+    h->entry = index;
+    h->top_level = level;
+    return;
+  }
+  const int top = static_cast<int>(h->top_level);
+  uint32_t entry = Descend(n->features, std::min(level, top));
+  for (int l = std::min(level, top); l >= 0; --l) {
+    std::vector<Candidate> candidates =
+        SearchLayer(n->features, entry, l, kBuildEf);
+    entry = candidates.front().second;
+    SelectNeighbours(&candidates, kLinks);
+    uint32_t* count;
+    uint32_t* links = Links(index, l, &count);
+    *count = static_cast<uint32_t>(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      links[i] = candidates[i].second;
+    }
+    for (const Candidate& candidate : candidates) {
+      AddLink(candidate.second, index, l);
+    }
+  }
+  if (level > top) {
+    h->entry = index;
+    h->top_level = level;
+  }
+}
+
+void SimilarityIndex::Relink() {
+  Header* h = header();
+  h->dirty = 1;
+  h->entry = kNone;
+  h->top_level = 0;
+  h->upper_count = 0;
+  for (uint32_t i = 0; i < h->count; ++i) {
+    Node* n = node(i);
+    n->link_count = 0;
+    n->upper = h->upper_count;
+    for (uint32_t l = 1; l <= n->level; ++l) {
+      upper(n->upper + l - 1)->count = 0;
+    }
+    h->upper_count += n->level;
+    Link(i);
+  }
+  h->dirty = 0;
+}
+
+uint32_t SimilarityIndex::Descend(const float* query, int bottom) const {
+  const Header* h = header();
+  uint32_t entry = h->entry;
+  for (int l = static_cast<int>(h->top_level); l > bottom; --l) {
+    entry = SearchLayer(query, entry, l, 1).front().second;
+  }
+  return entry;
+}
+
+std::vector<Candidate> SimilarityIndex::SearchLayer(const float* query,
+                                                    uint32_t entry,
+                                                    int level,
+                                                    int ef) const {
+  static thread_local VisitedSet visited;
+  const uint32_t count = header()->count;
+  visited.Reset(count);
+  visited.Insert(entry);
+
+  // Candidates still to expand, nearest on top, and the |ef| nearest
+  // entries found so far, furthest on top.
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>>
+      frontier;
+  std::priority_queue<Candidate> nearest;
+  const float distance = FeatureDistance(query, node(entry)->features);
+  frontier.emplace(distance, entry);
+  nearest.emplace(distance, entry);
+  while (!frontier.empty()) {
+    const Candidate current = frontier.top();
+    if (current.first > nearest.top().first &&
+        static_cast<int>(nearest.size()) >= ef) {
+      break;
+    }
+    frontier.pop();
+    uint32_t* link_count;
+    const uint32_t* links = Links(current.second, level, &link_count);
+    const uint32_t links_size = std::min<uint32_t>(
+        *link_count, level == 0 ? kBottomLinks : kLinks);
+    for (uint32_t i = 0; i < links_size; ++i) {
+      __builtin_prefetch(node(links[std::min(i + 1, links_size - 1)]));
+      const uint32_t next = links[i];
+      // Links past the end can only come from a damaged file.
+      if (next >= count || !visited.Insert(next)) {
+        continue;
+      }
+      const float d = FeatureDistance(query, node(next)->features);
+      if (static_cast<int>(nearest.size()) < ef || d < nearest.top().first) {
+        frontier.emplace(d, next);
+        nearest.emplace(d, next);
+        if (static_cast<int>(nearest.size()) > ef) {
+          nearest.pop();
+        }
+      }
+    }
+  }
+
+  std::vector<Candidate> result(nearest.size());
+  for (size_t i = result.size(); i-- > 0;) {
+    result[i] = nearest.top();
+    nearest.pop();
+  }
+  return result;
+}
+
+void SimilarityIndex::SelectNeighbours(std::vector<Candidate>* candidates,
+                                       int limit) const {
+  // Skipping candidates that an already kept neighbour is closer to keeps
+  // links pointing in different directions, which is what lets a greedy
+  // search cross between clusters.
+  std::vector<Candidate> kept;
+  kept.reserve(limit);
+  for (const Candidate& candidate : *candidates) {
+    if (static_cast<int>(kept.size()) >= limit) {
+      break;
+    }
+    const float* features = node(candidate.second)->features;
+    bool diverse = true;
+    for (const Candidate& other : kept) {
+      if (FeatureDistance(features, node(other.second)->features) <
+          candidate.first) {
+        diverse = false;
+        break;
+      }
+    }
+    if (diverse) {
+      kept.push_back(candidate);
+    }
+  }
+  candidates->swap(kept);
+}
+
+void SimilarityIndex::AddLink(uint32_t from, uint32_t to, int level) {
+  uint32_t* count;
+  uint32_t* links = Links(from, level, &count);
+  const uint32_t limit = level == 0 ? kBottomLinks : kLinks;
+  if (*count < limit) {
+    links[(*count)++] = to;
+    return;
+  }
+  const float* features = node(from)->features;
+  std::vector<Candidate> candidates;
+  candidates.reserve(limit + 1);
+  candidates.emplace_back(FeatureDistance(features, node(to)->features), to);
+  for (uint32_t i = 0; i < limit; ++i) {
+    candidates.emplace_back(
+        FeatureDistance(features, node(links[i])->features), links[i]);
+  }
+  std::sort(candidates.begin(), candidates.end());
+  SelectNeighbours(&candidates, limit);
+  *count = static_cast<uint32_t>(candidates.size());
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    links[i] = candidates[i].second;
+  }
+}
+
+std::vector<SimilarityMatch> SimilarityIndex::Search(const float* features,
+                                                     int count,
+                                                     int ef) const {
+  std::vector<SimilarityMatch> matches;
+  if (features == nullptr || count <= 0) {
+    return matches;
+  }
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  if (data_ == nullptr || header()->entry == kNone) {
+    return matches;
+  }
+  ef = std::max(ef > 0 ? ef : kDefaultEf, count);
+  const std::vector<Candidate> nearest =
+      SearchLayer(features, Descend(features, 0), 0, ef);
+  const size_t size = std::min<size_t>(count, nearest.size());
+  matches.resize(size);
+  for (size_t i = 0; i < size; ++i) {
+    matches[i].id = node(nearest[i].second)->id;
+    matches[i].distance = std::sqrt(nearest[i].first);
+  }
+  return matches;
+}
+
+int RunSimilaritySearch(const SimilaritySearchOptions& options) {
+  SimilarityIndex index;
+  OrbitaStatus status = index.Open(options.index.c_str(), false);
+  if (status != ORBITA_OK) {
+    fprintf(stderr, "orbita: cannot open index %s: %s\n",
+            options.index.c_str(), orbita_status_string(status));
+    return 1;
+  }
+  OrbitaSpectrumSummary summary;
+  AnalysisDetail detail;
+  status = AnalyzeFile(options.image.c_str(), options.params, &summary,
+                       nullptr, nullptr, &detail);
+  if (status != ORBITA_OK) {
+    fprintf(stderr, "orbita: cannot analyse %s: %s\n", options.image.c_str(),
+            orbita_status_string(status));
+    return 1;
+  }
+  float features[kSpectralFeatureSize];
+  SpectralFeatures(detail.spectrum, features);
+  for (const SimilarityMatch& match : index.Search(features, options.count)) {
+    std::string line = "{\"id\":";
+    AppendJsonString(&line, FormatImageId(match.id));
+    line += ",\"distance\":";
+    AppendJsonNumber(&line, match.distance);
+    line += "}\n";
+    fwrite(line.data(), 1, line.size(), stdout);
+  }
+  return 0;
+}
+
+}  // namespace orbita
@@ -0,0 +1,149 @@
+#ifndef ORBITA_NATIVE_SIMILARITY_INDEX_H_
+#define ORBITA_NATIVE_SIMILARITY_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// Length of a spectral feature vector.
+constexpr int kSpectralFeatureSize = 256;
+
+// The feature vector SimilarityIndex compares logograms by: |X[k]| / |X[0]|
+// of the ray profile's DFT for k = 1..256, taken from
+// AnalysisDetail::spectrum. Rotating a logogram only shifts its ray profile
+// round, which leaves the magnitudes alone, so rotated copies of one
+// logogram have the same features. Ray counts below 512 leave the bins they
+// lack at 0; an image without ink has all-zero features.
+void SpectralFeatures(const std::vector<double>& spectrum, float* out);
+
+// Squared Euclidean distance between two feature vectors.
+float FeatureDistance(const float* a, const float* b);
+
+// The id `orbita --analyze --index` files an image under: the XXH64 of its
+// encoded bytes, so the same image keeps its id wherever it is stored.
+uint64_t ImageId(const uint8_t* data, size_t size);
+
+// |id| as the 16 lower-case hex digits the JSON output carries.
+std::string FormatImageId(uint64_t id);
+
+struct SimilarityMatch {
+  uint64_t id = 0;
+  // Euclidean distance between the features.
+  float distance = 0;
+};
+
+// Persistent approximate nearest-neighbour index over spectral features: a
+// hierarchical navigable small world graph (HNSW, Malkov and Yashunin).
+//
+// The file is a header, a record per entry holding its id, features and
+// bottom-layer links, and the links of the few entries on upper layers. It
+// is memory-mapped and used in place, so opening a million-entry index
+// reads nothing until it is searched, and a search touches a few hundred
+// records. Inserts append a record and link it into the graph; the file
+// doubles when it fills up.
+//
+// One process may open the file for writing at a time, or any number for
+// reading. An index left half-written by a crash has its graph relinked
+// from the stored features the next time it is opened for writing; the
+// features themselves are never rewritten once stored.
+class SimilarityIndex {
+ public:
+  SimilarityIndex() = default;
+  ~SimilarityIndex();
+
+  SimilarityIndex(const SimilarityIndex&) = delete;
+  SimilarityIndex& operator=(const SimilarityIndex&) = delete;
+
+  // Opens the index at |path|, creating it if |writable|. Returns
+  // ORBITA_ERROR_IO if the file cannot be opened or another process holds
+  // it in a conflicting mode, and ORBITA_ERROR_DECODE if it is not an
+  // index.
+  OrbitaStatus Open(const char* path, bool writable);
+
+  size_t size() const;
+
+  // Adds |features| under |id|. An id already in the index keeps its
+  // features. Thread-safe; searches wait while an entry is linked in.
+  OrbitaStatus Insert(uint64_t id, const float* features);
+
+  // Up to |count| entries nearest to |features|, nearest first. |ef| is how
+  // many candidates the search keeps on the bottom layer, traded against
+  // recall; 0 picks max(count, 64). Thread-safe.
+  std::vector<SimilarityMatch> Search(const float* features,
+                                      int count,
+                                      int ef = 0) const;
+
+ private:
+  struct Header;
+  struct Node;
+  struct UpperLinks;
+
+  static size_t FileSize(uint32_t capacity, uint32_t upper_capacity);
+
+  Header* header() const;
+  Node* node(uint32_t index) const;
+  UpperLinks* upper(uint32_t block) const;
+  uint32_t* Links(uint32_t index, int level, uint32_t** count) const;
+
+  // Maps |size_| bytes of the file.
+  bool Map();
+  // Makes room for one more entry with |levels| upper layers.
+  bool Reserve(int levels);
+  void Link(uint32_t index);
+  // Links every entry again from scratch.
+  void Relink();
+  // Beam search of width |ef| over layer |level|, starting from |entry|.
+  // Returns (squared distance, entry) pairs, nearest first.
+  std::vector<std::pair<float, uint32_t>> SearchLayer(const float* query,
+                                                      uint32_t entry,
+                                                      int level,
+                                                      int ef) const;
+  // Where a search for |query| on layer |bottom| starts: the end of a
+  // greedy walk down the layers above it.
+  uint32_t Descend(const float* query, int bottom) const;
+  // Keeps at most |limit| of |candidates| (nearest first) that are not
+  // closer to an already kept one than to the entry they would link to.
+  void SelectNeighbours(std::vector<std::pair<float, uint32_t>>* candidates,
+                        int limit) const;
+  void AddLink(uint32_t from, uint32_t to, int level);
+
+  mutable std::shared_mutex mutex_;
+  int fd_ = -1;
+  bool writable_ = false;
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  // Entries by id, to keep inserts idempotent. Writable indexes only.
+  std::unordered_map<uint64_t, uint32_t> ids_;
+};
+
+// Options for `orbita --similar`.
+struct SimilaritySearchOptions {
+  // JPEG or PNG whose logogram to look for.
+  std::string image;
+  // SimilarityIndex file, as built by `orbita --analyze --index`.
+  std::string index;
+  // Matches to print.
+  int count = 10;
+  OrbitaAnalysisParams params;
+};
+
+// Analyses |options.image| and prints the entries of |options.index|
+// nearest to it as JSON Lines on stdout, nearest first:
+//
+//   {"id": ..., "distance": ...}
+//
+// Returns the process exit code: 0 on success, 1 if the image or index
+// cannot be read.
+int RunSimilaritySearch(const SimilaritySearchOptions& options);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_SIMILARITY_INDEX_H_
@@ -0,0 +1,261 @@
+#include "simplex_noise.h"
+
+#include <cmath>
+
+#include "simd.h"
+
+namespace orbita {
+
+namespace {
+
+constexpr double kF2 = 1.0 / 2.0;
+constexpr double kG2 = 1.0 / 4.0;
+constexpr uint32_t kXPrime = 1619;
+constexpr uint32_t kYPrime = 31337;
+constexpr uint32_t kHashMultiplier = 60493;
+
+alignas(32) constexpr double kGradX[8] = {-1, 1, -1, 1, 0, -1, 0, 1};
+alignas(32) constexpr double kGradY[8] = {-1, -1, 1, 1, -1, 0, 1, 0};
+
+// FastNoise's lattice hash. Only the low 16 bits of the product feed the
+// gradient index, so wrapping 32-bit arithmetic gives the same index as
+// Dart's 64-bit ints.
+inline int GradIndex(int32_t seed, int32_t x, int32_t y) {
+  uint32_t hash = static_cast<uint32_t>(seed);
+  hash ^= kXPrime * static_cast<uint32_t>(x);
+  hash ^= kYPrime * static_cast<uint32_t>(y);
+  hash = hash * hash * hash * kHashMultiplier;
+  hash = (hash >> 13) ^ hash;
+  return static_cast<int>(hash & 7);
+}
+
+inline double Corner(int32_t seed, int32_t i, int32_t j, double x, double y) {
+  double t = 0.5 - x * x - y * y;
+  if (t < 0) {
+    return 0;
+  }
+  t *= t;
+  const int g = GradIndex(seed, i, j);
+  return t * t * (x * kGradX[g] + y * kGradY[g]);
+}
+
+#if ORBITA_X86
+
+__attribute__((target("avx2"))) inline __m128i GradIndexAvx2(__m128i seed,
+                                                            __m128i x,
+                                                            __m128i y) {
+  __m128i hash = _mm_xor_si128(
+      seed, _mm_mullo_epi32(x, _mm_set1_epi32(static_cast<int>(kXPrime))));
+  hash = _mm_xor_si128(
+      hash, _mm_mullo_epi32(y, _mm_set1_epi32(static_cast<int>(kYPrime))));
+  const __m128i cube = _mm_mullo_epi32(_mm_mullo_epi32(hash, hash), hash);
+  hash = _mm_mullo_epi32(cube,
+                         _mm_set1_epi32(static_cast<int>(kHashMultiplier)));
+  hash = _mm_xor_si128(_mm_srli_epi32(hash, 13), hash);
+  return _mm_and_si128(hash, _mm_set1_epi32(7));
+}
+
+__attribute__((target("avx2"))) inline __m256d CornerAvx2(__m128i seed,
+                                                         __m128i i,
+                                                         __m128i j,
+                                                         __m256d x,
+                                                         __m256d y) {
+  __m256d t = _mm256_sub_pd(
+      _mm256_sub_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(x, x)),
+      _mm256_mul_pd(y, y));
+  const __m256d outside = _mm256_cmp_pd(t, _mm256_setzero_pd(), _CMP_LT_OQ);
+  t = _mm256_mul_pd(t, t);
+  const __m128i g = GradIndexAvx2(seed, i, j);
+  // The masked gather with an explicit zero source sidesteps GCC's
+  // maybe-uninitialized warning on the plain form.
+  const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  const __m256d gx =
+      _mm256_mask_i32gather_pd(_mm256_setzero_pd(), kGradX, g, all, 8);
+  const __m256d gy =
+      _mm256_mask_i32gather_pd(_mm256_setzero_pd(), kGradY, g, all, 8);
+  const __m256d grad =
+      _mm256_add_pd(_mm256_mul_pd(x, gx), _mm256_mul_pd(y, gy));
+  const __m256d n = _mm256_mul_pd(_mm256_mul_pd(t, t), grad);
+  return _mm256_andnot_pd(outside, n);
+}
+
+// Four points of SimplexNoise2, operation for operation.
+__attribute__((target("avx2"))) inline __m256d Simplex4Avx2(__m128i seed,
+                                                           __m256d frequency,
+                                                           __m256d x,
+                                                           __m256d y) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  x = _mm256_mul_pd(x, frequency);
+  y = _mm256_mul_pd(y, frequency);
+  __m256d t = _mm256_mul_pd(_mm256_add_pd(x, y), _mm256_set1_pd(kF2));
+  const __m256d fi = _mm256_floor_pd(_mm256_add_pd(x, t));
+  const __m256d fj = _mm256_floor_pd(_mm256_add_pd(y, t));
+  const __m128i i = _mm256_cvttpd_epi32(fi);
+  const __m128i j = _mm256_cvttpd_epi32(fj);
+  t = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_add_epi32(i, j)),
+                    _mm256_set1_pd(kG2));
+  const __m256d x0 = _mm256_sub_pd(x, _mm256_sub_pd(fi, t));
+  const __m256d y0 = _mm256_sub_pd(y, _mm256_sub_pd(fj, t));
+
+  const __m256d upper = _mm256_cmp_pd(x0, y0, _CMP_GT_OQ);
+  const __m256d i1 = _mm256_and_pd(upper, one);
+  const __m256d j1 = _mm256_andnot_pd(upper, one);
+  const __m256d f2 = _mm256_set1_pd(kF2);
+  const __m256d g2 = _mm256_set1_pd(kG2);
+  const __m256d x1 = _mm256_add_pd(_mm256_sub_pd(x0, i1), g2);
+  const __m256d y1 = _mm256_add_pd(_mm256_sub_pd(y0, j1), g2);
+  const __m256d x2 = _mm256_add_pd(_mm256_sub_pd(x0, one), f2);
+  const __m256d y2 = _mm256_add_pd(_mm256_sub_pd(y0, one), f2);
+
+  const __m128i ones = _mm_set1_epi32(1);
+  const __m256d n0 = CornerAvx2(seed, i, j, x0, y0);
+  const __m256d n1 =
+      CornerAvx2(seed, _mm_add_epi32(i, _mm256_cvttpd_epi32(i1)),
+                 _mm_add_epi32(j, _mm256_cvttpd_epi32(j1)), x1, y1);
+  const __m256d n2 = CornerAvx2(seed, _mm_add_epi32(i, ones),
+                                _mm_add_epi32(j, ones), x2, y2);
+  return _mm256_mul_pd(_mm256_set1_pd(50.0),
+                       _mm256_add_pd(_mm256_add_pd(n0, n1), n2));
+}
+
+__attribute__((target("avx2"))) int SimplexBatchAvx2(int32_t seed,
+                                                     double frequency,
+                                                     const double* x,
+                                                     const double* y,
+                                                     int count,
+                                                     double* out) {
+  const __m128i seeds = _mm_set1_epi32(seed);
+  const __m256d frequencies = _mm256_set1_pd(frequency);
+  int i = 0;
+  // Two independent vectors per iteration hide the gather latency.
+  for (; i + 8 <= count; i += 8) {
+    const __m256d a = Simplex4Avx2(seeds, frequencies, _mm256_loadu_pd(x + i),
+                                   _mm256_loadu_pd(y + i));
+    const __m256d b =
+        Simplex4Avx2(seeds, frequencies, _mm256_loadu_pd(x + i + 4),
+                     _mm256_loadu_pd(y + i + 4));
+    _mm256_storeu_pd(out + i, a);
+    _mm256_storeu_pd(out + i + 4, b);
+  }
+  for (; i + 4 <= count; i += 4) {
+    _mm256_storeu_pd(out + i,
+                     Simplex4Avx2(seeds, frequencies, _mm256_loadu_pd(x + i),
+                                  _mm256_loadu_pd(y + i)));
+  }
+  return i;
+}
+
+#elif ORBITA_NEON_F64
+
+inline float64x2_t CornerNeon(int32_t seed,
+                              int32x2_t i,
+                              int32x2_t j,
+                              float64x2_t x,
+                              float64x2_t y) {
+  float64x2_t t =
+      vsubq_f64(vsubq_f64(vdupq_n_f64(0.5), vmulq_f64(x, x)), vmulq_f64(y, y));
+  const uint64x2_t outside = vcltq_f64(t, vdupq_n_f64(0.0));
+  t = vmulq_f64(t, t);
+  const int g0 = GradIndex(seed, vget_lane_s32(i, 0), vget_lane_s32(j, 0));
+  const int g1 = GradIndex(seed, vget_lane_s32(i, 1), vget_lane_s32(j, 1));
+  const float64x2_t gx = {kGradX[g0], kGradX[g1]};
+  const float64x2_t gy = {kGradY[g0], kGradY[g1]};
+  const float64x2_t grad = vaddq_f64(vmulq_f64(x, gx), vmulq_f64(y, gy));
+  const float64x2_t n = vmulq_f64(vmulq_f64(t, t), grad);
+  return vreinterpretq_f64_u64(
+      vbicq_u64(vreinterpretq_u64_f64(n), outside));
+}
+
+float64x2_t Simplex2Neon(int32_t seed,
+                         float64x2_t frequency,
+                         float64x2_t x,
+                         float64x2_t y) {
+  const float64x2_t one = vdupq_n_f64(1.0);
+  x = vmulq_f64(x, frequency);
+  y = vmulq_f64(y, frequency);
+  float64x2_t t = vmulq_f64(vaddq_f64(x, y), vdupq_n_f64(kF2));
+  const float64x2_t fi = vrndmq_f64(vaddq_f64(x, t));
+  const float64x2_t fj = vrndmq_f64(vaddq_f64(y, t));
+  const int32x2_t i = vmovn_s64(vcvtq_s64_f64(fi));
+  const int32x2_t j = vmovn_s64(vcvtq_s64_f64(fj));
+  t = vmulq_f64(vcvtq_f64_s64(vmovl_s32(vadd_s32(i, j))), vdupq_n_f64(kG2));
+  const float64x2_t x0 = vsubq_f64(x, vsubq_f64(fi, t));
+  const float64x2_t y0 = vsubq_f64(y, vsubq_f64(fj, t));
+
+  const uint64x2_t upper = vcgtq_f64(x0, y0);
+  const float64x2_t i1 =
+      vreinterpretq_f64_u64(vandq_u64(upper, vreinterpretq_u64_f64(one)));
+  const float64x2_t j1 =
+      vreinterpretq_f64_u64(vbicq_u64(vreinterpretq_u64_f64(one), upper));
+  const float64x2_t x1 = vaddq_f64(vsubq_f64(x0, i1), vdupq_n_f64(kG2));
+  const float64x2_t y1 = vaddq_f64(vsubq_f64(y0, j1), vdupq_n_f64(kG2));
+  const float64x2_t x2 = vaddq_f64(vsubq_f64(x0, one), vdupq_n_f64(kF2));
+  const float64x2_t y2 = vaddq_f64(vsubq_f64(y0, one), vdupq_n_f64(kF2));
+
+  const int32x2_t ones = vdup_n_s32(1);
+  const float64x2_t n0 = CornerNeon(seed, i, j, x0, y0);
+  const float64x2_t n1 =
+      CornerNeon(seed, vadd_s32(i, vmovn_s64(vcvtq_s64_f64(i1))),
+                 vadd_s32(j, vmovn_s64(vcvtq_s64_f64(j1))), x1, y1);
+  const float64x2_t n2 =
+      CornerNeon(seed, vadd_s32(i, ones), vadd_s32(j, ones), x2, y2);
+  return vmulq_f64(vdupq_n_f64(50.0), vaddq_f64(vaddq_f64(n0, n1), n2));
+}
+
+#endif
+
+}  // namespace
+
+double SimplexNoise2(int32_t seed, double frequency, double x, double y) {
+  x *= frequency;
+  y *= frequency;
+  double t = (x + y) * kF2;
+  const int32_t i = static_cast<int32_t>(std::floor(x + t));
+  const int32_t j = static_cast<int32_t>(std::floor(y + t));
+
+  t = static_cast<double>(i + j) * kG2;
+  const double x0 = x - (i - t);
+  const double y0 = y - (j - t);
+
+  int32_t i1 = 0;
+  int32_t j1 = 1;
+  if (x0 > y0) {
+    i1 = 1;
+    j1 = 0;
+  }
+
+  const double x1 = x0 - i1 + kG2;
+  const double y1 = y0 - j1 + kG2;
+  const double x2 = x0 - 1 + kF2;
+  const double y2 = y0 - 1 + kF2;
+
+  const double n0 = Corner(seed, i, j, x0, y0);
+  const double n1 = Corner(seed, i + i1, j + j1, x1, y1);
+  const double n2 = Corner(seed, i + 1, j + 1, x2, y2);
+  return 50 * (n0 + n1 + n2);
+}
+
+void SimplexNoise2Batch(int32_t seed,
+                        double frequency,
+                        const double* x,
+                        const double* y,
+                        int count,
+                        double* out) {
+  int i = 0;
+#if ORBITA_X86
+  if (CpuHasAvx2()) {
+    i = SimplexBatchAvx2(seed, frequency, x, y, count, out);
+  }
+#elif ORBITA_NEON_F64
+  const float64x2_t frequencies = vdupq_n_f64(frequency);
+  for (; i + 2 <= count; i += 2) {
+    vst1q_f64(out + i, Simplex2Neon(seed, frequencies, vld1q_f64(x + i),
+                                    vld1q_f64(y + i)));
+  }
+#endif
+  for (; i < count; ++i) {
+    out[i] = SimplexNoise2(seed, frequency, x[i], y[i]);
+  }
+}
+
+}  // namespace orbita
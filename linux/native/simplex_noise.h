@@ -0,0 +1,33 @@
+#ifndef ORBITA_NATIVE_SIMPLEX_NOISE_H_
+#define ORBITA_NATIVE_SIMPLEX_NOISE_H_
+
+#include <cstdint>
+
+namespace orbita {
+
+// 2D simplex noise, bit-compatible with package:fast_noise's
+// SimplexNoise(seed: seed, frequency: frequency).getNoise2(x, y), which
+// HeptapodPainter uses for all of its geometry.
+//
+// fast_noise follows FastNoise: lattice gradients come from an integer hash
+// of the cell and seed rather than a permutation table, and the skew
+// factors are 1/2 and 1/4 rather than the textbook ones. Every
+// floating-point operation is done in double precision in the same order
+// as the Dart code (this file is built with -ffp-contract=off so nothing
+// is fused), so results match to the last bit for |x|, |y| * frequency
+// below 2^30.
+double SimplexNoise2(int32_t seed, double frequency, double x, double y);
+
+// out[i] = SimplexNoise2(seed, frequency, x[i], y[i]) for i < count.
+// AVX2 evaluates four points per instruction, two vectors at a time;
+// AArch64 NEON two per instruction.
+void SimplexNoise2Batch(int32_t seed,
+                        double frequency,
+                        const double* x,
+                        const double* y,
+                        int count,
+                        double* out);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_SIMPLEX_NOISE_H_
@@ -0,0 +1,422 @@
+#include "spectrum_archive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "parallel.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+constexpr char kArchiveMagic[8] = {'O', 'R', 'B', 'S', 'P', 'E', 'C', 'A'};
+constexpr uint32_t kArchiveVersion = 1;
+constexpr size_t kAlignment = 64;
+// Bytes of input parsed by one worker at a time.
+constexpr size_t kIngestChunkBytes = 1 << 20;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t spectrum_count;
+  uint64_t wave_count;
+  uint64_t shape_count;
+  uint64_t shape_bytes;
+  uint8_t reserved2[16];
+};
+
+static_assert(sizeof(Header) == kAlignment, "header must fill 64 bytes");
+
+size_t Align(size_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Where each column starts, from the counts in the header.
+struct Layout {
+  Layout(uint64_t spectrum_count,
+         uint64_t wave_count,
+         uint64_t shape_count,
+         uint64_t shape_bytes) {
+    layer_offsets = sizeof(Header);
+    source_lines = Align(layer_offsets +
+                         (SpectrumArchive::kLayerCount * spectrum_count + 1) *
+                             sizeof(uint64_t));
+    frequencies = Align(source_lines + spectrum_count * sizeof(uint64_t));
+    amplitudes = Align(frequencies + wave_count * sizeof(double));
+    chaos_factors = Align(amplitudes + wave_count * sizeof(double));
+    shapes = Align(chaos_factors + wave_count * sizeof(double));
+    shape_name_offsets = Align(shapes + wave_count * sizeof(uint32_t));
+    shape_names =
+        Align(shape_name_offsets + (shape_count + 1) * sizeof(uint32_t));
+    end = shape_names + shape_bytes;
+  }
+
+  size_t layer_offsets;
+  size_t source_lines;
+  size_t frequencies;
+  size_t amplitudes;
+  size_t chaos_factors;
+  size_t shapes;
+  size_t shape_name_offsets;
+  size_t shape_names;
+  size_t end;
+};
+
+// Writes |size| bytes at |data| at |offset| of |out|, padding with zeros
+// up to it.
+bool WriteAt(FILE* out, size_t offset, const void* data, size_t size) {
+  static const uint8_t kZeros[kAlignment] = {};
+  const long position = ftell(out);
+  if (position < 0 || static_cast<size_t>(position) > offset ||
+      fwrite(kZeros, 1, offset - position, out) != offset - position) {
+    return false;
+  }
+  return size == 0 || fwrite(data, 1, size, out) == size;
+}
+
+// Spectra parsed from one chunk of the input.
+struct IngestChunk {
+  size_t begin = 0;
+  size_t end = 0;
+  uint64_t lines = 0;
+  uint64_t malformed = 0;
+  // Line within the chunk, from 1, of the first malformed line.
+  uint64_t first_malformed = 0;
+  SpectrumArchiveWriter spectra;
+};
+
+void IngestLines(const char* text, IngestChunk* chunk) {
+  for (size_t start = chunk->begin; start < chunk->end;) {
+    const char* newline = static_cast<const char*>(
+        memchr(text + start, '\n', chunk->end - start));
+    const size_t stop = newline == nullptr ? chunk->end : newline - text;
+    const size_t length = stop - start;
+    ++chunk->lines;
+    HeptapodSpectrum spectrum;
+    if (ParseLenientSpectrumJson(text + start, length, &spectrum)) {
+      chunk->spectra.Add(spectrum, chunk->lines);
+    } else if (std::any_of(text + start, text + stop, [](char c) {
+                 return c != ' ' && c != '\t' && c != '\r';
+               })) {
+      if (chunk->malformed++ == 0) {
+        chunk->first_malformed = chunk->lines;
+      }
+    }
+    start = stop + 1;
+  }
+}
+
+}  // namespace
+
+OrbitaStatus SpectrumArchive::Open(const char* path) {
+  if (!file_.Open(path)) {
+    return ORBITA_ERROR_IO;
+  }
+  const uint8_t* data = file_.data();
+  const size_t size = file_.size();
+  Header header;
+  if (size < sizeof(header)) {
+    return ORBITA_ERROR_DECODE;
+  }
+  memcpy(&header, data, sizeof(header));
+  // Each count is bounded by the file size first, so the layout cannot
+  // overflow.
+  if (memcmp(header.magic, kArchiveMagic, sizeof(kArchiveMagic)) != 0 ||
+      header.version != kArchiveVersion ||
+      header.spectrum_count > size / sizeof(uint64_t) ||
+      header.wave_count > size / sizeof(uint64_t) ||
+      header.shape_count > size / sizeof(uint32_t) ||
+      header.shape_bytes > size) {
+    return ORBITA_ERROR_DECODE;
+  }
+  const Layout layout(header.spectrum_count, header.wave_count,
+                      header.shape_count, header.shape_bytes);
+  if (layout.end > size) {
+    return ORBITA_ERROR_DECODE;
+  }
+
+  const uint64_t* offsets =
+      reinterpret_cast<const uint64_t*>(data + layout.layer_offsets);
+  const size_t offset_count = kLayerCount * header.spectrum_count + 1;
+  if (offsets[0] != 0 || offsets[offset_count - 1] != header.wave_count) {
+    return ORBITA_ERROR_DECODE;
+  }
+  for (size_t i = 1; i < offset_count; ++i) {
+    if (offsets[i] < offsets[i - 1]) {
+      return ORBITA_ERROR_DECODE;
+    }
+  }
+  const uint32_t* shapes =
+      reinterpret_cast<const uint32_t*>(data + layout.shapes);
+  for (size_t i = 0; i < header.wave_count; ++i) {
+    if (shapes[i] >= header.shape_count) {
+      return ORBITA_ERROR_DECODE;
+    }
+  }
+  const uint32_t* name_offsets =
+      reinterpret_cast<const uint32_t*>(data + layout.shape_name_offsets);
+  const char* names =
+      reinterpret_cast<const char*>(data + layout.shape_names);
+  shape_names_.clear();
+  for (size_t i = 0; i < header.shape_count; ++i) {
+    if (name_offsets[i] > name_offsets[i + 1] ||
+        name_offsets[i + 1] > header.shape_bytes) {
+      return ORBITA_ERROR_DECODE;
+    }
+    shape_names_.emplace_back(names + name_offsets[i],
+                              name_offsets[i + 1] - name_offsets[i]);
+  }
+
+  spectrum_count_ = header.spectrum_count;
+  wave_count_ = header.wave_count;
+  layer_offsets_ = offsets;
+  source_lines_ =
+      reinterpret_cast<const uint64_t*>(data + layout.source_lines);
+  frequencies_ = reinterpret_cast<const double*>(data + layout.frequencies);
+  amplitudes_ = reinterpret_cast<const double*>(data + layout.amplitudes);
+  chaos_factors_ =
+      reinterpret_cast<const double*>(data + layout.chaos_factors);
+  shapes_ = shapes;
+  return ORBITA_OK;
+}
+
+void SpectrumArchive::Get(size_t index, HeptapodSpectrum* out) const {
+  std::vector<WaveLayer>* layers[kLayerCount] = {
+      &out->core, &out->narrative, &out->nuance};
+  for (int layer = 0; layer < kLayerCount; ++layer) {
+    const uint64_t* offsets = layer_offsets_ + kLayerCount * index + layer;
+    std::vector<WaveLayer>& waves = *layers[layer];
+    waves.clear();
+    for (uint64_t w = offsets[0]; w < offsets[1]; ++w) {
+      WaveLayer wave;
+      wave.frequency = frequencies_[w];
+      wave.amplitude = amplitudes_[w];
+      wave.shape_type = shape_names_[shapes_[w]];
+      wave.chaos_factor = chaos_factors_[w];
+      waves.push_back(std::move(wave));
+    }
+  }
+}
+
+SpectrumArchiveWriter::SpectrumArchiveWriter() : layer_offsets_(1, 0) {}
+
+uint32_t SpectrumArchiveWriter::ShapeIndex(const std::string& name) {
+  const auto found = shape_indices_.find(name);
+  if (found != shape_indices_.end()) {
+    return found->second;
+  }
+  const uint32_t index = static_cast<uint32_t>(shape_names_.size());
+  shape_indices_.emplace(name, index);
+  shape_names_.push_back(name);
+  return index;
+}
+
+void SpectrumArchiveWriter::Add(const HeptapodSpectrum& spectrum,
+                                uint64_t source_line) {
+  for (const std::vector<WaveLayer>* layer :
+       {&spectrum.core, &spectrum.narrative, &spectrum.nuance}) {
+    for (const WaveLayer& wave : *layer) {
+      frequencies_.push_back(wave.frequency);
+      amplitudes_.push_back(wave.amplitude);
+      chaos_factors_.push_back(wave.chaos_factor);
+      shapes_.push_back(ShapeIndex(wave.shape_type));
+    }
+    layer_offsets_.push_back(frequencies_.size());
+  }
+  source_lines_.push_back(source_line);
+}
+
+void SpectrumArchiveWriter::Append(const SpectrumArchiveWriter& other,
+                                   uint64_t line_offset) {
+  const uint64_t wave_base = frequencies_.size();
+  for (size_t i = 1; i < other.layer_offsets_.size(); ++i) {
+    layer_offsets_.push_back(wave_base + other.layer_offsets_[i]);
+  }
+  for (const uint64_t line : other.source_lines_) {
+    source_lines_.push_back(line_offset + line);
+  }
+  frequencies_.insert(frequencies_.end(), other.frequencies_.begin(),
+                      other.frequencies_.end());
+  amplitudes_.insert(amplitudes_.end(), other.amplitudes_.begin(),
+                     other.amplitudes_.end());
+  chaos_factors_.insert(chaos_factors_.end(), other.chaos_factors_.begin(),
+                        other.chaos_factors_.end());
+  std::vector<uint32_t> remap(other.shape_names_.size());
+  for (size_t i = 0; i < remap.size(); ++i) {
+    remap[i] = ShapeIndex(other.shape_names_[i]);
+  }
+  for (const uint32_t shape : other.shapes_) {
+    shapes_.push_back(remap[shape]);
+  }
+}
+
+bool SpectrumArchiveWriter::Write(const std::string& path) const {
+  std::vector<uint32_t> name_offsets(1, 0);
+  std::string names;
+  for (const std::string& name : shape_names_) {
+    names += name;
+    name_offsets.push_back(static_cast<uint32_t>(names.size()));
+  }
+  Header header = {};
+  memcpy(header.magic, kArchiveMagic, sizeof(kArchiveMagic));
+  header.version = kArchiveVersion;
+  header.spectrum_count = source_lines_.size();
+  header.wave_count = frequencies_.size();
+  header.shape_count = shape_names_.size();
+  header.shape_bytes = names.size();
+  const Layout layout(header.spectrum_count, header.wave_count,
+                      header.shape_count, header.shape_bytes);
+
+  const std::string partial = path + ".partial";
+  FILE* out = fopen(partial.c_str(), "wb");
+  if (out == nullptr) {
+    return false;
+  }
+  const size_t waves = frequencies_.size();
+  bool written =
+      WriteAt(out, 0, &header, sizeof(header)) &&
+      WriteAt(out, layout.layer_offsets, layer_offsets_.data(),
+              layer_offsets_.size() * sizeof(uint64_t)) &&
+      WriteAt(out, layout.source_lines, source_lines_.data(),
+              source_lines_.size() * sizeof(uint64_t)) &&
+      WriteAt(out, layout.frequencies, frequencies_.data(),
+              waves * sizeof(double)) &&
+      WriteAt(out, layout.amplitudes, amplitudes_.data(),
+              waves * sizeof(double)) &&
+      WriteAt(out, layout.chaos_factors, chaos_factors_.data(),
+              waves * sizeof(double)) &&
+      WriteAt(out, layout.shapes, shapes_.data(),
+              waves * sizeof(uint32_t)) &&
+      WriteAt(out, layout.shape_name_offsets, name_offsets.data(),
+              name_offsets.size() * sizeof(uint32_t)) &&
+      WriteAt(out, layout.shape_names, names.data(), names.size());
+  written = fclose(out) == 0 && written;
+  if (!written || rename(partial.c_str(), path.c_str()) != 0) {
+    remove(partial.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ReadSpectra(const std::string& path,
+                 std::vector<HeptapodSpectrum>* out,
+                 std::vector<uint64_t>* lines) {
+  SpectrumArchive archive;
+  if (archive.Open(path.c_str()) == ORBITA_OK) {
+    out->resize(archive.size());
+    for (size_t i = 0; i < archive.size(); ++i) {
+      archive.Get(i, &(*out)[i]);
+    }
+    if (lines != nullptr) {
+      lines->assign(archive.source_lines(),
+                    archive.source_lines() + archive.size());
+    }
+    if (out->empty()) {
+      fprintf(stderr, "orbita: %s holds no spectra\n", path.c_str());
+      return false;
+    }
+    return true;
+  }
+  MappedFile file;
+  if (!file.Open(path.c_str())) {
+    fprintf(stderr, "orbita: cannot read %s: %s\n", path.c_str(),
+            strerror(errno));
+    return false;
+  }
+  const char* text = reinterpret_cast<const char*>(file.data());
+  uint64_t line = 0;
+  for (size_t start = 0; start < file.size();) {
+    const char* end = static_cast<const char*>(
+        memchr(text + start, '\n', file.size() - start));
+    const size_t stop = end == nullptr ? file.size() : end - text;
+    ++line;
+    const char* json = text + start;
+    const size_t length = stop - start;
+    start = stop + 1;
+    if (std::all_of(json, json + length, [](char c) {
+          return c == ' ' || c == '\t' || c == '\r';
+        })) {
+      continue;
+    }
+    HeptapodSpectrum spectrum;
+    if (!ParseLenientSpectrumJson(json, length, &spectrum)) {
+      fprintf(stderr, "orbita: %s:%llu is not a spectrum\n", path.c_str(),
+              static_cast<unsigned long long>(line));
+      return false;
+    }
+    out->push_back(std::move(spectrum));
+    if (lines != nullptr) {
+      lines->push_back(line);
+    }
+  }
+  if (out->empty()) {
+    fprintf(stderr, "orbita: %s holds no spectra\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+int RunSpectrumIngest(const SpectrumIngestOptions& options) {
+  const auto start = std::chrono::steady_clock::now();
+  MappedFile file;
+  if (!file.Open(options.input.c_str())) {
+    fprintf(stderr, "orbita: cannot read %s: %s\n", options.input.c_str(),
+            strerror(errno));
+    return 1;
+  }
+  const char* text = reinterpret_cast<const char*>(file.data());
+
+  // Chunks end just after a newline, so no line spans two.
+  std::vector<IngestChunk> chunks;
+  for (size_t begin = 0; begin < file.size();) {
+    size_t end = std::min(begin + kIngestChunkBytes, file.size());
+    const char* newline = static_cast<const char*>(
+        memchr(text + end - 1, '\n', file.size() - (end - 1)));
+    end = newline == nullptr ? file.size() : newline - text + 1;
+    chunks.emplace_back();
+    chunks.back().begin = begin;
+    chunks.back().end = end;
+    begin = end;
+  }
+  ParallelFor(static_cast<int>(chunks.size()), [&](int i) {
+    ORBITA_TRACE_SPAN("ingest.chunk");
+    IngestLines(text, &chunks[i]);
+  });
+
+  SpectrumArchiveWriter archive;
+  uint64_t lines = 0;
+  uint64_t malformed = 0;
+  for (const IngestChunk& chunk : chunks) {
+    if (chunk.malformed > 0 && malformed == 0) {
+      fprintf(stderr, "orbita: %s:%llu is not a spectrum\n",
+              options.input.c_str(),
+              static_cast<unsigned long long>(lines + chunk.first_malformed));
+    }
+    archive.Append(chunk.spectra, lines);
+    lines += chunk.lines;
+    malformed += chunk.malformed;
+  }
+  if (!archive.Write(options.output)) {
+    fprintf(stderr, "orbita: cannot write %s: %s\n", options.output.c_str(),
+            strerror(errno));
+    return 1;
+  }
+
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  fprintf(stderr,
+          "orbita: archived %zu spectra (%llu malformed lines skipped) in "
+          "%.2f s (%.0f MB/s)\n",
+          archive.size(), static_cast<unsigned long long>(malformed),
+          seconds, file.size() / 1e6 / std::max(seconds, 1e-9));
+  return 0;
+}
+
+}  // namespace orbita
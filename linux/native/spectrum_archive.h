@@ -0,0 +1,144 @@
+#ifndef ORBITA_NATIVE_SPECTRUM_ARCHIVE_H_
+#define ORBITA_NATIVE_SPECTRUM_ARCHIVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+#include "orbita_native.h"
+#include "spectrum_json.h"
+
+namespace orbita {
+
+// A collection of spectra stored column by column, so renderers and
+// analytics can scan millions of them without parsing a record each.
+//
+// The file is a 64-byte header
+//
+//   char magic[8] = "ORBSPECA"; uint32 version = 1; uint32 reserved;
+//   uint64 spectrum_count, wave_count, shape_count, shape_bytes;
+//   16 bytes reserved
+//
+// followed by these columns, each starting on a multiple of 64 bytes:
+//
+//   uint64 layer_offsets[3 * spectrum_count + 1]
+//   uint64 source_lines[spectrum_count]
+//   double frequencies[wave_count]
+//   double amplitudes[wave_count]
+//   double chaos_factors[wave_count]
+//   uint32 shapes[wave_count]
+//   uint32 shape_name_offsets[shape_count + 1]
+//   char shape_names[shape_bytes]
+//
+// Layer l of spectrum i (0 core, 1 narrative, 2 nuance) is waves
+// layer_offsets[3 * i + l] up to layer_offsets[3 * i + l + 1] of the wave
+// columns. A wave's shapeType is shape name shapes[w], the bytes from
+// shape_name_offsets[shapes[w]] up to the next offset. Numbers are
+// little-endian.
+class SpectrumArchive {
+ public:
+  // Layers in the order layer_offsets() runs through them.
+  static constexpr int kLayerCount = 3;
+
+  SpectrumArchive() = default;
+
+  SpectrumArchive(const SpectrumArchive&) = delete;
+  SpectrumArchive& operator=(const SpectrumArchive&) = delete;
+
+  // Maps the archive at |path|. Returns ORBITA_ERROR_IO if it cannot be
+  // read and ORBITA_ERROR_DECODE if it is not an archive or is corrupt.
+  // The offsets and shape indices are checked here, so the columns can be
+  // scanned without bounds checks.
+  OrbitaStatus Open(const char* path);
+
+  size_t size() const { return spectrum_count_; }
+  size_t wave_count() const { return wave_count_; }
+
+  const uint64_t* layer_offsets() const { return layer_offsets_; }
+  // Line of the ingested JSON Lines file each spectrum came from, from 1.
+  const uint64_t* source_lines() const { return source_lines_; }
+  const double* frequencies() const { return frequencies_; }
+  const double* amplitudes() const { return amplitudes_; }
+  const double* chaos_factors() const { return chaos_factors_; }
+  // Each wave's index into shape_names().
+  const uint32_t* shapes() const { return shapes_; }
+  const std::vector<std::string>& shape_names() const {
+    return shape_names_;
+  }
+
+  // Spectrum |index| as a HeptapodSpectrum.
+  void Get(size_t index, HeptapodSpectrum* out) const;
+
+ private:
+  MappedFile file_;
+  size_t spectrum_count_ = 0;
+  size_t wave_count_ = 0;
+  const uint64_t* layer_offsets_ = nullptr;
+  const uint64_t* source_lines_ = nullptr;
+  const double* frequencies_ = nullptr;
+  const double* amplitudes_ = nullptr;
+  const double* chaos_factors_ = nullptr;
+  const uint32_t* shapes_ = nullptr;
+  std::vector<std::string> shape_names_;
+};
+
+// Builds a SpectrumArchive in memory and writes it out.
+class SpectrumArchiveWriter {
+ public:
+  SpectrumArchiveWriter();
+
+  size_t size() const { return source_lines_.size(); }
+
+  void Add(const HeptapodSpectrum& spectrum, uint64_t source_line);
+
+  // Adds every spectrum of |other| after this one's, adding |line_offset|
+  // to their source lines.
+  void Append(const SpectrumArchiveWriter& other, uint64_t line_offset);
+
+  // Writes the archive to |path|, replacing it only once it is complete.
+  bool Write(const std::string& path) const;
+
+ private:
+  uint32_t ShapeIndex(const std::string& name);
+
+  std::vector<uint64_t> layer_offsets_;
+  std::vector<uint64_t> source_lines_;
+  std::vector<double> frequencies_;
+  std::vector<double> amplitudes_;
+  std::vector<double> chaos_factors_;
+  std::vector<uint32_t> shapes_;
+  std::vector<std::string> shape_names_;
+  std::unordered_map<std::string, uint32_t> shape_indices_;
+};
+
+// Reads every spectrum of the SpectrumArchive at |path|, or one per
+// non-empty line if it is a JSON Lines file in the dialect
+// ParseLenientSpectrumJson() reads. If |lines| is not null, it receives the
+// line of the JSON Lines file each spectrum came from, counting from 1.
+// Reports failures, including a malformed line or no spectra at all, on
+// stderr and returns false.
+bool ReadSpectra(const std::string& path,
+                 std::vector<HeptapodSpectrum>* out,
+                 std::vector<uint64_t>* lines);
+
+// Options for `orbita --ingest`.
+struct SpectrumIngestOptions {
+  // JSON Lines file with a spectrum per line, in the dialect
+  // ParseLenientSpectrumJson() reads.
+  std::string input;
+  // SpectrumArchive to write.
+  std::string output;
+};
+
+// Parses |options.input| on all cores and writes its spectra to
+// |options.output|. Lines that are not spectra are skipped and counted.
+// Returns the process exit code: 0 on success, 1 if the input cannot be
+// read or the archive cannot be written.
+int RunSpectrumIngest(const SpectrumIngestOptions& options);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_SPECTRUM_ARCHIVE_H_
@@ -0,0 +1,504 @@
+#include "spectrum_json.h"
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+#include "simd.h"
+
+namespace orbita {
+
+namespace {
+
+// Deepest nesting skipped inside ignored values.
+constexpr int kMaxDepth = 64;
+// Longest number token parsed; JSON numbers any longer carry digits a
+// double cannot hold anyway.
+constexpr size_t kMaxNumberLength = 63;
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else if (code_point < 0x10000) {
+    out->push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else {
+    out->push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+}
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsNumberChar(char c) {
+  return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' ||
+         c == 'e' || c == 'E';
+}
+
+// Length of the run of whitespace at the start of the |size| bytes at
+// |text|. Pretty-printed spectra indent every line, so runs are often
+// longer than a byte or two.
+size_t SpaceRun(const char* text, size_t size) {
+  size_t i = 0;
+#if ORBITA_X86
+  for (; i + 16 <= size; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    const __m128i space = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+    const unsigned other = ~_mm_movemask_epi8(space) & 0xffff;
+    if (other != 0) {
+      return i + __builtin_ctz(other);
+    }
+  }
+#elif ORBITA_NEON
+  for (; i + 16 <= size; i += 16) {
+    const uint8x16_t bytes =
+        vld1q_u8(reinterpret_cast<const uint8_t*>(text + i));
+    const uint8x16_t space =
+        vorrq_u8(vorrq_u8(vceqq_u8(bytes, vdupq_n_u8(' ')),
+                          vceqq_u8(bytes, vdupq_n_u8('\t'))),
+                 vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\n')),
+                          vceqq_u8(bytes, vdupq_n_u8('\r'))));
+    // Four bits per byte, set where the byte is not whitespace.
+    const uint64_t other = ~vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(space), 4)), 0);
+    if (other != 0) {
+      return i + __builtin_ctzll(other) / 4;
+    }
+  }
+#endif
+  while (i < size && IsSpace(text[i])) {
+    ++i;
+  }
+  return i;
+}
+
+// Length of the run of plain characters at the start of the |size| bytes
+// at |text|: up to the first |quote|, backslash or control character.
+size_t StringRun(const char* text, size_t size, char quote) {
+  size_t i = 0;
+#if ORBITA_X86
+  for (; i + 16 <= size; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    const __m128i control =
+        _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(0x1f)), bytes);
+    const __m128i special = _mm_or_si128(
+        control, _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(quote)),
+                              _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))));
+    const unsigned mask = _mm_movemask_epi8(special);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#elif ORBITA_NEON
+  for (; i + 16 <= size; i += 16) {
+    const uint8x16_t bytes =
+        vld1q_u8(reinterpret_cast<const uint8_t*>(text + i));
+    const uint8x16_t special = vorrq_u8(
+        vcltq_u8(bytes, vdupq_n_u8(0x20)),
+        vorrq_u8(vceqq_u8(bytes, vdupq_n_u8(static_cast<uint8_t>(quote))),
+                 vceqq_u8(bytes, vdupq_n_u8('\\'))));
+    const uint64_t mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(special), 4)),
+        0);
+    if (mask != 0) {
+      return i + __builtin_ctzll(mask) / 4;
+    }
+  }
+#endif
+  while (i < size && text[i] != quote && text[i] != '\\' &&
+         static_cast<unsigned char>(text[i]) >= 0x20) {
+    ++i;
+  }
+  return i;
+}
+
+// Parses the |size|-byte number token at |text| into |out|.
+//
+// Most spectrum numbers are short decimals like 0.35, which are exact as a
+// whole number of at most 2^53 and a power of ten of at most 10^22; one
+// division of the two then rounds exactly as strtod() would. Anything else
+// goes to strtod_l() in the C locale, independent of the process locale,
+// which GTK sets from the environment.
+bool ParseNumber(const char* text, size_t size, double* out) {
+  static const double kPowersOfTen[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  size_t i = 0;
+  const bool negative = size > 0 && text[0] == '-';
+  i += negative;
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int decimals = -1;
+  for (; i < size; ++i) {
+    if (text[i] >= '0' && text[i] <= '9') {
+      mantissa = mantissa * 10 + (text[i] - '0');
+      digits += mantissa != 0;
+      decimals += decimals >= 0;
+    } else if (text[i] == '.' && decimals < 0) {
+      decimals = 0;
+    } else {
+      break;
+    }
+  }
+  const bool whole = i > static_cast<size_t>(negative) && i == size &&
+                     text[i - 1] != '.' && text[negative] != '.';
+  if (whole && digits <= 15 && decimals <= 22) {
+    const double value = static_cast<double>(mantissa) /
+                         kPowersOfTen[std::max(decimals, 0)];
+    *out = negative ? -value : value;
+    return true;
+  }
+
+  if (size == 0 || size > kMaxNumberLength) {
+    return false;
+  }
+  static const locale_t c_locale =
+      newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+  char token[kMaxNumberLength + 1];
+  memcpy(token, text, size);
+  token[size] = '\0';
+  char* end;
+  *out = strtod_l(token, &end, c_locale);
+  return end == token + size;
+}
+
+// Recursive-descent reader for the few shapes of JSON a spectrum uses.
+// Every method skips leading whitespace and returns false on malformed
+// input. |lenient| also takes strings in single quotes.
+class SpectrumReader {
+ public:
+  SpectrumReader(const char* text, size_t size, bool lenient)
+      : text_(text), size_(size), lenient_(lenient) {}
+
+  bool Read(HeptapodSpectrum* out) {
+    const bool parsed = Object([this, out](const std::string& key) {
+      if (key == "core") {
+        return Layer(&out->core);
+      }
+      if (key == "narrative") {
+        return Layer(&out->narrative);
+      }
+      if (key == "nuance") {
+        return Layer(&out->nuance);
+      }
+      return SkipValue(0);
+    });
+    SkipSpace();
+    return parsed && pos_ == size_;
+  }
+
+  // Reads text that is all one double-quoted string.
+  bool ReadString(std::string* out) {
+    const bool parsed = String(out);
+    SkipSpace();
+    return parsed && pos_ == size_;
+  }
+
+ private:
+  void SkipSpace() {
+    if (pos_ < size_ && IsSpace(text_[pos_])) {
+      pos_ += SpaceRun(text_ + pos_, size_ - pos_);
+    }
+  }
+
+  bool Consume(char c) {
+    SkipSpace();
+    if (pos_ < size_ && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  char Peek() {
+    SkipSpace();
+    return pos_ < size_ ? text_[pos_] : '\0';
+  }
+
+  // Calls |on_key| with the key of each member, positioned at its value,
+  // which |on_key| must read.
+  template <typename OnKey>
+  bool Object(OnKey on_key) {
+    if (!Consume('{')) {
+      return false;
+    }
+    if (Consume('}')) {
+      return true;
+    }
+    std::string key;
+    do {
+      if (!String(&key) || !Consume(':') || !on_key(key)) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  bool Layer(std::vector<WaveLayer>* out) {
+    out->clear();
+    if (Peek() == 'n') {
+      // A null layer is empty, as in HeptapodSpectrum.fromJson.
+      return Literal("null");
+    }
+    if (!Consume('[')) {
+      return false;
+    }
+    if (Consume(']')) {
+      return true;
+    }
+    do {
+      WaveLayer wave;
+      if (!Wave(&wave)) {
+        return false;
+      }
+      out->push_back(wave);
+    } while (Consume(','));
+    return Consume(']');
+  }
+
+  bool Wave(WaveLayer* out) {
+    bool has_frequency = false;
+    bool has_amplitude = false;
+    const bool parsed = Object([&](const std::string& key) {
+      if (key == "freq") {
+        has_frequency = true;
+        return Number(&out->frequency);
+      }
+      if (key == "amp") {
+        has_amplitude = true;
+        return Number(&out->amplitude);
+      }
+      if (key == "shapeType") {
+        return Peek() == 'n' ? Literal("null") : String(&out->shape_type);
+      }
+      if (key == "chaosFactor") {
+        return Peek() == 'n' ? Literal("null") : Number(&out->chaos_factor);
+      }
+      return SkipValue(0);
+    });
+    return parsed && has_frequency && has_amplitude;
+  }
+
+  bool String(std::string* out) {
+    const char quote = Peek();
+    if (quote != '"' && !(lenient_ && quote == '\'')) {
+      return false;
+    }
+    ++pos_;
+    out->clear();
+    while (pos_ < size_) {
+      const size_t run = StringRun(text_ + pos_, size_ - pos_, quote);
+      out->append(text_ + pos_, run);
+      pos_ += run;
+      if (pos_ >= size_) {
+        return false;
+      }
+      const char c = text_[pos_++];
+      if (c == quote) {
+        return true;
+      }
+      if (c != '\\' || pos_ >= size_) {
+        return false;
+      }
+      const char escape = text_[pos_++];
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          out->push_back(escape);
+          break;
+        case '\'':
+          if (!lenient_) {
+            return false;
+          }
+          out->push_back(escape);
+          break;
+        case 'b':
+          out->push_back('\b');
+          break;
+        case 'f':
+          out->push_back('\f');
+          break;
+        case 'n':
+          out->push_back('\n');
+          break;
+        case 'r':
+          out->push_back('\r');
+          break;
+        case 't':
+          out->push_back('\t');
+          break;
+        case 'u': {
+          uint32_t code_point;
+          if (!Hex4(&code_point)) {
+            return false;
+          }
+          uint32_t low;
+          if (code_point >= 0xd800 && code_point < 0xdc00 &&
+              pos_ + 2 <= size_ && text_[pos_] == '\\' &&
+              text_[pos_ + 1] == 'u') {
+            pos_ += 2;
+            if (!Hex4(&low) || low < 0xdc00 || low >= 0xe000) {
+              return false;
+            }
+            code_point = 0x10000 + ((code_point - 0xd800) << 10) +
+                         (low - 0xdc00);
+          }
+          AppendUtf8(code_point, out);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool Hex4(uint32_t* out) {
+    if (pos_ + 4 > size_) {
+      return false;
+    }
+    *out = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = text_[pos_++];
+      uint32_t digit;
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+      } else {
+        return false;
+      }
+      *out = *out * 16 + digit;
+    }
+    return true;
+  }
+
+  bool Number(double* out) {
+    SkipSpace();
+    const size_t start = pos_;
+    while (pos_ < size_ && IsNumberChar(text_[pos_])) {
+      ++pos_;
+    }
+    return ParseNumber(text_ + start, pos_ - start, out);
+  }
+
+  bool Literal(const char* literal) {
+    SkipSpace();
+    const size_t length = strlen(literal);
+    if (size_ - pos_ < length || memcmp(text_ + pos_, literal, length) != 0) {
+      return false;
+    }
+    pos_ += length;
+    return true;
+  }
+
+  bool SkipValue(int depth) {
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    std::string ignored;
+    double number;
+    switch (Peek()) {
+      case '{':
+        return Object([this, depth](const std::string&) {
+          return SkipValue(depth + 1);
+        });
+      case '[':
+        ++pos_;
+        if (Consume(']')) {
+          return true;
+        }
+        do {
+          if (!SkipValue(depth + 1)) {
+            return false;
+          }
+        } while (Consume(','));
+        return Consume(']');
+      case '"':
+      case '\'':
+        return String(&ignored);
+      case 't':
+        return Literal("true");
+      case 'f':
+        return Literal("false");
+      case 'n':
+        return Literal("null");
+      default:
+        return Number(&number);
+    }
+  }
+
+  const char* text_;
+  size_t size_;
+  bool lenient_;
+  size_t pos_ = 0;
+};
+
+}  // namespace
+
+bool ParseSpectrumJson(const std::string& text, HeptapodSpectrum* out) {
+  *out = HeptapodSpectrum();
+  return SpectrumReader(text.data(), text.size(), false).Read(out);
+}
+
+bool ParseLenientSpectrumJson(const char* text,
+                              size_t size,
+                              HeptapodSpectrum* out) {
+  const size_t space = SpaceRun(text, size);
+  if (space < size && text[space] == '"') {
+    std::string quoted;
+    return SpectrumReader(text, size, false).ReadString(&quoted) &&
+           ParseLenientSpectrumJson(quoted.data(), quoted.size(), out);
+  }
+  // Keep what is inside a ```json fence, up to the closing one.
+  const char* fence =
+      static_cast<const char*>(memmem(text, size, "```", 3));
+  if (fence != nullptr) {
+    const char* end = text + size;
+    const char* body = fence + 3;
+    while (body < end && isalpha(static_cast<unsigned char>(*body))) {
+      ++body;
+    }
+    const char* close =
+        static_cast<const char*>(memmem(body, end - body, "```", 3));
+    text = body;
+    size = (close == nullptr ? end : close) - body;
+  }
+  *out = HeptapodSpectrum();
+  return SpectrumReader(text, size, true).Read(out);
+}
+
+OrbitaLogogramShape ShapeOf(const HeptapodSpectrum& spectrum) {
+  OrbitaLogogramShape shape = {};
+  for (const WaveLayer& wave : spectrum.core) {
+    shape.core_amplitude += wave.amplitude;
+  }
+  for (const WaveLayer& wave : spectrum.nuance) {
+    shape.nuance_chaos = std::max(shape.nuance_chaos, wave.chaos_factor);
+    shape.nuance_amplitude += wave.amplitude;
+  }
+  return shape;
+}
+
+}  // namespace orbita
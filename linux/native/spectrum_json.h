@@ -0,0 +1,55 @@
+#ifndef ORBITA_NATIVE_SPECTRUM_JSON_H_
+#define ORBITA_NATIVE_SPECTRUM_JSON_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "orbita_native.h"
+
+namespace orbita {
+
+// WaveLayer in lib/data/models/wave_layer.dart.
+struct WaveLayer {
+  double frequency = 0;
+  double amplitude = 0;
+  std::string shape_type = "circle";
+  double chaos_factor = 0;
+};
+
+// HeptapodSpectrum in lib/data/models/heptapod_spectrum.dart.
+struct HeptapodSpectrum {
+  std::vector<WaveLayer> core;
+  std::vector<WaveLayer> narrative;
+  std::vector<WaveLayer> nuance;
+};
+
+// Parses a spectrum in the JSON format HeptapodSpectrum.fromJson reads:
+//
+//   {"core": [{"freq": 1.0, "amp": 0.5, "shapeType": "circle",
+//              "chaosFactor": 0.1}, ...],
+//    "narrative": [...], "nuance": [...]}
+//
+// Missing layers are empty, missing shapeType and chaosFactor take the
+// model's defaults, and other keys are ignored. Returns false, leaving
+// |out| unspecified, if |text| is not valid JSON of that shape.
+bool ParseSpectrumJson(const std::string& text, HeptapodSpectrum* out);
+
+// ParseSpectrumJson() for the looser text GeminiService.parseSpectrumJson
+// copes with from the model: the JSON may sit in a Markdown code fence
+// (```json ... ```) with prose around it, and strings may be in single
+// quotes as well as double, with \' escaping a quote inside them. Unlike
+// the Dart fallback, which swaps every ' for ", apostrophes inside
+// double-quoted strings survive. The whole response may also come quoted
+// as one JSON string, as a corpus of stored responses keeps it.
+bool ParseLenientSpectrumJson(const char* text,
+                              size_t size,
+                              HeptapodSpectrum* out);
+
+// HeptapodGeometry.shapeOf: the parts of |spectrum| its logogram depends
+// on.
+OrbitaLogogramShape ShapeOf(const HeptapodSpectrum& spectrum);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_SPECTRUM_JSON_H_
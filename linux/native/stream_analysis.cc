@@ -0,0 +1,426 @@
+#include "stream_analysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "analysis.h"
+#include "json_writer.h"
+#include "parallel.h"
+#include "ray_cast.h"
+#include "tracing.h"
+
+namespace orbita {
+
+namespace {
+
+// Side of the tiles frames are compared in. Small enough that a pen
+// stroke dirties little beyond itself, large enough that the blur window
+// around a tile does not dwarf it.
+constexpr int kTileSize = 32;
+
+// True if any pixel of the |width| x |height| tile at |a| and |b|, rows
+// |stride| apart, differs by more than |threshold|.
+bool TileChanged(const uint8_t* a,
+                 const uint8_t* b,
+                 int width,
+                 int height,
+                 int stride,
+                 int threshold) {
+  for (int y = 0; y < height; ++y, a += stride, b += stride) {
+    if (threshold == 0) {
+      if (memcmp(a, b, width) != 0) {
+        return true;
+      }
+      continue;
+    }
+    for (int x = 0; x < width; ++x) {
+      if (std::abs(a[x] - b[x]) > threshold) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Marks the sectors of rays from (center_x, center_y) that can sample a
+// pixel of |rect|. A ray samples a pixel when it passes within half a
+// pixel of its centre, so the rectangle is widened by a pixel all round
+// to stay clear of rounding.
+void MarkSectors(const PixelRect& rect,
+                 double center_x,
+                 double center_y,
+                 int ray_count,
+                 std::vector<uint8_t>* stale) {
+  const double x0 = rect.x0 - 1.0;
+  const double y0 = rect.y0 - 1.0;
+  const double x1 = rect.x1;
+  const double y1 = rect.y1;
+  if (center_x >= x0 && center_x <= x1 && center_y >= y0 && center_y <= y1) {
+    std::fill(stale->begin(), stale->end(), 1);
+    return;
+  }
+  // Seen from outside, the rectangle spans less than half a turn, so the
+  // corners' angles around the direction of its middle cannot wrap.
+  const double middle =
+      std::atan2((y0 + y1) / 2 - center_y, (x0 + x1) / 2 - center_x);
+  double low = 0;
+  double high = 0;
+  for (const double x : {x0, x1}) {
+    for (const double y : {y0, y1}) {
+      const double angle = std::remainder(
+          std::atan2(y - center_y, x - center_x) - middle, 2 * M_PI);
+      low = std::min(low, angle);
+      high = std::max(high, angle);
+    }
+  }
+  const double step = 2 * M_PI / ray_count;
+  const long first = static_cast<long>(std::floor((middle + low) / step)) - 1;
+  const long last = static_cast<long>(std::ceil((middle + high) / step)) + 1;
+  for (long i = first; i <= last; ++i) {
+    const long ray = ((i % ray_count) + ray_count) % ray_count;
+    (*stale)[ray / kRaySectorSize] = 1;
+  }
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+std::string FormatFrame(int frame,
+                        double frame_rate,
+                        const OrbitaSpectrumSummary& summary,
+                        const FrameReuse& reuse,
+                        double analysis_ms) {
+  std::string line = "{\"frame\":";
+  AppendJsonNumber(&line, frame);
+  if (frame_rate > 0) {
+    line += ",\"timeMs\":";
+    AppendJsonNumber(&line, frame * 1000.0 / frame_rate);
+  }
+  line += ",\"dominantFrequencies\":[";
+  for (int i = 0; i < ORBITA_DOMINANT_BIN_COUNT; ++i) {
+    if (i > 0) {
+      line += ',';
+    }
+    AppendJsonNumber(&line, summary.dominant_frequencies[i]);
+  }
+  line += "],\"chaosLevel\":";
+  AppendJsonNumber(&line, summary.chaos_level);
+  line += ",\"density\":";
+  AppendJsonNumber(&line, summary.density);
+  line += ",\"dirtyTiles\":";
+  AppendJsonNumber(&line, reuse.dirty_tiles);
+  line += ",\"tiles\":";
+  AppendJsonNumber(&line, reuse.tiles);
+  line += ",\"raysCast\":";
+  AppendJsonNumber(&line, reuse.rays_cast);
+  line += ",\"analysisMs\":";
+  AppendJsonNumber(&line, analysis_ms);
+  line += "}\n";
+  return line;
+}
+
+}  // namespace
+
+StreamingAnalyzer::StreamingAnalyzer(const OrbitaAnalysisParams& params,
+                                     const StreamOptions& options)
+    : params_(params), options_(options) {
+  if (ValidateAnalysisParams(params)) {
+    plan_ = RealFftPlan::Get(params.ray_count);
+  }
+}
+
+OrbitaStatus StreamingAnalyzer::Analyze(const LumaFrame& frame,
+                                        OrbitaSpectrumSummary* out,
+                                        FrameReuse* reuse) {
+  ORBITA_TRACE_SPAN("analyze_frame");
+  ScratchScope scratch;
+  if (plan_ == nullptr || frame.width <= 0 || frame.height <= 0 ||
+      frame.luma.size() !=
+          static_cast<size_t>(frame.width) * frame.height) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  FrameReuse local;
+  if (reuse == nullptr) {
+    reuse = &local;
+  }
+  *reuse = FrameReuse();
+
+  if (reference_.empty() || frame.width != width_ ||
+      frame.height != height_ || frame.scale != scale_) {
+    width_ = frame.width;
+    height_ = frame.height;
+    scale_ = frame.scale;
+    radius_ = ParamsForScale(params_, scale_).blur_radius;
+    tiles_x_ = (width_ + kTileSize - 1) / kTileSize;
+    tiles_y_ = (height_ + kTileSize - 1) / kTileSize;
+    reference_ = frame.luma;
+    reuse->tiles = reuse->dirty_tiles = tiles_x_ * tiles_y_;
+    AnalyzeFull(reuse);
+    *out = summary_;
+    return ORBITA_OK;
+  }
+
+  std::vector<uint8_t> dirty;
+  reuse->tiles = tiles_x_ * tiles_y_;
+  reuse->dirty_tiles = CompareTiles(frame, &dirty);
+  if (reuse->dirty_tiles == 0) {
+    *out = summary_;
+    return ORBITA_OK;
+  }
+
+  const ImageView view{reference_.data(), width_, height_, width_, 1};
+  if (HasDarkBackground(view, radius_) != ink_.dark_background) {
+    AnalyzeFull(reuse);
+    *out = summary_;
+    return ORBITA_OK;
+  }
+  const std::vector<PixelRect> changed = UpdateInkMask(
+      view, radius_, params_.threshold, DirtyRects(dirty), &mask_, &ink_);
+  if (changed.empty()) {
+    *out = summary_;
+    return ORBITA_OK;
+  }
+
+  double center_x = width_ / 2.0;
+  double center_y = height_ / 2.0;
+  if (ink_.ink_count > 0) {
+    center_x = ink_.sum_x / static_cast<double>(ink_.ink_count);
+    center_y = ink_.sum_y / static_cast<double>(ink_.ink_count);
+  }
+  const double drift =
+      std::hypot(center_x - center_x_, center_y - center_y_);
+  if (drift > options_.recenter_tolerance) {
+    center_x_ = center_x;
+    center_y_ = center_y;
+    rays_ = CastRays(mask_.data(), width_, height_, center_x_, center_y_,
+                     params_.ray_count);
+    reuse->rays_cast = params_.ray_count;
+  } else {
+    const int sectors =
+        (params_.ray_count + kRaySectorSize - 1) / kRaySectorSize;
+    std::vector<uint8_t> stale(sectors, 0);
+    for (const PixelRect& rect : changed) {
+      MarkSectors(rect, center_x_, center_y_, params_.ray_count, &stale);
+    }
+    RecastRays(mask_.data(), width_, height_, center_x_, center_y_, stale,
+               &rays_);
+    reuse->rays_cast = static_cast<int>(
+        std::count(stale.begin(), stale.end(), 1) * kRaySectorSize);
+  }
+  Summarize();
+  *out = summary_;
+  return ORBITA_OK;
+}
+
+void StreamingAnalyzer::AnalyzeFull(FrameReuse* reuse) {
+  const ImageView view{reference_.data(), width_, height_, width_, 1};
+  ExtractInkMask(view, radius_, params_.threshold, &mask_, &ink_);
+  center_x_ = width_ / 2.0;
+  center_y_ = height_ / 2.0;
+  if (ink_.ink_count > 0) {
+    center_x_ = ink_.sum_x / static_cast<double>(ink_.ink_count);
+    center_y_ = ink_.sum_y / static_cast<double>(ink_.ink_count);
+  }
+  rays_ = CastRays(mask_.data(), width_, height_, center_x_, center_y_,
+                   params_.ray_count);
+  reuse->rays_cast = params_.ray_count;
+  reuse->full = true;
+  Summarize();
+}
+
+int StreamingAnalyzer::CompareTiles(const LumaFrame& frame,
+                                    std::vector<uint8_t>* dirty) {
+  ORBITA_TRACE_SPAN("frame.compare");
+  dirty->assign(static_cast<size_t>(tiles_x_) * tiles_y_, 0);
+  std::atomic<int> count{0};
+  ParallelFor(tiles_y_, [&](int ty) {
+    const int y0 = ty * kTileSize;
+    const int height = std::min(kTileSize, height_ - y0);
+    int changed = 0;
+    for (int tx = 0; tx < tiles_x_; ++tx) {
+      const int x0 = tx * kTileSize;
+      const int width = std::min(kTileSize, width_ - x0);
+      const size_t offset = static_cast<size_t>(y0) * width_ + x0;
+      if (!TileChanged(frame.luma.data() + offset, reference_.data() + offset,
+                       width, height, width_, options_.change_threshold)) {
+        continue;
+      }
+      (*dirty)[static_cast<size_t>(ty) * tiles_x_ + tx] = 1;
+      for (int y = 0; y < height; ++y) {
+        memcpy(reference_.data() + offset + static_cast<size_t>(y) * width_,
+               frame.luma.data() + offset + static_cast<size_t>(y) * width_,
+               width);
+      }
+      ++changed;
+    }
+    count += changed;
+  });
+  return count;
+}
+
+std::vector<PixelRect> StreamingAnalyzer::DirtyRects(
+    const std::vector<uint8_t>& dirty) const {
+  // Runs of dirty tiles along each tile row, merged with the run directly
+  // above when they span the same columns.
+  struct Run {
+    int tx0;
+    int tx1;
+    int ty0;
+  };
+  std::vector<PixelRect> rects;
+  auto close = [&](const Run& run, int ty1) {
+    rects.push_back(PixelRect{
+        std::max(0, run.tx0 * kTileSize - radius_),
+        std::max(0, run.ty0 * kTileSize - radius_),
+        std::min(width_, run.tx1 * kTileSize + radius_),
+        std::min(height_, ty1 * kTileSize + radius_)});
+  };
+  std::vector<Run> open;
+  std::vector<Run> next;
+  for (int ty = 0; ty <= tiles_y_; ++ty) {
+    next.clear();
+    for (int tx = 0; ty < tiles_y_ && tx < tiles_x_;) {
+      if (!dirty[static_cast<size_t>(ty) * tiles_x_ + tx]) {
+        ++tx;
+        continue;
+      }
+      Run run{tx, tx, ty};
+      while (run.tx1 < tiles_x_ &&
+             dirty[static_cast<size_t>(ty) * tiles_x_ + run.tx1]) {
+        ++run.tx1;
+      }
+      tx = run.tx1;
+      for (const Run& above : open) {
+        if (above.tx0 == run.tx0 && above.tx1 == run.tx1) {
+          run.ty0 = above.ty0;
+        }
+      }
+      next.push_back(run);
+    }
+    for (const Run& above : open) {
+      const bool continued = std::any_of(
+          next.begin(), next.end(), [&above](const Run& run) {
+            return run.tx0 == above.tx0 && run.tx1 == above.tx1;
+          });
+      if (!continued) {
+        close(above, ty);
+      }
+    }
+    std::swap(open, next);
+  }
+  return rects;
+}
+
+void StreamingAnalyzer::Summarize() {
+  SummarizeRayProfile(*plan_, rays_.data(), &summary_);
+  summary_.density = static_cast<double>(ink_.ink_count) /
+                     (static_cast<double>(width_) * height_);
+}
+
+FrameStream::FrameStream(std::unique_ptr<FrameSource> source,
+                         const OrbitaAnalysisParams& params,
+                         const StreamOptions& options)
+    : source_(std::move(source)),
+      analyzer_(params, options),
+      working_pixels_(params.working_pixels) {}
+
+OrbitaStatus FrameStream::Next(OrbitaSpectrumSummary* out,
+                               FrameReuse* reuse) {
+  if (done()) {
+    return ORBITA_ERROR_INVALID_ARGUMENT;
+  }
+  if (!has_current_) {
+    current_status_ = source_->ReadFrame(next_, working_pixels_, &current_);
+  }
+  const int index = next_++;
+  if (current_status_ != ORBITA_OK) {
+    has_current_ = false;
+    return current_status_;
+  }
+  // Decoding the next frame overlaps with analysing this one.
+  const bool read_ahead = !done();
+  OrbitaStatus status = ORBITA_OK;
+  OrbitaStatus ahead_status = ORBITA_OK;
+  ParallelFor(read_ahead ? 2 : 1, [&](int task) {
+    if (task == 0) {
+      status = analyzer_.Analyze(current_, out, reuse);
+    } else {
+      ahead_status = source_->ReadFrame(index + 1, working_pixels_, &ahead_);
+    }
+  });
+  std::swap(current_, ahead_);
+  current_status_ = ahead_status;
+  has_current_ = read_ahead;
+  return status;
+}
+
+int RunFrameAnalysis(const FrameAnalysisOptions& options) {
+  std::unique_ptr<FrameSource> source;
+  OrbitaStatus status = OpenFrameSource(
+      options.input.c_str(), options.raw.width > 0 ? &options.raw : nullptr,
+      &source);
+  if (status != ORBITA_OK) {
+    fprintf(stderr, "orbita: cannot read frames from %s: %s\n",
+            options.input.c_str(), orbita_status_string(status));
+    return 1;
+  }
+  if (source->frame_count() == 0) {
+    fprintf(stderr, "orbita: no frames in %s\n", options.input.c_str());
+    return 1;
+  }
+  if (!ValidateAnalysisParams(options.params)) {
+    fprintf(stderr, "orbita: invalid analysis parameters\n");
+    return 1;
+  }
+  FILE* out = options.output == "-" ? stdout
+                                    : fopen(options.output.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "orbita: cannot write %s: %s\n", options.output.c_str(),
+            strerror(errno));
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const double frame_rate = source->frame_rate();
+  const int frames = source->frame_count();
+  FrameStream stream(std::move(source), options.params, options.stream);
+  int failures = 0;
+  while (!stream.done()) {
+    const int frame = stream.position();
+    const auto begin = std::chrono::steady_clock::now();
+    OrbitaSpectrumSummary summary;
+    FrameReuse reuse;
+    status = stream.Next(&summary, &reuse);
+    if (status != ORBITA_OK) {
+      ++failures;
+      fprintf(stderr, "orbita: frame %d: %s\n", frame,
+              orbita_status_string(status));
+      continue;
+    }
+    const std::string line = FormatFrame(frame, frame_rate, summary, reuse,
+                                         MillisecondsSince(begin));
+    fwrite(line.data(), 1, line.size(), out);
+    fflush(out);
+  }
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  const double seconds = MillisecondsSince(start) / 1000.0;
+  fprintf(stderr,
+          "orbita: analysed %d frames (%d failed) in %.2f s, %.1f frames/s\n",
+          frames, failures, seconds, frames / seconds);
+  return failures == 0 ? 0 : 1;
+}
+
+}  // namespace orbita
@@ -0,0 +1,148 @@
+#ifndef ORBITA_NATIVE_STREAM_ANALYSIS_H_
+#define ORBITA_NATIVE_STREAM_ANALYSIS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fft.h"
+#include "frame_source.h"
+#include "orbita_native.h"
+#include "preprocess.h"
+#include "scratch_memory.h"
+
+namespace orbita {
+
+// How much of one frame's work StreamingAnalyzer carries into the next.
+struct StreamOptions {
+  // A tile whose luma changed by at most this much anywhere keeps the
+  // pixels of the frame it last changed in. 0 treats any change as one;
+  // camera footage needs a few levels to ride over sensor noise.
+  int change_threshold = 0;
+  // Rays stay cast from where they were until the centroid has moved this
+  // many analysed pixels away, and only the sectors the changed ink falls
+  // in are cast again. 0 recasts every ray whenever the centroid moves,
+  // which makes every summary exactly AnalyzeImage()'s for the frame.
+  double recenter_tolerance = 1.0;
+};
+
+// What analysing one frame took.
+struct FrameReuse {
+  int tiles = 0;
+  // Tiles that differed from the previous frame.
+  int dirty_tiles = 0;
+  int rays_cast = 0;
+  // True if nothing could be reused: the first frame, a change of size or
+  // a change of background.
+  bool full = false;
+};
+
+// Analyses the frames of a recording in order, such as someone drawing a
+// logogram, reusing the previous frame's work where the ink did not
+// change:
+//
+// - the frame is compared with the last one tile by tile, and only the
+//   mask around changed tiles is blurred and thresholded again;
+// - the centroid and density move by the mask pixels that flipped;
+// - only rays whose sectors saw flipped pixels are cast again, unless the
+//   centroid moved further than StreamOptions::recenter_tolerance.
+class StreamingAnalyzer {
+ public:
+  StreamingAnalyzer(const OrbitaAnalysisParams& params,
+                    const StreamOptions& options);
+
+  // Analyses |frame|, the next frame of the recording. Frames of another
+  // size or scale start over. |reuse| is optional.
+  OrbitaStatus Analyze(const LumaFrame& frame,
+                       OrbitaSpectrumSummary* out,
+                       FrameReuse* reuse = nullptr);
+
+  // Forgets the previous frame, so the next one is analysed in full.
+  void Reset() { reference_.clear(); }
+
+ private:
+  void AnalyzeFull(FrameReuse* reuse);
+  // Marks tiles of |frame| that differ from |reference_| in |dirty| and
+  // copies them over. Returns how many there were.
+  int CompareTiles(const LumaFrame& frame, std::vector<uint8_t>* dirty);
+  // Mask rectangles covering the blur windows of the dirty tiles.
+  std::vector<PixelRect> DirtyRects(const std::vector<uint8_t>& dirty) const;
+  void Summarize();
+
+  const OrbitaAnalysisParams params_;
+  const StreamOptions options_;
+  std::shared_ptr<const RealFftPlan> plan_;
+
+  int width_ = 0;
+  int height_ = 0;
+  int scale_ = 0;
+  int radius_ = 0;
+  int tiles_x_ = 0;
+  int tiles_y_ = 0;
+  // Luma of the frame the mask describes.
+  ScratchVector<uint8_t> reference_;
+  ScratchVector<uint8_t> mask_;
+  InkStats ink_;
+  // Where the rays were cast from.
+  double center_x_ = 0;
+  double center_y_ = 0;
+  std::vector<double> rays_;
+  OrbitaSpectrumSummary summary_;
+};
+
+// StreamingAnalyzer over the frames of a FrameSource, reading each frame
+// while the one before it is analysed.
+class FrameStream {
+ public:
+  FrameStream(std::unique_ptr<FrameSource> source,
+              const OrbitaAnalysisParams& params,
+              const StreamOptions& options);
+
+  const FrameSource& source() const { return *source_; }
+  // Index of the frame Next() analyses.
+  int position() const { return next_; }
+  bool done() const { return next_ >= source_->frame_count(); }
+
+  // Analyses the next frame. Must not be called once done().
+  OrbitaStatus Next(OrbitaSpectrumSummary* out, FrameReuse* reuse = nullptr);
+
+ private:
+  std::unique_ptr<FrameSource> source_;
+  StreamingAnalyzer analyzer_;
+  const int64_t working_pixels_;
+  int next_ = 0;
+  // Frame |next_|, once read ahead.
+  LumaFrame current_;
+  OrbitaStatus current_status_ = ORBITA_OK;
+  bool has_current_ = false;
+  LumaFrame ahead_;
+};
+
+// Options for `orbita --analyze-frames`.
+struct FrameAnalysisOptions {
+  // A directory of numbered frames or a video file; see OpenFrameSource.
+  std::string input;
+  // JSON Lines output file; "-" writes to stdout.
+  std::string output = "-";
+  // Layout of a headerless video file; ignored while raw.width is 0.
+  RawVideoFormat raw;
+  StreamOptions stream;
+  OrbitaAnalysisParams params;
+};
+
+// Analyses every frame of |options.input| in order and streams one JSON
+// object per frame to |options.output| as soon as it is ready:
+//
+//   {"frame": ..., "timeMs": ..., "dominantFrequencies": [...],
+//    "chaosLevel": ..., "density": ..., "dirtyTiles": ..., "tiles": ...,
+//    "raysCast": ..., "analysisMs": ...}
+//
+// timeMs, the frame's place in the recording, is left out when the source
+// has no frame rate. Returns the process exit code: 0 if every frame was
+// analysed, 1 otherwise.
+int RunFrameAnalysis(const FrameAnalysisOptions& options);
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_STREAM_ANALYSIS_H_
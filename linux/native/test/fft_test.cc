@@ -0,0 +1,111 @@
+#include "fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "test.h"
+
+namespace orbita {
+namespace {
+
+constexpr long double kPi = 3.141592653589793238462643383279502884L;
+
+// Bins 0..size/2 of the DFT of |input|, summed term by term in long
+// double with the angle reduced modulo the size, so the reference is more
+// accurate than the transform it checks.
+void NaiveDft(const std::vector<double>& input,
+              std::vector<double>* re,
+              std::vector<double>* im) {
+  const int size = static_cast<int>(input.size());
+  re->assign(size / 2 + 1, 0);
+  im->assign(size / 2 + 1, 0);
+  for (int k = 0; k <= size / 2; ++k) {
+    long double sum_re = 0;
+    long double sum_im = 0;
+    for (int t = 0; t < size; ++t) {
+      const long double angle =
+          -2 * kPi * ((static_cast<int64_t>(k) * t) % size) / size;
+      sum_re += input[t] * std::cos(angle);
+      sum_im += input[t] * std::sin(angle);
+    }
+    (*re)[k] = static_cast<double>(sum_re);
+    (*im)[k] = static_cast<double>(sum_im);
+  }
+}
+
+std::vector<double> RandomSignal(int size, std::mt19937_64* random) {
+  std::uniform_real_distribution<double> sample(0, 1);
+  std::vector<double> signal(size);
+  for (double& value : signal) {
+    value = sample(*random);
+  }
+  return signal;
+}
+
+ORBITA_TEST(RealFft, MatchesNaiveDft) {
+  std::mt19937_64 random(1);
+  for (int size = 4; size <= 4096; size *= 2) {
+    const std::vector<double> input = RandomSignal(size, &random);
+    std::vector<double> re(size / 2 + 1);
+    std::vector<double> im(size / 2 + 1);
+    RealFftPlan::Get(size)->Forward(input.data(), re.data(), im.data());
+
+    std::vector<double> want_re;
+    std::vector<double> want_im;
+    NaiveDft(input, &want_re, &want_im);
+    double error = 0;
+    for (int k = 0; k <= size / 2; ++k) {
+      error = std::max(error, std::hypot(re[k] - want_re[k],
+                                         im[k] - want_im[k]));
+    }
+    // Rounding stays under 2e-13 at 4096 points; a wrong twiddle or
+    // permutation is off by whole units.
+    EXPECT_NEAR(error, 0, 5e-13);
+  }
+}
+
+ORBITA_TEST(RealFft, InverseUndoesForward) {
+  std::mt19937_64 random(2);
+  for (int size : {4, 64, 512, 4096}) {
+    const std::vector<double> input = RandomSignal(size, &random);
+    std::vector<double> re(size / 2 + 1);
+    std::vector<double> im(size / 2 + 1);
+    std::vector<double> output(size);
+    const std::shared_ptr<const RealFftPlan> plan = RealFftPlan::Get(size);
+    plan->Forward(input.data(), re.data(), im.data());
+    plan->Inverse(re.data(), im.data(), output.data());
+    double error = 0;
+    for (int t = 0; t < size; ++t) {
+      error = std::max(error, std::fabs(output[t] - input[t]));
+    }
+    EXPECT_NEAR(error, 0, 1e-13);
+  }
+}
+
+ORBITA_TEST(RealFft, BatchMatchesOneAtATime) {
+  constexpr int kSize = 512;
+  constexpr int kCount = 37;
+  std::mt19937_64 random(3);
+  const std::vector<double> inputs = RandomSignal(kSize * kCount, &random);
+  constexpr int kBins = kSize / 2 + 1;
+  std::vector<double> re(kBins * kCount);
+  std::vector<double> im(kBins * kCount);
+  RealFftBatch(inputs.data(), kCount, kSize, re.data(), im.data());
+
+  const std::shared_ptr<const RealFftPlan> plan = RealFftPlan::Get(kSize);
+  std::vector<double> one_re(kBins);
+  std::vector<double> one_im(kBins);
+  for (int i = 0; i < kCount; ++i) {
+    plan->Forward(inputs.data() + i * kSize, one_re.data(), one_im.data());
+    EXPECT_TRUE(
+        std::equal(one_re.begin(), one_re.end(), re.begin() + i * kBins));
+    EXPECT_TRUE(
+        std::equal(one_im.begin(), one_im.end(), im.begin() + i * kBins));
+  }
+}
+
+}  // namespace
+}  // namespace orbita
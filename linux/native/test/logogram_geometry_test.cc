@@ -0,0 +1,46 @@
+#include "logogram_geometry.h"
+
+#include "test.h"
+
+namespace orbita {
+namespace {
+
+void ExpectSameGeometry(const LogogramGeometry& actual,
+                        const LogogramGeometry& expected) {
+  EXPECT_TRUE(actual.x == expected.x);
+  EXPECT_TRUE(actual.y == expected.y);
+  EXPECT_TRUE(actual.particle_x == expected.particle_x);
+  EXPECT_TRUE(actual.particle_y == expected.particle_y);
+  EXPECT_EQ(actual.polylines.size(), expected.polylines.size());
+  if (actual.polylines.size() != expected.polylines.size()) {
+    return;
+  }
+  for (size_t i = 0; i < actual.polylines.size(); ++i) {
+    const StrokePolyline& a = actual.polylines[i];
+    const StrokePolyline& b = expected.polylines[i];
+    EXPECT_EQ(a.first_point, b.first_point);
+    EXPECT_EQ(a.point_count, b.point_count);
+    EXPECT_EQ(a.closed, b.closed);
+    EXPECT_EQ(a.layer, b.layer);
+    EXPECT_EQ(a.generation, b.generation);
+  }
+}
+
+// The cache reuses the skeleton and main loops of other shapes and sizes;
+// Build() draws everything afresh. Both must place the same points.
+ORBITA_TEST(LogogramGeometry, BuildMatchesCachedGeometry) {
+  const OrbitaLogogramShape shape = {0.5, 0.8, 0.1};
+  OrbitaLogogramShape other_nuance = shape;
+  other_nuance.nuance_chaos = 0.3;
+  LogogramGeometryCache cache(4, 4);
+  cache.Get(shape, 1337, 640, 480);
+  cache.Get(other_nuance, 1337, 400, 300);
+
+  ExpectSameGeometry(*LogogramGeometryCache::Build(shape, 1337, 400, 300),
+                     *cache.Get(shape, 1337, 400, 300));
+  ExpectSameGeometry(*LogogramGeometryCache::Build(shape, 1337, 640, 480),
+                     *cache.Get(shape, 1337, 640, 480));
+}
+
+}  // namespace
+}  // namespace orbita
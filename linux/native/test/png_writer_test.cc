@@ -0,0 +1,122 @@
+#include "png_writer.h"
+
+#include <png.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace orbita {
+namespace {
+
+// RGBA with smooth gradients, where the filters matter, and noise, where
+// they cannot help.
+std::vector<uint8_t> TestImage(int width, int height) {
+  std::mt19937 random(1);
+  std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t* pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+      pixel[0] = static_cast<uint8_t>(x);
+      pixel[1] = static_cast<uint8_t>(y * 3);
+      pixel[2] = static_cast<uint8_t>(y < height / 2 ? random() : x ^ y);
+      pixel[3] = static_cast<uint8_t>(255 - x / 2);
+    }
+  }
+  return rgba;
+}
+
+// Writes |rgba| with PngWriter on |threads| threads, |rows_per_write| rows
+// at a time, and returns the file's bytes.
+std::string Encode(const std::vector<uint8_t>& rgba,
+                   int width,
+                   int height,
+                   int threads,
+                   int rows_per_write) {
+  char path[] = "/tmp/orbita_png_test_XXXXXX";
+  const int fd = mkstemp(path);
+  EXPECT_TRUE(fd >= 0);
+  if (fd < 0) {
+    return std::string();
+  }
+  unlink(path);
+
+  PngWriter writer(threads);
+  EXPECT_EQ(writer.Start(fd, width, height), ORBITA_OK);
+  for (int y = 0; y < height; y += rows_per_write) {
+    const int rows = std::min(rows_per_write, height - y);
+    EXPECT_EQ(writer.WriteRows(&rgba[static_cast<size_t>(y) * width * 4],
+                               rows, width * 4),
+              ORBITA_OK);
+  }
+  EXPECT_EQ(writer.Finish(), ORBITA_OK);
+
+  std::string bytes(static_cast<size_t>(lseek(fd, 0, SEEK_END)), '\0');
+  EXPECT_EQ(pread(fd, &bytes[0], bytes.size(), 0),
+            static_cast<ssize_t>(bytes.size()));
+  close(fd);
+  return bytes;
+}
+
+// Decodes |png| with libpng into RGBA.
+std::vector<uint8_t> Decode(const std::string& png, int* width, int* height) {
+  png_image image;
+  memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+  std::vector<uint8_t> rgba;
+  if (!png_image_begin_read_from_memory(&image, png.data(), png.size())) {
+    return rgba;
+  }
+  image.format = PNG_FORMAT_RGBA;
+  rgba.resize(PNG_IMAGE_SIZE(image));
+  if (!png_image_finish_read(&image, nullptr, rgba.data(), 0, nullptr)) {
+    rgba.clear();
+  }
+  *width = image.width;
+  *height = image.height;
+  return rgba;
+}
+
+ORBITA_TEST(PngWriter, RoundTripsThroughLibpng) {
+  // Several 512 KB chunks, the last one partial.
+  constexpr int kWidth = 333;
+  constexpr int kHeight = 1201;
+  const std::vector<uint8_t> rgba = TestImage(kWidth, kHeight);
+  int width = 0;
+  int height = 0;
+  EXPECT_TRUE(Decode(Encode(rgba, kWidth, kHeight, 4, 7), &width,
+                     &height) == rgba);
+  EXPECT_EQ(width, kWidth);
+  EXPECT_EQ(height, kHeight);
+}
+
+ORBITA_TEST(PngWriter, OutputDoesNotDependOnThreads) {
+  constexpr int kWidth = 640;
+  constexpr int kHeight = 480;
+  const std::vector<uint8_t> rgba = TestImage(kWidth, kHeight);
+  const std::string one = Encode(rgba, kWidth, kHeight, 1, kHeight);
+  EXPECT_TRUE(Encode(rgba, kWidth, kHeight, 3, 1) == one);
+  EXPECT_TRUE(Encode(rgba, kWidth, kHeight, 0, 64) == one);
+}
+
+ORBITA_TEST(PngWriter, FinishFailsOnMissingRows) {
+  char path[] = "/tmp/orbita_png_test_XXXXXX";
+  const int fd = mkstemp(path);
+  EXPECT_TRUE(fd >= 0);
+  unlink(path);
+  const std::vector<uint8_t> rgba = TestImage(16, 16);
+  PngWriter writer(1);
+  EXPECT_EQ(writer.Start(fd, 16, 16), ORBITA_OK);
+  EXPECT_EQ(writer.WriteRows(rgba.data(), 15, 16 * 4), ORBITA_OK);
+  EXPECT_TRUE(writer.Finish() != ORBITA_OK);
+  close(fd);
+}
+
+}  // namespace
+}  // namespace orbita
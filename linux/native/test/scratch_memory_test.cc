@@ -0,0 +1,72 @@
+#include "scratch_memory.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+namespace orbita {
+namespace {
+
+constexpr size_t kBlock = 1 << 20;
+
+// Every job needs two blocks at once, with room for only one. A job
+// holding a block has to go ahead over the budget, and jobs yet to start
+// have to wait until it is done rather than take the memory it waits for,
+// or the jobs would wait on each other forever.
+ORBITA_TEST(ScratchMemory, JobsOverBudgetDoNotDeadlock) {
+  SetScratchLimit(kBlock * 3 / 2);
+  const int64_t waits = GetScratchUsage().waits;
+  std::atomic<int> finished{0};
+  std::vector<std::thread> jobs;
+  for (int j = 0; j < 4; ++j) {
+    jobs.emplace_back([&] {
+      for (int round = 0; round < 20; ++round) {
+        ScratchScope scope;
+        void* first = AllocateScratch(kBlock);
+        std::this_thread::yield();
+        void* second = AllocateScratch(kBlock);
+        FreeScratch(second, kBlock);
+        FreeScratch(first, kBlock);
+      }
+      ++finished;
+    });
+  }
+  for (std::thread& job : jobs) {
+    job.join();
+  }
+  SetScratchLimit(0);
+  EXPECT_EQ(finished.load(), 4);
+  EXPECT_TRUE(GetScratchUsage().waits > waits);
+  EXPECT_EQ(GetScratchUsage().used_bytes, 0);
+}
+
+ORBITA_TEST(ScratchMemory, AllocationsOutsideScopesNeverWait) {
+  SetScratchLimit(kBlock);
+  const int64_t waits = GetScratchUsage().waits;
+  void* first = AllocateScratch(kBlock);
+  void* second = AllocateScratch(kBlock);
+  EXPECT_EQ(GetScratchUsage().waits, waits);
+  EXPECT_TRUE(GetScratchUsage().used_bytes >=
+              static_cast<int64_t>(kBlock) * 2);
+  FreeScratch(second, kBlock);
+  FreeScratch(first, kBlock);
+  SetScratchLimit(0);
+}
+
+// More than the address space holds, so mapping it always fails.
+ORBITA_TEST(ScratchMemory, FailedAllocationsReportOutOfMemory) {
+  const OrbitaStatus status = CatchOutOfMemory([] {
+    ScratchScope scope;
+    AllocateScratch(size_t{1} << 62);
+    return ORBITA_OK;
+  });
+  EXPECT_EQ(status, ORBITA_ERROR_OUT_OF_MEMORY);
+  EXPECT_EQ(GetScratchUsage().used_bytes, 0);
+  EXPECT_EQ(CatchOutOfMemory([] { return ORBITA_ERROR_IO; }),
+            ORBITA_ERROR_IO);
+}
+
+}  // namespace
+}  // namespace orbita
@@ -0,0 +1,84 @@
+#include "simplex_noise.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "test.h"
+
+namespace orbita {
+namespace {
+
+constexpr double kFrequency = 0.01;
+
+// package:fast_noise's SimplexNoise(seed: seed, frequency: 0.01)
+// .getNoise2(x, y). test/heptapod_geometry_test.dart pins the same values
+// on the Dart side.
+struct Golden {
+  int32_t seed;
+  double x;
+  double y;
+  double noise;
+};
+
+constexpr Golden kGoldens[] = {
+    {1337, 0, 0, 0.0},
+    {1337, 1, 0, -0.031225482994025004},
+    {1337, 123.4, -56.7, 0.48306427256805146},
+    {1337, -3000.25, 2999.5, 0.015621016713729667},
+    {42, 10, 1000, 0.2865987875},
+    {42, 512.5, -0.125, 0.04816480073626776},
+    {-7, 123456.789, -98765.4321, 0.17400809378311557},
+    {-7, -37.75, 81.0625, 0.5006803254966031},
+};
+
+bool SameBits(double a, double b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+ORBITA_TEST(SimplexNoise, MatchesFastNoise) {
+  for (const Golden& golden : kGoldens) {
+    EXPECT_EQ(SimplexNoise2(golden.seed, kFrequency, golden.x, golden.y),
+              golden.noise);
+  }
+}
+
+ORBITA_TEST(SimplexNoise, BatchMatchesFastNoise) {
+  for (const Golden& golden : kGoldens) {
+    double noise;
+    SimplexNoise2Batch(golden.seed, kFrequency, &golden.x, &golden.y, 1,
+                       &noise);
+    EXPECT_EQ(noise, golden.noise);
+  }
+}
+
+// The AVX2 or NEON path, whichever this machine takes, against the scalar
+// one. Counts that are not a multiple of the vector width exercise the
+// scalar tail too.
+ORBITA_TEST(SimplexNoise, BatchMatchesScalarBitForBit) {
+  std::mt19937_64 random(1);
+  std::uniform_real_distribution<double> coordinate(-5000, 5000);
+  for (int count : {1, 3, 4, 7, 8, 9, 4099}) {
+    for (int32_t seed : {1337, 0, -123456}) {
+      std::vector<double> x(count);
+      std::vector<double> y(count);
+      for (int i = 0; i < count; ++i) {
+        x[i] = coordinate(random);
+        y[i] = coordinate(random);
+      }
+      std::vector<double> batch(count);
+      SimplexNoise2Batch(seed, kFrequency, x.data(), y.data(), count,
+                         batch.data());
+      int mismatches = 0;
+      for (int i = 0; i < count; ++i) {
+        if (!SameBits(batch[i], SimplexNoise2(seed, kFrequency, x[i], y[i]))) {
+          ++mismatches;
+        }
+      }
+      EXPECT_EQ(mismatches, 0);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace orbita
@@ -0,0 +1,108 @@
+#include "spectrum_json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "test.h"
+
+namespace orbita {
+namespace {
+
+bool SameBits(double a, double b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+HeptapodSpectrum ParseLenient(const std::string& text, bool* ok) {
+  HeptapodSpectrum spectrum;
+  *ok = ParseLenientSpectrumJson(text.data(), text.size(), &spectrum);
+  return spectrum;
+}
+
+// Numbers are parsed in one pass without strtod, so every format the
+// model writes must still give strtod's result to the last bit.
+ORBITA_TEST(SpectrumJson, NumbersMatchStrtod) {
+  std::mt19937_64 random(1);
+  std::uniform_real_distribution<double> value(0, 60);
+  const char* formats[] = {"%.0f", "%.17g", "%.3e", "-%.2f", "%.20f",
+                           "%.2f", "%.1E",  "%g"};
+  int mismatches = 0;
+  for (int i = 0; i < 20000; ++i) {
+    char number[64];
+    snprintf(number, sizeof(number), formats[i % 8], value(random));
+    const std::string text =
+        std::string("{\"core\": [{\"freq\": ") + number + ", \"amp\": 1}]}";
+    HeptapodSpectrum spectrum;
+    if (!ParseSpectrumJson(text, &spectrum) || spectrum.core.size() != 1 ||
+        !SameBits(spectrum.core[0].frequency, strtod(number, nullptr))) {
+      ++mismatches;
+    }
+  }
+  EXPECT_EQ(mismatches, 0);
+}
+
+ORBITA_TEST(SpectrumJson, FillsModelDefaults) {
+  HeptapodSpectrum spectrum;
+  EXPECT_TRUE(ParseSpectrumJson(
+      "{\"core\": [{\"freq\": 2, \"amp\": 0.5}], \"nuance\": [{\"freq\": 30,"
+      " \"amp\": 0.1, \"shapeType\": \"spiky\", \"chaosFactor\": 0.8}],"
+      " \"extra\": {\"ignored\": [1, 2]}}",
+      &spectrum));
+  EXPECT_EQ(spectrum.core.size(), 1u);
+  EXPECT_EQ(spectrum.core[0].shape_type, std::string("circle"));
+  EXPECT_EQ(spectrum.core[0].chaos_factor, 0.0);
+  EXPECT_TRUE(spectrum.narrative.empty());
+  EXPECT_EQ(spectrum.nuance[0].shape_type, std::string("spiky"));
+  EXPECT_EQ(spectrum.nuance[0].chaos_factor, 0.8);
+}
+
+ORBITA_TEST(SpectrumJson, LenientAcceptsWhatTheModelWrites) {
+  const std::string json = "{\"core\": [{\"freq\": 1.5, \"amp\": 0.25}]}";
+  const std::string forms[] = {
+      json,
+      "Here you go:\n```json\n" + json + "\n```\nEnjoy!",
+      "{'core': [{'freq': 1.5, 'amp': 0.25}]}",
+      "\"```json\\n{\\\"core\\\": [{\\\"freq\\\": 1.5, \\\"amp\\\": 0.25}]}"
+      "\\n```\"",
+  };
+  for (const std::string& form : forms) {
+    bool ok = false;
+    const HeptapodSpectrum spectrum = ParseLenient(form, &ok);
+    EXPECT_TRUE(ok);
+    if (ok) {
+      EXPECT_EQ(spectrum.core.size(), 1u);
+      EXPECT_EQ(spectrum.core[0].frequency, 1.5);
+      EXPECT_EQ(spectrum.core[0].amplitude, 0.25);
+    }
+  }
+}
+
+ORBITA_TEST(SpectrumJson, LenientKeepsApostrophes) {
+  bool ok = false;
+  const HeptapodSpectrum spectrum = ParseLenient(
+      "{'core': [{'freq': 2, 'amp': 1, 'shapeType': 'it\\'s'}],"
+      " \"nuance\": [{\"freq\": 3, \"amp\": 0.5, \"shapeType\": \"don't\"}]}",
+      &ok);
+  EXPECT_TRUE(ok);
+  if (ok) {
+    EXPECT_EQ(spectrum.core[0].shape_type, std::string("it's"));
+    EXPECT_EQ(spectrum.nuance[0].shape_type, std::string("don't"));
+  }
+}
+
+ORBITA_TEST(SpectrumJson, RejectsMalformedText) {
+  const std::string json =
+      "{\"core\": [{\"freq\": 1.5, \"amp\": 0.25, \"shapeType\": \"a\"}]}";
+  HeptapodSpectrum spectrum;
+  for (size_t size = 0; size < json.size(); ++size) {
+    EXPECT_TRUE(!ParseSpectrumJson(json.substr(0, size), &spectrum));
+    EXPECT_TRUE(!ParseLenientSpectrumJson(json.data(), size, &spectrum));
+  }
+  EXPECT_TRUE(!ParseSpectrumJson("{'core': []}", &spectrum));
+  EXPECT_TRUE(!ParseSpectrumJson("{\"core\": [{\"freq\": 1e}]}", &spectrum));
+}
+
+}  // namespace
+}  // namespace orbita
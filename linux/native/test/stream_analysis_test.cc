@@ -0,0 +1,75 @@
+#include "stream_analysis.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "analysis.h"
+#include "test.h"
+
+namespace orbita {
+namespace {
+
+constexpr int kSize = 192;
+constexpr int kFrames = 24;
+constexpr double kPi = 3.14159265358979323846;
+
+// Frame |index| of a ring being written clockwise on white paper, with a
+// faint flicker elsewhere every few frames, as RGB.
+std::vector<uint8_t> WritingFrame(int index) {
+  std::vector<uint8_t> rgb(kSize * kSize * 3, 255);
+  const double drawn = 2 * kPi * (index + 1) / kFrames;
+  for (int y = 0; y < kSize; ++y) {
+    for (int x = 0; x < kSize; ++x) {
+      const double dx = x - kSize * 0.45;
+      const double dy = y - kSize * 0.55;
+      const double radius = std::hypot(dx, dy);
+      const double angle = std::atan2(dy, dx) + kPi;
+      uint8_t* pixel = &rgb[(y * kSize + x) * 3];
+      if (angle < drawn && radius > 40 + 6 * std::sin(angle * 5) &&
+          radius < 52) {
+        pixel[0] = pixel[1] = pixel[2] = 20;
+      }
+      if (index % 5 == 3 && x < 12 && y < 12) {
+        pixel[0] ^= 1;
+      }
+    }
+  }
+  return rgb;
+}
+
+// With a recentre tolerance of 0 every summary must be exactly the one a
+// full analysis of the frame gives, however little of it was redone.
+ORBITA_TEST(StreamingAnalyzer, ExactAtZeroTolerance) {
+  OrbitaAnalysisParams params;
+  orbita_analysis_params_init(&params);
+  StreamOptions options;
+  options.recenter_tolerance = 0;
+  StreamingAnalyzer analyzer(params, options);
+
+  int reused = 0;
+  for (int i = 0; i < kFrames; ++i) {
+    const std::vector<uint8_t> rgb = WritingFrame(i);
+    const ImageView view{rgb.data(), kSize, kSize, kSize * 3, 3};
+    OrbitaSpectrumSummary want;
+    EXPECT_EQ(AnalyzeImage(view, params, &want), ORBITA_OK);
+
+    LumaFrame frame;
+    frame.width = kSize;
+    frame.height = kSize;
+    frame.luma.resize(kSize * kSize);
+    LumaPlane(view, frame.luma.data());
+    OrbitaSpectrumSummary got;
+    FrameReuse reuse;
+    EXPECT_EQ(analyzer.Analyze(frame, &got, &reuse), ORBITA_OK);
+    EXPECT_TRUE(memcmp(&got, &want, sizeof(got)) == 0);
+    if (!reuse.full && reuse.dirty_tiles < reuse.tiles) {
+      ++reused;
+    }
+  }
+  // Otherwise the test would only show that full analyses agree.
+  EXPECT_TRUE(reused > kFrames / 2);
+}
+
+}  // namespace
+}  // namespace orbita
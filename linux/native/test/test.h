@@ -0,0 +1,81 @@
+#ifndef ORBITA_NATIVE_TEST_TEST_H_
+#define ORBITA_NATIVE_TEST_TEST_H_
+
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace orbita {
+namespace test {
+
+// A minimal test harness, so the native tests need nothing beyond the
+// library's own dependencies.
+//
+//   ORBITA_TEST(Fft, MatchesNaiveDft) {
+//     ...
+//     EXPECT_NEAR(got, want, 1e-12);
+//   }
+//
+// Tests register themselves and run in the order they are defined, file
+// by file; see test_main.cc. A failed expectation prints its location and
+// marks the test failed, but the test goes on.
+
+using TestBody = void (*)();
+
+// Adds the test |suite|.|name| to the run. Returns true, so it can
+// initialise a static.
+bool RegisterTest(const char* suite, const char* name, TestBody body);
+
+// Records a failure of the running test at |file|:|line|.
+void Fail(const char* file, int line, const std::string& message);
+
+template <typename T>
+std::string Describe(const T& value) {
+  std::ostringstream out;
+  out.precision(17);
+  out << value;
+  return out.str();
+}
+
+}  // namespace test
+}  // namespace orbita
+
+#define ORBITA_TEST(suite, name)                                          \
+  static void suite##_##name##_Test();                                    \
+  static const bool suite##_##name##_registered =                         \
+      ::orbita::test::RegisterTest(#suite, #name, suite##_##name##_Test); \
+  static void suite##_##name##_Test()
+
+#define EXPECT_TRUE(condition)                                          \
+  do {                                                                  \
+    if (!(condition)) {                                                 \
+      ::orbita::test::Fail(__FILE__, __LINE__, "expected " #condition); \
+    }                                                                   \
+  } while (0)
+
+#define EXPECT_EQ(actual, expected)                                       \
+  do {                                                                    \
+    const auto& orbita_actual = (actual);                                 \
+    const auto& orbita_expected = (expected);                             \
+    if (!(orbita_actual == orbita_expected)) {                            \
+      ::orbita::test::Fail(                                               \
+          __FILE__, __LINE__,                                             \
+          #actual " is " + ::orbita::test::Describe(orbita_actual) +      \
+              ", expected " + ::orbita::test::Describe(orbita_expected)); \
+    }                                                                     \
+  } while (0)
+
+#define EXPECT_NEAR(actual, expected, tolerance)                          \
+  do {                                                                    \
+    const double orbita_actual = (actual);                                \
+    const double orbita_expected = (expected);                            \
+    if (!(std::fabs(orbita_actual - orbita_expected) <= (tolerance))) {   \
+      ::orbita::test::Fail(                                               \
+          __FILE__, __LINE__,                                             \
+          #actual " is " + ::orbita::test::Describe(orbita_actual) +      \
+              ", expected " + ::orbita::test::Describe(orbita_expected) + \
+              " within " #tolerance);                                     \
+    }                                                                     \
+  } while (0)
+
+#endif  // ORBITA_NATIVE_TEST_TEST_H_
@@ -0,0 +1,67 @@
+// orbita_native_tests: unit tests of the native library.
+//
+//   orbita_native_tests [FILTER]
+//
+// Runs every test whose suite.name contains FILTER, or all of them, and
+// exits with status 1 if any failed.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace orbita {
+namespace test {
+namespace {
+
+struct TestCase {
+  std::string name;
+  TestBody body;
+};
+
+std::vector<TestCase>& Registry() {
+  static std::vector<TestCase>* tests = new std::vector<TestCase>();
+  return *tests;
+}
+
+int failures_in_test = 0;
+
+}  // namespace
+
+bool RegisterTest(const char* suite, const char* name, TestBody body) {
+  Registry().push_back({std::string(suite) + "." + name, body});
+  return true;
+}
+
+void Fail(const char* file, int line, const std::string& message) {
+  ++failures_in_test;
+  fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+}
+
+}  // namespace test
+}  // namespace orbita
+
+int main(int argc, char** argv) {
+  using orbita::test::Registry;
+  const char* filter = argc > 1 ? argv[1] : "";
+  int run = 0;
+  int failed = 0;
+  for (const orbita::test::TestCase& test : Registry()) {
+    if (strstr(test.name.c_str(), filter) == nullptr) {
+      continue;
+    }
+    orbita::test::failures_in_test = 0;
+    test.body();
+    ++run;
+    if (orbita::test::failures_in_test > 0) {
+      ++failed;
+    }
+    fprintf(stderr, "[%s] %s\n",
+            orbita::test::failures_in_test > 0 ? "FAIL" : " OK ",
+            test.name.c_str());
+  }
+  fprintf(stderr, "%d of %d tests passed\n", run - failed, run);
+  return failed == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace orbita {
+
+namespace {
+
+// The pool and worker index of the current thread, if it is a pool worker.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0) {
+    threads = static_cast<int>(
+        std::max(1u, std::thread::hardware_concurrency()));
+  }
+  for (int i = 0; i < threads; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  for (int i = 0; i < threads; ++i) {
+    workers_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_available_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  const int index = current_pool == this
+                        ? current_worker
+                        : static_cast<int>(next_queue_++ % queues_.size());
+  // Counted before it is pushed, so a worker that pops it at once never
+  // takes either count below the tasks still outstanding.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_;
+    ++queued_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+  work_available_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return pending_ == 0; });
+}
+
+bool ThreadPool::TryPop(int index, std::function<void()>* task) {
+  {
+    Queue& own = *queues_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  const size_t count = queues_.size();
+  for (size_t offset = 1; offset < count; ++offset) {
+    Queue& victim = *queues_[(index + offset) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int index) {
+  current_pool = this;
+  current_worker = index;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+      if (stopping_ && queued_ == 0) {
+        return;
+      }
+    }
+    std::function<void()> task;
+    if (!TryPop(index, &task)) {
+      // Another worker took it between the wake-up and the pop, or it is
+      // still being pushed.
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --queued_;
+    }
+    task();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) {
+      idle_.notify_all();
+    }
+  }
+}
+
+}  // namespace orbita
@@ -0,0 +1,63 @@
+#ifndef ORBITA_NATIVE_THREAD_POOL_H_
+#define ORBITA_NATIVE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace orbita {
+
+// Work-stealing pool for coarse jobs such as whole images in a batch.
+//
+// Every worker owns a deque: it pops its own work from the back and, once
+// that runs dry, steals from the front of the others. Tasks submitted from
+// outside the pool are dealt round-robin; tasks submitted from a worker go
+// to that worker's own deque. Fine-grained loops inside a job should use
+// ParallelFor instead.
+class ThreadPool {
+ public:
+  // |threads| <= 0 uses one thread per hardware thread.
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int size() const { return static_cast<int>(workers_.size()); }
+
+  void Submit(std::function<void()> task);
+
+  // Blocks until every submitted task has finished.
+  void Wait();
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void WorkerLoop(int index);
+  bool TryPop(int index, std::function<void()>* task);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<size_t> next_queue_{0};
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable idle_;
+  // Tasks submitted but not yet finished.
+  size_t pending_ = 0;
+  // Tasks sitting in a deque; workers sleep only when this is zero.
+  size_t queued_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace orbita
+
+#endif  // ORBITA_NATIVE_THREAD_POOL_H_
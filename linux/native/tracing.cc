@@ -0,0 +1,187 @@
+#include "tracing.h"
+
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "json_writer.h"
+
+namespace orbita {
+
+namespace internal {
+std::atomic<bool> tracing_enabled{false};
+}  // namespace internal
+
+namespace {
+
+// Events kept per thread; about 512 KiB each.
+constexpr size_t kRingCapacity = size_t{1} << 14;
+
+struct TraceEvent {
+  const char* name;
+  uint64_t start_ns;
+  // Spans only.
+  uint64_t end_ns;
+  // Counters only.
+  double value;
+  bool counter;
+};
+
+class TraceRing {
+ public:
+  explicit TraceRing(long thread_id) : thread_id_(thread_id) {}
+
+  void Append(const TraceEvent& event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.empty()) {
+      events_.resize(kRingCapacity);
+    }
+    events_[(first_ + count_) % kRingCapacity] = event;
+    if (count_ < kRingCapacity) {
+      ++count_;
+    } else {
+      first_ = (first_ + 1) % kRingCapacity;
+      ++dropped_;
+    }
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    first_ = 0;
+    count_ = 0;
+    dropped_ = 0;
+  }
+
+  // Appends the events to the traceEvents array in |out|, each preceded by
+  // a comma unless |*first_event|. Returns how many were overwritten.
+  uint64_t AppendJson(long pid, bool* first_event, std::string* out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    char ids[64];
+    snprintf(ids, sizeof(ids), ",\"pid\":%ld,\"tid\":%ld", pid, thread_id_);
+    for (size_t i = 0; i < count_; ++i) {
+      const TraceEvent& event = events_[(first_ + i) % kRingCapacity];
+      out->append(*first_event ? "\n" : ",\n");
+      *first_event = false;
+      out->append("{\"name\":");
+      AppendJsonString(out, event.name);
+      out->append(",\"cat\":\"orbita\",\"ph\":");
+      out->append(event.counter ? "\"C\"" : "\"X\"");
+      out->append(",\"ts\":");
+      AppendJsonNumber(out, event.start_ns / 1e3);
+      if (event.counter) {
+        out->append(",\"args\":{\"value\":");
+        AppendJsonNumber(out, event.value);
+        out->append("}");
+      } else {
+        out->append(",\"dur\":");
+        AppendJsonNumber(out, (event.end_ns - event.start_ns) / 1e3);
+      }
+      out->append(ids);
+      out->append("}");
+    }
+    return dropped_;
+  }
+
+ private:
+  const long thread_id_;
+  mutable std::mutex mutex_;
+  std::vector<TraceEvent> events_;
+  size_t first_ = 0;
+  size_t count_ = 0;
+  uint64_t dropped_ = 0;
+};
+
+// Every thread's ring, so the dump can find them. The registry keeps the
+// rings of threads that have exited until the next StartTracing().
+std::mutex registry_mutex;
+std::vector<std::shared_ptr<TraceRing>>* registry = nullptr;
+
+TraceRing& ThreadRing() {
+  thread_local std::shared_ptr<TraceRing> ring;
+  if (ring == nullptr) {
+    ring = std::make_shared<TraceRing>(syscall(SYS_gettid));
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (registry == nullptr) {
+      registry = new std::vector<std::shared_ptr<TraceRing>>();
+    }
+    registry->push_back(ring);
+  }
+  return *ring;
+}
+
+}  // namespace
+
+void StartTracing() {
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (registry != nullptr) {
+      std::vector<std::shared_ptr<TraceRing>> live;
+      for (std::shared_ptr<TraceRing>& ring : *registry) {
+        // Only the registry holds the rings of exited threads.
+        if (ring.use_count() > 1) {
+          ring->Clear();
+          live.push_back(std::move(ring));
+        }
+      }
+      registry->swap(live);
+    }
+  }
+  internal::tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+void StopTracing() {
+  internal::tracing_enabled.store(false, std::memory_order_relaxed);
+}
+
+std::string ChromeTraceJson() {
+  std::string json = "{\"traceEvents\":[";
+  bool first_event = true;
+  uint64_t dropped = 0;
+  const long pid = getpid();
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (registry != nullptr) {
+      for (const std::shared_ptr<TraceRing>& ring : *registry) {
+        dropped += ring->AppendJson(pid, &first_event, &json);
+      }
+    }
+  }
+  json.append("\n],\"displayTimeUnit\":\"ms\",");
+  json.append("\"otherData\":{\"droppedEvents\":");
+  AppendJsonNumber(&json, static_cast<double>(dropped));
+  json.append("}}\n");
+  return json;
+}
+
+bool WriteChromeTrace(const char* path) {
+  const std::string json = ChromeTraceJson();
+  FILE* file = fopen(path, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  const bool written = fwrite(json.data(), 1, json.size(), file) ==
+                       json.size();
+  return fclose(file) == 0 && written;
+}
+
+void RecordTraceSpan(const char* name, uint64_t start_ns, uint64_t end_ns) {
+  ThreadRing().Append(TraceEvent{name, start_ns, end_ns, 0, false});
+}
+
+void RecordTraceCounter(const char* name, double value) {
+  ThreadRing().Append(TraceEvent{name, TraceNowNs(), 0, value, true});
+}
+
+uint64_t TraceNowNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000u +
+         static_cast<uint64_t>(now.tv_nsec);
+}
+
+}  // namespace orbita
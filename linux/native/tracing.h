@@ -0,0 +1,92 @@
+#ifndef ORBITA_NATIVE_TRACING_H_
+#define ORBITA_NATIVE_TRACING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace orbita {
+
+// Low-overhead trace events for the native pipeline, written out in the
+// Chrome trace event format that chrome://tracing and ui.perfetto.dev
+// load.
+//
+// Each thread records into its own ring buffer, so recording threads never
+// contend: spans and counters are appended with a short uncontended lock
+// that only the dump ever competes for. A full buffer overwrites its
+// oldest events. While recording is off, a span costs one relaxed load and
+// one predictable branch when it opens, and a test of a null pointer when
+// it closes.
+//
+// Event names must be string literals or otherwise outlive the dump.
+
+namespace internal {
+extern std::atomic<bool> tracing_enabled;
+}  // namespace internal
+
+inline bool TracingEnabled() {
+  return internal::tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// Clears every buffer and starts recording.
+void StartTracing();
+// Stops recording. The events stay until the next StartTracing().
+void StopTracing();
+
+// The events recorded so far, oldest first per thread, as a Chrome trace
+// JSON object.
+std::string ChromeTraceJson();
+// Writes ChromeTraceJson() to |path|. Returns false if it cannot.
+bool WriteChromeTrace(const char* path);
+
+// Records a complete span; times are from TraceNowNs().
+void RecordTraceSpan(const char* name, uint64_t start_ns, uint64_t end_ns);
+// Records the value of counter |name| now.
+void RecordTraceCounter(const char* name, double value);
+// Monotonic time in nanoseconds.
+uint64_t TraceNowNs();
+
+// Records the span from its construction to the end of the scope, if
+// tracing was on when it opened.
+class ScopedTraceSpan {
+ public:
+  explicit ScopedTraceSpan(const char* name)
+      : name_(TracingEnabled() ? name : nullptr) {
+    if (name_ != nullptr) {
+      start_ns_ = TraceNowNs();
+    }
+  }
+  ~ScopedTraceSpan() {
+    if (name_ != nullptr) {
+      RecordTraceSpan(name_, start_ns_, TraceNowNs());
+    }
+  }
+
+  ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+  ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+ private:
+  const char* name_;
+  uint64_t start_ns_ = 0;
+};
+
+}  // namespace orbita
+
+#define ORBITA_TRACE_CONCAT_INNER(a, b) a##b
+#define ORBITA_TRACE_CONCAT(a, b) ORBITA_TRACE_CONCAT_INNER(a, b)
+
+// Traces the rest of the enclosing scope as |name|.
+#define ORBITA_TRACE_SPAN(name)                                   \
+  ::orbita::ScopedTraceSpan ORBITA_TRACE_CONCAT(orbita_trace_span_, \
+                                                __LINE__)(name)
+
+// Records |value| for counter |name| if tracing is on. |value| is not
+// evaluated otherwise.
+#define ORBITA_TRACE_COUNTER(name, value)             \
+  do {                                                \
+    if (::orbita::TracingEnabled()) {                 \
+      ::orbita::RecordTraceCounter((name), (value));  \
+    }                                                 \
+  } while (0)
+
+#endif  // ORBITA_NATIVE_TRACING_H_
@@ -0,0 +1,369 @@
+#include "analysis_channel.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "analysis.h"
+#include "job_scheduler.h"
+#include "result_cache.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "messages are encoded in host byte order");
+
+namespace {
+
+constexpr char kChannelName[] = "orbita/analysis";
+constexpr char kPreviewChannelName[] = "orbita/analysis/preview";
+
+// Matches AnalysisService.cacheCapacity.
+constexpr int kCacheCapacity = 65536;
+
+constexpr uint8_t kSourcePath = 0;
+constexpr uint8_t kSourceBytes = 1;
+constexpr uint8_t kFlagRays = 1 << 0;
+constexpr uint8_t kFlagSpectrum = 1 << 1;
+constexpr uint8_t kFlagProgressive = 1 << 2;
+constexpr size_t kRequestHeaderSize = 8;
+// The preview id before the payload of a progressive request.
+constexpr size_t kPreviewIdSize = 4;
+constexpr size_t kPreviewHeaderSize = 16;
+constexpr size_t kResponseHeaderSize = 16;
+constexpr size_t kSummaryValues = ORBITA_DOMINANT_BIN_COUNT + 2;
+
+// One request on its way through the scheduler and back to the main loop.
+struct Job {
+  Job(FlBinaryMessenger* messenger,
+      FlBinaryMessengerResponseHandle* handle,
+      GBytes* message)
+      : messenger(FL_BINARY_MESSENGER(g_object_ref(messenger))),
+        handle(FL_BINARY_MESSENGER_RESPONSE_HANDLE(g_object_ref(handle))),
+        message(message != nullptr ? g_bytes_ref(message)
+                                   : g_bytes_new(nullptr, 0)) {}
+
+  ~Job() {
+    g_object_unref(messenger);
+    g_object_unref(handle);
+    g_bytes_unref(message);
+    if (response != nullptr) {
+      g_bytes_unref(response);
+    }
+  }
+
+  FlBinaryMessenger* messenger;
+  FlBinaryMessengerResponseHandle* handle;
+  GBytes* message;
+  GBytes* response = nullptr;
+};
+
+// A preview of a progressive analysis on its way to the main loop.
+struct Preview {
+  Preview(FlBinaryMessenger* messenger, GBytes* message)
+      : messenger(FL_BINARY_MESSENGER(g_object_ref(messenger))),
+        message(message) {}
+
+  ~Preview() {
+    g_object_unref(messenger);
+    g_bytes_unref(message);
+  }
+
+  FlBinaryMessenger* messenger;
+  GBytes* message;
+};
+
+// The result cache under the XDG cache directory, where AnalysisService
+// keeps it too. Opened by the first request, on a scheduler thread, so an
+// app that never analyses an image does not pay for it.
+class LazyResultCache {
+ public:
+  // Null if the cache cannot be opened.
+  orbita::ResultCache* Get() {
+    std::call_once(opened_, [this] { cache_ = Open(); });
+    return cache_.get();
+  }
+
+ private:
+  static std::unique_ptr<orbita::ResultCache> Open() {
+    g_autofree gchar* dir =
+        g_build_filename(g_get_user_cache_dir(), "orbita", nullptr);
+    if (g_mkdir_with_parents(dir, 0755) != 0) {
+      return nullptr;
+    }
+    g_autofree gchar* path =
+        g_build_filename(dir, "analysis-results.bin", nullptr);
+    std::unique_ptr<orbita::ResultCache> cache(new orbita::ResultCache());
+    if (!cache->Open(path, kCacheCapacity)) {
+      return nullptr;
+    }
+    return cache;
+  }
+
+  std::once_flag opened_;
+  std::unique_ptr<orbita::ResultCache> cache_;
+};
+
+}  // namespace
+
+struct _AnalysisChannel {
+  GObject parent_instance;
+
+  FlBinaryMessenger* messenger;
+  // Shared with the jobs in flight, which may outlive the channel.
+  std::shared_ptr<LazyResultCache>* cache;
+};
+
+G_DEFINE_TYPE(AnalysisChannel, analysis_channel, G_TYPE_OBJECT)
+
+// Reads the scheduling fields of a request: its priority class and the key
+// it supersedes earlier requests under, empty for none.
+static void parse_schedule(GBytes* message,
+                           orbita::JobPriority* priority,
+                           std::string* key) {
+  gsize size = 0;
+  const uint8_t* data =
+      static_cast<const uint8_t*>(g_bytes_get_data(message, &size));
+  *priority = orbita::JobPriority::kInterpret;
+  if (size < kRequestHeaderSize) {
+    return;
+  }
+  if (data[2] < orbita::kJobPriorityCount) {
+    *priority = static_cast<orbita::JobPriority>(data[2]);
+  }
+  if (data[3] != 0) {
+    *key = "analysis/" + std::to_string(data[3]);
+  }
+}
+
+// Sends a preview. Runs on the main loop.
+static gboolean send_preview_cb(gpointer user_data) {
+  std::unique_ptr<Preview> preview(static_cast<Preview*>(user_data));
+  fl_binary_messenger_send_on_channel(preview->messenger, kPreviewChannelName,
+                                      preview->message, nullptr, nullptr,
+                                      nullptr);
+  return G_SOURCE_REMOVE;
+}
+
+// Queues a preview message for the main loop to send on |messenger|.
+static void queue_preview(FlBinaryMessenger* messenger,
+                          uint32_t id,
+                          const OrbitaSpectrumSummary& summary,
+                          int scale) {
+  double values[kSummaryValues];
+  memcpy(values, summary.dominant_frequencies,
+         sizeof(double) * ORBITA_DOMINANT_BIN_COUNT);
+  values[ORBITA_DOMINANT_BIN_COUNT] = summary.chaos_level;
+  values[ORBITA_DOMINANT_BIN_COUNT + 1] = summary.density;
+
+  uint8_t message[kPreviewHeaderSize + sizeof(values)] = {};
+  const int32_t scale32 = scale;
+  memcpy(message, &id, sizeof(id));
+  memcpy(message + 4, &scale32, sizeof(scale32));
+  memcpy(message + kPreviewHeaderSize, values, sizeof(values));
+  g_idle_add(send_preview_cb,
+             new Preview(messenger, g_bytes_new(message, sizeof(message))));
+}
+
+// A response reporting that a request failed with |status|.
+static GBytes* failure_response(OrbitaStatus status) {
+  const int32_t header[4] = {static_cast<int32_t>(status), 0, 0, 0};
+  return g_bytes_new(header, kResponseHeaderSize);
+}
+
+// Runs the request in |message| and encodes the response. Previews of a
+// progressive request go out on |messenger|.
+static GBytes* analyze(FlBinaryMessenger* messenger,
+                       GBytes* message,
+                       LazyResultCache* lazy_cache,
+                       const orbita::CancellationToken& cancel) {
+  gsize size = 0;
+  const uint8_t* data =
+      static_cast<const uint8_t*>(g_bytes_get_data(message, &size));
+
+  OrbitaStatus status = ORBITA_ERROR_INVALID_ARGUMENT;
+  OrbitaSpectrumSummary summary = {};
+  orbita::AnalysisDetail detail;
+  uint8_t flags = 0;
+  if (cancel.cancelled()) {
+    status = ORBITA_ERROR_CANCELLED;
+  } else if (size >= kRequestHeaderSize) {
+    orbita::ResultCache* cache = lazy_cache->Get();
+    flags = data[1];
+    OrbitaAnalysisParams params;
+    orbita_analysis_params_init(&params);
+    memcpy(&params.working_pixels, data + 4, sizeof(int32_t));
+    orbita::AnalysisDetail* wanted =
+        (flags & (kFlagRays | kFlagSpectrum)) != 0 ? &detail : nullptr;
+    const uint8_t* payload = data + kRequestHeaderSize;
+    size_t payload_size = size - kRequestHeaderSize;
+    const bool progressive = (flags & kFlagProgressive) != 0;
+    orbita::RefinementOptions refinement;
+    if (progressive && payload_size >= kPreviewIdSize) {
+      uint32_t id;
+      memcpy(&id, payload, sizeof(id));
+      payload += kPreviewIdSize;
+      payload_size -= kPreviewIdSize;
+      refinement.on_preview = [messenger, id](
+                                  const OrbitaSpectrumSummary& preview,
+                                  int scale) {
+        queue_preview(messenger, id, preview, scale);
+      };
+    }
+    if (progressive && !refinement.on_preview) {
+      // Too short for its preview id.
+    } else if (data[0] == kSourcePath) {
+      const std::string path(reinterpret_cast<const char*>(payload),
+                             payload_size);
+      status = progressive
+                   ? orbita::AnalyzeFileProgressive(path.c_str(), params,
+                                                    refinement, &summary,
+                                                    cache, wanted, &cancel)
+                   : orbita::AnalyzeFile(path.c_str(), params, &summary,
+                                         nullptr, cache, wanted, &cancel);
+    } else if (data[0] == kSourceBytes) {
+      status = progressive
+                   ? orbita::AnalyzeEncodedProgressive(
+                         payload, payload_size, params, refinement, &summary,
+                         cache, wanted, &cancel)
+                   : orbita::AnalyzeEncoded(payload, payload_size, params,
+                                            &summary, nullptr, cache, wanted,
+                                            &cancel);
+    }
+  }
+
+  if (status != ORBITA_OK) {
+    return failure_response(status);
+  }
+  int32_t header[4] = {ORBITA_OK, 0, 0, 0};
+  if ((flags & kFlagRays) != 0) {
+    header[1] = static_cast<int32_t>(detail.rays.size());
+  }
+  if ((flags & kFlagSpectrum) != 0) {
+    header[2] = static_cast<int32_t>(detail.spectrum.size());
+  }
+  double values[kSummaryValues];
+  memcpy(values, summary.dominant_frequencies,
+         sizeof(double) * ORBITA_DOMINANT_BIN_COUNT);
+  values[ORBITA_DOMINANT_BIN_COUNT] = summary.chaos_level;
+  values[ORBITA_DOMINANT_BIN_COUNT + 1] = summary.density;
+
+  const size_t total = kResponseHeaderSize + sizeof(values) +
+                       sizeof(double) * (header[1] + header[2]);
+  uint8_t* response = static_cast<uint8_t*>(g_malloc(total));
+  uint8_t* cursor = response;
+  memcpy(cursor, header, kResponseHeaderSize);
+  cursor += kResponseHeaderSize;
+  memcpy(cursor, values, sizeof(values));
+  cursor += sizeof(values);
+  if (header[1] > 0) {
+    memcpy(cursor, detail.rays.data(), sizeof(double) * header[1]);
+    cursor += sizeof(double) * header[1];
+  }
+  if (header[2] > 0) {
+    memcpy(cursor, detail.spectrum.data(), sizeof(double) * header[2]);
+  }
+  return g_bytes_new_take(response, total);
+}
+
+// Sends a finished job's response. Runs on the main loop.
+static gboolean send_response_cb(gpointer user_data) {
+  std::unique_ptr<Job> job(static_cast<Job*>(user_data));
+  g_autoptr(GError) error = nullptr;
+  if (!fl_binary_messenger_send_response(job->messenger, job->handle,
+                                         job->response, &error)) {
+    g_warning("Failed to send analysis response: %s", error->message);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void message_cb(FlBinaryMessenger* messenger,
+                       const gchar* channel,
+                       GBytes* message,
+                       FlBinaryMessengerResponseHandle* response_handle,
+                       gpointer user_data) {
+  AnalysisChannel* self = ANALYSIS_CHANNEL(user_data);
+  Job* job = new Job(messenger, response_handle, message);
+
+  std::shared_ptr<orbita::JobScheduler> scheduler =
+      orbita::JobScheduler::Shared();
+  if (scheduler == nullptr) {
+    job->response = failure_response(ORBITA_ERROR_CANCELLED);
+    send_response_cb(job);
+    return;
+  }
+  orbita::JobPriority priority;
+  std::string key;
+  parse_schedule(job->message, &priority, &key);
+  std::shared_ptr<LazyResultCache> cache = *self->cache;
+  scheduler->Submit(priority, key,
+                    [job, cache](const orbita::CancellationToken& cancel) {
+                      try {
+                        job->response = analyze(job->messenger, job->message,
+                                                cache.get(), cancel);
+                      } catch (const std::bad_alloc&) {
+                        job->response =
+                            failure_response(ORBITA_ERROR_OUT_OF_MEMORY);
+                      }
+                      g_idle_add(send_response_cb, job);
+                    });
+}
+
+// Implements GObject::dispose.
+static void analysis_channel_dispose(GObject* object) {
+  AnalysisChannel* self = ANALYSIS_CHANNEL(object);
+  if (self->messenger != nullptr) {
+    fl_binary_messenger_set_message_handler_on_channel(
+        self->messenger, kChannelName, nullptr, nullptr, nullptr);
+    g_clear_object(&self->messenger);
+  }
+  G_OBJECT_CLASS(analysis_channel_parent_class)->dispose(object);
+}
+
+// Implements GObject::finalize.
+static void analysis_channel_finalize(GObject* object) {
+  delete ANALYSIS_CHANNEL(object)->cache;
+  G_OBJECT_CLASS(analysis_channel_parent_class)->finalize(object);
+}
+
+static void analysis_channel_class_init(AnalysisChannelClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = analysis_channel_dispose;
+  G_OBJECT_CLASS(klass)->finalize = analysis_channel_finalize;
+}
+
+static void analysis_channel_init(AnalysisChannel* self) {
+  self->cache = new std::shared_ptr<LazyResultCache>(
+      std::make_shared<LazyResultCache>());
+}
+
+AnalysisChannel* analysis_channel_new(FlBinaryMessenger* messenger) {
+  AnalysisChannel* self =
+      ANALYSIS_CHANNEL(g_object_new(analysis_channel_get_type(), nullptr));
+  self->messenger = FL_BINARY_MESSENGER(g_object_ref(messenger));
+  fl_binary_messenger_set_message_handler_on_channel(
+      messenger, kChannelName, message_cb, self, nullptr);
+  return self;
+}
+
+void analysis_channel_warm_up(AnalysisChannel* self) {
+  g_return_if_fail(ANALYSIS_IS_CHANNEL(self));
+
+  std::shared_ptr<orbita::JobScheduler> scheduler =
+      orbita::JobScheduler::Shared();
+  if (scheduler == nullptr) {
+    return;
+  }
+  std::shared_ptr<LazyResultCache> cache = *self->cache;
+  scheduler->Submit(orbita::JobPriority::kBatch, "",
+                    [cache](const orbita::CancellationToken& cancel) {
+                      if (cancel.cancelled()) {
+                        return;
+                      }
+                      try {
+                        cache->Get();
+                      } catch (const std::bad_alloc&) {
+                        // The first request tries again.
+                      }
+                    });
+}
@@ -0,0 +1,90 @@
+#ifndef FLUTTER_ANALYSIS_CHANNEL_H_
+#define FLUTTER_ANALYSIS_CHANNEL_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(AnalysisChannel,
+                     analysis_channel,
+                     ANALYSIS,
+                     CHANNEL,
+                     GObject)
+
+/**
+ * AnalysisChannel:
+ *
+ * Serves image analysis on the `orbita/analysis` channel with raw binary
+ * messages, answered from the app's job scheduler so neither the GTK main
+ * loop nor the Dart UI thread waits on it. The Dart side is
+ * lib/data/services/analysis_channel.dart.
+ *
+ * A request with a non-zero key supersedes any earlier request with the
+ * same key: that one is cancelled between pipeline stages and answered
+ * with ORBITA_ERROR_CANCELLED. Each tab uses its own key, so only its
+ * latest image is analysed.
+ *
+ * All integers and doubles are little-endian. A request is:
+ *
+ * |[
+ *   0  uint8   source: 0 = file path, 1 = encoded JPEG or PNG bytes
+ *   1  uint8   flags: bit 0 = ray profile, bit 1 = spectrum,
+ *              bit 2 = progressive
+ *   2  uint8   orbita::JobPriority class, normally 1 (interpret)
+ *   3  uint8   supersede key, 0 for none
+ *   4  int32   working pixels (see OrbitaAnalysisParams)
+ *   8          the UTF-8 path, unterminated, or the image bytes
+ * ]|
+ *
+ * Its response is:
+ *
+ * |[
+ *   0  int32   OrbitaStatus; on failure the response ends at byte 16
+ *   4  int32   R, ray profile length, 0 unless requested
+ *   8  int32   B, spectrum length, 0 unless requested
+ *  12  int32   reserved, 0
+ *  16  double  dominant frequencies[5], chaos level, density
+ *  72  double  ray profile[R]
+ *      double  spectrum magnitudes[B], bins 0..R / 2 of the profile's DFT
+ * ]|
+ *
+ * Every double sits at a multiple of 8 bytes, so Dart can view the arrays
+ * in place. Summaries without detail are answered from the on-disk result
+ * cache AnalysisService also uses.
+ *
+ * A progressive request puts a uint32 preview id at byte 8, before the
+ * path or bytes. While it is analysed, each coarser estimate is sent on
+ * `orbita/analysis/preview` as
+ *
+ * |[
+ *   0  uint32  preview id
+ *   4  int32   source pixels per analysed pixel
+ *   8          reserved, 0
+ *  16  double  dominant frequencies[5], chaos level, density
+ * ]|
+ *
+ * before the response, so the UI can show something long before the
+ * full-resolution result arrives. A preview's chaos level is measured at
+ * its own resolution, so it runs higher than the final one.
+ */
+
+/**
+ * analysis_channel_new:
+ * @messenger: the #FlBinaryMessenger to listen on.
+ *
+ * Starts serving analysis requests on the scheduler started by
+ * my_application_startup. The result cache is only opened when the first
+ * request arrives.
+ *
+ * Returns: a new #AnalysisChannel.
+ */
+AnalysisChannel* analysis_channel_new(FlBinaryMessenger* messenger);
+
+/**
+ * analysis_channel_warm_up:
+ * @channel: an #AnalysisChannel.
+ *
+ * Opens the result cache in the background, so the first request does not
+ * wait for it. Call once the app is idle after startup.
+ */
+void analysis_channel_warm_up(AnalysisChannel* channel);
+
+#endif  // FLUTTER_ANALYSIS_CHANNEL_H_
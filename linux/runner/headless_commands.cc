@@ -0,0 +1,383 @@
+#include "headless_commands.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "batch_analysis.h"
+#include "batch_render.h"
+#include "logogram_synthesis.h"
+#include "morph_sequence.h"
+#include "similarity_index.h"
+#include "spectrum_archive.h"
+#include "stream_analysis.h"
+
+// Returns TRUE if any argument is the option |name|, as --name or
+// --name=value.
+static gboolean has_option(gchar** arguments, const gchar* name) {
+  for (gchar** argument = arguments; *argument != nullptr; ++argument) {
+    if (g_str_has_prefix(*argument, name)) {
+      const gchar next = (*argument)[strlen(name)];
+      if (next == '\0' || next == '=') {
+        return TRUE;
+      }
+    }
+  }
+  return FALSE;
+}
+
+static int run_analyze(gchar** arguments) {
+  g_autofree gchar* input = nullptr;
+  g_autofree gchar* output = nullptr;
+  g_autofree gchar* index = nullptr;
+  gint jobs = 0;
+  gint memory_budget = 0;
+  GOptionEntry entries[] = {
+      {"analyze", 0, 0, G_OPTION_ARG_FILENAME, &input,
+       "Analyze every image in a directory or matching a glob", "PATH"},
+      {"jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+       "Images analyzed concurrently (default: one per CPU)", "N"},
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+       "JSON Lines output file (default: stdout)", "FILE"},
+      {"index", 0, 0, G_OPTION_ARG_FILENAME, &index,
+       "Add every image to a similarity index, creating it if needed",
+       "FILE"},
+      {"memory-budget", 0, 0, G_OPTION_ARG_INT, &memory_budget,
+       "Scratch memory the jobs may hold at once (default: no limit)", "MB"},
+      {nullptr}};
+
+  g_autoptr(GOptionContext) context = g_option_context_new(nullptr);
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_auto(GStrv) argv = g_strdupv(arguments);
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse_strv(context, &argv, &error)) {
+    g_printerr("orbita: %s\n", error->message);
+    return 1;
+  }
+  if (input == nullptr || memory_budget < 0 || g_strv_length(argv) > 1) {
+    g_printerr(
+        "usage: orbita --analyze <dir|glob> [--jobs N] [--out FILE] "
+        "[--index FILE] [--memory-budget MB]\n");
+    return 1;
+  }
+
+  orbita::BatchAnalysisOptions options;
+  options.input = input;
+  if (output != nullptr) {
+    options.output = output;
+  }
+  if (index != nullptr) {
+    options.index = index;
+  }
+  options.jobs = jobs;
+  options.memory_limit = static_cast<int64_t>(memory_budget) * 1000000;
+  orbita_analysis_params_init(&options.params);
+  return orbita::RunBatchAnalysis(options);
+}
+
+static int run_similar(gchar** arguments) {
+  g_autofree gchar* image = nullptr;
+  g_autofree gchar* index = nullptr;
+  gint count = orbita::SimilaritySearchOptions().count;
+  GOptionEntry entries[] = {
+      {"similar", 0, 0, G_OPTION_ARG_FILENAME, &image,
+       "Find the indexed logograms most like an image's", "IMAGE"},
+      {"index", 0, 0, G_OPTION_ARG_FILENAME, &index,
+       "Similarity index built by --analyze --index", "FILE"},
+      {"count", 'n', 0, G_OPTION_ARG_INT, &count,
+       "Matches to print (default: 10)", "N"},
+      {nullptr}};
+
+  g_autoptr(GOptionContext) context = g_option_context_new(nullptr);
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_auto(GStrv) argv = g_strdupv(arguments);
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse_strv(context, &argv, &error)) {
+    g_printerr("orbita: %s\n", error->message);
+    return 1;
+  }
+  if (image == nullptr || index == nullptr || count <= 0 ||
+      g_strv_length(argv) > 1) {
+    g_printerr("usage: orbita --similar <image> --index FILE [--count N]\n");
+    return 1;
+  }
+
+  orbita::SimilaritySearchOptions options;
+  options.image = image;
+  options.index = index;
+  options.count = count;
+  orbita_analysis_params_init(&options.params);
+  return orbita::RunSimilaritySearch(options);
+}
+
+static int run_analyze_frames(gchar** arguments) {
+  g_autofree gchar* input = nullptr;
+  g_autofree gchar* output = nullptr;
+  g_autofree gchar* raw = nullptr;
+  gint change_threshold = 0;
+  gdouble recenter = orbita::StreamOptions().recenter_tolerance;
+  GOptionEntry entries[] = {
+      {"analyze-frames", 0, 0, G_OPTION_ARG_FILENAME, &input,
+       "Analyze each frame of a directory of numbered frames or a video",
+       "PATH"},
+      {"raw", 0, 0, G_OPTION_ARG_STRING, &raw,
+       "Read a headerless video of W x H frames of C channels (1, 3 or 4)",
+       "WxHxC"},
+      {"change-threshold", 0, 0, G_OPTION_ARG_INT, &change_threshold,
+       "Luma change a tile ignores between frames (default: 0)", "N"},
+      {"recenter", 0, 0, G_OPTION_ARG_DOUBLE, &recenter,
+       "Centroid movement before every ray is recast (default: 1, 0 for "
+       "exact results)",
+       "PX"},
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+       "JSON Lines output file (default: stdout)", "FILE"},
+      {nullptr}};
+
+  g_autoptr(GOptionContext) context = g_option_context_new(nullptr);
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_auto(GStrv) argv = g_strdupv(arguments);
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse_strv(context, &argv, &error)) {
+    g_printerr("orbita: %s\n", error->message);
+    return 1;
+  }
+  orbita::FrameAnalysisOptions options;
+  const gboolean raw_valid =
+      raw == nullptr ||
+      (sscanf(raw, "%dx%dx%d", &options.raw.width, &options.raw.height,
+              &options.raw.channels) == 3 &&
+       options.raw.width > 0);
+  if (input == nullptr || !raw_valid || change_threshold < 0 ||
+      recenter < 0 || g_strv_length(argv) > 1) {
+    g_printerr(
+        "usage: orbita --analyze-frames <dir|video.y4m> [--raw WxHxC] "
+        "[--change-threshold N] [--recenter PX] [--out FILE]\n");
+    return 1;
+  }
+
+  options.input = input;
+  if (output != nullptr) {
+    options.output = output;
+  }
+  options.stream.change_threshold = change_threshold;
+  options.stream.recenter_tolerance = recenter;
+  orbita_analysis_params_init(&options.params);
+  return orbita::RunFrameAnalysis(options);
+}
+
+static int run_morph(gchar** arguments) {
+  g_autofree gchar* to = nullptr;
+  g_autofree gchar* from = nullptr;
+  g_autofree gchar* output = nullptr;
+  gint frames = 60;
+  gint size = 1024;
+  gint seed = 1337;
+  GOptionEntry entries[] = {
+      {"morph", 0, 0, G_OPTION_ARG_FILENAME, &to,
+       "Animate into the logogram of a spectrum JSON file", "FILE"},
+      {"from", 0, 0, G_OPTION_ARG_FILENAME, &from,
+       "Spectrum JSON file to start from (default: write onto a blank "
+       "canvas)",
+       "FILE"},
+      {"frames", 0, 0, G_OPTION_ARG_INT, &frames,
+       "Frames in the sequence (default: 60)", "N"},
+      {"size", 0, 0, G_OPTION_ARG_INT, &size,
+       "Side of each frame in pixels (default: 1024)", "PX"},
+      {"seed", 0, 0, G_OPTION_ARG_INT, &seed,
+       "Logogram seed (default: the app's)", "N"},
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+       "Directory for frame_0000.png onwards", "DIR"},
+      {nullptr}};
+
+  g_autoptr(GOptionContext) context = g_option_context_new(nullptr);
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_auto(GStrv) argv = g_strdupv(arguments);
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse_strv(context, &argv, &error)) {
+    g_printerr("orbita: %s\n", error->message);
+    return 1;
+  }
+  if (to == nullptr || output == nullptr || g_strv_length(argv) > 1) {
+    g_printerr(
+        "usage: orbita --morph <to.json> [--from <from.json>] [--frames N] "
+        "[--size PX] [--seed N] --out DIR\n");
+    return 1;
+  }
+
+  orbita::MorphSequenceOptions options;
+  options.to = to;
+  if (from != nullptr) {
+    options.from = from;
+  }
+  options.output_dir = output;
+  options.frames = frames;
+  options.seed = seed;
+  orbita_render_style_init(&options.style);
+  options.style.width = size;
+  options.style.height = size;
+  return orbita::RunMorphSequence(options);
+}
+
+static int run_synthesize(gchar** arguments) {
+  g_autofree gchar* output = nullptr;
+  g_autofree gchar* spectra = nullptr;
+  gint64 count = 0;
+  gint size = orbita::SynthesisOptions().size;
+  gint64 seed = 0;
+  gint shard_size = orbita::SynthesisRunOptions().shard_size;
+  GOptionEntry entries[] = {
+      {"synthesize", 0, 0, G_OPTION_ARG_INT64, &count,
+       "Generate logogram masks straight from spectrum parameters", "N"},
+      {"spectra", 0, 0, G_OPTION_ARG_FILENAME, &spectra,
+       "JSON Lines file of spectra to use in turn (default: random ones)",
+       "FILE"},
+      {"size", 0, 0, G_OPTION_ARG_INT, &size,
+       "Side of each mask in pixels, a multiple of 8 (default: 256)", "PX"},
+      {"seed", 0, 0, G_OPTION_ARG_INT64, &seed,
+       "Seed of the first logogram (default: 0)", "N"},
+      {"shard-size", 0, 0, G_OPTION_ARG_INT, &shard_size,
+       "Logograms per shard file (default: 65536)", "N"},
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+       "Directory for shard_00000.bin onwards", "DIR"},
+      {nullptr}};
+
+  g_autoptr(GOptionContext) context = g_option_context_new(nullptr);
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_auto(GStrv) argv = g_strdupv(arguments);
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse_strv(context, &argv, &error)) {
+    g_printerr("orbita: %s\n", error->message);
+    return 1;
+  }
+  if (count <= 0 || output == nullptr || shard_size <= 0 ||
+      g_strv_length(argv) > 1) {
+    g_printerr(
+        "usage: orbita --synthesize N --out DIR [--spectra FILE] "
+        "[--size PX] [--seed N] [--shard-size N]\n");
+    return 1;
+  }
+
+  orbita::SynthesisRunOptions options;
+  options.count = count;
+  options.output_dir = output;
+  if (spectra != nullptr) {
+    options.spectra = spectra;
+  }
+  options.seed = static_cast<uint64_t>(seed);
+  options.shard_size = shard_size;
+  options.synthesis.size = size;
+  return orbita::RunSynthesis(options);
+}
+
+static int run_ingest(gchar** arguments) {
+  g_autofree gchar* input = nullptr;
+  g_autofree gchar* output = nullptr;
+  GOptionEntry entries[] = {
+      {"ingest", 0, 0, G_OPTION_ARG_FILENAME, &input,
+       "Archive a JSON Lines file of spectra in columnar form", "FILE"},
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+       "Spectrum archive to write", "FILE"},
+      {nullptr}};
+
+  g_autoptr(GOptionContext) context = g_option_context_new(nullptr);
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_auto(GStrv) argv = g_strdupv(arguments);
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse_strv(context, &argv, &error)) {
+    g_printerr("orbita: %s\n", error->message);
+    return 1;
+  }
+  if (input == nullptr || output == nullptr || g_strv_length(argv) > 1) {
+    g_printerr("usage: orbita --ingest <spectra.jsonl> --out FILE\n");
+    return 1;
+  }
+
+  orbita::SpectrumIngestOptions options;
+  options.input = input;
+  options.output = output;
+  return orbita::RunSpectrumIngest(options);
+}
+
+static int run_render(gchar** arguments) {
+  g_autofree gchar* input = nullptr;
+  g_autofree gchar* output = nullptr;
+  gint size = 2048;
+  gint seed = orbita::BatchRenderOptions().seed;
+  gboolean seed_from_id = FALSE;
+  gint jobs = 0;
+  GOptionEntry entries[] = {
+      {"render", 0, 0, G_OPTION_ARG_FILENAME, &input,
+       "Export the logogram of every spectrum in a JSON Lines file or "
+       "spectrum archive as a PNG",
+       "FILE"},
+      {"size", 0, 0, G_OPTION_ARG_INT, &size,
+       "Side of each image in pixels (default: 2048)", "PX"},
+      {"seed", 0, 0, G_OPTION_ARG_INT, &seed,
+       "Logogram seed (default: the app's)", "N"},
+      {"seed-from-id", 0, 0, G_OPTION_ARG_NONE, &seed_from_id,
+       "Derive each logogram's seed from --seed and its line in the input",
+       nullptr},
+      {"jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+       "Logograms rendered concurrently (default: one per CPU)", "N"},
+      {"out", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+       "Directory for logogram_<line>.png files", "DIR"},
+      {nullptr}};
+
+  g_autoptr(GOptionContext) context = g_option_context_new(nullptr);
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_auto(GStrv) argv = g_strdupv(arguments);
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse_strv(context, &argv, &error)) {
+    g_printerr("orbita: %s\n", error->message);
+    return 1;
+  }
+  if (input == nullptr || output == nullptr || size <= 0 ||
+      g_strv_length(argv) > 1) {
+    g_printerr(
+        "usage: orbita --render <spectra.jsonl> --out DIR [--size PX] "
+        "[--seed N] [--seed-from-id] [--jobs N]\n");
+    return 1;
+  }
+
+  orbita::BatchRenderOptions options;
+  options.input = input;
+  options.output_dir = output;
+  options.jobs = jobs;
+  options.seed = seed;
+  options.seed_from_id = seed_from_id;
+  orbita_render_style_init(&options.style);
+  options.style.width = size;
+  options.style.height = size;
+  return orbita::RunBatchRender(options);
+}
+
+gboolean headless_commands_run(gchar** arguments, int* exit_status) {
+  if (has_option(arguments, "--analyze")) {
+    *exit_status = run_analyze(arguments);
+    return TRUE;
+  }
+  if (has_option(arguments, "--analyze-frames")) {
+    *exit_status = run_analyze_frames(arguments);
+    return TRUE;
+  }
+  if (has_option(arguments, "--similar")) {
+    *exit_status = run_similar(arguments);
+    return TRUE;
+  }
+  if (has_option(arguments, "--morph")) {
+    *exit_status = run_morph(arguments);
+    return TRUE;
+  }
+  if (has_option(arguments, "--synthesize")) {
+    *exit_status = run_synthesize(arguments);
+    return TRUE;
+  }
+  if (has_option(arguments, "--ingest")) {
+    *exit_status = run_ingest(arguments);
+    return TRUE;
+  }
+  if (has_option(arguments, "--render")) {
+    *exit_status = run_render(arguments);
+    return TRUE;
+  }
+  return FALSE;
+}
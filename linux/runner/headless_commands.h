@@ -0,0 +1,41 @@
+#ifndef FLUTTER_HEADLESS_COMMANDS_H_
+#define FLUTTER_HEADLESS_COMMANDS_H_
+
+#include <glib.h>
+
+/**
+ * headless_commands_run:
+ * @arguments: (array zero-terminated=1): the full command line, including
+ *   the binary name.
+ * @exit_status: (out): return location for the process exit status.
+ *
+ * Runs a command that does not need a window:
+ *
+ * - `orbita --analyze <dir|glob> [--jobs N] [--out results.jsonl]
+ *   [--index FILE] [--memory-budget MB]` analyses images in bulk,
+ *   optionally adding them to a similarity index;
+ * - `orbita --analyze-frames <dir|video.y4m> [--raw WxHxC]
+ *   [--change-threshold N] [--recenter PX] [--out results.jsonl]`
+ *   analyses a recording frame by frame, reusing work between frames;
+ * - `orbita --similar <image> --index FILE [--count N]` lists the indexed
+ *   images whose logograms are most like @image's;
+ * - `orbita --morph <to.json> [--from <from.json>] [--frames N]
+ *   [--size PX] [--seed N] --out <dir>` renders the animation between two
+ *   spectra's logograms, or the writing of one, as numbered PNG frames;
+ * - `orbita --synthesize N --out <dir> [--spectra FILE] [--size PX]
+ *   [--seed N] [--shard-size N]` generates N logogram masks straight from
+ *   spectrum parameters into binary shards, for building datasets;
+ * - `orbita --ingest <spectra.jsonl> --out FILE` parses stored model
+ *   responses into a columnar spectrum archive, which --synthesize
+ *   --spectra and --render also read;
+ * - `orbita --render <spectra.jsonl> --out <dir> [--size PX] [--seed N]
+ *   [--seed-from-id] [--jobs N]` exports the logogram of every spectrum in
+ *   a JSON Lines file or archive as a PNG, as ImageSaver would, for
+ *   regenerating a catalogue's print assets.
+ *
+ * Returns: %TRUE if @arguments named a headless command, which has then run
+ * to completion and set @exit_status; %FALSE to start the UI as normal.
+ */
+gboolean headless_commands_run(gchar** arguments, int* exit_status);
+
+#endif  // FLUTTER_HEADLESS_COMMANDS_H_
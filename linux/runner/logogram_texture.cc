@@ -0,0 +1,561 @@
+#include "logogram_texture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "job_scheduler.h"
+#include "logogram_geometry.h"
+#include "logogram_morph.h"
+#include "logogram_raster.h"
+
+namespace {
+
+constexpr char kChannelName[] = "orbita/logogram_texture";
+constexpr char kPluginName[] = "LogogramTexture";
+constexpr char kPreviewJobKey[] = "preview";
+
+// Largest side accepted for a preview frame, in pixels.
+constexpr int64_t kMaxFrameSide = 8192;
+
+// Longest animation accepted, in milliseconds.
+constexpr int64_t kMaxDurationMs = 60000;
+
+using Clock = std::chrono::steady_clock;
+
+// Animations are paced to a 60 Hz display.
+constexpr Clock::duration kFramePeriod = std::chrono::microseconds(16667);
+
+// Time an animation frame may take to render. Frames over budget make the
+// following ones render at a lower resolution, which the engine stretches
+// to the widget, so the animation keeps pace with the display instead of
+// slowing down.
+constexpr Clock::duration kFrameBudget = std::chrono::milliseconds(12);
+constexpr double kMinFrameScale = 0.25;
+
+// How the logogram on screen turns into a newly requested one; the values
+// of LogogramTransition in lib/data/services/logogram_texture.dart.
+enum class Transition {
+  // Replaced at once.
+  kNone = 0,
+  // LogogramMorph from the logogram on screen.
+  kMorph = 1,
+  // LogogramMorph writing it onto a blank canvas.
+  kWrite = 2,
+};
+
+struct Frame {
+  std::vector<uint8_t> rgba;
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+struct RenderRequest {
+  OrbitaLogogramShape shape;
+  int32_t seed;
+  OrbitaRenderStyle style;
+  Transition transition = Transition::kNone;
+  Clock::duration duration{};
+};
+
+// What the render thread keeps between requests. No other thread uses it.
+struct RenderState {
+  // Geometry of the newest frame published at full resolution, or of the
+  // animation frame that was on screen when a new request cut it short.
+  std::shared_ptr<const orbita::LogogramGeometry> shown;
+  int32_t shown_width = 0;
+  int32_t shown_height = 0;
+  // Resolution of animation frames relative to the request, adapted to
+  // kFrameBudget.
+  double frame_scale = 1;
+  orbita::LogogramGeometry scratch;
+};
+
+}  // namespace
+
+// Frames pass between three slots so that neither thread ever waits on the
+// other's pixels:
+//  - back is drawn into by the render thread alone;
+//  - ready holds the newest finished frame, swapped with back when one is
+//    done;
+//  - front is what the engine is showing, swapped with ready when the
+//    engine asks for pixels. The engine uploads front right after
+//    copy_pixels returns, on the same thread, so it is never overwritten
+//    mid-upload.
+// Swaps only exchange vector storage and run under |mutex|.
+struct LogogramRenderer {
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  // Only the newest request is kept; ones the render thread has not
+  // started yet are superseded.
+  bool has_request = false;
+  RenderRequest request;
+  bool has_ready = false;
+  Frame back;
+  Frame ready;
+  Frame front;
+  std::thread thread;
+};
+
+struct _LogogramTexture {
+  FlPixelBufferTexture parent_instance;
+
+  // Holds this texture until logogram_texture_stop unregisters it, which
+  // breaks the reference cycle. Safe to use after the engine is gone.
+  FlTextureRegistrar* registrar;
+  FlMethodChannel* channel;
+  LogogramRenderer* renderer;
+};
+
+G_DEFINE_TYPE(LogogramTexture,
+              logogram_texture,
+              fl_pixel_buffer_texture_get_type())
+
+// Implements FlPixelBufferTexture::copy_pixels. Called on the raster thread.
+static gboolean logogram_texture_copy_pixels(FlPixelBufferTexture* texture,
+                                             const uint8_t** out_buffer,
+                                             uint32_t* width,
+                                             uint32_t* height,
+                                             GError** error) {
+  LogogramRenderer* renderer = LOGOGRAM_TEXTURE(texture)->renderer;
+  std::lock_guard<std::mutex> lock(renderer->mutex);
+  if (renderer->has_ready) {
+    std::swap(renderer->front, renderer->ready);
+    renderer->has_ready = false;
+  }
+  *out_buffer = renderer->front.rgba.data();
+  *width = renderer->front.width;
+  *height = renderer->front.height;
+  return TRUE;
+}
+
+// Rasterizes |geometry| in |style| into |frame|.
+static OrbitaStatus rasterize(const orbita::LogogramGeometry& geometry,
+                              const OrbitaRenderStyle& style,
+                              Frame* frame) {
+  frame->rgba.resize(static_cast<size_t>(style.width) * style.height * 4);
+  const OrbitaStatus status = orbita::RasterizeLogogram(
+      geometry, style, frame->rgba.data(), style.width * 4);
+  if (status == ORBITA_OK) {
+    frame->width = style.width;
+    frame->height = style.height;
+  }
+  return status;
+}
+
+// Rasterizes |request| into |frame| as a preview job on the app's
+// scheduler, ahead of analysis and exports, and stores the geometry drawn
+// in |geometry|.
+static OrbitaStatus render_frame(
+    const RenderRequest& request,
+    Frame* frame,
+    std::shared_ptr<const orbita::LogogramGeometry>* geometry) {
+  return orbita::RunScheduled(
+      orbita::JobPriority::kPreview, kPreviewJobKey,
+      [&request, frame, geometry](const orbita::CancellationToken* cancel) {
+        const OrbitaRenderStyle& style = request.style;
+        *geometry = orbita::LogogramGeometryCache::Shared().Get(
+            request.shape, request.seed, style.width, style.height);
+        if (orbita::IsCancelled(cancel)) {
+          return ORBITA_ERROR_CANCELLED;
+        }
+        return rasterize(**geometry, style, frame);
+      });
+}
+
+// Rasterizes |morph| |progress| of the way through into |frame| at |scale|
+// times the size of |style|, as a preview job.
+static OrbitaStatus render_morph_frame(const orbita::LogogramMorph& morph,
+                                       double progress,
+                                       double scale,
+                                       const OrbitaRenderStyle& style,
+                                       orbita::LogogramGeometry* scratch,
+                                       Frame* frame) {
+  return orbita::RunScheduled(
+      orbita::JobPriority::kPreview, kPreviewJobKey,
+      [&](const orbita::CancellationToken* cancel) {
+        OrbitaRenderStyle scaled = style;
+        scaled.width = std::max(1, static_cast<int32_t>(style.width * scale));
+        scaled.height =
+            std::max(1, static_cast<int32_t>(style.height * scale));
+        scaled.stroke_width = static_cast<float>(style.stroke_width * scale);
+        scaled.stroke_blur_sigma =
+            static_cast<float>(style.stroke_blur_sigma * scale);
+        scaled.particle_radius =
+            static_cast<float>(style.particle_radius * scale);
+        morph.Frame(progress, scale, scratch);
+        if (orbita::IsCancelled(cancel)) {
+          return ORBITA_ERROR_CANCELLED;
+        }
+        return rasterize(*scratch, scaled, frame);
+      });
+}
+
+// Hands the frame just drawn into the back slot to the engine, if |status|
+// says it was drawn. Returns FALSE if it was not.
+static gboolean publish_frame(LogogramTexture* self,
+                              const RenderRequest& request,
+                              OrbitaStatus status) {
+  LogogramRenderer* renderer = self->renderer;
+  if (status == ORBITA_ERROR_CANCELLED) {
+    return FALSE;
+  }
+  if (status != ORBITA_OK) {
+    g_warning("Failed to render a %dx%d logogram preview: %s",
+              request.style.width, request.style.height,
+              orbita_status_string(status));
+    return FALSE;
+  }
+  {
+    std::lock_guard<std::mutex> lock(renderer->mutex);
+    std::swap(renderer->back, renderer->ready);
+    renderer->has_ready = true;
+  }
+  // Thread-safe; the texture stays registered until the render thread is
+  // joined.
+  fl_texture_registrar_mark_texture_frame_available(self->registrar,
+                                                    FL_TEXTURE(self));
+  return TRUE;
+}
+
+// Draws |request| straight away.
+static void render_still(LogogramTexture* self,
+                         const RenderRequest& request,
+                         RenderState* state) {
+  std::shared_ptr<const orbita::LogogramGeometry> geometry;
+  const OrbitaStatus status =
+      render_frame(request, &self->renderer->back, &geometry);
+  if (publish_frame(self, request, status)) {
+    state->shown = std::move(geometry);
+    state->shown_width = request.style.width;
+    state->shown_height = request.style.height;
+  }
+}
+
+// Scales the resolution of animation frames so that one rendered in
+// |took| would have fit kFrameBudget. Render time grows with the pixel
+// count, so with the square of the scale.
+static void fit_frame_budget(Clock::duration took, RenderState* state) {
+  const double ratio = std::chrono::duration<double>(kFrameBudget).count() /
+                       std::chrono::duration<double>(took).count();
+  if (ratio >= 1 && ratio < 2) {
+    return;
+  }
+  // Recovers gradually, so one quick frame does not bring back a slow one.
+  const double factor = std::min(std::sqrt(ratio), 1.25);
+  state->frame_scale =
+      std::min(std::max(state->frame_scale * factor, kMinFrameScale), 1.0);
+}
+
+// How far the transition to |request| is |elapsed| after it started, from
+// 0 to 1.
+static double progress_at(const RenderRequest& request,
+                          Clock::duration elapsed) {
+  if (request.duration <= Clock::duration::zero()) {
+    return 1;
+  }
+  return std::min(1.0, std::chrono::duration<double>(elapsed).count() /
+                           std::chrono::duration<double>(request.duration)
+                               .count());
+}
+
+// Plays the transition to |request| frame by frame at display rate, each
+// frame showing the point the animation has reached by the wall clock. The
+// last frame is always drawn at full resolution. Returns early, leaving
+// the frame on screen in |state|, once a new request arrives.
+static void animate(LogogramTexture* self,
+                    const RenderRequest& request,
+                    RenderState* state) {
+  LogogramRenderer* renderer = self->renderer;
+  const OrbitaRenderStyle& style = request.style;
+  std::shared_ptr<const orbita::LogogramGeometry> target =
+      orbita::LogogramGeometryCache::Shared().Get(
+          request.shape, request.seed, style.width, style.height);
+  const orbita::LogogramMorph morph(
+      request.transition == Transition::kMorph ? state->shown : nullptr,
+      target);
+
+  const Clock::time_point start = Clock::now();
+  double shown_progress = 0;
+  bool anything_shown = false;
+  while (true) {
+    const Clock::time_point frame_start = Clock::now();
+    const double progress = progress_at(request, frame_start - start);
+    const bool last = progress >= 1;
+    const double scale = last ? 1.0 : state->frame_scale;
+    const OrbitaStatus status = render_morph_frame(
+        morph, progress, scale, style, &state->scratch, &renderer->back);
+    if (!last) {
+      fit_frame_budget(Clock::now() - frame_start, state);
+    }
+    if (publish_frame(self, request, status)) {
+      shown_progress = progress;
+      anything_shown = true;
+      if (last) {
+        state->shown = std::move(target);
+        state->shown_width = style.width;
+        state->shown_height = style.height;
+        return;
+      }
+    } else if (status != ORBITA_ERROR_CANCELLED) {
+      return;
+    }
+
+    // Sleeps until the display's next refresh, skipping any this frame
+    // overran.
+    const Clock::time_point next =
+        start + kFramePeriod * ((Clock::now() - start) / kFramePeriod + 1);
+    std::unique_lock<std::mutex> lock(renderer->mutex);
+    if (renderer->wake.wait_until(lock, next, [renderer] {
+          return renderer->stopping || renderer->has_request;
+        })) {
+      break;
+    }
+  }
+
+  if (anything_shown) {
+    auto current = std::make_shared<orbita::LogogramGeometry>();
+    morph.Frame(shown_progress, 1.0, current.get());
+    state->shown = std::move(current);
+    state->shown_width = style.width;
+    state->shown_height = style.height;
+  }
+}
+
+static void render_loop(LogogramTexture* self) {
+  LogogramRenderer* renderer = self->renderer;
+  RenderState state;
+  std::unique_lock<std::mutex> lock(renderer->mutex);
+  while (true) {
+    renderer->wake.wait(lock, [renderer] {
+      return renderer->stopping || renderer->has_request;
+    });
+    if (renderer->stopping) {
+      return;
+    }
+    const RenderRequest request = renderer->request;
+    renderer->has_request = false;
+    lock.unlock();
+
+    // A morph needs the logogram on screen, on a canvas of the same size.
+    const bool animated =
+        request.transition == Transition::kWrite ||
+        (request.transition == Transition::kMorph && state.shown != nullptr &&
+         state.shown_width == request.style.width &&
+         state.shown_height == request.style.height);
+    if (animated) {
+      animate(self, request, &state);
+    } else {
+      render_still(self, request, &state);
+    }
+    lock.lock();
+  }
+}
+
+// Returns the number stored under |key| in the map |args|, or FALSE if it
+// is missing or not a number.
+static gboolean lookup_number(FlValue* args, const gchar* key, double* out) {
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (value == nullptr) {
+    return FALSE;
+  }
+  switch (fl_value_get_type(value)) {
+    case FL_VALUE_TYPE_INT:
+      *out = fl_value_get_int(value);
+      return TRUE;
+    case FL_VALUE_TYPE_FLOAT:
+      *out = fl_value_get_float(value);
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+// Returns the integer stored under |key| in the map |args|, or FALSE if it
+// is missing or not an integer.
+static gboolean lookup_int(FlValue* args, const gchar* key, int64_t* out) {
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return FALSE;
+  }
+  *out = fl_value_get_int(value);
+  return TRUE;
+}
+
+// Reads the arguments of a `render` call.
+static gboolean parse_render_request(FlValue* args, RenderRequest* request) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  int64_t seed, width, height, background, stroke, particle;
+  double stroke_width, stroke_blur_sigma, particle_radius;
+  if (!lookup_number(args, "coreAmplitude", &request->shape.core_amplitude) ||
+      !lookup_number(args, "nuanceChaos", &request->shape.nuance_chaos) ||
+      !lookup_number(args, "nuanceAmplitude",
+                     &request->shape.nuance_amplitude) ||
+      !lookup_int(args, "seed", &seed) || !lookup_int(args, "width", &width) ||
+      !lookup_int(args, "height", &height) ||
+      !lookup_int(args, "backgroundArgb", &background) ||
+      !lookup_int(args, "strokeArgb", &stroke) ||
+      !lookup_number(args, "strokeWidth", &stroke_width) ||
+      !lookup_number(args, "strokeBlurSigma", &stroke_blur_sigma) ||
+      !lookup_int(args, "particleArgb", &particle) ||
+      !lookup_number(args, "particleRadius", &particle_radius)) {
+    return FALSE;
+  }
+  if (width <= 0 || height <= 0 || width > kMaxFrameSide ||
+      height > kMaxFrameSide) {
+    return FALSE;
+  }
+  int64_t transition = 0;
+  int64_t duration_ms = 0;
+  if (fl_value_lookup_string(args, "transition") != nullptr &&
+      (!lookup_int(args, "transition", &transition) ||
+       !lookup_int(args, "durationMs", &duration_ms) || transition < 0 ||
+       transition > static_cast<int64_t>(Transition::kWrite) ||
+       duration_ms < 0 || duration_ms > kMaxDurationMs)) {
+    return FALSE;
+  }
+  request->transition = static_cast<Transition>(transition);
+  request->duration = std::chrono::milliseconds(duration_ms);
+  request->seed = static_cast<int32_t>(seed);
+  OrbitaRenderStyle& style = request->style;
+  style.width = static_cast<int32_t>(width);
+  style.height = static_cast<int32_t>(height);
+  style.background_argb = static_cast<uint32_t>(background);
+  style.stroke_argb = static_cast<uint32_t>(stroke);
+  style.stroke_width = static_cast<float>(stroke_width);
+  style.stroke_blur_sigma = static_cast<float>(stroke_blur_sigma);
+  style.particle_argb = static_cast<uint32_t>(particle);
+  style.particle_radius = static_cast<float>(particle_radius);
+  return TRUE;
+}
+
+static FlMethodResponse* handle_render(LogogramTexture* self, FlValue* args) {
+  RenderRequest request;
+  if (!parse_render_request(args, &request)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid-arguments", "Malformed logogram render request", nullptr));
+  }
+  LogogramRenderer* renderer = self->renderer;
+  {
+    std::lock_guard<std::mutex> lock(renderer->mutex);
+    renderer->request = request;
+    renderer->has_request = true;
+    // Started by the first request rather than at app startup.
+    if (!renderer->stopping && !renderer->thread.joinable()) {
+      renderer->thread = std::thread(render_loop, self);
+    }
+  }
+  renderer->wake.notify_one();
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  LogogramTexture* self = LOGOGRAM_TEXTURE(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, "textureId") == 0) {
+    g_autoptr(FlValue) id =
+        fl_value_new_int(fl_texture_get_id(FL_TEXTURE(self)));
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(id));
+  } else if (strcmp(method, "render") == 0) {
+    response = handle_render(self, fl_method_call_get_args(method_call));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send response: %s", error->message);
+  }
+}
+
+// Joins the render thread and stops listening for requests.
+static void stop_rendering(LogogramTexture* self) {
+  LogogramRenderer* renderer = self->renderer;
+  {
+    std::lock_guard<std::mutex> lock(renderer->mutex);
+    renderer->stopping = true;
+  }
+  renderer->wake.notify_one();
+  if (renderer->thread.joinable()) {
+    renderer->thread.join();
+  }
+
+  if (self->channel != nullptr) {
+    fl_method_channel_set_method_call_handler(self->channel, nullptr, nullptr,
+                                              nullptr);
+    g_clear_object(&self->channel);
+  }
+}
+
+// Implements GObject::dispose. Only reached once unregistered, as the
+// registrar holds a reference until then.
+static void logogram_texture_dispose(GObject* object) {
+  stop_rendering(LOGOGRAM_TEXTURE(object));
+  G_OBJECT_CLASS(logogram_texture_parent_class)->dispose(object);
+}
+
+// Implements GObject::finalize.
+static void logogram_texture_finalize(GObject* object) {
+  delete LOGOGRAM_TEXTURE(object)->renderer;
+  G_OBJECT_CLASS(logogram_texture_parent_class)->finalize(object);
+}
+
+static void logogram_texture_class_init(LogogramTextureClass* klass) {
+  FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels =
+      logogram_texture_copy_pixels;
+  G_OBJECT_CLASS(klass)->dispose = logogram_texture_dispose;
+  G_OBJECT_CLASS(klass)->finalize = logogram_texture_finalize;
+}
+
+static void logogram_texture_init(LogogramTexture* self) {
+  self->renderer = new LogogramRenderer();
+  // A transparent pixel until the first frame is ready.
+  self->renderer->front.rgba.assign(4, 0);
+  self->renderer->front.width = 1;
+  self->renderer->front.height = 1;
+}
+
+LogogramTexture* logogram_texture_new(FlPluginRegistry* registry) {
+  LogogramTexture* self =
+      LOGOGRAM_TEXTURE(g_object_new(logogram_texture_get_type(), nullptr));
+
+  g_autoptr(FlPluginRegistrar) registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, kPluginName);
+  self->registrar = FL_TEXTURE_REGISTRAR(
+      g_object_ref(fl_plugin_registrar_get_texture_registrar(registrar)));
+  fl_texture_registrar_register_texture(self->registrar, FL_TEXTURE(self));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  self->channel = fl_method_channel_new(
+      fl_plugin_registrar_get_messenger(registrar), kChannelName,
+      FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(self->channel, method_call_cb,
+                                            self, nullptr);
+
+  return self;
+}
+
+void logogram_texture_stop(LogogramTexture* self) {
+  g_return_if_fail(LOGOGRAM_IS_TEXTURE(self));
+
+  stop_rendering(self);
+  if (self->registrar != nullptr) {
+    fl_texture_registrar_unregister_texture(self->registrar, FL_TEXTURE(self));
+    g_clear_object(&self->registrar);
+  }
+}
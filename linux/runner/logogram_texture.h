@@ -0,0 +1,56 @@
+#ifndef FLUTTER_LOGOGRAM_TEXTURE_H_
+#define FLUTTER_LOGOGRAM_TEXTURE_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(LogogramTexture,
+                     logogram_texture,
+                     LOGOGRAM,
+                     TEXTURE,
+                     FlPixelBufferTexture)
+
+/**
+ * LogogramTexture:
+ *
+ * A live logogram preview rendered natively and shown by a Dart `Texture`
+ * widget.
+ *
+ * Dart asks for frames over the `orbita/logogram_texture` method channel:
+ * `textureId` returns the id to give the widget, and `render` takes the
+ * spectrum shape, seed, size in physical pixels and style of the next frame.
+ * A background thread, started by the first request, rasterizes the
+ * newest request with orbita_native, reusing its geometry cache, and only
+ * signals the engine that a frame is available. The engine then reads the
+ * pixels straight from the finished buffer, so no pixels ever cross the
+ * channel.
+ *
+ * A `render` request may also ask for a transition lasting `durationMs`:
+ * `transition` 1 morphs the logogram on screen into the new one, and 2
+ * writes the new one onto a blank canvas (see orbita::LogogramMorph). The
+ * render thread then draws frames paced to the display, dropping their
+ * resolution whenever one overruns its time budget, and finishes on a
+ * full-resolution frame. A request arriving mid-animation morphs on from
+ * the frame on screen.
+ */
+
+/**
+ * logogram_texture_new:
+ * @registry: the #FlPluginRegistry of the view to show the preview in.
+ *
+ * Registers a new preview texture with the view's engine and starts
+ * listening for render requests.
+ *
+ * Returns: a new #LogogramTexture.
+ */
+LogogramTexture* logogram_texture_new(FlPluginRegistry* registry);
+
+/**
+ * logogram_texture_stop:
+ * @texture: a #LogogramTexture.
+ *
+ * Stops the render thread, dropping any pending request, and unregisters
+ * the texture. Call before the view's engine shuts down.
+ */
+void logogram_texture_stop(LogogramTexture* texture);
+
+#endif  // FLUTTER_LOGOGRAM_TEXTURE_H_
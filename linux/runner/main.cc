@@ -1,6 +1,13 @@
 #include "my_application.h"
+#include "native_trace.h"
+#include "startup_trace.h"
 
 int main(int argc, char** argv) {
+  startup_trace_start(&argc, argv);
+  native_trace_start(&argc, argv);
   g_autoptr(MyApplication) app = my_application_new();
-  return g_application_run(G_APPLICATION(app), argc, argv);
+  startup_trace_mark("my_application_new");
+  const int status = g_application_run(G_APPLICATION(app), argc, argv);
+  native_trace_finish();
+  return status;
 }
@@ -5,23 +5,50 @@
 #include <gdk/gdkx.h>
 #endif
 
+#include "analysis_channel.h"
 #include "flutter/generated_plugin_registrant.h"
+#include "headless_commands.h"
+#include "job_scheduler.h"
+#include "logogram_texture.h"
+#include "native_trace.h"
+#include "parallel.h"
+#include "startup_trace.h"
 
 struct _MyApplication {
   GtkApplication parent_instance;
   char** dart_entrypoint_arguments;
+  AnalysisChannel* analysis_channel;
+  LogogramTexture* logogram_texture;
+  FlMethodChannel* trace_channel;
 };
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
 
+// Starts the native worker threads and opens the analysis result cache,
+// which nothing needs before the first frame. Runs once the main loop is
+// idle after it.
+static gboolean warm_up_cb(gpointer user_data) {
+  MyApplication* self = MY_APPLICATION(user_data);
+  orbita::JobScheduler::Shared();
+  orbita::ParallelConcurrency();
+  if (self->analysis_channel != nullptr) {
+    analysis_channel_warm_up(self->analysis_channel);
+  }
+  return G_SOURCE_REMOVE;
+}
+
 // Called when first Flutter frame received.
 static void first_frame_cb(MyApplication* self, FlView* view) {
   gtk_widget_show(gtk_widget_get_toplevel(GTK_WIDGET(view)));
+  startup_trace_finish();
+  g_idle_add_full(G_PRIORITY_LOW, warm_up_cb, g_object_ref(self),
+                  g_object_unref);
 }
 
 // Implements GApplication::activate.
 static void my_application_activate(GApplication* application) {
   MyApplication* self = MY_APPLICATION(application);
+  startup_trace_mark("activate");
   GtkWindow* window =
       GTK_WINDOW(gtk_application_window_new(GTK_APPLICATION(application)));
 
@@ -53,12 +80,15 @@ static void my_application_activate(GApplication* application) {
   }
 
   gtk_window_set_default_size(window, 1280, 720);
+  startup_trace_mark("window created");
 
   g_autoptr(FlDartProject) project = fl_dart_project_new();
   fl_dart_project_set_dart_entrypoint_arguments(
       project, self->dart_entrypoint_arguments);
+  startup_trace_mark("fl_dart_project_new");
 
   FlView* view = fl_view_new(project);
+  startup_trace_mark("fl_view_new");
   GdkRGBA background_color;
   // Background defaults to black, override it here if necessary, e.g. #00000000
   // for transparent.
@@ -72,8 +102,19 @@ static void my_application_activate(GApplication* application) {
   g_signal_connect_swapped(view, "first-frame", G_CALLBACK(first_frame_cb),
                            self);
   gtk_widget_realize(GTK_WIDGET(view));
+  startup_trace_mark("view realized");
 
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
+  startup_trace_mark("plugins registered");
+  // Image analysis for AnalysisService, answered off the main loop.
+  self->analysis_channel = analysis_channel_new(
+      fl_engine_get_binary_messenger(fl_view_get_engine(view)));
+  // Live logogram preview, drawn natively off the UI thread.
+  self->logogram_texture = logogram_texture_new(FL_PLUGIN_REGISTRY(view));
+  // Native trace recording, for profiling a running app.
+  self->trace_channel = native_trace_channel_new(
+      fl_engine_get_binary_messenger(fl_view_get_engine(view)));
+  startup_trace_mark("native channels");
 
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
@@ -83,6 +124,12 @@ static gboolean my_application_local_command_line(GApplication* application,
                                                   gchar*** arguments,
                                                   int* exit_status) {
   MyApplication* self = MY_APPLICATION(application);
+  startup_trace_mark("local_command_line");
+  // Batch commands such as --analyze run here and exit without a window.
+  if (headless_commands_run(*arguments, exit_status)) {
+    return TRUE;
+  }
+
   // Strip out the first argument as it is the binary name.
   self->dart_entrypoint_arguments = g_strdupv(*arguments + 1);
 
@@ -92,6 +139,7 @@ static gboolean my_application_local_command_line(GApplication* application,
     *exit_status = 1;
     return TRUE;
   }
+  startup_trace_mark("g_application_register");
 
   g_application_activate(application);
   *exit_status = 0;
@@ -103,16 +151,26 @@ static gboolean my_application_local_command_line(GApplication* application,
 static void my_application_startup(GApplication* application) {
   // MyApplication* self = MY_APPLICATION(object);
 
-  // Perform any actions required at application startup.
+  // Runs preview, analysis and export work by priority; see job_scheduler.h.
+  // Its threads start after the first frame, or with the first job if one
+  // comes sooner.
+  orbita::JobScheduler::DeferShared(/*threads=*/0);
 
   G_APPLICATION_CLASS(my_application_parent_class)->startup(application);
+  startup_trace_mark("gtk startup");
 }
 
 // Implements GApplication::shutdown.
 static void my_application_shutdown(GApplication* application) {
-  // MyApplication* self = MY_APPLICATION(object);
+  MyApplication* self = MY_APPLICATION(application);
 
-  // Perform any actions required at application shutdown.
+  // Stop rendering and release the preview texture before exit.
+  if (self->logogram_texture != nullptr) {
+    logogram_texture_stop(self->logogram_texture);
+  }
+  // Cancels whatever is still queued or running; analysis requests are
+  // answered as cancelled.
+  orbita::JobScheduler::StopShared();
 
   G_APPLICATION_CLASS(my_application_parent_class)->shutdown(application);
 }
@@ -121,6 +179,9 @@ static void my_application_shutdown(GApplication* application) {
 static void my_application_dispose(GObject* object) {
   MyApplication* self = MY_APPLICATION(object);
   g_clear_pointer(&self->dart_entrypoint_arguments, g_strfreev);
+  g_clear_object(&self->analysis_channel);
+  g_clear_object(&self->logogram_texture);
+  g_clear_object(&self->trace_channel);
   G_OBJECT_CLASS(my_application_parent_class)->dispose(object);
 }
 
@@ -0,0 +1,113 @@
+#include "native_trace.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include "tracing.h"
+
+namespace {
+
+constexpr char kChannelName[] = "orbita/trace";
+constexpr char kOption[] = "--trace-out=";
+
+// The --trace-out file, or null.
+gchar* trace_out_path = nullptr;
+
+// A new file for a trace in the user cache directory, or null if the
+// directory cannot be created.
+gchar* default_trace_path() {
+  g_autofree gchar* dir =
+      g_build_filename(g_get_user_cache_dir(), "orbita", "traces", nullptr);
+  if (g_mkdir_with_parents(dir, 0755) != 0) {
+    return nullptr;
+  }
+  g_autoptr(GDateTime) now = g_date_time_new_now_local();
+  g_autofree gchar* name =
+      g_date_time_format(now, "trace-%Y%m%d-%H%M%S.json");
+  return g_build_filename(dir, name, nullptr);
+}
+
+FlMethodResponse* handle_stop(FlValue* args) {
+  orbita::StopTracing();
+
+  g_autofree gchar* path = nullptr;
+  FlValue* path_value = args != nullptr &&
+                                fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                            ? fl_value_lookup_string(args, "path")
+                            : nullptr;
+  if (path_value != nullptr &&
+      fl_value_get_type(path_value) == FL_VALUE_TYPE_STRING) {
+    path = g_strdup(fl_value_get_string(path_value));
+  } else {
+    path = default_trace_path();
+  }
+  if (path == nullptr || !orbita::WriteChromeTrace(path)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "io", "Cannot write the trace", nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_string(path);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+void method_call_cb(FlMethodChannel* channel,
+                    FlMethodCall* method_call,
+                    gpointer user_data) {
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, "start") == 0) {
+    orbita::StartTracing();
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else if (strcmp(method, "stop") == 0) {
+    response = handle_stop(fl_method_call_get_args(method_call));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send response: %s", error->message);
+  }
+}
+
+}  // namespace
+
+void native_trace_start(int* argc, char** argv) {
+  const size_t length = strlen(kOption);
+  int kept = 0;
+  for (int i = 0; i < *argc; ++i) {
+    if (i > 0 && strncmp(argv[i], kOption, length) == 0) {
+      g_free(trace_out_path);
+      trace_out_path = g_strdup(argv[i] + length);
+      continue;
+    }
+    argv[kept++] = argv[i];
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+
+  if (trace_out_path != nullptr) {
+    orbita::StartTracing();
+  }
+}
+
+void native_trace_finish() {
+  if (trace_out_path == nullptr) {
+    return;
+  }
+  orbita::StopTracing();
+  if (!orbita::WriteChromeTrace(trace_out_path)) {
+    g_warning("Failed to write the trace to %s: %s", trace_out_path,
+              strerror(errno));
+  }
+  g_clear_pointer(&trace_out_path, g_free);
+}
+
+FlMethodChannel* native_trace_channel_new(FlBinaryMessenger* messenger) {
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  FlMethodChannel* channel =
+      fl_method_channel_new(messenger, kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb, nullptr,
+                                            nullptr);
+  return channel;
+}
@@ -0,0 +1,53 @@
+#ifndef FLUTTER_NATIVE_TRACE_H_
+#define FLUTTER_NATIVE_TRACE_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+/**
+ * SECTION:native_trace
+ *
+ * Controls the native pipeline's trace events (see
+ * linux/native/tracing.h): spans for decoding, preprocessing, ray casting,
+ * the spectrum, geometry, rasterisation and PNG encoding, plus a few
+ * counters, written as Chrome trace JSON that chrome://tracing and
+ * ui.perfetto.dev open.
+ *
+ * Recording covers a whole run when the app is started with
+ * `--trace-out=FILE`, headless commands included, or any stretch of a
+ * running app over the `orbita/trace` method channel:
+ *
+ * - `start` clears earlier events and starts recording.
+ * - `stop` stops recording and writes the events to the `path` argument,
+ *   or to a new file in the user cache directory without one. It returns
+ *   the path written.
+ */
+
+/**
+ * native_trace_start:
+ * @argc: (inout): the argument count passed to `main()`.
+ * @argv: (inout) (array length=argc): the arguments passed to `main()`.
+ *
+ * Removes any `--trace-out=FILE` option from @argv and, if there was one,
+ * starts recording. Call early in `main()`.
+ */
+void native_trace_start(int* argc, char** argv);
+
+/**
+ * native_trace_finish:
+ *
+ * Writes the events to the `--trace-out` file, if one was given. Call
+ * once the application has finished running.
+ */
+void native_trace_finish();
+
+/**
+ * native_trace_channel_new:
+ * @messenger: the #FlBinaryMessenger to listen on.
+ *
+ * Starts answering `orbita/trace` calls on the main thread.
+ *
+ * Returns: the new #FlMethodChannel; dropping it stops answering.
+ */
+FlMethodChannel* native_trace_channel_new(FlBinaryMessenger* messenger);
+
+#endif  // FLUTTER_NATIVE_TRACE_H_
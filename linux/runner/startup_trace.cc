@@ -0,0 +1,162 @@
+#include "startup_trace.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace {
+
+constexpr char kOption[] = "--startup-trace";
+constexpr int kMaxMarks = 32;
+
+struct Mark {
+  const gchar* phase;
+  gint64 time;
+};
+
+struct StartupTrace {
+  gboolean enabled = FALSE;
+  gboolean finished = FALSE;
+  // Where the JSON report goes, or null for the table on stderr.
+  gchar* path = nullptr;
+  gboolean has_process_start = FALSE;
+  // Relative to main(), in microseconds.
+  gint64 process_start = 0;
+  Mark marks[kMaxMarks];
+  int mark_count = 0;
+};
+
+StartupTrace trace;
+
+gint64 boot_time_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_BOOTTIME, &now);
+  return gint64{now.tv_sec} * G_USEC_PER_SEC + now.tv_nsec / 1000;
+}
+
+// When the kernel started this process, in microseconds on the
+// CLOCK_BOOTTIME clock, from field 22 of /proc/self/stat.
+gboolean read_process_start(gint64* out) {
+  g_autofree gchar* stat = nullptr;
+  if (!g_file_get_contents("/proc/self/stat", &stat, nullptr, nullptr)) {
+    return FALSE;
+  }
+  // The command name in field 2 may contain spaces, but not after its
+  // closing parenthesis.
+  const gchar* fields = strrchr(stat, ')');
+  if (fields == nullptr) {
+    return FALSE;
+  }
+  g_auto(GStrv) values = g_strsplit(fields + 2, " ", 0);
+  // Field 3 is the first after the command name.
+  constexpr guint kStartTimeIndex = 22 - 3;
+  if (g_strv_length(values) <= kStartTimeIndex) {
+    return FALSE;
+  }
+  const long ticks_per_second = sysconf(_SC_CLK_TCK);
+  if (ticks_per_second <= 0) {
+    return FALSE;
+  }
+  const guint64 ticks =
+      g_ascii_strtoull(values[kStartTimeIndex], nullptr, 10);
+  *out = static_cast<gint64>(ticks * G_USEC_PER_SEC / ticks_per_second);
+  return TRUE;
+}
+
+double milliseconds(gint64 microseconds) {
+  return microseconds / 1000.0;
+}
+
+void write_table() {
+  const gint64 main_time = trace.marks[0].time;
+  g_printerr("orbita: startup trace, ms since main()\n");
+  if (trace.has_process_start) {
+    g_printerr("%9.1f           process start\n",
+               milliseconds(trace.process_start));
+  }
+  gint64 previous = main_time;
+  for (int i = 0; i < trace.mark_count; ++i) {
+    const Mark& mark = trace.marks[i];
+    g_printerr("%9.1f %+8.1f  %s\n", milliseconds(mark.time - main_time),
+               milliseconds(mark.time - previous), mark.phase);
+    previous = mark.time;
+  }
+}
+
+void write_json(const gchar* path) {
+  const gint64 main_time = trace.marks[0].time;
+  g_autoptr(GString) json = g_string_new("{");
+  if (trace.has_process_start) {
+    g_string_append_printf(json, "\"processStartMs\": %.3f, ",
+                           milliseconds(trace.process_start));
+  }
+  g_string_append(json, "\"phases\": [");
+  for (int i = 0; i < trace.mark_count; ++i) {
+    // Phase names are plain ASCII literals, so need no escaping.
+    g_string_append_printf(json, "%s{\"name\": \"%s\", \"ms\": %.3f}",
+                           i > 0 ? ", " : "", trace.marks[i].phase,
+                           milliseconds(trace.marks[i].time - main_time));
+  }
+  g_string_append(json, "]}\n");
+
+  g_autoptr(GError) error = nullptr;
+  if (!g_file_set_contents(path, json->str, json->len, &error)) {
+    g_warning("Failed to write the startup trace: %s", error->message);
+  }
+}
+
+}  // namespace
+
+void startup_trace_start(int* argc, char** argv) {
+  const gint64 main_boot_time = boot_time_us();
+  startup_trace_mark("main");
+
+  gint64 process_start;
+  if (read_process_start(&process_start)) {
+    trace.has_process_start = TRUE;
+    trace.process_start = process_start - main_boot_time;
+  }
+
+  int kept = 0;
+  for (int i = 0; i < *argc; ++i) {
+    const gchar* argument = argv[i];
+    const size_t length = strlen(kOption);
+    if (i > 0 && strncmp(argument, kOption, length) == 0 &&
+        (argument[length] == '\0' || argument[length] == '=')) {
+      trace.enabled = TRUE;
+      g_clear_pointer(&trace.path, g_free);
+      if (argument[length] == '=') {
+        trace.path = g_strdup(argument + length + 1);
+      }
+      continue;
+    }
+    argv[kept++] = argv[i];
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+}
+
+void startup_trace_mark(const gchar* phase) {
+  if (trace.finished || trace.mark_count == kMaxMarks) {
+    return;
+  }
+  trace.marks[trace.mark_count++] = Mark{phase, g_get_monotonic_time()};
+}
+
+void startup_trace_finish() {
+  if (trace.finished) {
+    return;
+  }
+  startup_trace_mark("first frame");
+  trace.finished = TRUE;
+  if (!trace.enabled) {
+    return;
+  }
+  if (trace.path != nullptr) {
+    write_json(trace.path);
+  } else {
+    write_table();
+  }
+  g_clear_pointer(&trace.path, g_free);
+}
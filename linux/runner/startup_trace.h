@@ -0,0 +1,55 @@
+#ifndef FLUTTER_STARTUP_TRACE_H_
+#define FLUTTER_STARTUP_TRACE_H_
+
+#include <glib.h>
+
+/**
+ * SECTION:startup_trace
+ *
+ * Timestamps of the phases between `main()` and the first Flutter frame,
+ * taken from the monotonic clock. Marks are always recorded, which costs a
+ * clock read each; they are only reported when the app is started with
+ * `--startup-trace`, as a table on stderr, or `--startup-trace=FILE`, as a
+ * JSON object:
+ *
+ * |[
+ *   {"processStartMs": -41.0,
+ *    "phases": [{"name": "main", "ms": 0.0}, ...]}
+ * ]|
+ *
+ * All times are milliseconds since `main()`. processStartMs is when the
+ * kernel started the process, which includes loading the shared
+ * libraries, and is only accurate to a clock tick (usually 10 ms).
+ *
+ * Only call these from the main thread.
+ */
+
+/**
+ * startup_trace_start:
+ * @argc: (inout): the argument count passed to `main()`.
+ * @argv: (inout) (array length=argc): the arguments passed to `main()`.
+ *
+ * Records the "main" phase and removes any `--startup-trace` option from
+ * @argv, so that neither GApplication nor Dart sees it. Call first thing
+ * in `main()`.
+ */
+void startup_trace_start(int* argc, char** argv);
+
+/**
+ * startup_trace_mark:
+ * @phase: a static string naming the phase that just ended.
+ *
+ * Records the time @phase ended. Marks after startup_trace_finish() are
+ * ignored.
+ */
+void startup_trace_mark(const gchar* phase);
+
+/**
+ * startup_trace_finish:
+ *
+ * Records the "first frame" phase and writes the report, if one was asked
+ * for. Call when the first Flutter frame is shown.
+ */
+void startup_trace_finish();
+
+#endif  // FLUTTER_STARTUP_TRACE_H_
@@ -0,0 +1,114 @@
+import 'dart:math';
+import 'dart:ui';
+import 'package:fast_noise/fast_noise.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:orbita/data/models/heptapod_spectrum.dart';
+import 'package:orbita/data/models/wave_layer.dart';
+import 'package:orbita/ui/painters/heptapod_geometry.dart';
+
+// The native geometry and noise (linux/native) reproduce these bit for bit,
+// and linux/native/test/simplex_noise_test.cc pins the same noise values.
+// A change here means exports no longer match the preview.
+
+/// (x, y) of point [index] of [geometry].
+List<double> _point(HeptapodGeometry geometry, int index) =>
+    [geometry.pointBuffer[index * 2], geometry.pointBuffer[index * 2 + 1]];
+
+void main() {
+  final spectrum = HeptapodSpectrum(
+    coreLayer: [WaveLayer(frequency: 4, amplitude: 0.5, chaosFactor: 0.1)],
+    narrativeLayer: [WaveLayer(frequency: 10, amplitude: 0.3)],
+    nuanceLayer: [WaveLayer(frequency: 30, amplitude: 0.1, chaosFactor: 0.8)],
+  );
+
+  group('Random', () {
+    test('draws the sequence the native DartRandom mirrors', () {
+      final random = Random(1337);
+      expect(random.nextDouble(), 0.528322467588213);
+      expect(random.nextDouble(), 0.72747218583868);
+      expect(Random(0).nextDouble(), 0.8255140718871702);
+      expect(Random(-5).nextDouble(), 0.7235720321336252);
+      expect(Random(1337).nextInt(30), 16);
+      expect(Random(1338).nextInt(30), 5);
+    });
+  });
+
+  group('SimplexNoise', () {
+    test('matches the native noise golden values', () {
+      double noise(int seed, double x, double y) =>
+          SimplexNoise(seed: seed, frequency: HeptapodGeometry.noiseFrequency)
+              .getNoise2(x, y);
+
+      expect(noise(1337, 0, 0), 0.0);
+      expect(noise(1337, 1, 0), -0.031225482994025004);
+      expect(noise(1337, 123.4, -56.7), 0.48306427256805146);
+      expect(noise(1337, -3000.25, 2999.5), 0.015621016713729667);
+      expect(noise(42, 10, 1000), 0.2865987875);
+      expect(noise(42, 512.5, -0.125), 0.04816480073626776);
+      expect(noise(-7, 123456.789, -98765.4321), 0.17400809378311557);
+      expect(noise(-7, -37.75, 81.0625), 0.5006803254966031);
+    });
+  });
+
+  group('HeptapodGeometry.build', () {
+    test('lays out 50 layers of a loop and 8 tendrils of 7 branches', () {
+      final geometry = HeptapodGeometry.build(spectrum,
+          seed: 123, size: const Size(400, 300));
+
+      expect(geometry.pointBuffer.length, 76850 * 2);
+      expect(geometry.polylineBuffer.length, 2850 * 4);
+      expect(geometry.particleBuffer.length, 36 * 2);
+      // The layer 0 main loop, then its first tendril branch.
+      expect(geometry.polylineBuffer.sublist(0, 8),
+          [0, 361, 1, 0, 361, 21, 0, 0]);
+    });
+
+    test('pins the points for seed 123', () {
+      final geometry = HeptapodGeometry.build(spectrum,
+          seed: 123, size: const Size(400, 300));
+
+      expect(_point(geometry, 0), [299.99859619140625, 150.46546936035156]);
+      expect(_point(geometry, 361), [285.80291748046875, 100.10913848876953]);
+      expect(_point(geometry, 38425), [300.3121337890625, 148.9015655517578]);
+      expect(_point(geometry, 76849), [209.91299438476562, 284.2444763183594]);
+      expect(geometry.particleBuffer.sublist(0, 2),
+          [332.1741027832031, 112.00359344482422]);
+    });
+
+    test('pins the points for seed 1337', () {
+      final geometry = HeptapodGeometry.build(spectrum,
+          seed: 1337, size: const Size(400, 300));
+
+      expect(_point(geometry, 0), [297.9234924316406, 150.46530151367188]);
+      expect(_point(geometry, 361), [100.33850860595703, 132.5420379638672]);
+      expect(_point(geometry, 38425), [297.37359619140625, 150.07809448242188]);
+      expect(_point(geometry, 76849),
+          [-25.394197463989258, -69.21891784667969]);
+      expect(geometry.particleBuffer.sublist(70),
+          [122.04348754882812, 126.55208587646484]);
+    });
+
+    test('draws no tendrils for a silent spectrum', () {
+      final geometry = HeptapodGeometry.build(
+          HeptapodSpectrum(coreLayer: [], narrativeLayer: [], nuanceLayer: []),
+          seed: 7,
+          size: const Size(100, 100));
+
+      expect(geometry.pointBuffer.length, 361 * 50 * 2);
+      expect(geometry.polylineBuffer.length, 50 * 4);
+      expect(geometry.particleBuffer.length, 30 * 2);
+      expect(_point(geometry, 0), [84.37312316894531, 50.1561279296875]);
+    });
+
+    test('matches HeptapodGeometry.of', () {
+      final built = HeptapodGeometry.build(spectrum,
+          seed: 1337, size: const Size(640, 480));
+      final cached = HeptapodGeometry.of(spectrum,
+          seed: 1337, size: const Size(640, 480));
+
+      expect(cached.pointBuffer, built.pointBuffer);
+      expect(cached.polylineBuffer, built.polylineBuffer);
+      expect(cached.particleBuffer, built.particleBuffer);
+    });
+  });
+}